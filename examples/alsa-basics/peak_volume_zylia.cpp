@@ -2,142 +2,89 @@
 #include <iostream>
 #include <iomanip>
 #include <cmath> // Add this at the top for std::abs
+#include <vector>
+#include "../poc-saf/capture_device.h"
+#include "../poc-saf/sample_convert.h"
+
+// Peak levels come from the same fused convert + meter kernels the
+// localization pipeline uses, for whatever native format the device
+// negotiated. Build with:
+//   g++ -O2 peak_volume_zylia.cpp ../poc-saf/pcm_device.cpp ../poc-saf/capture_device.cpp ../poc-saf/sample_convert.cpp ../poc-saf/level_meter.cpp -lasound
 
-// hw: no conversion, less configurable
-// plughw: software conversion, more configurable, automatic resampling
-const char* device_in_use = "plughw:2,0";
 const int mic_channels = 19;
-// Zylia uses 24 bit, Linux is LE (echo -n I | od -to2 | head -n1 | cut -f2 -d"
-// " | cut -c6 # 1 LE, 0 BE), signed is standard
-const snd_pcm_format_t mic_format = SND_PCM_FORMAT_S24_LE;
-int dir = 0; // rounding direction of sample rate: -1 = accurate or first
-// bellow, 0 = accurate, 1 = accurate or first above
-unsigned int mic_sample_rate = 48000;
-snd_pcm_uframes_t mic_period_size = 1024; // in frames
-snd_pcm_uframes_t mic_buffer_size = mic_period_size * 4;
-// latency = period_size / (sample_rate) * 1000 ms; with values from
-// above:: 21.33 ms
-
-int init_mic(snd_pcm_t* pcm_handle, snd_pcm_hw_params_t*& hw_params)
-{
-    int err;
-    bool success = true;
-    int debug = 0;
-    snd_pcm_hw_params_malloc(&hw_params); // Allocates the parameter container
-    snd_pcm_hw_params_any(pcm_handle, hw_params); // Init with full default configuration
-    snd_pcm_hw_params_set_access(
-        pcm_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED); // Access mode:
-    // SND_PCM_ACCESS_RW_INTERLEAVED (LRLR;
-    // standard) or
-    // SND_PCM_ACCESS_RW_NONINTERLEAVED (LLRR)
-    snd_pcm_hw_params_set_format(pcm_handle, hw_params,
-                                 mic_format); // Sets sample format (Signed 16-bit, Float, etc.).
-                                 snd_pcm_hw_params_set_channels(pcm_handle, hw_params, mic_channels);
-                                 snd_pcm_hw_params_set_rate_near(pcm_handle, hw_params, &mic_sample_rate, &dir);
-                                 snd_pcm_hw_params_set_period_size_near(pcm_handle, hw_params, &mic_period_size,
-                                                                        &dir); // Sets interrupt interval size.
-                                 snd_pcm_hw_params_set_buffer_size_near(pcm_handle, hw_params, &mic_buffer_size); // Sets total ring buffer size.
-                                 err = snd_pcm_hw_params(pcm_handle, hw_params); // Applies the configuration
-                                 if (err) {
-                                     std::cout << "Error setting HW params: " << snd_strerror(err) << std::endl;
-                                     success = false;
-                                 }
-                                 return success;
-}
 
-int main()
+int main(int argc, char** argv)
 {
     std::cout << "Starting ALSA test program..." << std::endl;
-    std::cout << snd_pcm_format_width(mic_format) << std::endl;
-    snd_pcm_t* pcm_handle = nullptr; // Handle for the PCM audio stream of a sound device
-    snd_pcm_hw_params_t* hw_params = nullptr;
-    snd_ctl_t* ctl_handle = nullptr; // Handle for the control interface (card capabilities).
-    snd_pcm_stream_t stream;
-
-    // SND_PCM_STREAM_PLAYBACK (Output) or SND_PCM_STREAM_CAPTURE (Input)
-    if (snd_pcm_open(&pcm_handle, device_in_use, SND_PCM_STREAM_CAPTURE, 0)) {
-        std::cout << "Error opening PCM device " << device_in_use << std::endl;
+
+    CaptureDeviceConfig config;
+    config.channels = mic_channels;
+    if (argc > 1) pcm_device_select(config, argv[1]); // default: the ZM-1 by name
+
+    CaptureDevice device;
+    if (!capture_device_open(device, config)) {
+        std::cout << "Failed to initialize microphone." << std::endl;
         return -1;
     }
-    if (init_mic(pcm_handle, hw_params)) {
-        snd_pcm_prepare(pcm_handle); //  Prepares the PCM for IO after config or overrun
-        snd_pcm_start(pcm_handle); // Explicitly starts the PCM
-
-        // Save a period to the buffer
-        int32_t* buffer = new int32_t[mic_period_size * mic_channels];
-
-        // Loop to visualize audio data
-        std::cout << "Capturing... (Make some noise!)" << std::endl;
-
-        for(int i = 0; i < 500; ++i) {
-            snd_pcm_sframes_t rc = snd_pcm_readi(pcm_handle, buffer, mic_period_size);
-
-            if (rc == -EPIPE) {
-                // Buffer full
-                // std::cout << "Overrun occurred." << std::endl; // Commented out to reduce spam
-                snd_pcm_prepare(pcm_handle);
-            } else if (rc < 0) {
-                std::cout << "Error: " << snd_strerror(rc) << std::endl;
-            } else {
-                // Calculate Peak Amplitude for all 19 channels
-                // Data is interleaved: [Ch1, Ch2... Ch19, Ch1, Ch2...]
-                int32_t max_vals[mic_channels] = {0};
-
-                for(int f = 0; f < rc; ++f) {
-                    for(int ch = 0; ch < mic_channels; ++ch) {
-                        int32_t sample = buffer[f * mic_channels + ch];
-
-                        // Fix 24-bit sign extension in 32-bit integer
-                        // Shift left 8 bits (to push sign bit to MSB), then arithmetic right shift
-                        sample = (sample << 8) >> 8;
-
-                        if (std::abs(sample) > max_vals[ch]) {
-                            max_vals[ch] = std::abs(sample);
-                        }
-                    }
-                }
-
-                // Clear screen and move cursor to top
-                std::cout << "\033[2J\033[H";
-
-                // Draw VU Meters for all 19 channels using dB scale
-                // 24-bit max value is 2^23 = 8,388,608
-                const float max_24bit = 8388608.0f;
-                const float min_db = -60.0f; // Minimum dB to display
-
-                for(int ch = 0; ch < mic_channels; ++ch) {
-                    float db;
-                    if (max_vals[ch] > 0) {
-                        db = 20.0f * log10f((float)max_vals[ch] / max_24bit);
-                    } else {
-                        db = min_db;
-                    }
-                    if (db < min_db) db = min_db;
-
-                    // Map dB range [min_db, 0] to [0, 40] bars
-                    int bars = (int)(((db - min_db) / (-min_db)) * 40);
-                    if (bars < 0) bars = 0;
-                    if (bars > 40) bars = 40;
-
-                    std::cout << "Ch" << (ch + 1 < 10 ? " " : "") << (ch + 1) << " [";
-                    for(int b = 0; b < bars; ++b) std::cout << "#";
-                    for(int b = bars; b < 40; ++b) std::cout << " ";
-                    std::cout << "] " << std::fixed << std::setprecision(1) << std::setw(6) << db << " dB" << std::endl;
-                }
-                std::cout << std::flush;
+    pcm_device_report(device, stdout);
+
+    snd_pcm_t* pcm_handle = device.pcm;
+    snd_pcm_prepare(pcm_handle); //  Prepares the PCM for IO after config or overrun
+    snd_pcm_start(pcm_handle); // Explicitly starts the PCM
+
+    // Save a period to the buffer
+    const int frames = (int)device.period_frames;
+    std::vector<uint8_t> buffer((size_t)frames * pcm_device_frame_bytes(device));
+    std::vector<float> channel_data((size_t)frames * mic_channels);
+    float* channels[mic_channels];
+    for (int ch = 0; ch < mic_channels; ++ch) channels[ch] = &channel_data[(size_t)ch * frames];
+
+    // Loop to visualize audio data
+    std::cout << "Capturing... (Make some noise!)" << std::endl;
+
+    for(int i = 0; i < 500; ++i) {
+        snd_pcm_sframes_t rc = snd_pcm_readi(pcm_handle, buffer.data(), frames);
+
+        if (rc == -EPIPE) {
+            // Buffer full
+            // std::cout << "Overrun occurred." << std::endl; // Commented out to reduce spam
+            snd_pcm_prepare(pcm_handle);
+        } else if (rc < 0) {
+            std::cout << "Error: " << snd_strerror(rc) << std::endl;
+        } else {
+            // Peak amplitude for all 19 channels, measured while converting
+            // (sign extension and normalization to [-1, 1) happen in the kernel)
+            LevelAccum levels[mic_channels];
+            convert_to_float_channels(buffer.data(), device.format, channels, rc, mic_channels, levels);
+
+            // Clear screen and move cursor to top
+            std::cout << "\033[2J\033[H";
+
+            // Draw VU Meters for all 19 channels using dB scale (relative to full scale)
+            const float min_db = -60.0f; // Minimum dB to display
+
+            for(int ch = 0; ch < mic_channels; ++ch) {
+                float db = level_to_db(levels[ch].peak);
+                if (db < min_db) db = min_db;
+
+                // Map dB range [min_db, 0] to [0, 40] bars
+                int bars = (int)(((db - min_db) / (-min_db)) * 40);
+                if (bars < 0) bars = 0;
+                if (bars > 40) bars = 40;
+
+                std::cout << "Ch" << (ch + 1 < 10 ? " " : "") << (ch + 1) << " [";
+                for(int b = 0; b < bars; ++b) std::cout << "#";
+                for(int b = bars; b < 40; ++b) std::cout << " ";
+                std::cout << "] " << std::fixed << std::setprecision(1) << std::setw(6) << db << " dB" << std::endl;
             }
+            std::cout << std::flush;
         }
+    }
 
-        std::cout << std::endl << "Capture finished." << std::endl;
-
-        delete[] buffer; // Clean up memory
+    std::cout << std::endl << "Capture finished." << std::endl;
 
-        snd_pcm_drop(pcm_handle); // stops stream; drops remaining data
-        snd_pcm_close(pcm_handle); // Close PCM, free resources
-    } else {
-        std::cout << "Failed to initialize microphone." << std::endl;
-        return -1;
-    }
+    snd_pcm_drop(pcm_handle); // stops stream; drops remaining data
+    pcm_device_close(device); // Close PCM, free resources
 
     std::cout << "ALSA test program finished successful." << std::endl;
     return 0;
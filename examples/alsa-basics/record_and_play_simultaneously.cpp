@@ -1,123 +1,562 @@
 #include "alsa/asoundlib.h"
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include "../poc-saf/capture_device.h"
+#include "../poc-saf/playback_device.h"
+#include "../poc-saf/rt_config.h"
+#include "../poc-saf/stage_stats.h"
 
-#define PCM_REC_DEVICE "hw:3,0"
-#define PCM_PLAY_DEVICE "hw:1,0"
-#define SAMPLE_RATE 44100
-#define REC_CHANNELS 1
-#define PLAY_CHANNELS 2
-#define DURATION_SECONDS 2
-#define BUFFER_SIZE 4096
-
-int main() {
-  snd_pcm_t *rec_handle, *play_handle;
-  snd_pcm_hw_params_t *rec_params, *play_params;
-  unsigned int rate = SAMPLE_RATE;
-  int err;
-  int total_frames = SAMPLE_RATE * DURATION_SECONDS;
-  char *buffer = new char[BUFFER_SIZE];
-
-  // Open PCM device for recording
-  if ((err = snd_pcm_open(&rec_handle, PCM_REC_DEVICE, SND_PCM_STREAM_CAPTURE,
-                          0)) < 0) {
-    std::cerr << "Error opening recording device: " << snd_strerror(err)
-              << std::endl;
-    return 1;
-  }
-  std::cout << "Recording from " << PCM_REC_DEVICE << " for "
-            << DURATION_SECONDS << " seconds..." << std::endl;
-
-  // Set recording hardware parameters
-  snd_pcm_hw_params_malloc(&rec_params);
-  snd_pcm_hw_params_any(rec_handle, rec_params);
-  snd_pcm_hw_params_set_access(rec_handle, rec_params,
-                               SND_PCM_ACCESS_RW_INTERLEAVED);
-  snd_pcm_hw_params_set_format(rec_handle, rec_params, SND_PCM_FORMAT_S16_LE);
-  snd_pcm_hw_params_set_channels(rec_handle, rec_params, REC_CHANNELS);
-  snd_pcm_hw_params_set_rate_near(rec_handle, rec_params, &rate, 0);
-  snd_pcm_hw_params(rec_handle, rec_params);
-  snd_pcm_hw_params_free(rec_params);
-  snd_pcm_start(rec_handle);
-
-  // Record audio (mono)
-  char *record_buffer = new char[total_frames * REC_CHANNELS * 2];
-  int offset = 0;
-  int remaining = total_frames;
-
-  while (remaining > 0) {
-    int frames_to_read =
-        (remaining > BUFFER_SIZE / 4) ? BUFFER_SIZE / 4 : remaining;
-    int frames_read = snd_pcm_readi(rec_handle, buffer, frames_to_read);
-
-    if (frames_read < 0) {
-      std::cerr << "Error reading: " << snd_strerror(frames_read) << std::endl;
-      break;
-    }
-
-    std::memcpy(record_buffer + offset, buffer, frames_read * REC_CHANNELS * 2);
-    offset += frames_read * REC_CHANNELS * 2;
-    remaining -= frames_read;
-  }
-
-  snd_pcm_close(rec_handle);
-  std::cout << "Recording complete." << std::endl;
-
-  // Convert mono to stereo
-  char *stereo_buffer = new char[total_frames * PLAY_CHANNELS * 2];
-  for (int i = 0; i < total_frames; i++) {
-    int16_t mono_sample = *(int16_t *)(record_buffer + i * 2);
-    *(int16_t *)(stereo_buffer + i * PLAY_CHANNELS * 2) = mono_sample;
-    *(int16_t *)(stereo_buffer + i * PLAY_CHANNELS * 2 + 2) = mono_sample;
-  }
-
-  // Open PCM device for playback
-  if ((err = snd_pcm_open(&play_handle, PCM_PLAY_DEVICE,
-                          SND_PCM_STREAM_PLAYBACK, 0)) < 0) {
-    std::cerr << "Error opening playback device: " << snd_strerror(err)
+// Live monitoring: streams the ZM-1 (or any capture device) to a playback
+// device with a few small periods of buffering.
+//
+// Capture and playback are linked with snd_pcm_link, so one snd_pcm_start
+// starts both on the same period boundary; the playback buffer is primed
+// with --prefill periods of silence, which is the monitoring latency. Every
+// period goes straight from the capture DMA buffer into the playback DMA
+// buffer (mmap on both sides, else one fixed period buffer each): each
+// output channel gets the sample of its source capsule re-packed into the
+// output format, without an intermediate float buffer. Everything is
+// allocated before the stream starts, so a session of any length runs in
+// constant memory.
+//
+// An overrun or underrun stops both streams, re-primes the playback buffer
+// and restarts, so the latency never creeps up. With two cards (two clocks)
+// a slower output fills up; a capture period is then skipped instead.
+//
+// Latency is reported two ways:
+// - buffered: capture delay + playback delay (snd_pcm_delay) at every period
+// - round trip (--measure): a 1 ms burst is played once a second instead of
+//   the passthrough and detected on the capture side (loopback cable, or a
+//   speaker next to the array), so converters and the analog path count too
+//
+// Build with:
+//   g++ -O2 record_and_play_simultaneously.cpp ../poc-saf/pcm_device.cpp ../poc-saf/capture_device.cpp ../poc-saf/playback_device.cpp ../poc-saf/rt_config.cpp ../poc-saf/stage_stats.cpp -lasound -lpthread
+
+struct DuplexOptions
+{
+    CaptureDeviceConfig capture;
+    PlaybackDeviceConfig playback;
+    std::vector<int> map;           // capture channel of every output channel; default: capsule 1 everywhere
+    int prefill = 2;                // periods of silence in the playback buffer at start
+    double seconds = 0.0;           // 0 = until Ctrl+C
+    bool measure = false;           // play bursts instead of the passthrough and time their return
+    float threshold_db = -30.0f;    // --measure: burst detection level on the source capsule
+    bool rt = false;
+};
+
+static std::atomic<bool> running{true};
+
+static void on_signal(int)
+{
+    running.store(false);
+}
+
+// Samples are handled as left-justified 32-bit integers between formats
+template <snd_pcm_format_t F>
+static inline int32_t load_sample(const uint8_t* p)
+{
+    if (F == SND_PCM_FORMAT_S24_3LE) {
+        return (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+    }
+    int32_t v;
+    std::memcpy(&v, p, 4);
+    return F == SND_PCM_FORMAT_S24_LE ? (int32_t)((uint32_t)v << 8) : v;
+}
+
+template <snd_pcm_format_t F>
+static inline void store_sample(uint8_t* p, int32_t v)
+{
+    if (F == SND_PCM_FORMAT_S16_LE) {
+        int16_t s = (int16_t)(v >> 16);
+        std::memcpy(p, &s, 2);
+    } else if (F == SND_PCM_FORMAT_S24_3LE) {
+        p[0] = (uint8_t)(v >> 8);
+        p[1] = (uint8_t)(v >> 16);
+        p[2] = (uint8_t)(v >> 24);
+    } else {
+        if (F == SND_PCM_FORMAT_S24_LE) v >>= 8;
+        std::memcpy(p, &v, 4);
+    }
+}
+
+// Copies `frames` frames: out channel c of every frame gets in channel map[c]
+typedef void (*MapKernel)(const uint8_t* in, int in_stride, uint8_t* out, int out_stride, int frames,
+                          const int* map, int out_channels);
+
+template <snd_pcm_format_t IN, snd_pcm_format_t OUT>
+static void map_channels(const uint8_t* in, int in_stride, uint8_t* out, int out_stride, int frames,
+                         const int* map, int out_channels)
+{
+    const int in_bytes = snd_pcm_format_physical_width(IN) / 8;
+    const int out_bytes = snd_pcm_format_physical_width(OUT) / 8;
+    for (int f = 0; f < frames; ++f) {
+        const uint8_t* src = in + (size_t)f * in_stride;
+        uint8_t* dst = out + (size_t)f * out_stride;
+        for (int c = 0; c < out_channels; ++c) {
+            store_sample<OUT>(dst + c * out_bytes, load_sample<IN>(src + map[c] * in_bytes));
+        }
+    }
+}
+
+template <snd_pcm_format_t IN>
+static MapKernel select_map_out(snd_pcm_format_t out)
+{
+    switch (out) {
+        case SND_PCM_FORMAT_S16_LE: return map_channels<IN, SND_PCM_FORMAT_S16_LE>;
+        case SND_PCM_FORMAT_S24_LE: return map_channels<IN, SND_PCM_FORMAT_S24_LE>;
+        case SND_PCM_FORMAT_S24_3LE: return map_channels<IN, SND_PCM_FORMAT_S24_3LE>;
+        case SND_PCM_FORMAT_S32_LE: return map_channels<IN, SND_PCM_FORMAT_S32_LE>;
+        default: return nullptr;
+    }
+}
+
+static MapKernel select_map_kernel(snd_pcm_format_t in, snd_pcm_format_t out)
+{
+    switch (in) {
+        case SND_PCM_FORMAT_S24_LE: return select_map_out<SND_PCM_FORMAT_S24_LE>(out);
+        case SND_PCM_FORMAT_S24_3LE: return select_map_out<SND_PCM_FORMAT_S24_3LE>(out);
+        case SND_PCM_FORMAT_S32_LE: return select_map_out<SND_PCM_FORMAT_S32_LE>(out);
+        default: return nullptr;
+    }
+}
+
+// --measure only, so a per-sample format switch is fine
+static int32_t load_any(const uint8_t* p, snd_pcm_format_t format)
+{
+    switch (format) {
+        case SND_PCM_FORMAT_S24_3LE: return load_sample<SND_PCM_FORMAT_S24_3LE>(p);
+        case SND_PCM_FORMAT_S24_LE: return load_sample<SND_PCM_FORMAT_S24_LE>(p);
+        default: return load_sample<SND_PCM_FORMAT_S32_LE>(p);
+    }
+}
+
+static void store_any(uint8_t* p, snd_pcm_format_t format, int32_t v)
+{
+    switch (format) {
+        case SND_PCM_FORMAT_S16_LE: store_sample<SND_PCM_FORMAT_S16_LE>(p, v); break;
+        case SND_PCM_FORMAT_S24_3LE: store_sample<SND_PCM_FORMAT_S24_3LE>(p, v); break;
+        case SND_PCM_FORMAT_S24_LE: store_sample<SND_PCM_FORMAT_S24_LE>(p, v); break;
+        default: store_sample<SND_PCM_FORMAT_S32_LE>(p, v); break;
+    }
+}
+
+// Round-trip measurement state (--measure)
+struct Probe
+{
+    int interval = 0;               // frames between bursts
+    int burst = 0;                  // burst length, frames
+    int half_cycle = 0;             // square wave half period, frames
+    int32_t level = 0;              // burst amplitude (left-justified)
+    int32_t threshold = 0;          // detection level (left-justified)
+    int64_t emitted_at = -1;        // playback frame of the pending burst's start
+    int64_t ignore_until = 0;       // capture frame before which nothing is detected (burst tail)
+    LatencyHistogram round_trip;    // ns
+    uint64_t missed = 0;            // bursts not detected within one interval
+};
+
+struct Duplex
+{
+    CaptureDevice in;
+    PlaybackDevice out;
+    MapKernel kernel = nullptr;
+    std::vector<int> map;
+    int source = 0;                 // capture channel the probe listens on
+    int period = 0;
+    int prefill = 0;
+    bool linked = false;
+    bool measure = false;
+
+    // RW access only: one period each, allocated before the stream starts
+    std::vector<uint8_t> in_buffer;
+    std::vector<uint8_t> out_buffer;
+
+    // Frames since the last (re)start, on each side
+    int64_t frames_in = 0;
+    int64_t frames_out = 0;
+
+    uint64_t overruns = 0;
+    uint64_t underruns = 0;
+    uint64_t skipped_periods = 0;   // output full (its clock is slower): capture period skipped
+    uint64_t total_frames = 0;
+    LatencyHistogram buffered;      // ns
+    Probe probe;
+};
+
+// Writes silence (RW or mmap) to the playback buffer
+static bool write_silence(Duplex& d, int frames)
+{
+    const int frame_bytes = pcm_device_frame_bytes(d.out);
+    while (frames > 0) {
+        snd_pcm_uframes_t n = (snd_pcm_uframes_t)std::min(frames, d.period);
+        if (d.out.mmap) {
+            const snd_pcm_channel_area_t* areas;
+            snd_pcm_uframes_t offset;
+            if (snd_pcm_mmap_begin(d.out.pcm, &areas, &offset, &n) < 0) return false;
+            uint8_t* base = (uint8_t*)areas[0].addr + (areas[0].first + offset * areas[0].step) / 8;
+            std::memset(base, 0, n * frame_bytes);
+            if (snd_pcm_mmap_commit(d.out.pcm, offset, n) != (snd_pcm_sframes_t)n) return false;
+        } else {
+            std::memset(d.out_buffer.data(), 0, n * frame_bytes);
+            if (snd_pcm_writei(d.out.pcm, d.out_buffer.data(), n) != (snd_pcm_sframes_t)n) return false;
+        }
+        frames -= (int)n;
+    }
+    return true;
+}
+
+// Stops both streams and starts them again with a freshly primed playback buffer
+static bool restart(Duplex& d)
+{
+    snd_pcm_drop(d.in.pcm);
+    if (!d.linked) snd_pcm_drop(d.out.pcm);
+    snd_pcm_prepare(d.in.pcm);
+    if (!d.linked) snd_pcm_prepare(d.out.pcm);
+
+    if (!write_silence(d, d.prefill * d.period)) {
+        std::cerr << "Cannot prime the playback buffer" << std::endl;
+        return false;
+    }
+    d.frames_in = 0;
+    d.frames_out = d.prefill * d.period;
+    d.probe.emitted_at = -1;
+    d.probe.ignore_until = 0;
+
+    // Linked: one start triggers both. Otherwise back to back, output first
+    // so it is not short of data when the first capture period arrives
+    int err = d.linked ? snd_pcm_start(d.in.pcm)
+                       : (snd_pcm_start(d.out.pcm) < 0 ? -1 : snd_pcm_start(d.in.pcm));
+    if (err < 0) {
+        std::cerr << "Cannot start the streams: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// --measure: replaces the output of this chunk with silence and the bursts
+static void emit_probe(Duplex& d, uint8_t* out, int out_stride, int frames)
+{
+    Probe& p = d.probe;
+    const int out_bytes = snd_pcm_format_physical_width(d.out.alsa_format) / 8;
+    for (int f = 0; f < frames; ++f) {
+        int64_t t = d.frames_out + f;
+        int phase = (int)(t % p.interval);
+        int32_t v = 0;
+        if (phase < p.burst) v = (phase / p.half_cycle) % 2 ? -p.level : p.level;
+        if (phase == 0 && p.emitted_at < 0) p.emitted_at = t;
+        for (int c = 0; c < d.out.channels; ++c) store_any(out + (size_t)f * out_stride + c * out_bytes, d.out.alsa_format, v);
+    }
+}
+
+// --measure: looks for the pending burst in the captured chunk
+static void detect_probe(Duplex& d, const uint8_t* in, int in_stride, int frames)
+{
+    Probe& p = d.probe;
+    if (p.emitted_at < 0) return;
+    const int in_bytes = snd_pcm_format_physical_width(d.in.alsa_format) / 8;
+    for (int f = 0; f < frames; ++f) {
+        int64_t t = d.frames_in + f;
+        if (t < p.ignore_until || t < p.emitted_at) continue;
+        int32_t v = load_any(in + (size_t)f * in_stride + d.source * in_bytes, d.in.alsa_format);
+        if (v > p.threshold || v < -p.threshold) {
+            p.round_trip.record((uint64_t)(t - p.emitted_at) * 1000000000ull / d.in.sample_rate);
+            p.ignore_until = t + p.burst + d.in.sample_rate / 20; // burst plus 50 ms of room echo
+            p.emitted_at = -1;
+            return;
+        }
+    }
+    if (d.frames_in + frames - p.emitted_at > p.interval) {
+        p.missed++;
+        p.emitted_at = -1;
+    }
+}
+
+static void process_chunk(Duplex& d, const uint8_t* in, int in_stride, uint8_t* out, int out_stride, int frames)
+{
+    if (d.measure) {
+        detect_probe(d, in, in_stride, frames);
+        emit_probe(d, out, out_stride, frames);
+    } else {
+        d.kernel(in, in_stride, out, out_stride, frames, d.map.data(), d.out.channels);
+    }
+    d.frames_in += frames;
+    d.frames_out += frames;
+    d.total_frames += frames;
+}
+
+// Moves one period from capture to playback. Returns false on an xrun.
+static bool transfer_period(Duplex& d)
+{
+    if (!d.in.mmap || !d.out.mmap) {
+        // One side without mmap: the fixed period buffers stand in for its DMA buffer
+        const int in_stride = pcm_device_frame_bytes(d.in);
+        const int out_stride = pcm_device_frame_bytes(d.out);
+        snd_pcm_sframes_t n = snd_pcm_readi(d.in.pcm, d.in_buffer.data(), d.period);
+        if (n < 0) return false;
+        process_chunk(d, d.in_buffer.data(), in_stride, d.out_buffer.data(), out_stride, (int)n);
+        return snd_pcm_writei(d.out.pcm, d.out_buffer.data(), n) == n;
+    }
+
+    // Both mmap: straight from one DMA buffer into the other, in as many
+    // chunks as the two ring buffers wrap
+    snd_pcm_uframes_t done = 0;
+    while (done < (snd_pcm_uframes_t)d.period) {
+        const snd_pcm_channel_area_t* in_areas;
+        const snd_pcm_channel_area_t* out_areas;
+        snd_pcm_uframes_t in_offset, out_offset;
+        snd_pcm_uframes_t in_frames = d.period - done;
+        if (snd_pcm_mmap_begin(d.in.pcm, &in_areas, &in_offset, &in_frames) < 0) return false;
+        snd_pcm_uframes_t out_frames = in_frames;
+        if (snd_pcm_mmap_begin(d.out.pcm, &out_areas, &out_offset, &out_frames) < 0) return false;
+        snd_pcm_uframes_t n = std::min(in_frames, out_frames);
+
+        const uint8_t* src = (const uint8_t*)in_areas[0].addr + (in_areas[0].first + in_offset * in_areas[0].step) / 8;
+        uint8_t* dst = (uint8_t*)out_areas[0].addr + (out_areas[0].first + out_offset * out_areas[0].step) / 8;
+        process_chunk(d, src, in_areas[0].step / 8, dst, out_areas[0].step / 8, (int)n);
+
+        if (snd_pcm_mmap_commit(d.in.pcm, in_offset, n) != (snd_pcm_sframes_t)n) return false;
+        if (snd_pcm_mmap_commit(d.out.pcm, out_offset, n) != (snd_pcm_sframes_t)n) return false;
+        done += n;
+    }
+    return true;
+}
+
+static void run(Duplex& d, double seconds)
+{
+    const uint64_t limit = seconds > 0.0 ? (uint64_t)(seconds * d.in.sample_rate) : UINT64_MAX;
+    while (running.load() && d.total_frames < limit) {
+        int err = snd_pcm_wait(d.in.pcm, 1000);
+        if (err == -EINTR) continue;
+
+        snd_pcm_sframes_t in_avail = snd_pcm_avail_update(d.in.pcm);
+        if (err < 0 || in_avail < 0) {
+            d.overruns++;
+            if (!restart(d)) return;
+            continue;
+        }
+        while (in_avail >= d.period) {
+            snd_pcm_sframes_t out_avail = snd_pcm_avail_update(d.out.pcm);
+            if (out_avail < 0) {
+                d.underruns++;
+                if (!restart(d)) return;
+                break;
+            }
+            snd_pcm_sframes_t moved = d.period;
+            if (out_avail < d.period) {
+                // The output runs slower than the input: keep the latency, lose a period
+                moved = snd_pcm_forward(d.in.pcm, d.period);
+                if (moved < 0) {
+                    d.overruns++;
+                    if (!restart(d)) return;
+                    break;
+                }
+                if (moved == 0) break;
+                d.skipped_periods++;
+                // Both sides move on: the next output frame carries the next
+                // input frame, so --measure keeps one time base. A burst
+                // already queued still plays when its stamp says.
+                d.frames_in += moved;
+                d.frames_out += moved;
+            } else if (!transfer_period(d)) {
+                snd_pcm_state_t state = snd_pcm_state(d.out.pcm);
+                if (state == SND_PCM_STATE_XRUN) d.underruns++;
+                else d.overruns++;
+                if (!restart(d)) return;
+                break;
+            }
+            in_avail -= moved;
+
+            // Queued on both sides now: what a sample captured at this moment waits
+            snd_pcm_sframes_t in_delay = 0, out_delay = 0;
+            if (snd_pcm_delay(d.in.pcm, &in_delay) == 0 && snd_pcm_delay(d.out.pcm, &out_delay) == 0) {
+                d.buffered.record((uint64_t)(in_delay + out_delay) * 1000000000ull / d.in.sample_rate);
+            }
+        }
+    }
+}
+
+static void print_latency(const char* name, const LatencyHistogram& h)
+{
+    if (!h.count()) {
+        std::cout << name << ": no samples" << std::endl;
+        return;
+    }
+    std::cout << name << ": mean " << h.sum() / h.count() / 1000 / 1000.0 << " ms, p50 "
+              << h.percentile(50) / 1000 / 1000.0 << " ms, p99 " << h.percentile(99) / 1000 / 1000.0
+              << " ms, max " << h.max() / 1000 / 1000.0 << " ms (" << h.count() << " samples)" << std::endl;
+}
+
+static long max_rss_kib()
+{
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void print_usage(const char* prog)
+{
+    std::cout << "Usage: " << prog << " [options]\n"
+              << "  --capture DEV      card name or ALSA PCM to capture from (default ZM-1)\n"
+              << "  --playback DEV     card name or ALSA PCM to play to (default: default)\n"
+              << "  --in-channels N    capture channels (default 19)\n"
+              << "  --out-channels N   playback channels (default 2)\n"
+              << "  --map A,B,...      capture channel (from 1) of every output channel (default: 1 everywhere)\n"
+              << "  --rate HZ          sample rate of both devices (default 48000)\n"
+              << "  --period FRAMES    period of both devices (default 64)\n"
+              << "  --periods N        buffer size in periods (default 4)\n"
+              << "  --prefill N        periods of silence queued at start, the added latency (default 2)\n"
+              << "  --seconds S        stop after S seconds (default: Ctrl+C)\n"
+              << "  --measure          play a burst every second and time its return on the first mapped\n"
+              << "                     capture channel (loopback cable or speaker next to the array)\n"
+              << "  --threshold DB     --measure: detection level in dBFS (default -30)\n"
+              << "  --rt               SCHED_FIFO 80 and locked memory" << std::endl;
+}
+
+static bool parse_options(int argc, char** argv, DuplexOptions& opts)
+{
+    // The system's default output; a card name or hw: PCM (--playback) gets
+    // the lowest latency
+    opts.playback.device = "default";
+    opts.capture.period_frames = opts.playback.period_frames = 64;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--capture" && has_value) {
+            opts.capture.device = nullptr;
+            pcm_device_select(opts.capture, argv[++i]);
+        } else if (arg == "--playback" && has_value) {
+            opts.playback.device = nullptr;
+            pcm_device_select(opts.playback, argv[++i]);
+        } else if (arg == "--in-channels" && has_value) {
+            opts.capture.channels = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--out-channels" && has_value) {
+            opts.playback.channels = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--map" && has_value) {
+            opts.map.clear();
+            for (const char* p = argv[++i]; *p; ) {
+                opts.map.push_back(std::atoi(p) - 1);
+                p = std::strchr(p, ',');
+                if (!p) break;
+                ++p;
+            }
+        } else if (arg == "--rate" && has_value) {
+            opts.capture.sample_rate = opts.playback.sample_rate = (unsigned int)std::atoi(argv[++i]);
+        } else if (arg == "--period" && has_value) {
+            opts.capture.period_frames = opts.playback.period_frames = std::max(16, std::atoi(argv[++i]));
+        } else if (arg == "--periods" && has_value) {
+            opts.capture.periods = opts.playback.periods = std::max(2, std::atoi(argv[++i]));
+        } else if (arg == "--prefill" && has_value) {
+            opts.prefill = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--seconds" && has_value) {
+            opts.seconds = std::atof(argv[++i]);
+        } else if (arg == "--measure") {
+            opts.measure = true;
+        } else if (arg == "--threshold" && has_value) {
+            opts.threshold_db = (float)std::atof(argv[++i]);
+        } else if (arg == "--rt") {
+            opts.rt = true;
+        } else {
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    DuplexOptions opts;
+    if (!parse_options(argc, argv, opts)) return 1;
+
+    Duplex d;
+    opts.capture.mmap = opts.playback.mmap = true;
+    opts.playback.explicit_start = true;
+    if (!capture_device_open(d.in, opts.capture)) return 1;
+    opts.playback.sample_rate = d.in.sample_rate;
+    opts.playback.period_frames = d.in.period_frames;
+    if (!playback_device_open(d.out, opts.playback)) return 1;
+    pcm_device_report(d.in, stdout);
+    pcm_device_report(d.out, stdout);
+
+    if (d.out.sample_rate != d.in.sample_rate || d.out.period_frames != d.in.period_frames) {
+        std::cerr << "Playback runs at " << d.out.sample_rate << " Hz / " << d.out.period_frames
+                  << " frame periods, capture at " << d.in.sample_rate << " Hz / " << d.in.period_frames
+                  << "; they must match" << std::endl;
+        return 1;
+    }
+    d.period = (int)d.in.period_frames;
+    d.prefill = std::min(opts.prefill, (int)(d.out.buffer_frames / d.in.period_frames) - 1);
+    if (d.prefill < 1) {
+        std::cerr << "Playback buffer of " << d.out.buffer_frames << " frames is too small" << std::endl;
+        return 1;
+    }
+
+    d.map = opts.map;
+    d.map.resize(d.out.channels, d.map.empty() ? 0 : d.map.back());
+    for (int& c : d.map) c = std::min(std::max(c, 0), d.in.channels - 1);
+    d.source = d.map[0];
+    d.kernel = select_map_kernel(d.in.alsa_format, d.out.alsa_format);
+    if (!d.kernel) {
+        std::cerr << "No channel mapping from " << snd_pcm_format_name(d.in.alsa_format) << " to "
+                  << snd_pcm_format_name(d.out.alsa_format) << std::endl;
+        return 1;
+    }
+
+    d.measure = opts.measure;
+    d.probe.interval = (int)d.in.sample_rate;
+    d.probe.burst = (int)d.in.sample_rate / 1000;
+    d.probe.half_cycle = std::max(1, (int)d.in.sample_rate / 6000); // 3 kHz square wave
+    d.probe.level = INT32_MAX / 2;
+    d.probe.threshold = (int32_t)(INT32_MAX * std::pow(10.0f, opts.threshold_db / 20.0f));
+
+    if (!d.in.mmap || !d.out.mmap) {
+        d.in_buffer.resize((size_t)d.period * pcm_device_frame_bytes(d.in));
+        d.out_buffer.resize((size_t)d.period * pcm_device_frame_bytes(d.out));
+    }
+
+    int err = snd_pcm_link(d.in.pcm, d.out.pcm);
+    d.linked = err == 0;
+    std::cout << "Period: " << d.period << " frames, prefill " << d.prefill << " ("
+              << 1000.0 * d.prefill * d.period / d.in.sample_rate << " ms), access "
+              << (d.in.mmap && d.out.mmap ? "mmap" : "read/write") << ", "
+              << (d.linked ? "linked" : std::string("not linked (") + snd_strerror(err) + "), started back to back")
               << std::endl;
-    return 1;
-  }
-  std::cout << "Playing back on " << PCM_PLAY_DEVICE << "..." << std::endl;
-
-  // Set playback hardware parameters
-  snd_pcm_hw_params_malloc(&play_params);
-  snd_pcm_hw_params_any(play_handle, play_params);
-  snd_pcm_hw_params_set_access(play_handle, play_params,
-                               SND_PCM_ACCESS_RW_INTERLEAVED);
-  snd_pcm_hw_params_set_format(play_handle, play_params, SND_PCM_FORMAT_S16_LE);
-  snd_pcm_hw_params_set_channels(play_handle, play_params, PLAY_CHANNELS);
-  snd_pcm_hw_params_set_rate_near(play_handle, play_params, &rate, 0);
-  snd_pcm_hw_params(play_handle, play_params);
-  snd_pcm_hw_params_free(play_params);
-
-  // Playback audio
-  offset = 0;
-  remaining = total_frames;
-
-  while (remaining > 0) {
-    int frames_to_write =
-        (remaining > BUFFER_SIZE / 4) ? BUFFER_SIZE / 4 : remaining;
-    int frames_written =
-        snd_pcm_writei(play_handle, stereo_buffer + offset * PLAY_CHANNELS * 2,
-                       frames_to_write);
-
-    if (frames_written < 0) {
-      std::cerr << "Error writing: " << snd_strerror(frames_written)
-                << std::endl;
-      break;
-    }
-
-    offset += frames_written;
-    remaining -= frames_written;
-  }
-
-  snd_pcm_drain(play_handle);
-  snd_pcm_close(play_handle);
-  std::cout << "Playback complete." << std::endl;
-
-  delete[] buffer;
-  delete[] record_buffer;
-  delete[] stereo_buffer;
-  return 0;
+    std::cout << "Map:";
+    for (int c : d.map) std::cout << " " << c + 1;
+    std::cout << (d.measure ? " (measuring round trip instead of monitoring)" : "") << std::endl;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    if (opts.rt) {
+        RtThreadConfig rt;
+        rt.priority = 80;
+        rt_apply_thread("duplex", rt);
+        rt_lock_memory();
+    }
+    const long setup_rss = max_rss_kib();
+
+    if (restart(d)) run(d, opts.seconds);
+
+    snd_pcm_drop(d.in.pcm);
+    if (d.linked) snd_pcm_unlink(d.in.pcm);
+    snd_pcm_drop(d.out.pcm);
+
+    std::cout << "\nStreamed " << (double)d.total_frames / d.in.sample_rate << " s; overruns " << d.overruns
+              << ", underruns " << d.underruns << ", skipped periods " << d.skipped_periods << std::endl;
+    print_latency("Buffered latency", d.buffered);
+    if (d.measure) {
+        print_latency("Round trip", d.probe.round_trip);
+        if (d.probe.missed) std::cout << "Bursts not detected: " << d.probe.missed << std::endl;
+    }
+    std::cout << "Max RSS: " << max_rss_kib() << " KiB (" << setup_rss << " KiB after setup)" << std::endl;
+    return 0;
 }
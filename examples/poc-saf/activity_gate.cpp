@@ -0,0 +1,142 @@
+#include "activity_gate.h"
+#include "level_meter.h"
+#include <algorithm>
+#include <cmath>
+
+const char* gate_detector_name(GateDetector detector)
+{
+    return detector == GateDetector::Level ? "level" : "vad";
+}
+
+ActivityGate::ActivityGate(const ActivityGateConfig& config, int num_channels, int block_frames, int sample_rate,
+                           int blocks_per_update)
+    : config_(config),
+      num_channels_(std::min(num_channels, max_channels)),
+      block_frames_(block_frames),
+      blocks_per_update_(std::max(blocks_per_update, 1)),
+      block_s_((float)block_frames / sample_rate),
+      hold_blocks_((int)std::ceil(config.hold_s / block_s_)),
+      preroll_blocks_(config.preroll_s > 0.0f ? std::max(1, (int)std::ceil(config.preroll_s / block_s_)) : 0),
+      slots_(preroll_blocks_ + 1)
+{
+}
+
+bool ActivityGate::prepare()
+{
+    if (preroll_blocks_ == 0) return true;
+    int handle = arena_.add_channels(num_channels_ * slots_, block_frames_);
+    if (!arena_.allocate()) return false;
+    history_ = arena_.channels(handle);
+    return true;
+}
+
+bool ActivityGate::detect(float level_db, float block_s)
+{
+    bool open_now, keep;
+    if (config_.detector == GateDetector::Level) {
+        open_now = level_db >= config_.open_db;
+        keep = level_db >= config_.close_db;
+    } else {
+        // The floor drops to the level at once and rises slowly, also while
+        // open, so a noise source that stays on eventually closes the gate
+        if (!have_floor_ || level_db < floor_) floor_ = level_db;
+        else floor_ = std::min(level_db, floor_ + config_.floor_rise_db_per_s * block_s);
+        have_floor_ = true;
+        floor_db_.store(floor_, std::memory_order_relaxed);
+        open_now = level_db >= std::max(config_.min_db, floor_ + config_.snr_open_db);
+        keep = level_db >= std::max(config_.min_db, floor_ + config_.snr_close_db);
+    }
+
+    if (open_now || (was_open_ && keep)) {
+        hold_left_ = hold_blocks_;
+        return true;
+    }
+    if (hold_left_ > 0) {
+        --hold_left_;
+        return true;
+    }
+    return false;
+}
+
+void ActivityGate::push(const float* const* x)
+{
+    float* const* slot = history_ + ((oldest_ + stored_) % slots_) * num_channels_;
+    for (int ch = 0; ch < num_channels_; ++ch) std::copy(x[ch], x[ch] + block_frames_, slot[ch]);
+    ++stored_;
+}
+
+const float* const* ActivityGate::run_block(int i) const
+{
+    if (run_first_ < 0) return current_;
+    return history_ + ((run_first_ + i) % slots_) * num_channels_;
+}
+
+int ActivityGate::process(const float* const* x)
+{
+    // Mean power over all channels, the same measure as LevelMeter::mean_db
+    LevelAccum acc[max_channels];
+    measure_levels(x, num_channels_, block_frames_, acc);
+    float sum_sq = 0.0f;
+    for (int ch = 0; ch < num_channels_; ++ch) sum_sq += acc[ch].sum_sq;
+    float power = sum_sq / (float)(num_channels_ * block_frames_);
+    float level = power > 1e-12f ? 10.0f * log10f(power) : LevelMeter::floor_db;
+    level_db_.store(level, std::memory_order_relaxed);
+
+    bool active = detect(level, block_s_);
+    bool run = active;
+    if (!active && config_.idle_decimation > 0) {
+        run = (block_index_ / blocks_per_update_) % config_.idle_decimation == 0;
+    }
+    ++block_index_;
+
+    if (active && !was_open_) {
+        activations_.store(activations_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (stored_ > 0) catching_up_ = true;
+    }
+    was_open_ = active;
+    open_.store(active, std::memory_order_relaxed);
+
+    current_ = x;
+    run_first_ = -1;
+    int n = 0;
+    if (catching_up_) {
+        // Oldest first, this block behind the backlog; runs even if the gate
+        // has closed again, the backlog is already started
+        push(x);
+        n = config_.preroll_catchup > 0 ? std::min(stored_, 1 + config_.preroll_catchup) : stored_;
+        run_first_ = oldest_;
+        oldest_ = (oldest_ + n) % slots_;
+        stored_ -= n;
+        catching_up_ = stored_ > 0;
+    } else if (run) {
+        // A decimated idle update does not continue the pre-roll before it
+        n = 1;
+        stored_ = 0;
+    } else if (history_) {
+        if (stored_ == preroll_blocks_) {
+            oldest_ = (oldest_ + 1) % slots_;
+            --stored_;
+        }
+        push(x);
+    }
+
+    // Single writer: plain load + store, as in LatencyHistogram
+    blocks_.store(blocks_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (n > 0) blocks_run_.store(blocks_run_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    return n;
+}
+
+float ActivityGate::duty_cycle() const
+{
+    uint64_t n = blocks();
+    return n ? (float)blocks_run() / (float)n : 0.0f;
+}
+
+void activity_gate_report(const ActivityGate& gate, FILE* out)
+{
+    fprintf(out, "activity gate (%s): DoA chain ran %.1f%% of blocks (%llu of %llu, pre-roll included), "
+                 "%llu activations\n",
+            gate_detector_name(gate.config().detector), 100.0 * gate.duty_cycle(),
+            (unsigned long long)gate.blocks_run(), (unsigned long long)gate.blocks(),
+            (unsigned long long)gate.activations());
+}
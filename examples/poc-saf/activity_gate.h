@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include "buffer_arena.h"
+
+// Activity gate in front of the localization chain: a cheap per-block
+// detector decides whether array2sh + DoA run at all, so a quiet room costs
+// almost nothing.
+//
+//   Level: mean mic power (dBFS, like LevelMeter::mean_db) against a fixed
+//          threshold, with a lower close threshold (hysteresis)
+//   Vad:   energy VAD, the level against a tracked noise floor. The floor
+//          follows the level down at once and up slowly, so steady noise
+//          (fans, HVAC) stops counting as activity while onsets still do.
+//
+// The gate stays open for hold_s after the level drops. Skipped blocks are
+// kept for preroll_s, and when the gate opens they are run through the chain
+// first, so the onset that opened it is localized too (and the filterbanks
+// have settled by the time the onset arrives). The replay is spread over
+// the following blocks: each runs at most 1 + preroll_catchup blocks, so the
+// chain catches up in preroll_blocks / preroll_catchup blocks instead of
+// running the whole pre-roll at once (19 blocks at 50 ms, 128 frames and
+// 48 kHz: a deadline miss). Until then the chain lags the input by the
+// remaining backlog, and it keeps running even if the gate closes again.
+//
+// While closed the chain can also be decimated instead of bypassed: with
+// idle_decimation = N it still runs one DoA update out of every N.
+
+enum class GateDetector { Level, Vad };
+
+const char* gate_detector_name(GateDetector detector);
+
+struct ActivityGateConfig
+{
+    GateDetector detector = GateDetector::Vad;
+    float open_db = -50.0f;       // Level: opens above this
+    float close_db = -56.0f;      // Level: closes below this
+    float snr_open_db = 10.0f;    // Vad: opens this far above the noise floor
+    float snr_close_db = 5.0f;    // Vad: closes below this
+    float min_db = -75.0f;        // Vad: never opens below this (digital silence, dither)
+    float floor_rise_db_per_s = 1.0f; // Vad: how fast the noise floor follows a louder scene
+    float hold_s = 0.3f;
+    float preroll_s = 0.05f;      // 0 = no pre-roll (nothing is kept while closed)
+    int preroll_catchup = 2;      // pre-roll blocks run per block on top of the current one; 0 = all at once
+    int idle_decimation = 0;      // 0 = skip everything while closed
+};
+
+class ActivityGate
+{
+public:
+    static const int max_channels = 32;
+
+    // blocks_per_update: chain blocks per DoA update, so that decimation
+    // runs whole updates
+    ActivityGate(const ActivityGateConfig& config, int num_channels, int block_frames, int sample_rate,
+                 int blocks_per_update);
+
+    ActivityGate(const ActivityGate&) = delete;
+    ActivityGate& operator=(const ActivityGate&) = delete;
+
+    // Allocates the pre-roll history, if any
+    bool prepare();
+
+    // Decides for one block. Returns the number of blocks to run through the
+    // chain now, run_block(0) .. run_block(n - 1) in that order: 0 to skip it,
+    // 1 for this block alone, more while pre-roll is being caught up (then
+    // the last one is not necessarily this block).
+    int process(const float* const* x);
+
+    // The i-th block to run. Valid until the next process().
+    const float* const* run_block(int i) const;
+
+    // Readers (any thread)
+    bool is_open() const { return open_.load(std::memory_order_relaxed); }
+    float level_db() const { return level_db_.load(std::memory_order_relaxed); }
+    float noise_floor_db() const { return floor_db_.load(std::memory_order_relaxed); }
+    uint64_t blocks() const { return blocks_.load(std::memory_order_relaxed); }
+    uint64_t blocks_run() const { return blocks_run_.load(std::memory_order_relaxed); } // pre-roll included
+    uint64_t activations() const { return activations_.load(std::memory_order_relaxed); }
+    float duty_cycle() const; // blocks_run / blocks, 0..1
+
+    const ActivityGateConfig& config() const { return config_; }
+    int preroll_blocks() const { return preroll_blocks_; }
+
+private:
+    bool detect(float level_db, float block_s);
+    void push(const float* const* x);
+
+    const ActivityGateConfig config_;
+    const int num_channels_;
+    const int block_frames_;
+    const int blocks_per_update_;
+    const float block_s_;
+    const int hold_blocks_;
+    const int preroll_blocks_;
+    const int slots_;             // preroll_blocks_ + 1: the backlog plus the block that opened the gate
+
+    // Writer-only state
+    float floor_ = 0.0f;
+    bool have_floor_ = false;
+    int hold_left_ = 0;
+    bool was_open_ = false;
+    uint64_t block_index_ = 0;
+    int oldest_ = 0;              // history slot of the oldest block not run yet
+    int stored_ = 0;              // blocks in the history, up to preroll_blocks_ while closed
+    bool catching_up_ = false;    // replaying pre-roll: every block goes through the history
+    int run_first_ = 0;           // slot of run_block(0), or -1 for the current block
+    const float* const* current_ = nullptr;
+
+    BufferArena arena_;
+    float** history_ = nullptr;   // slots_ slots of num_channels_ channels, a FIFO
+
+    std::atomic<bool> open_{false};
+    std::atomic<float> level_db_{-120.0f};
+    std::atomic<float> floor_db_{-120.0f};
+    std::atomic<uint64_t> blocks_{0};
+    std::atomic<uint64_t> blocks_run_{0};
+    std::atomic<uint64_t> activations_{0};
+};
+
+// One line: detector, duty cycle and activations. Not for the audio threads.
+void activity_gate_report(const ActivityGate& gate, FILE* out);
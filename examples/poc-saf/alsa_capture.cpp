@@ -0,0 +1,324 @@
+#include "alsa_capture.h"
+#include <ctime>
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+#include "array_sim.h"
+#include "rt_alloc_guard.h"
+
+// Capture thread bookkeeping for the clock
+struct CaptureTiming
+{
+    snd_pcm_status_t* status = nullptr;
+    uint64_t device_frames = 0; // taken from ALSA (kept or dropped) plus lost in overruns
+    uint64_t run_frames = 0;    // taken since the stream last (re)started
+    bool resync = false;        // the stream restarted; the gap is measured at the next status
+};
+
+static int64_t clock_ns(clockid_t id)
+{
+    timespec ts;
+    clock_gettime(id, &ts);
+    return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+// Timestamps the hardware position after `tm.device_frames` frames were
+// taken. Call before pushing them: a gap found here precedes them.
+static void timestamp_chunk(CaptureContext* ctx, CaptureTiming& tm)
+{
+    const int64_t now_ns = clock_ns(CLOCK_MONOTONIC);
+    const int64_t realtime_offset = clock_ns(CLOCK_REALTIME) - now_ns;
+    if (!tm.status || snd_pcm_status(ctx->pcm, tm.status) < 0) {
+        if (tm.resync) ctx->ring->mark_discontinuity(DiscontinuityKind::Overrun, 0);
+        tm.resync = false;
+        return;
+    }
+
+    // With timestamps enabled, htstamp is when the position (and so the
+    // delay) was last updated by the driver
+    int64_t t_ns = now_ns;
+    if (ctx->htstamps) {
+        snd_htimestamp_t ts;
+        snd_pcm_status_get_htstamp(tm.status, &ts);
+        if (ts.tv_sec || ts.tv_nsec) t_ns = (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+    }
+    // Captured but not read yet
+    snd_pcm_sframes_t delay = snd_pcm_status_get_delay(tm.status);
+    if (delay < 0) delay = 0;
+
+    if (tm.resync) {
+        uint64_t lost = ctx->clock.resync(tm.device_frames - tm.run_frames, tm.run_frames + (uint64_t)delay, t_ns,
+                                          realtime_offset);
+        tm.device_frames += lost;
+        ctx->ring->mark_discontinuity(DiscontinuityKind::Overrun, (uint32_t)lost);
+        tm.resync = false;
+    } else {
+        ctx->clock.observe(tm.device_frames + (uint64_t)delay, t_ns, realtime_offset);
+    }
+}
+
+static void count_taken(CaptureTiming& tm, uint64_t frames)
+{
+    tm.device_frames += frames;
+    tm.run_frames += frames;
+}
+
+// Overrun (-EPIPE) or suspend (-ESTRPIPE): snd_pcm_recover prepares (or
+// resumes) the stream; the gap is sized at the next timestamp. Returns false
+// on errors we cannot recover from.
+static bool recover(CaptureContext* ctx, CaptureTiming& tm, int err)
+{
+    if (err != -EPIPE && err != -ESTRPIPE) {
+        std::cerr << "ALSA Error: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    ctx->xruns.fetch_add(1, std::memory_order_relaxed);
+    tm.resync = true;
+    tm.run_frames = 0;
+    err = snd_pcm_recover(ctx->pcm, err, 1);
+    if (err < 0) {
+        std::cerr << "ALSA recovery failed: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Converts `frames` interleaved frames into the ring, or drops them if the
+// consumer has fallen behind. Never blocks. Input levels are measured by the
+// conversion itself and published once per call.
+static void push_to_ring(CaptureContext* ctx, const uint8_t* src, int frames, float** dst)
+{
+    ScopedNoAlloc no_alloc;
+    StageTimer timer(ctx->stats, Stage::Convert);
+    const size_t frame_bytes = (size_t)sample_format_bytes(ctx->format) * ctx->channels;
+
+    if (ctx->ring->write_space() < frames) {
+        ctx->ring->note_dropped(frames);
+        return;
+    }
+
+    LevelAccum levels[LevelMeter::max_channels];
+    LevelAccum* meter = ctx->levels ? levels : nullptr;
+
+    // The block may wrap around the end of the ring
+    int done = 0;
+    while (done < frames) {
+        int n = ctx->ring->write_region(dst, frames - done);
+        convert_to_float_channels(src + done * frame_bytes, ctx->format, dst, n, ctx->channels, meter);
+        ctx->ring->commit_write(n);
+        done += n;
+    }
+    if (meter) ctx->levels->update(levels, frames);
+    if (ctx->on_data) ctx->on_data(ctx->on_data_arg);
+}
+
+// RW access: snd_pcm_readi copies each period into period_buffer first.
+// Short reads are passed on as they are; the ring re-blocks them.
+static void capture_loop_rw(CaptureContext* ctx, CaptureTiming& tm)
+{
+    const int period = ctx->period_frames;
+    uint8_t* buffer = ctx->period_buffer;
+    std::vector<float*> dst(ctx->channels);
+    bool failed = false; // the previous read failed with something other than an xrun
+
+    while (ctx->running.load(std::memory_order_relaxed)) {
+        snd_pcm_sframes_t frames_read;
+        {
+            StageTimer timer(ctx->stats, Stage::CaptureWait);
+            frames_read = snd_pcm_readi(ctx->pcm, buffer, period);
+        }
+
+        if (frames_read == -EPIPE || frames_read == -ESTRPIPE) {
+            // snd_pcm_readi restarts the stream by itself
+            if (!recover(ctx, tm, (int)frames_read)) break;
+            continue;
+        } else if (frames_read < 0) {
+            // One snd_pcm_recover (it handles -EINTR); a device that fails
+            // again right after (-ENODEV, -EBADFD) is gone, stop like mmap
+            std::cerr << "ALSA Error: " << snd_strerror(frames_read) << std::endl;
+            if (failed || snd_pcm_recover(ctx->pcm, (int)frames_read, 1) < 0) break;
+            failed = true;
+            continue;
+        } else if (frames_read != period) {
+            ctx->short_reads.fetch_add(1, std::memory_order_relaxed);
+        }
+        failed = false;
+        ctx->periods.fetch_add(1, std::memory_order_relaxed);
+
+        count_taken(tm, (uint64_t)frames_read);
+        timestamp_chunk(ctx, tm);
+        push_to_ring(ctx, buffer, (int)frames_read, dst.data());
+    }
+}
+
+// Recovery for the mmap calls, which (unlike snd_pcm_readi) need an
+// explicit restart
+static bool recover_mmap(CaptureContext* ctx, CaptureTiming& tm, int err)
+{
+    if (!recover(ctx, tm, err)) return false;
+    return snd_pcm_start(ctx->pcm) >= 0;
+}
+
+// MMAP access: sleep in poll() until a period is available, then convert
+// straight out of the DMA ring; the data is never copied into a bounce buffer.
+static void capture_loop_mmap(CaptureContext* ctx, CaptureTiming& tm)
+{
+    const int period = ctx->period_frames;
+    std::vector<float*> dst(ctx->channels);
+
+    int nfds = snd_pcm_poll_descriptors_count(ctx->pcm);
+    std::vector<struct pollfd> pfds(nfds > 0 ? nfds : 1);
+    nfds = snd_pcm_poll_descriptors(ctx->pcm, pfds.data(), pfds.size());
+
+    while (ctx->running.load(std::memory_order_relaxed)) {
+        snd_pcm_sframes_t avail = snd_pcm_avail_update(ctx->pcm);
+        if (avail < 0) {
+            if (!recover_mmap(ctx, tm, (int)avail)) break;
+            continue;
+        }
+
+        if (avail < period) {
+            if (snd_pcm_state(ctx->pcm) == SND_PCM_STATE_PREPARED) snd_pcm_start(ctx->pcm);
+
+            // Wake up when avail_min (one period) is reached; the timeout only
+            // lets us notice a stop request on a stalled device
+            int ready;
+            {
+                StageTimer timer(ctx->stats, Stage::CaptureWait);
+                ready = poll(pfds.data(), nfds, 1000);
+            }
+            if (ready > 0) {
+                unsigned short revents = 0;
+                snd_pcm_poll_descriptors_revents(ctx->pcm, pfds.data(), nfds, &revents);
+                if (revents & POLLERR) {
+                    if (!recover_mmap(ctx, tm, snd_pcm_state(ctx->pcm) == SND_PCM_STATE_XRUN ? -EPIPE : -ESTRPIPE)) {
+                        break;
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Position first: everything up to it is drained below
+        timestamp_chunk(ctx, tm);
+
+        // Drain everything available, a contiguous DMA chunk at a time
+        snd_pcm_uframes_t remaining = (snd_pcm_uframes_t)avail;
+        bool recovered = true;
+        while (remaining > 0) {
+            const snd_pcm_channel_area_t* areas = nullptr;
+            snd_pcm_uframes_t offset = 0;
+            snd_pcm_uframes_t frames = remaining;
+
+            int err = snd_pcm_mmap_begin(ctx->pcm, &areas, &offset, &frames);
+            if (err < 0) {
+                recovered = recover_mmap(ctx, tm, err);
+                break;
+            }
+
+            // Interleaved: all channels share one area, the frame stride is `step` bits
+            const uint8_t* src = (const uint8_t*)areas[0].addr + (areas[0].first + offset * areas[0].step) / 8;
+            push_to_ring(ctx, src, (int)frames, dst.data());
+            count_taken(tm, frames);
+
+            snd_pcm_sframes_t committed = snd_pcm_mmap_commit(ctx->pcm, offset, frames);
+            if (committed < 0 || (snd_pcm_uframes_t)committed != frames) {
+                recovered = recover_mmap(ctx, tm, committed < 0 ? (int)committed : -EPIPE);
+                break;
+            }
+            ctx->periods.fetch_add(1, std::memory_order_relaxed);
+            remaining -= frames;
+        }
+        if (!recovered) break;
+    }
+}
+
+// Simulated array: one generated block per period, due at sim_speed times
+// real time since the start. Blocks that find the ring full are dropped like
+// late captures. At speed 0 the thread instead waits for the DSP to make
+// room, so the pipeline runs flat out on a gap-free stream.
+static void capture_loop_sim(CaptureContext* ctx, CaptureTiming& tm)
+{
+    ArraySimulator& sim = *ctx->simulator;
+    const int block = sim.block_frames();
+    std::vector<float*> dst(ctx->channels);
+    const double ns_per_block = ctx->sim_speed > 0.0f ? 1e9 * block / (ctx->sample_rate * ctx->sim_speed) : 0.0;
+    const int64_t start_ns = clock_ns(CLOCK_MONOTONIC);
+    uint64_t blocks = 0;
+
+    while (ctx->running.load(std::memory_order_relaxed)) {
+        {
+            StageTimer timer(ctx->stats, Stage::CaptureWait);
+            if (ns_per_block > 0.0) {
+                const int64_t due_ns = start_ns + (int64_t)(ns_per_block * (double)(blocks + 1));
+                timespec due = {(time_t)(due_ns / 1000000000ll), (long)(due_ns % 1000000000ll)};
+                while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, nullptr) == EINTR) {}
+            } else {
+                while (ctx->ring->write_space() < block && ctx->running.load(std::memory_order_relaxed)) usleep(100);
+            }
+        }
+        ++blocks;
+        count_taken(tm, (uint64_t)block);
+        // The block just "captured" ends now
+        const int64_t now_ns = clock_ns(CLOCK_MONOTONIC);
+        ctx->clock.observe(tm.device_frames, now_ns, clock_ns(CLOCK_REALTIME) - now_ns);
+        ctx->periods.fetch_add(1, std::memory_order_relaxed);
+
+        ScopedNoAlloc no_alloc;
+        StageTimer timer(ctx->stats, Stage::Convert);
+        if (ctx->ring->write_space() < block) {
+            ctx->ring->note_dropped(block);
+            continue;
+        }
+        // Contiguous: the ring holds whole blocks
+        ctx->ring->write_region(dst.data(), block);
+        sim.generate(dst.data());
+        if (ctx->levels) {
+            LevelAccum levels[LevelMeter::max_channels];
+            measure_levels(dst.data(), ctx->channels, block, levels);
+            ctx->levels->update(levels, block);
+        }
+        ctx->ring->commit_write(block);
+        if (ctx->on_data) ctx->on_data(ctx->on_data_arg);
+    }
+}
+
+static void capture_main(CaptureContext* ctx)
+{
+    if (ctx->rt.priority > 0 || ctx->rt.cpu >= 0) ctx->rt_applied.store(rt_apply_thread("capture", ctx->rt));
+    CaptureTiming tm;
+    if (ctx->simulator) {
+        capture_loop_sim(ctx, tm);
+    } else {
+        snd_pcm_status_malloc(&tm.status);
+        if (ctx->use_mmap) capture_loop_mmap(ctx, tm);
+        else capture_loop_rw(ctx, tm);
+        if (tm.status) snd_pcm_status_free(tm.status);
+    }
+    ctx->exited.store(true);
+}
+
+bool capture_start(CaptureContext& ctx)
+{
+    if ((!ctx.pcm && !ctx.simulator) || !ctx.ring || ctx.ring->channels() != ctx.channels) return false;
+    if (ctx.levels && ctx.levels->channels() != ctx.channels) return false;
+    if (ctx.simulator) {
+        if (ctx.channels != ArraySimulator::num_capsules || ctx.ring->capacity() % ctx.simulator->block_frames() != 0) {
+            return false;
+        }
+    } else if (!ctx.use_mmap && !ctx.period_buffer) {
+        return false;
+    }
+
+    ctx.clock.reset(ctx.sample_rate > 0 ? ctx.sample_rate : 48000);
+    ctx.exited.store(false);
+    ctx.running.store(true);
+    ctx.thread = std::thread(capture_main, &ctx);
+    return true;
+}
+
+void capture_stop(CaptureContext& ctx)
+{
+    ctx.running.store(false);
+    if (ctx.thread.joinable()) ctx.thread.join();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include "alsa/asoundlib.h"
+#include "capture_clock.h"
+#include "rt_config.h"
+#include "sample_convert.h"
+#include "spsc_ring.h"
+#include "stage_stats.h"
+
+class ArraySimulator;
+
+// Capture thread: drains an already configured and started PCM into an
+// SpscFrameRing and does nothing else, so a slow consumer can never push the
+// ALSA buffer into overrun. With mmap access the samples are converted
+// straight out of the DMA buffer; otherwise snd_pcm_readi is used.
+//
+// Every chunk is timestamped with snd_pcm_status (the hardware position and
+// its htstamp) into `clock`. Overruns and suspends go through
+// snd_pcm_recover; the size of the gap is measured from the timestamps on
+// either side and recorded in the ring's discontinuity log. On an error it
+// cannot recover from the thread returns by itself and sets `exited`.
+//
+// With a simulator instead of a PCM, the thread generates the capsule
+// signals block by block straight into the ring, paced by CLOCK_MONOTONIC.
+struct CaptureContext
+{
+    snd_pcm_t* pcm = nullptr;
+    ArraySimulator* simulator = nullptr;  // prepared; replaces pcm, period_frames = its block
+    float sim_speed = 1.0f;               // simulator pace vs real time; 0 = as fast as the ring drains, lossless
+    int channels = 0;
+    int period_frames = 0;                // ALSA period; independent of the SAF frame size
+    SampleFormat format = SampleFormat::S24_LE;
+    bool use_mmap = false;  // PCM was configured with SND_PCM_ACCESS_MMAP_INTERLEAVED
+    SpscFrameRing* ring = nullptr;
+    LevelMeter* levels = nullptr;           // optional: per-channel input levels, updated per chunk
+    StageStats* stats = nullptr;            // optional: records CaptureWait and Convert
+    RtThreadConfig rt;                      // priority / CPU the capture thread gives itself
+    int sample_rate = 0;
+    bool htstamps = false;  // PCM timestamps are SND_PCM_TSTAMP_ENABLE + MONOTONIC (else: time of the status call)
+    CaptureClock clock;     // device frame -> capture time, published for the DSP thread
+    void (*on_data)(void* arg) = nullptr;   // optional: called on the capture thread after each chunk is in the ring
+    void* on_data_arg = nullptr;
+
+    std::atomic<bool> running{false};
+    std::atomic<bool> exited{false};      // the thread returned: stopped, or the device failed for good
+    std::atomic<bool> rt_applied{false};  // rt took effect (false while not requested)
+    std::atomic<uint64_t> periods{0};     // periods (mmap: contiguous chunks) read from ALSA
+    std::atomic<uint64_t> xruns{0};       // overrun / suspend recoveries
+    std::atomic<uint64_t> short_reads{0}; // reads shorter than a period (kept, re-blocked by the ring)
+
+    uint8_t* period_buffer = nullptr;     // RW access only: one period, owned by the caller
+    std::thread thread;
+};
+
+bool capture_start(CaptureContext& ctx);
+void capture_stop(CaptureContext& ctx);
@@ -1,345 +1,1221 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <iomanip>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 #include "alsa/asoundlib.h"
+#include "activity_gate.h"
+#include "alsa_capture.h"
+#include "array_sim.h"
+#include "buffer_arena.h"
+#include "capture_device.h"
+#include "console_ui.h"
+#include "deadline_pool.h"
+#include "doa_tracker.h"
+#include "file_source.h"
+#include "level_meter.h"
+#include "monitor_decoder.h"
+#include "monitor_output.h"
+#include "pipeline.h"
+#include "recorder.h"
+#include "results_publisher.h"
+#include "rt_config.h"
+#include "rt_alloc_guard.h"
+#include "spsc_ring.h"
+#include "stage_stats.h"
+#include "triple_buffer.h"
 
-// SAF framework includes
-#include "saf.h"
-#include "array2sh.h"
-#include "sldoa.h"
+// Live capture rate; the device is found and configured by capture_device_open
+const unsigned int mic_sample_rate = 48000;
 
-// ALSA Configuration
-const char* device_in_use = "plughw:2,0";
-const int mic_channels = 19;
-const snd_pcm_format_t mic_format = SND_PCM_FORMAT_S24_LE;
-int dir = 0;
-unsigned int mic_sample_rate = 48000;
-snd_pcm_uframes_t mic_period_size = 128; // Match SAF frame size
-snd_pcm_uframes_t mic_buffer_size = mic_period_size * 8;
+// Capture -> DSP ring, at least this many SAF frames (32 * 128 samples = ~85 ms
+// at 48 kHz) and at least 4 ALSA periods
+const int ring_blocks = 32;
+const int ring_min_periods = 4;
 
-// SAF Configuration
-const int SH_ORDER = 3; // Zylia supports up to 3rd order
-const int NUM_SH_SIGNALS = (SH_ORDER + 1) * (SH_ORDER + 1); // 16 SH channels
+// Command line options
+struct AppOptions
+{
+    const char* file_path = nullptr; // replay a recording instead of capturing
+    bool have_raw = false;           // --raw given: headerless files are accepted
+    RawFormat raw;
+    bool quiet = false;              // file mode: no per-update output, summary only
+    bool tracks = false;             // file mode: print source tracks instead of the dominant direction
+    const char* device = nullptr;    // live mode: ALSA PCM name instead of looking up card_name
+    const char* card_name = "ZM-1";  // live mode: capture card to look up by name
+    bool list_devices = false;       // print the capture devices and exit
+    bool no_mmap = false;            // live mode: force snd_pcm_readi
+    int period_frames = 0;           // live mode: ALSA period, 0 = SAF frame size
+    int periods = 8;                 // live mode: ALSA buffer size in periods
+    bool lock_memory = false;        // live mode: mlockall once everything is allocated
+    RtThreadConfig capture_rt;       // live mode: capture thread priority / CPU
+    RtThreadConfig dsp_rt;           // live mode: DSP (main) thread priority / CPU
+    const char* stats_path = nullptr; // latency summary destination, default stderr
+    int stats_interval_s = 10;        // live mode: summary period, 0 = only at exit
+    int refresh_hz = 15;              // live mode: console refresh rate
+    DoaMethod doa_method = DoaMethod::Sldoa;
+    int doa_directions = 1024;        // grid size for --doa pwd / music
+    int doa_sources = 3;              // --doa pwd / music: map peaks tracked per update
+    float histogram_s = 0.0f;         // direction histogram memory, 0 = dominant sector / map peak
+    bool publish = false;             // binary results in shared memory
+    const char* publish_name = doa_results_default_name;
+    const char* publish_socket = nullptr; // ... and streamed on this Unix socket
+    bool record = false;              // archive the SH (and mic) signals, see --record
+    RecorderConfig record_config;
+    bool gate = false;                // skip the chain while the scene is quiet
+    ActivityGateConfig gate_config;
+    bool monitor = false;             // live mode: decode the SH signals to headphones
+    MonitorMode monitor_mode = MonitorMode::Binaural;
+    MonitorOutputConfig monitor_config;
+    float monitor_gain_db = 0.0f;
+    int monitor_taps = 0;             // binaural filter length, 0 = as designed
+    bool simulate = false;            // live mode: synthesized array signals instead of the device
+    ArraySimConfig sim_config;
+    float sim_speed = 1.0f;           // simulator pace vs real time, 0 = as fast as the DSP runs
+    std::vector<const char*> arrays;  // multi-array mode: card names, ALSA PCMs or "sim"
+    int pool_workers = 0;             // multi-array mode: DSP workers, 0 = one per array up to the CPU count
+    int pool_cpu = -1;                // multi-array mode: pin worker i to CPU pool_cpu + i
+    float deadline_ms = 0.0f;         // multi-array mode: per block after capture, 0 = one sldoa update
+};
+
+static void print_usage(const char* prog)
+{
+    std::cout << "Usage: " << prog << " [options]\n"
+              << "  --file PATH        process a 19-channel WAV/RF64/raw recording as fast as possible\n"
+              << "  --raw FORMAT       headerless input format: s24_3le, s24_le or s32_le\n"
+              << "  --rate HZ          sample rate of headerless input (default 48000)\n"
+              << "  --quiet            file mode: only print the throughput summary\n"
+              << "  --tracks           file mode: print the confirmed source tracks of every update\n"
+              << "  --card NAME        live mode: capture from the card whose name contains NAME (default ZM-1)\n"
+              << "  --device PCM       live mode: capture from this ALSA PCM instead (e.g. hw:2,0)\n"
+              << "  --list-devices     print the capture devices and their native formats, then exit\n"
+              << "  --no-mmap          live mode: use snd_pcm_readi instead of mmap access\n"
+              << "  --period FRAMES    live mode: ALSA period size (default: SAF frame size)\n"
+              << "  --periods N        live mode: ALSA buffer size in periods (default 8)\n"
+              << "  --rt               live mode: SCHED_FIFO audio threads (capture 80, DSP 75) and locked memory\n"
+              << "  --rt-priority N    like --rt with capture priority N, DSP N - 5\n"
+              << "  --cpu-capture N    live mode: pin the capture thread to CPU N\n"
+              << "  --cpu-dsp N        live mode: pin the DSP thread to CPU N\n"
+              << "  --refresh HZ       live mode: console refresh rate (default 15)\n"
+              << "  --doa METHOD       DoA estimation: sldoa (default), pwd or music\n"
+              << "  --doa-grid N       directions on the pwd/music grid (default 1024, ~6 deg)\n"
+              << "  --doa-sources N    pwd/music: sources (map peaks) tracked per update, up to 8 (default 3)\n"
+              << "  --histogram S      report the peak of an alpha-weighted direction histogram over all\n"
+              << "                     bands and sectors with S seconds of memory (default: dominant sector)\n"
+              << "  --gate DETECTOR    skip array2sh + DoA while quiet: level or vad (default: off)\n"
+              << "  --gate-level DB    level gate: opens above DB dBFS, closes 6 dB lower (default -50)\n"
+              << "  --gate-snr DB      vad gate: opens DB above the noise floor, closes at half (default 10)\n"
+              << "  --gate-hold MS     keep the gate open this long after the sound (default 300)\n"
+              << "  --preroll MS       audio before an onset that is localized too (default 50)\n"
+              << "  --idle-decimate N  while the gate is closed, still run 1 of every N DoA updates\n"
+              << "  --publish          publish every DoA update as a binary record in shared memory\n"
+              << "  --publish-name NAME shared memory name (default " << doa_results_default_name << ")\n"
+              << "  --publish-socket PATH also stream the records on a Unix socket\n"
+              << "  --record DIR       record the SH signals to DIR as AmbiX (ACN/SN3D, float32) WAV/RF64\n"
+              << "  --record-mic       also record the raw mic signals (24-bit, replayable with --file)\n"
+              << "  --rotate S         start new recording files every S seconds (default: one file)\n"
+              << "  --monitor MODE     live mode: decode the SH signals to headphones: binaural or stereo\n"
+              << "  --monitor-device DEV playback card name or ALSA PCM for --monitor (default: default)\n"
+              << "  --monitor-latency MS audio queued ahead of the playback device (default 20)\n"
+              << "  --monitor-gain DB  gain of the monitor signal (default 0)\n"
+              << "  --monitor-taps N   binaural: cut the filters to N taps, whole SAF frames (default: as\n"
+              << "                     designed, twice the HRIR length)\n"
+              << "  --sim-source AZ,EL[,DB[,SIGNAL]] live mode without hardware: simulate the ZM-1 with a\n"
+              << "                     far-field source at AZ,EL degrees and DB dBFS (default -20); repeatable,\n"
+              << "                     up to 8. SIGNAL: noise (default), bursts or tone[:HZ]\n"
+              << "  --sim-noise DB     simulator: sensor noise per capsule (default -80 dBFS)\n"
+              << "  --sim-rt60 S       simulator: reverb decay time (default 0, anechoic)\n"
+              << "  --sim-reverb DB    simulator: reverb energy relative to the direct sound (default -6)\n"
+              << "  --sim-speed X      simulator: run at X times real time; 0 = as fast as the pipeline,\n"
+              << "                     without drops (default 1)\n"
+              << "  --array DEV        capture several arrays at once, one --array per array: card name,\n"
+              << "                     ALSA PCM (hw:2,0; needed for identical cards) or sim (simulated, see\n"
+              << "                     --sim-*), up to " << DeadlinePool::max_streams << ". Their DSP shares one worker pool, earliest\n"
+              << "                     deadline first; results are published with the array's index\n"
+              << "  --workers N        --array: DSP worker threads (default: one per array, at most one per CPU)\n"
+              << "  --cpu-workers N    --array: pin worker i to CPU N + i (--cpu-capture pins all capture threads)\n"
+              << "  --deadline MS      --array: process each block within MS of its capture (default: one\n"
+              << "                     sldoa update, ~10.7 ms)\n"
+              << "  --stats PATH       write the stage latency summary to PATH instead of stderr\n"
+              << "  --stats-interval S live mode: print the summary every S seconds (default 10, 0 = at exit)\n"
+              << "Without --file, audio is captured live from the card's hw: device in its native format." << std::endl;
+}
 
-int init_mic(snd_pcm_t* pcm_handle, snd_pcm_hw_params_t*& hw_params)
+// --sim-source AZ,EL[,DB[,SIGNAL]], SIGNAL = noise | bursts | tone[:HZ]
+static bool parse_sim_source(const char* arg, SimSource& source)
 {
-    int err;
-    bool success = true;
-    
-    snd_pcm_hw_params_malloc(&hw_params);
-    snd_pcm_hw_params_any(pcm_handle, hw_params);
-    snd_pcm_hw_params_set_access(pcm_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED);
-    snd_pcm_hw_params_set_format(pcm_handle, hw_params, mic_format);
-    snd_pcm_hw_params_set_channels(pcm_handle, hw_params, mic_channels);
-    snd_pcm_hw_params_set_rate_near(pcm_handle, hw_params, &mic_sample_rate, &dir);
-    snd_pcm_hw_params_set_period_size_near(pcm_handle, hw_params, &mic_period_size, &dir);
-    snd_pcm_hw_params_set_buffer_size_near(pcm_handle, hw_params, &mic_buffer_size);
-    
-    err = snd_pcm_hw_params(pcm_handle, hw_params);
-    if (err) {
-        std::cout << "Error setting HW params: " << snd_strerror(err) << std::endl;
-        success = false;
-    }
-    return success;
+    char signal[32] = "";
+    int n = sscanf(arg, "%f,%f,%f,%31s", &source.azimuth_deg, &source.elevation_deg, &source.level_db, signal);
+    if (n < 2) return false;
+    if (n < 4) return true;
+    char* hz = std::strchr(signal, ':');
+    if (hz) {
+        *hz++ = '\0';
+        source.tone_hz = (float)std::atof(hz);
+    }
+    return sim_signal_from_name(signal, source.signal) && (!hz || source.signal == SimSignal::Tone);
 }
 
-// Convert interleaved 24-bit samples to float arrays for SAF (channel-major)
-void convert_interleaved_to_float_channels(int32_t* interleaved, float** channels, 
-                                            int num_frames, int num_channels)
+static bool parse_options(int argc, char** argv, AppOptions& opts)
 {
-    const float scale = 1.0f / 8388608.0f; // 2^23 for 24-bit normalization
-    
-    for (int f = 0; f < num_frames; ++f) {
-        for (int ch = 0; ch < num_channels; ++ch) {
-            int32_t sample = interleaved[f * num_channels + ch];
-            // Sign extension for 24-bit in 32-bit container
-            sample = (sample << 8) >> 8;
-            channels[ch][f] = (float)sample * scale;
+    opts.monitor_config.device.device = "default";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--file" && has_value) {
+            opts.file_path = argv[++i];
+        } else if (arg == "--raw" && has_value) {
+            std::string fmt = argv[++i];
+            opts.have_raw = true;
+            if (fmt == "s24_3le") opts.raw.format = SampleFormat::S24_3LE;
+            else if (fmt == "s24_le") opts.raw.format = SampleFormat::S24_LE;
+            else if (fmt == "s32_le") opts.raw.format = SampleFormat::S32_LE;
+            else {
+                std::cout << "Unknown raw format: " << fmt << std::endl;
+                return false;
+            }
+        } else if (arg == "--rate" && has_value) {
+            opts.raw.sample_rate = std::atoi(argv[++i]);
+        } else if (arg == "--quiet") {
+            opts.quiet = true;
+        } else if (arg == "--tracks") {
+            opts.tracks = true;
+        } else if (arg == "--card" && has_value) {
+            opts.card_name = argv[++i];
+        } else if (arg == "--device" && has_value) {
+            opts.device = argv[++i];
+        } else if (arg == "--list-devices") {
+            opts.list_devices = true;
+        } else if (arg == "--no-mmap") {
+            opts.no_mmap = true;
+        } else if (arg == "--period" && has_value) {
+            opts.period_frames = std::atoi(argv[++i]);
+        } else if (arg == "--periods" && has_value) {
+            opts.periods = std::atoi(argv[++i]);
+            if (opts.periods < 2) opts.periods = 2;
+        } else if (arg == "--rt" || (arg == "--rt-priority" && has_value)) {
+            // The capture thread preempts the DSP thread: it only drains
+            // the ALSA buffer, and an overrun there loses audio for good
+            int priority = arg == "--rt" ? 80 : std::min(99, std::max(2, std::atoi(argv[++i])));
+            opts.capture_rt.priority = priority;
+            opts.dsp_rt.priority = std::max(1, priority - 5);
+            // Below capture, above DSP: a late period is audible at once
+            opts.monitor_config.rt.priority = std::max(1, priority - 2);
+            opts.lock_memory = true;
+        } else if (arg == "--cpu-capture" && has_value) {
+            opts.capture_rt.cpu = std::max(-1, std::atoi(argv[++i]));
+        } else if (arg == "--cpu-dsp" && has_value) {
+            opts.dsp_rt.cpu = std::max(-1, std::atoi(argv[++i]));
+        } else if (arg == "--doa" && has_value) {
+            if (!doa_method_from_name(argv[++i], opts.doa_method)) {
+                std::cout << "Unknown DoA method: " << argv[i] << std::endl;
+                return false;
+            }
+        } else if (arg == "--doa-grid" && has_value) {
+            opts.doa_directions = std::max(16, std::atoi(argv[++i]));
+        } else if (arg == "--doa-sources" && has_value) {
+            opts.doa_sources = std::max(1, std::min(8, std::atoi(argv[++i])));
+        } else if (arg == "--histogram" && has_value) {
+            opts.histogram_s = std::max(0.0f, (float)std::atof(argv[++i]));
+        } else if (arg == "--publish") {
+            opts.publish = true;
+        } else if (arg == "--publish-name" && has_value) {
+            opts.publish = true;
+            opts.publish_name = argv[++i];
+        } else if (arg == "--publish-socket" && has_value) {
+            opts.publish = true;
+            opts.publish_socket = argv[++i];
+        } else if (arg == "--record" && has_value) {
+            opts.record = true;
+            opts.record_config.directory = argv[++i];
+        } else if (arg == "--record-mic") {
+            opts.record_config.record_mic = true;
+        } else if (arg == "--rotate" && has_value) {
+            opts.record_config.rotate_s = std::max(0.0f, (float)std::atof(argv[++i]));
+        } else if (arg == "--gate" && has_value) {
+            std::string detector = argv[++i];
+            opts.gate = detector != "off";
+            if (detector == "level") opts.gate_config.detector = GateDetector::Level;
+            else if (detector == "vad") opts.gate_config.detector = GateDetector::Vad;
+            else if (opts.gate) {
+                std::cout << "Unknown gate detector: " << detector << std::endl;
+                return false;
+            }
+        } else if (arg == "--gate-level" && has_value) {
+            opts.gate_config.open_db = (float)std::atof(argv[++i]);
+            opts.gate_config.close_db = opts.gate_config.open_db - 6.0f;
+        } else if (arg == "--gate-snr" && has_value) {
+            opts.gate_config.snr_open_db = std::max(1.0f, (float)std::atof(argv[++i]));
+            opts.gate_config.snr_close_db = opts.gate_config.snr_open_db * 0.5f;
+        } else if (arg == "--gate-hold" && has_value) {
+            opts.gate_config.hold_s = std::max(0, std::atoi(argv[++i])) / 1000.0f;
+        } else if (arg == "--preroll" && has_value) {
+            opts.gate_config.preroll_s = std::max(0, std::atoi(argv[++i])) / 1000.0f;
+        } else if (arg == "--idle-decimate" && has_value) {
+            opts.gate_config.idle_decimation = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--monitor" && has_value) {
+            if (!monitor_mode_from_name(argv[++i], opts.monitor_mode)) {
+                std::cout << "Unknown monitor mode: " << argv[i] << std::endl;
+                return false;
+            }
+            opts.monitor = true;
+        } else if (arg == "--monitor-device" && has_value) {
+            opts.monitor_config.device.device = nullptr;
+            pcm_device_select(opts.monitor_config.device, argv[++i]);
+        } else if (arg == "--monitor-latency" && has_value) {
+            opts.monitor_config.latency_ms = std::max(1.0f, (float)std::atof(argv[++i]));
+        } else if (arg == "--monitor-gain" && has_value) {
+            opts.monitor_gain_db = (float)std::atof(argv[++i]);
+        } else if (arg == "--monitor-taps" && has_value) {
+            opts.monitor_taps = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--sim-source" && has_value) {
+            SimSource source;
+            if (!parse_sim_source(argv[++i], source)) {
+                std::cout << "Bad simulated source: " << argv[i] << std::endl;
+                return false;
+            }
+            opts.sim_config.sources.push_back(source);
+            opts.simulate = true;
+        } else if (arg == "--sim-noise" && has_value) {
+            opts.sim_config.noise_db = (float)std::atof(argv[++i]);
+        } else if (arg == "--sim-rt60" && has_value) {
+            opts.sim_config.rt60_s = std::max(0.0f, (float)std::atof(argv[++i]));
+        } else if (arg == "--sim-reverb" && has_value) {
+            opts.sim_config.reverb_db = (float)std::atof(argv[++i]);
+        } else if (arg == "--sim-speed" && has_value) {
+            opts.sim_speed = std::max(0.0f, (float)std::atof(argv[++i]));
+        } else if (arg == "--array" && has_value) {
+            if ((int)opts.arrays.size() == DeadlinePool::max_streams) {
+                std::cout << "At most " << DeadlinePool::max_streams << " arrays" << std::endl;
+                return false;
+            }
+            opts.arrays.push_back(argv[++i]);
+        } else if (arg == "--workers" && has_value) {
+            opts.pool_workers = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--cpu-workers" && has_value) {
+            opts.pool_cpu = std::max(-1, std::atoi(argv[++i]));
+        } else if (arg == "--deadline" && has_value) {
+            opts.deadline_ms = std::max(0.0f, (float)std::atof(argv[++i]));
+        } else if (arg == "--refresh" && has_value) {
+            opts.refresh_hz = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--stats" && has_value) {
+            opts.stats_path = argv[++i];
+        } else if (arg == "--stats-interval" && has_value) {
+            opts.stats_interval_s = std::atoi(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return false;
         }
     }
+    return true;
 }
 
-int main()
+// Stage latencies plus the capture-side counters
+static void print_live_stats(FILE* out, const StageStats& stats, const CaptureContext& capture,
+                             const SpscFrameRing& ring, const ActivityGate* gate, const Recorder* recorder)
 {
-    std::cout << "=== SAF Ambisonics POC ===" << std::endl;
-    std::cout << "Microphone channels: " << mic_channels << std::endl;
-    std::cout << "SH Order: " << SH_ORDER << " (" << NUM_SH_SIGNALS << " SH signals)" << std::endl;
-    
-    // === Initialize SAF components ===
-    
-    // 1. Create array2sh instance (microphone array to spherical harmonics)
-    void* array2sh_handle = nullptr;
-    array2sh_create(&array2sh_handle);
-    array2sh_init(array2sh_handle, mic_sample_rate);
-    
-    // Configure for Zylia ZM-1 (19 microphones on a sphere)
-    array2sh_setPreset(array2sh_handle, MICROPHONE_ARRAY_PRESET_ZYLIA_1D);
-    array2sh_setEncodingOrder(array2sh_handle, (SH_ORDERS)SH_ORDER);
-    array2sh_setNormType(array2sh_handle, NORM_SN3D);
-    array2sh_setChOrder(array2sh_handle, CH_ACN);
-    //array2sh_setGain(array2sh_handle, 30.0f);
+    fprintf(out, "--- latency after %.1f s of audio ---\n", (double)ring.frames_read() / capture.sample_rate);
+    stage_stats_report(stats, out);
+    fprintf(out, "xruns: %llu, short reads: %llu, skipped frames: %llu (%llu blocks)\n",
+            (unsigned long long)capture.xruns.load(), (unsigned long long)capture.short_reads.load(),
+            (unsigned long long)ring.dropped_frames(), (unsigned long long)ring.dropped_blocks());
+    double rate = capture.clock.measured_rate();
+    if (rate > 0.0) {
+        fprintf(out, "device clock: %.3f Hz (%+.1f ppm against CLOCK_MONOTONIC)\n", rate,
+                (rate / capture.sample_rate - 1.0) * 1e6);
+    }
+    if (gate) activity_gate_report(*gate, out);
+    if (recorder) recorder_report(*recorder, out);
+    fflush(out);
+}
 
-    // Evaluate encoder (computes encoding filters)
-    std::cout << "Initializing array2sh encoder..." << std::endl;
-    array2sh_evalEncoder(array2sh_handle);
-    
-    // Wait for initialization to complete
-    while (array2sh_getEvalStatus(array2sh_handle) == EVAL_STATUS_EVALUATING) {
-        std::cout << "." << std::flush;
-        usleep(100000); // 100ms
+// One results record per update, filled in place in the shared ring.
+// DSP thread: no allocation, no blocking.
+static void publish_update(ResultsPublisher& results, const Pipeline& p, const SampleTime& end, float input_db,
+                           uint32_t array_id = 0)
+{
+    DoaRecord& r = results_begin(results);
+    const DoaEstimate& est = p.estimate;
+    r.stream_frame = end.stream_frame;
+    r.device_frame = end.device_frame;
+    r.capture_monotonic_ns = end.monotonic_ns;
+    r.capture_realtime_ns = end.realtime_ns;
+    r.sample_rate = (uint32_t)p.sample_rate;
+    r.method = (int32_t)p.doa_method;
+    r.array_id = array_id;
+    r.azimuth_deg = est.azimuth_deg;
+    r.elevation_deg = est.elevation_deg;
+    r.strength = est.strength;
+    r.input_db = input_db;
+    r.sh_db = p.sh_levels->mean_db();
+    r.gate_open = !p.gate || p.gate->is_open();
+
+    r.num_tracks = 0;
+    const DoaTracker& tracker = *p.tracker;
+    for (int i = 0; i < tracker.num_tracks() && r.num_tracks < doa_record_max_tracks; ++i) {
+        const DoaTrack& t = tracker.track(i);
+        if (t.confirmed) r.tracks[r.num_tracks++] = {t.id, t.azimuth_deg, t.elevation_deg, t.strength};
     }
-    std::cout << " Done!" << std::endl;
-    
-    // 2. Create sldoa instance (spatial localization based on direction of arrival)
-    void* sld_handle = nullptr;
-    sldoa_create(&sld_handle);
-    sldoa_init(sld_handle, mic_sample_rate);
-    
-    // Configure sldoa
-    sldoa_setMasterOrder(sld_handle, (SH_ORDERS)SH_ORDER);
-    sldoa_setNormType(sld_handle, NORM_SN3D);
-    sldoa_setChOrder(sld_handle, CH_ACN);
-    
-    // CRITICAL: Initialize the codec - without this, sldoa_analysis does nothing!
-    std::cout << "Initializing sldoa codec..." << std::endl;
-    sldoa_initCodec(sld_handle);
-    while (sldoa_getCodecStatus(sld_handle) == CODEC_STATUS_INITIALISING) {
-        std::cout << "." << std::flush;
-        usleep(100000); // 100ms
+
+    // sldoa: the dominant sector of every band of this update
+    const DoaDisplayData& d = p.doa;
+    r.start_band = d.start_band;
+    r.num_bands = 0;
+    if (!p.doa_engine && est.strength >= 0.0f && d.sectors_per_band && d.alpha_scale) {
+        for (int band = d.start_band; band <= d.end_band && r.num_bands < doa_record_max_bands; ++band) {
+            int best = band * d.max_num_sectors;
+            for (int sector = 1; sector < d.sectors_per_band[band]; ++sector) {
+                int i = band * d.max_num_sectors + sector;
+                if (d.alpha_scale[i] > d.alpha_scale[best]) best = i;
+            }
+            r.bands[r.num_bands++] = {d.azi_deg[best], d.elev_deg[best], d.alpha_scale[best]};
+        }
     }
-    std::cout << " Done!" << std::endl;
-    
-    // Get frame sizes
-    int a2sh_framesize = array2sh_getFrameSize();
-    int sldoa_framesize = sldoa_getFrameSize();
-    
-    std::cout << "array2sh frame size: " << a2sh_framesize << std::endl;
-    std::cout << "sldoa frame size: " << sldoa_framesize << std::endl;
+    results_commit(results);
+}
+
+// Live mode: capture thread -> ring -> pipeline, with the console display
+static int run_live(Pipeline& pipeline, const AppOptions& opts, ResultsPublisher* results, Recorder* recorder,
+                    FILE* stats_out)
+{
+    const int framesize = pipeline.framesize;
     
-    // Use array2sh frame size for ALSA (smaller, more responsive)
-    // We'll accumulate frames for sldoa internally
-    int framesize = a2sh_framesize;  // 128 samples
-    mic_period_size = framesize;
+    // The ALSA period is independent of the SAF frame; the ring in between
+    // re-blocks whatever the driver delivers into exact SAF frames
+    CaptureDeviceConfig device_config;
+    device_config.device = opts.device;
+    device_config.card_name = opts.card_name;
+    device_config.channels = mic_channels;
+    device_config.sample_rate = (unsigned int)pipeline.sample_rate;
+    device_config.period_frames = opts.period_frames > 0 ? opts.period_frames : framesize;
+    device_config.periods = opts.periods;
+    device_config.mmap = !opts.no_mmap;
     
-    // sldoa processes every SLDOA_FRAME_SIZE (512) samples
-    // It has 4 time slots (512/128 = 4), so we should only read display data
-    // after 4 frames have been processed
-    int frames_per_sldoa_update = sldoa_framesize / a2sh_framesize; // 512/128 = 4
-    int frame_counter = 0;
+    // === Initialize ALSA ===
+    // (or the simulated array, which delivers one SAF frame per period)
+    CaptureDevice device;
+    ArraySimulator simulator(opts.sim_config);
+    if (opts.simulate) {
+        if (!simulator.prepare(pipeline.sample_rate, framesize)) return -1;
+        device.name = "simulator";
+        device.sample_rate = (unsigned int)pipeline.sample_rate;
+        device.period_frames = device.buffer_frames = (snd_pcm_uframes_t)framesize;
+        std::cout << "Simulated ZM-1: " << simulator.num_sources() << " source(s), sensor noise "
+                  << opts.sim_config.noise_db << " dBFS";
+        if (opts.sim_config.rt60_s > 0.0f) {
+            std::cout << ", rt60 " << opts.sim_config.rt60_s << " s at " << opts.sim_config.reverb_db << " dB";
+        }
+        if (opts.sim_speed > 0.0f) std::cout << ", " << opts.sim_speed << "x real time";
+        else std::cout << ", unpaced (lossless)";
+        std::cout << " (" << simd_level_name(simulator.simd_level()) << ")" << std::endl;
+        for (const SimSource& src : opts.sim_config.sources) {
+            std::cout << "  " << sim_signal_name(src.signal) << " at " << src.azimuth_deg << ", "
+                      << src.elevation_deg << " deg, " << src.level_db << " dBFS" << std::endl;
+        }
+    } else if (!capture_device_open(device, device_config)) {
+        std::cout << "Failed to initialize microphone." << std::endl;
+        return -1;
+    } else {
+        pcm_device_report(device, stdout);
+    }
+    if ((int)device.sample_rate != pipeline.sample_rate) {
+        std::cout << "Device runs at " << device.sample_rate << " Hz, the pipeline at " << pipeline.sample_rate
+                  << " Hz" << std::endl;
+        return -1;
+    }
+    snd_pcm_t* pcm_handle = device.pcm;
     
-    // === Allocate audio buffers ===
+    // Ring between the capture thread and this (DSP) thread. Converted float
+    // channels live here; mic_input just points into the ring, no copy.
+    // The device may have adjusted the period, so size the ring afterwards.
+    // Ring storage and the RW period buffer come from one arena, allocated
+    // before capture starts; nothing is allocated while audio is flowing.
+    int min_ring_frames = (int)device.period_frames * ring_min_periods;
+    int num_ring_blocks = std::max(ring_blocks, (min_ring_frames + framesize - 1) / framesize);
+    BufferArena arena;
+    int ring_buffers = arena.add_channels(mic_channels, framesize * num_ring_blocks);
+    int period_bytes = device.mmap || opts.simulate ? -1 : arena.add_bytes((size_t)device.period_frames * pcm_device_frame_bytes(device));
+    int monitor_buffers = opts.monitor ? arena.add_channels(MonitorDecoder::num_outputs, framesize) : -1;
+    if (!arena.allocate()) {
+        std::cout << "Cannot allocate audio buffers" << std::endl;
+        return -1;
+    }
+    SpscFrameRing capture_ring(arena.channels(ring_buffers), mic_channels, framesize * num_ring_blocks);
+    const float* mic_input[mic_channels];
     
-    // Input buffer for ALSA (interleaved 24-bit)
-    int32_t* alsa_buffer = new int32_t[framesize * mic_channels];
+    // Per-capsule input levels, measured by the capture thread during conversion
+    LevelMeter mic_levels(mic_channels, device.sample_rate);
     
-    // Input channels for array2sh (float, channel-major)
-    float** mic_input = new float*[mic_channels];
-    for (int i = 0; i < mic_channels; ++i) {
-        mic_input[i] = new float[framesize];
+    if (!opts.simulate) {
+        std::cout << "Period: " << device.period_frames << " frames x " << device.buffer_frames / device.period_frames
+                  << " (SAF frame: " << framesize << ")" << std::endl;
+        std::cout << "Access: " << (device.mmap ? "mmap" : opts.no_mmap ? "read" : "read (mmap not supported)") << std::endl;
+        std::cout << "Timestamps: " << (device.htstamps ? "driver htstamp (monotonic)" : "status call time") << std::endl;
     }
     
-    // Output SH signals from array2sh
-    float** sh_output = new float*[NUM_SH_SIGNALS];
-    for (int i = 0; i < NUM_SH_SIGNALS; ++i) {
-        sh_output[i] = new float[framesize];
+    // Headphone monitor: decoded on this thread after array2sh, played by
+    // its own thread behind a ring. Filters are designed and timed here.
+    MonitorDecoder monitor_decoder(SH_ORDER, framesize, opts.monitor_mode);
+    MonitorOutput monitor_output;
+    float** monitor_block = opts.monitor ? arena.channels(monitor_buffers) : nullptr;
+    if (opts.monitor) {
+        monitor_output.config = opts.monitor_config;
+        monitor_output.config.device.period_frames = (snd_pcm_uframes_t)framesize;
+        if (!monitor_decoder.prepare(pipeline.sample_rate, opts.monitor_gain_db, opts.monitor_taps) ||
+            !monitor_output_start(monitor_output, pipeline.sample_rate, framesize)) {
+            std::cout << "Failed to start the monitor." << std::endl;
+            return -1;
+        }
+        pcm_device_report(monitor_output.device, stdout);
+        std::cout << "Monitor: " << monitor_mode_name(monitor_decoder.mode());
+        if (monitor_decoder.mode() == MonitorMode::Binaural) {
+            std::cout << ", " << monitor_decoder.partitions() << " of " << monitor_decoder.designed_partitions()
+                      << " filter partitions (" << monitor_decoder.partitions() * framesize << " taps)";
+        }
+        std::cout << ", " << std::fixed << std::setprecision(1) << 100.0f * monitor_decoder.load()
+                  << "% of a frame" << std::defaultfloat << std::endl;
     }
     
-    // === Initialize ALSA ===
-    snd_pcm_t* pcm_handle = nullptr;
-    snd_pcm_hw_params_t* hw_params = nullptr;
-    
-    if (snd_pcm_open(&pcm_handle, device_in_use, SND_PCM_STREAM_CAPTURE, 0)) {
-        std::cout << "Error opening PCM device " << device_in_use << std::endl;
-        return -1;
+    if (pcm_handle) {
+        snd_pcm_prepare(pcm_handle);
+        snd_pcm_start(pcm_handle);
     }
     
-    if (!init_mic(pcm_handle, hw_params)) {
-        std::cout << "Failed to initialize microphone." << std::endl;
+    CaptureContext capture;
+    capture.pcm = pcm_handle;
+    capture.simulator = opts.simulate ? &simulator : nullptr;
+    capture.sim_speed = opts.sim_speed;
+    capture.channels = mic_channels;
+    capture.period_frames = (int)device.period_frames;
+    capture.ring = &capture_ring;
+    capture.use_mmap = device.mmap;
+    capture.format = device.format;
+    capture.levels = &mic_levels;
+    capture.stats = pipeline.stats;
+    capture.rt = opts.capture_rt;
+    capture.sample_rate = (int)device.sample_rate;
+    capture.htstamps = device.htstamps;
+    if (period_bytes >= 0) capture.period_buffer = (uint8_t*)arena.bytes(period_bytes);
+    if (!capture_start(capture)) {
+        std::cout << "Failed to start capture thread." << std::endl;
         return -1;
     }
     
-    snd_pcm_prepare(pcm_handle);
-    snd_pcm_start(pcm_handle);
-    
     std::cout << "\n=== Capturing and Processing ===" << std::endl;
-    std::cout << "Make some noise! (Clap, snap, speak...)" << std::endl;
+    if (!opts.simulate) std::cout << "Make some noise! (Clap, snap, speak...)" << std::endl;
     std::cout << "Press Ctrl+C to exit.\n" << std::endl;
     
-    // Persistent display data (only update when sldoa produces new output)
-    float* azi_deg = nullptr;
-    float* elev_deg = nullptr;
-    float* colour_scale = nullptr;
-    float* alpha_scale = nullptr;
-    int* sectors_per_band = nullptr;
-    int max_num_sectors = 0;
-    int start_band = 0;
-    int end_band = 0;
+    // Periodic latency summary, off the audio threads
+    StageStats& stats = *pipeline.stats;
+    stats.block_budget_ns = (uint64_t)framesize * 1000000000ull / device.sample_rate;
+    std::atomic<bool> reporting{true};
+    std::thread reporter;
+    if (opts.stats_interval_s > 0) {
+        reporter = std::thread([&] {
+            uint64_t next = monotonic_ns() + (uint64_t)opts.stats_interval_s * 1000000000ull;
+            while (reporting.load()) {
+                usleep(100000);
+                if (monotonic_ns() < next) continue;
+                next += (uint64_t)opts.stats_interval_s * 1000000000ull;
+                print_live_stats(stats_out, stats, capture, capture_ring, pipeline.gate, recorder);
+            }
+        });
+    }
+    
+    // Console display runs on its own thread
+    ConsoleUi ui;
+    ui.refresh_hz = opts.refresh_hz;
+    ui.stats = &stats;
+    console_ui_start(ui);
+    
+    // Real-time setup last: every buffer and helper thread exists by now, so
+    // locking covers them, and the UI and reporter threads do not inherit
+    // the DSP thread's priority or CPU
+    bool memory_locked = opts.lock_memory && rt_lock_memory();
+    bool dsp_rt = opts.dsp_rt.priority > 0 || opts.dsp_rt.cpu >= 0;
+    if (dsp_rt) dsp_rt = rt_apply_thread("DSP", opts.dsp_rt);
+    
+    // Stream frames -> device frames and capture times
+    StreamTimeline timeline(capture_ring.discontinuities(), &capture.clock.models);
     
     // === Main processing loop ===
     for (int iteration = 0; iteration < 10000; ++iteration) {
-        // Read audio from ALSA
-        snd_pcm_sframes_t frames_read = snd_pcm_readi(pcm_handle, alsa_buffer, framesize);
-        
-        if (frames_read == -EPIPE) {
-            snd_pcm_prepare(pcm_handle);
-            continue;
-        } else if (frames_read < 0) {
-            std::cout << "ALSA Error: " << snd_strerror(frames_read) << std::endl;
+        // Wait for the capture thread to deliver a full frame
+        bool have_frame;
+        {
+            StageTimer timer(&stats, Stage::DspWait);
+            have_frame = capture_ring.wait_for(framesize, 1000);
+        }
+        if (!have_frame) {
+            if (capture.exited.load()) {
+                std::cout << "Capture stopped on a device error." << std::endl;
+                break;
+            }
+            std::cout << "No audio from capture thread." << std::endl;
             continue;
-        } else if (frames_read != framesize) {
-            continue; // Wait for full frame
+        }
+        {
+            // Per-frame work must not touch the heap (checked in debug builds)
+            ScopedNoAlloc no_alloc;
+            StageTimer timer(&stats, Stage::Block);
+            capture_ring.read_block(mic_input, framesize);
+            // Sample counter and capture time of the block's first frame
+            const SampleTime block_time = timeline.at(capture_ring.frames_read());
+            
+            // mic signals -> SH signals -> DoA estimates
+            bool updated = pipeline_process(pipeline, (const float* const*)mic_input);
+            if (updated && results) {
+                publish_update(*results, pipeline, timeline.after(block_time, framesize), mic_levels.mean_db());
+            }
+            // Queued for the writer thread, before the ring slot is handed back
+            if (recorder) recorder_push(*recorder, (const float* const*)pipeline.sh_output, mic_input);
+            if (monitor_block) {
+                StageTimer monitor_timer(&stats, Stage::Monitor);
+                monitor_decoder.process((const float* const*)pipeline.sh_output, monitor_block);
+                monitor_output_push(monitor_output, (const float* const*)monitor_block);
+            }
+            
+            // Done with this frame, hand the slot back to the capture thread
+            capture_ring.release(framesize);
         }
         
-        // Convert interleaved 24-bit to float channels
-        convert_interleaved_to_float_channels(alsa_buffer, mic_input, framesize, mic_channels);
+        // Input level for activity detection (latest captured chunk)
+        float input_db = mic_levels.mean_db();
         
-        // === Process with array2sh (mic signals -> SH signals) ===
-        array2sh_process(array2sh_handle, 
-                         (const float* const*)mic_input, 
-                         sh_output, 
-                         mic_channels, 
-                         NUM_SH_SIGNALS, 
-                         framesize);
+        // Hand the display values to the UI thread; rendering happens there
+        if (iteration % 4 != 0) continue;
         
-        // === Process with sldoa (SH signals -> DoA estimates) ===
-        sldoa_analysis(sld_handle, 
-                       (const float* const*)sh_output, 
-                       NUM_SH_SIGNALS, 
-                       framesize, 
-                       1); // isPlaying = 1
+        DoaSnapshot& snap = ui.snapshots.write_buffer();
+        const DoaDisplayData& doa = pipeline.doa;
+        const DoaEstimate& est = pipeline.estimate;
+        snap.frame = iteration;
+        snap.input_db = input_db;
+        snap.sh_db = pipeline.sh_levels->mean_db();
+        for (int ch = 0; ch < mic_channels; ++ch) snap.capsule_db[ch] = mic_levels.smoothed_db(ch);
+        snap.ring_fill = capture_ring.fill();
+        snap.ring_capacity = capture_ring.capacity();
+        snap.dropped_blocks = capture_ring.dropped_blocks();
+        snap.xruns = capture.xruns.load();
+        snap.discontinuities = capture_ring.discontinuities().count();
+        snap.method = pipeline.doa_method;
+        snap.grid_directions = pipeline.doa_directions;
+        snap.histogram = pipeline.histogram != nullptr;
         
-        // Increment frame counter
-        frame_counter++;
+        const ActivityGate* gate = pipeline.gate;
+        snap.gated = gate != nullptr;
+        if (gate) {
+            snap.gate_open = gate->is_open();
+            snap.gate_level_db = gate->level_db();
+            snap.gate_floor_db = gate->noise_floor_db();
+            snap.gate_vad = gate->config().detector == GateDetector::Vad;
+            snap.duty_cycle = gate->duty_cycle();
+        }
         
-        // Only get display data every N frames (when sldoa has processed a full block)
-        if (frame_counter >= frames_per_sldoa_update) {
-            frame_counter = 0;
-            sldoa_getDisplayData(sld_handle, &azi_deg, &elev_deg, &colour_scale, &alpha_scale,
-                                 &sectors_per_band, &max_num_sectors, &start_band, &end_band);
+        // Show DoA estimates if audio is present (the gate decides that itself)
+        snap.have_doa = (gate || input_db > -50.0f) && est.strength >= 0.0f;
+        if (snap.have_doa) {
+            snap.azimuth_deg = est.azimuth_deg;
+            snap.elevation_deg = est.elevation_deg;
+            snap.alpha = est.strength;
+            snap.band = est.band;
+            snap.sector = est.sector;
+            snap.num_tracks = 0;
+            const DoaTracker& tracker = *pipeline.tracker;
+            for (int i = 0; i < tracker.num_tracks(); ++i) {
+                if (tracker.track(i).confirmed) snap.tracks[snap.num_tracks++] = tracker.track(i);
+            }
+            if (doa.sectors_per_band) {
+                snap.start_band = doa.start_band;
+                snap.end_band = doa.end_band;
+                snap.max_num_sectors = doa.max_num_sectors;
+                snap.sectors_in_start_band = doa.sectors_per_band[doa.start_band];
+            }
         }
+        ui.snapshots.publish();
+    }
+    
+    console_ui_stop(ui);
+    capture_stop(capture);
+    monitor_output_stop(monitor_output);
+    reporting.store(false);
+    if (reporter.joinable()) reporter.join();
+    // The recorder reports once it has drained, after this
+    print_live_stats(stats_out, stats, capture, capture_ring, pipeline.gate, nullptr);
+    std::cout << std::endl << "Capture: " << capture.periods.load() << " periods, "
+              << capture.xruns.load() << " xruns, "
+              << capture.short_reads.load() << " short reads, "
+              << capture_ring.dropped_blocks() << " dropped blocks ("
+              << capture_ring.dropped_frames() << " frames)" << std::endl;
+    std::cout << "Tracks: " << pipeline.tracker->births() << " sources confirmed, "
+              << pipeline.tracker->deaths() << " ended" << std::endl;
+    if (opts.monitor) monitor_output_report(monitor_output, stdout);
+    if (opts.lock_memory || opts.capture_rt.cpu >= 0 || opts.dsp_rt.cpu >= 0) {
+        // The warnings scrolled away under the console display
+        std::cout << "Real-time: capture thread " << (capture.rt_applied.load() ? "configured" : "not configured")
+                  << ", DSP thread " << (dsp_rt ? "configured" : "not configured")
+                  << (opts.monitor ? (monitor_output.rt_applied.load() ? ", monitor thread configured"
+                                                                       : ", monitor thread not configured") : "")
+                  << ", memory " << (memory_locked ? "locked" : "not locked") << std::endl;
+    }
+    
+    // Where the stream the DSP saw has gaps (most recent ones)
+    const DiscontinuityLog& gaps = capture_ring.discontinuities();
+    uint64_t num_gaps = gaps.count();
+    for (uint64_t i = num_gaps > 10 ? num_gaps - 10 : 0; i < num_gaps; ++i) {
+        Discontinuity d;
+        if (!gaps.get(i, d)) continue;
+        std::cout << "  Discontinuity #" << i << " at " << std::fixed << std::setprecision(3)
+                  << (double)d.stream_frame / device.sample_rate << " s (frame " << d.stream_frame << "): "
+                  << discontinuity_kind_name(d.kind);
+        if (d.lost_frames) std::cout << ", " << d.lost_frames << " frames lost";
+        std::cout << std::endl;
+    }
+    
+    if (pcm_handle) snd_pcm_drop(pcm_handle);
+    return 0;
+}
+
+// One array of a multi-array run: its own capture thread, ring, pipeline
+// and stats. Its blocks run on whichever pool worker is free, one at a time.
+struct ArrayStream
+{
+    int id = 0;
+    std::string name;
+    CaptureDevice device;
+    std::unique_ptr<ArraySimulator> simulator;
+    Pipeline pipeline;
+    bool pipeline_ready = false;
+    StageStats stats;
+    BufferArena arena;
+    std::unique_ptr<SpscFrameRing> ring;
+    std::unique_ptr<LevelMeter> levels;
+    std::unique_ptr<StreamTimeline> timeline;
+    CaptureContext capture;
+    DeadlinePool* pool = nullptr;
+    int64_t block_ns = 0;                 // one SAF frame
+    std::atomic<uint64_t> blocks{0};      // processed
+    TripleBuffer<DoaEstimate> estimates;  // latest estimate, for the status lines
+};
+
+// Capture thread, after each chunk: a block is ready once the ring holds a
+// SAF frame, and due one deadline after its last frame arrived (now)
+static void array_block_ready(void* arg)
+{
+    ArrayStream& a = *(ArrayStream*)arg;
+    if (a.ring->fill() >= a.pipeline.framesize) {
+        a.pool->post(a.id, (int64_t)monotonic_ns() + a.pool->config().deadline_ns);
+    }
+}
+
+// Pool worker: the oldest ready block of one array (see DeadlinePool::JobFn).
+// The same per-block work as the single-array DSP thread; only the results
+// publisher is shared between the arrays, so publishing is serialized.
+static int64_t process_array_block(ArrayStream& a, ResultsPublisher* results, std::mutex& publish_mutex)
+{
+    const int framesize = a.pipeline.framesize;
+    SpscFrameRing& ring = *a.ring;
+    if (ring.fill() < framesize) return -1;
+    {
+        ScopedNoAlloc no_alloc;
+        StageTimer timer(&a.stats, Stage::Block);
+        const float* mic_input[mic_channels];
+        ring.read_block(mic_input, framesize);
+        const SampleTime block_time = a.timeline->at(ring.frames_read());
+        bool updated = pipeline_process(a.pipeline, (const float* const*)mic_input);
+        if (updated) {
+            a.estimates.write_buffer() = a.pipeline.estimate;
+            a.estimates.publish();
+            if (results) {
+                std::lock_guard<std::mutex> lock(publish_mutex);
+                publish_update(*results, a.pipeline, a.timeline->after(block_time, framesize), a.levels->mean_db(),
+                               (uint32_t)a.id);
+            }
+        }
+        ring.release(framesize);
+    }
+    a.blocks.fetch_add(1, std::memory_order_relaxed);
+    if (ring.fill() < framesize) return 0;
+    // The next block is complete already (a backlog): due one deadline after
+    // its last frame was captured, so a stream that fell behind goes first
+    const SampleTime next = a.timeline->at(ring.frames_read());
+    const int64_t ready_ns = next.monotonic_ns ? next.monotonic_ns + a.block_ns : (int64_t)monotonic_ns();
+    return ready_ns + a.pool->config().deadline_ns;
+}
+
+// One status line per array, from the main thread
+static void print_array_status(ArrayStream& a, uint64_t& last_blocks)
+{
+    const uint64_t blocks = a.blocks.load();
+    std::cout << "array " << a.id << " (" << a.name << "): ";
+    if (blocks == last_blocks) {
+        std::cout << "no audio from capture thread";
+    } else {
+        a.estimates.update();
+        const DoaEstimate& est = a.estimates.read_buffer();
+        std::cout << std::fixed << std::setprecision(1) << "input " << a.levels->mean_db() << " dBFS";
+        if (est.strength >= 0.0f) {
+            std::cout << ", azimuth " << est.azimuth_deg << ", elevation " << est.elevation_deg
+                      << std::setprecision(2) << ", strength " << est.strength;
+        } else {
+            std::cout << ", no direction";
+        }
+    }
+    std::cout << ", " << a.ring->dropped_blocks() << " dropped blocks" << std::defaultfloat << std::endl;
+    last_blocks = blocks;
+}
+
+// Multi-array mode: a capture thread, ring and pipeline per array, and the
+// DSP of all of them on one shared worker pool, earliest deadline first.
+// Status lines and the pool's headroom instead of the console display.
+static int run_multi(const AppOptions& opts, ResultsPublisher* results, FILE* stats_out)
+{
+    const int num_arrays = (int)opts.arrays.size();
+    std::vector<std::unique_ptr<ArrayStream>> arrays;
+    int result = 0;
+    
+    // === Per-array setup ===
+    // One after the other: SAF initialization (FFTW planning) is not thread-safe
+    for (int i = 0; i < num_arrays; ++i) {
+        arrays.emplace_back(new ArrayStream());
+        ArrayStream& a = *arrays.back();
+        a.id = i;
+        a.name = opts.arrays[i];
+        std::cout << "\n=== Array " << i << ": " << a.name << " ===" << std::endl;
         
-        // Calculate input level for activity detection
-        float input_energy = 0.0f;
-        for (int ch = 0; ch < mic_channels; ++ch) {
-            for (int s = 0; s < framesize; ++s) {
-                input_energy += mic_input[ch][s] * mic_input[ch][s];
+        Pipeline& p = a.pipeline;
+        p.doa_method = opts.doa_method;
+        p.doa_directions = opts.doa_directions;
+        p.doa_sources = opts.doa_sources;
+        p.histogram_decay_s = opts.histogram_s;
+        if (opts.gate) p.gate_config = &opts.gate_config;
+        if (!pipeline_init(p, mic_sample_rate)) {
+            std::cout << "Failed to initialize SAF pipeline." << std::endl;
+            pipeline_destroy(p);
+            result = -1;
+            break;
+        }
+        a.pipeline_ready = true;
+        p.stats = &a.stats;
+        const int framesize = p.framesize;
+        
+        if (a.name == "sim") {
+            // Same scene for every simulated array, independent noise
+            ArraySimConfig sim_config = opts.sim_config;
+            sim_config.seed += (uint32_t)i;
+            a.simulator.reset(new ArraySimulator(sim_config));
+            if (!a.simulator->prepare(p.sample_rate, framesize)) {
+                result = -1;
+                break;
+            }
+            a.device.name = "simulator";
+            a.device.sample_rate = (unsigned int)p.sample_rate;
+            a.device.period_frames = a.device.buffer_frames = (snd_pcm_uframes_t)framesize;
+            std::cout << "Simulated ZM-1: " << a.simulator->num_sources() << " source(s), "
+                      << (opts.sim_speed > 0.0f ? "paced" : "unpaced (lossless)") << std::endl;
+        } else {
+            CaptureDeviceConfig device_config;
+            pcm_device_select(device_config, opts.arrays[i]);
+            device_config.channels = mic_channels;
+            device_config.sample_rate = (unsigned int)p.sample_rate;
+            device_config.period_frames = opts.period_frames > 0 ? opts.period_frames : framesize;
+            device_config.periods = opts.periods;
+            device_config.mmap = !opts.no_mmap;
+            if (!capture_device_open(a.device, device_config)) {
+                std::cout << "Failed to initialize microphone." << std::endl;
+                result = -1;
+                break;
             }
+            pcm_device_report(a.device, stdout);
+        }
+        if ((int)a.device.sample_rate != p.sample_rate) {
+            std::cout << "Device runs at " << a.device.sample_rate << " Hz, the pipeline at " << p.sample_rate
+                      << " Hz" << std::endl;
+            result = -1;
+            break;
         }
-        input_energy /= (mic_channels * framesize);
-        float input_db = 10.0f * log10f(input_energy + 1e-10f);
         
-        // Only update display every 4 frames (to reduce flickering and CPU)
-        if (iteration % 4 != 0) continue;
+        // Ring and RW period buffer as in run_live
+        int min_ring_frames = (int)a.device.period_frames * ring_min_periods;
+        int num_ring_blocks = std::max(ring_blocks, (min_ring_frames + framesize - 1) / framesize);
+        int ring_buffers = a.arena.add_channels(mic_channels, framesize * num_ring_blocks);
+        int period_bytes = a.device.mmap || a.simulator
+                               ? -1 : a.arena.add_bytes((size_t)a.device.period_frames * pcm_device_frame_bytes(a.device));
+        if (!a.arena.allocate()) {
+            std::cout << "Cannot allocate audio buffers" << std::endl;
+            result = -1;
+            break;
+        }
+        a.ring.reset(new SpscFrameRing(a.arena.channels(ring_buffers), mic_channels, framesize * num_ring_blocks));
+        a.levels.reset(new LevelMeter(mic_channels, a.device.sample_rate));
+        a.timeline.reset(new StreamTimeline(a.ring->discontinuities(), &a.capture.clock.models));
+        a.block_ns = (int64_t)framesize * 1000000000ll / p.sample_rate;
+        a.stats.block_budget_ns = (uint64_t)a.block_ns;
         
-        // === Display results ===
-//        std::cout << "\033[2J\033[H"; // Clear screen
-//        std::cout << "=== SAF Ambisonics Sound Source Localization ===" << std::endl;
-//        std::cout << "Input Level: " << std::fixed << std::setprecision(1) << input_db << " dB" << std::endl;
-//        std::cout << std::endl;
+        CaptureContext& capture = a.capture;
+        capture.pcm = a.device.pcm;
+        capture.simulator = a.simulator.get();
+        capture.sim_speed = opts.sim_speed;
+        capture.channels = mic_channels;
+        capture.period_frames = (int)a.device.period_frames;
+        capture.ring = a.ring.get();
+        capture.use_mmap = a.device.mmap;
+        capture.format = a.device.format;
+        capture.levels = a.levels.get();
+        capture.stats = &a.stats;
+        capture.rt = opts.capture_rt;
+        capture.sample_rate = (int)a.device.sample_rate;
+        capture.htstamps = a.device.htstamps;
+        if (period_bytes >= 0) capture.period_buffer = (uint8_t*)a.arena.bytes(period_bytes);
+        capture.on_data = array_block_ready;
+        capture.on_data_arg = &a;
+    }
+    
+    // === Shared DSP pool ===
+    // Workers below the capture threads (--rt), one CPU each from
+    // --cpu-workers (or --cpu-dsp) on
+    std::unique_ptr<DeadlinePool> pool;
+    std::mutex publish_mutex;
+    std::vector<std::string> labels;
+    for (auto& a : arrays) labels.push_back(std::to_string(a->id) + ": " + a->name);
+    std::vector<const char*> names;
+    for (const std::string& label : labels) names.push_back(label.c_str());
+    bool memory_locked = false;
+    if (result == 0) {
+        DeadlinePoolConfig pool_config;
+        int cpus = std::max(1, (int)std::thread::hardware_concurrency());
+        pool_config.num_workers = opts.pool_workers > 0 ? opts.pool_workers : std::min(num_arrays, cpus);
+        pool_config.first_cpu = opts.pool_cpu >= 0 ? opts.pool_cpu : opts.dsp_rt.cpu;
+        pool_config.priority = opts.dsp_rt.priority;
+        pool_config.deadline_ns = opts.deadline_ms > 0.0f
+                                      ? (int64_t)(opts.deadline_ms * 1e6)
+                                      : arrays[0]->pipeline.frames_per_sldoa_update * arrays[0]->block_ns;
+        pool.reset(new DeadlinePool(pool_config, num_arrays, [&](int, int stream) {
+            return process_array_block(*arrays[stream], results, publish_mutex);
+        }));
+        for (auto& a : arrays) a->pool = pool.get();
         
-        // Debug: Check SH output energy
-        float sh_energy = 0.0f;
-        for (int ch = 0; ch < NUM_SH_SIGNALS; ++ch) {
-            for (int s = 0; s < framesize; ++s) {
-                sh_energy += sh_output[ch][s] * sh_output[ch][s];
+        // Everything is allocated and every thread but capture exists
+        memory_locked = opts.lock_memory && rt_lock_memory();
+        for (auto& a : arrays) {
+            if (a->device.pcm) {
+                snd_pcm_prepare(a->device.pcm);
+                snd_pcm_start(a->device.pcm);
+            }
+            if (!capture_start(a->capture)) {
+                std::cout << "Failed to start capture thread for array " << a->id << "." << std::endl;
+                result = -1;
+                break;
             }
         }
-        sh_energy /= (NUM_SH_SIGNALS * framesize);
-        float sh_db = 10.0f * log10f(sh_energy + 1e-10f);
-//        std::cout << "SH Output Level: " << sh_db << " dB" << std::endl;
-//        std::cout << std::endl;
+    }
+    
+    if (result == 0) {
+        std::cout << "\n=== Capturing and Processing: " << num_arrays << " arrays, " << pool->config().num_workers
+                  << " DSP worker(s), deadline " << std::fixed << std::setprecision(1)
+                  << pool->config().deadline_ns / 1e6 << " ms ===" << std::defaultfloat << std::endl;
+        std::cout << "Press Ctrl+C to exit.\n" << std::endl;
         
-        // Show DoA estimates if audio is present
-        if (input_db > -50.0f && azi_deg != nullptr && elev_deg != nullptr && alpha_scale != nullptr && sectors_per_band != nullptr) {
-            std::cout << "\033[2J\033[H"; // Clear screen
-            std::cout << "=== SAF Ambisonics Sound Source Localization ===" << std::endl;
-            std::cout << "Input Level: " << std::fixed << std::setprecision(1) << input_db << " dB" << std::endl;
-            std::cout << std::endl;
-            std::cout << "SH Output Level: " << sh_db << " dB" << std::endl;
-            std::cout << std::endl;
-            
-            std::cout << "Detected Sound Direction:" << std::endl;
-            std::cout << "  Bands: " << start_band << " to " << end_band 
-                      << ", max_num_sectors: " << max_num_sectors << std::endl;
-            
-            // Find the sector with maximum alpha (energy) across all frequency bands
-            // Data layout: azi_deg[band * max_num_sectors + sector]
-            float max_alpha = -1.0f;
-            int best_band = start_band;
-            int best_sector = 0;
-            
-            for (int band = start_band; band <= end_band; ++band) {
-                int nSectors = sectors_per_band[band];
-                for (int sector = 0; sector < nSectors; ++sector) {
-                    int idx = band * max_num_sectors + sector;
-                    if (alpha_scale[idx] > max_alpha) {
-                        max_alpha = alpha_scale[idx];
-                        best_band = band;
-                        best_sector = sector;
-                    }
+        // As long as the single-array loop runs: 10000 blocks of every array.
+        // An array whose capture thread has exited, or that delivers nothing
+        // for stall_ns, would never get there: the run stops with it.
+        const uint64_t target_blocks = 10000;
+        const uint64_t stall_ns = 5000000000ull;
+        std::vector<uint64_t> last_blocks(num_arrays, 0);
+        std::vector<uint64_t> seen_blocks(num_arrays, 0);
+        std::vector<uint64_t> last_progress(num_arrays, monotonic_ns());
+        uint64_t next_status = monotonic_ns() + 1000000000ull;
+        uint64_t next_report = monotonic_ns() + (uint64_t)opts.stats_interval_s * 1000000000ull;
+        for (;;) {
+            usleep(100000);
+            uint64_t now = monotonic_ns();
+            bool done = true;
+            const ArrayStream* failed = nullptr;
+            for (auto& a : arrays) {
+                const uint64_t blocks = a->blocks.load();
+                done = done && blocks >= target_blocks;
+                if (blocks != seen_blocks[a->id]) {
+                    seen_blocks[a->id] = blocks;
+                    last_progress[a->id] = now;
+                } else if (blocks < target_blocks && !failed &&
+                           (a->capture.exited.load() || now - last_progress[a->id] > stall_ns)) {
+                    failed = a.get();
                 }
             }
-            
-            int best_idx = best_band * max_num_sectors + best_sector;
-            
-            // Debug: print a few values from the first valid band
-            std::cout << "  Sectors in band " << start_band << ": " << sectors_per_band[start_band] << std::endl;
-            
-            // Display dominant direction
-            std::cout << "  Azimuth:   " << std::setw(8) << std::setprecision(1) 
-                      << azi_deg[best_idx] << " deg" << std::endl;
-            std::cout << "  Elevation: " << std::setw(8) << std::setprecision(1) 
-                      << elev_deg[best_idx] << " deg" << std::endl;
-            std::cout << "  Alpha:     " << std::setw(8) << std::setprecision(3) 
-                      << max_alpha << std::endl;
-            std::cout << "  Band/Sector: " << best_band << "/" << best_sector << std::endl;
-            
-            // Simple ASCII compass visualization
-            std::cout << std::endl << "  Compass (top view):" << std::endl;
-            std::cout << "         N (0°)" << std::endl;
-            std::cout << "           |" << std::endl;
-            std::cout << "  W (-90°) + E (90°)" << std::endl;
-            std::cout << "           |" << std::endl;
-            std::cout << "       S (±180°)" << std::endl;
-            
-            // Show direction indicator
-            float azi = azi_deg[best_idx];
-            std::string direction;
-            if (azi >= -22.5f && azi < 22.5f) direction = "Front";
-            else if (azi >= 22.5f && azi < 67.5f) direction = "Front-Right";
-            else if (azi >= 67.5f && azi < 112.5f) direction = "Right";
-            else if (azi >= 112.5f && azi < 157.5f) direction = "Back-Right";
-            else if (azi >= 157.5f || azi < -157.5f) direction = "Back";
-            else if (azi >= -157.5f && azi < -112.5f) direction = "Back-Left";
-            else if (azi >= -112.5f && azi < -67.5f) direction = "Left";
-            else direction = "Front-Left";
-            
-            std::cout << std::endl << "  Direction: " << direction << std::endl;
-            std::cout << std::endl << "Frame: " << iteration << std::flush;
-            
-        } else {
-            //std::cout << "(No significant sound detected - make some noise!)" << std::endl;
+            if (done) break;
+            if (failed) {
+                std::cout << "array " << failed->id << " (" << failed->name << "): ";
+                if (failed->capture.exited.load()) std::cout << "capture stopped on a device error";
+                else std::cout << "no audio for " << stall_ns / 1000000000ull << " s";
+                std::cout << " after " << seen_blocks[failed->id] << " blocks, stopping" << std::endl;
+                result = -1;
+                break;
+            }
+            if (now >= next_status) {
+                next_status += 1000000000ull;
+                for (auto& a : arrays) print_array_status(*a, last_blocks[a->id]);
+            }
+            if (opts.stats_interval_s > 0 && now >= next_report) {
+                next_report += (uint64_t)opts.stats_interval_s * 1000000000ull;
+                deadline_pool_report(*pool, names.data(), stats_out);
+            }
+        }
+    }
+    
+    for (auto& a : arrays) capture_stop(a->capture);
+    if (pool) {
+        pool->stop();
+        for (auto& a : arrays) {
+            fprintf(stats_out, "=== array %d: %s ===\n", a->id, a->name.c_str());
+            print_live_stats(stats_out, a->stats, a->capture, *a->ring, a->pipeline.gate, nullptr);
+        }
+        deadline_pool_report(*pool, names.data(), stats_out);
+        if (opts.lock_memory || opts.capture_rt.cpu >= 0 || pool->config().first_cpu >= 0) {
+            int captures = 0, workers = 0;
+            for (auto& a : arrays) captures += a->capture.rt_applied.load();
+            for (int w = 0; w < pool->config().num_workers; ++w) workers += pool->worker_rt_applied(w);
+            std::cout << "Real-time: " << captures << " of " << num_arrays << " capture threads and " << workers
+                      << " of " << pool->config().num_workers << " DSP workers configured, memory "
+                      << (memory_locked ? "locked" : "not locked") << std::endl;
+        }
+    }
+    
+    for (auto& a : arrays) {
+        if (a->device.pcm) {
+            snd_pcm_drop(a->device.pcm);
+            pcm_device_close(a->device);
+        }
+        if (a->pipeline_ready) pipeline_destroy(a->pipeline);
+    }
+    return result;
+}
+
+// File mode: feed a mapped recording through the pipeline as fast as the CPU
+// allows and report throughput as a real-time factor
+static int run_file(Pipeline& pipeline, const FileSource& src, bool quiet, bool tracks, ResultsPublisher* results,
+                    Recorder* recorder, FILE* stats_out)
+{
+    const int framesize = pipeline.framesize;
+    const uint64_t num_blocks = src.num_frames / framesize;
+    
+    BufferArena arena;
+    int block_buffers = arena.add_channels(mic_channels, framesize);
+    if (!arena.allocate()) {
+        std::cout << "Cannot allocate audio buffers" << std::endl;
+        return -1;
+    }
+    float** mic_input = arena.channels(block_buffers);
+    
+    if (!quiet) {
+        std::cout << (tracks ? "time_s,track_id,azimuth_deg,elevation_deg,strength"
+                             : "time_s,azimuth_deg,elevation_deg,alpha,band,sector") << std::endl;
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t block = 0; block < num_blocks; ++block) {
+        // Convert straight out of the mapping; the file data is never copied
+        bool updated;
+        {
+            ScopedNoAlloc no_alloc;
+            StageTimer block_timer(pipeline.stats, Stage::Block);
+            {
+                StageTimer timer(pipeline.stats, Stage::Convert);
+                convert_to_float_channels(file_source_frame(src, block * framesize), src.format,
+                                          mic_input, framesize, mic_channels);
+            }
+            updated = pipeline_process(pipeline, (const float* const*)mic_input);
+            // No capture meter or clock here: the gate's level if there is
+            // one, and stream positions without times
+            if (updated && results) {
+                SampleTime end;
+                end.stream_frame = end.device_frame = (block + 1) * framesize;
+                publish_update(*results, pipeline, end, pipeline.gate ? pipeline.gate->level_db() : LevelMeter::floor_db);
+            }
+            if (recorder) recorder_push(*recorder, (const float* const*)pipeline.sh_output, mic_input);
         }
+        if (!updated || quiet) continue;
         
-        //std::cout << std::endl << "Frame: " << iteration << std::flush;
+        double t = (double)((block + 1) * framesize) / src.sample_rate;
+        if (tracks) {
+            const DoaTracker& tracker = *pipeline.tracker;
+            for (int i = 0; i < tracker.num_tracks(); ++i) {
+                const DoaTrack& track = tracker.track(i);
+                if (!track.confirmed) continue;
+                std::cout << std::fixed << std::setprecision(4) << t << "," << track.id << ","
+                          << std::setprecision(1) << track.azimuth_deg << "," << track.elevation_deg << ","
+                          << std::setprecision(3) << track.strength << "\n";
+            }
+            continue;
+        }
+        const DoaEstimate& est = pipeline.estimate;
+        if (est.strength < 0.0f) continue;
+        std::cout << std::fixed << std::setprecision(4) << t << ","
+                  << std::setprecision(1) << est.azimuth_deg << ","
+                  << est.elevation_deg << ","
+                  << std::setprecision(3) << est.strength << ","
+                  << est.band << "," << est.sector << "\n";
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout << std::flush;
+    
+    double wall_s = std::chrono::duration<double>(end - start).count();
+    double audio_s = (double)(num_blocks * framesize) / src.sample_rate;
+    std::cerr << std::fixed << std::setprecision(2)
+              << "Processed " << audio_s << " s of audio in " << wall_s << " s: "
+              << "real-time factor " << (wall_s > 0.0 ? audio_s / wall_s : 0.0) << "x" << std::endl;
+    std::cerr << "Tracks: " << pipeline.tracker->births() << " sources confirmed, "
+              << pipeline.tracker->deaths() << " ended" << std::endl;
+    stage_stats_report(*pipeline.stats, stats_out);
+    if (pipeline.gate) activity_gate_report(*pipeline.gate, stats_out);
+    return 0;
+}
+
+// Latency summary destination: --stats PATH, else stderr
+static FILE* open_stats_out(const AppOptions& opts)
+{
+    FILE* out = nullptr;
+    if (opts.stats_path && !(out = fopen(opts.stats_path, "w"))) {
+        std::cout << "Cannot open " << opts.stats_path << ", writing stats to stderr" << std::endl;
+    }
+    return out ? out : stderr;
+}
+
+static bool start_results(ResultsPublisher& results, const AppOptions& opts)
+{
+    if (!results_publisher_start(results, opts.publish_name, opts.publish_socket)) return false;
+    std::cout << "Publishing results in shared memory " << opts.publish_name;
+    if (opts.publish_socket) std::cout << " and on " << opts.publish_socket;
+    std::cout << std::endl;
+    return true;
+}
+
+static void stop_results(ResultsPublisher& results, const AppOptions& opts)
+{
+    std::cout << "Published " << results.next_sequence << " results";
+    if (opts.publish_socket) std::cout << ", " << results.stream_dropped.load() << " dropped for slow socket clients";
+    std::cout << std::endl;
+    results_publisher_stop(results);
+}
+
+int main(int argc, char** argv)
+{
+    AppOptions opts;
+    if (!parse_options(argc, argv, opts)) return -1;
+    if (opts.list_devices) {
+        pcm_device_list(stdout, SND_PCM_STREAM_CAPTURE);
+        return 0;
     }
     
+    std::cout << "=== SAF Ambisonics POC ===" << std::endl;
+    std::cout << "Microphone channels: " << mic_channels << std::endl;
+    std::cout << "SH Order: " << SH_ORDER << " (" << NUM_SH_SIGNALS << " SH signals)" << std::endl;
+    std::cout << "Sample conversion: " << simd_level_name(cpu_simd_level()) << std::endl;
+    
+    // Several arrays: pipelines, devices and the DSP pool are set up in run_multi
+    if (!opts.arrays.empty()) {
+        if (opts.file_path || opts.record || opts.monitor) {
+            std::cout << "--array does not combine with --file, --record or --monitor" << std::endl;
+            return -1;
+        }
+        FILE* stats_out = open_stats_out(opts);
+        ResultsPublisher results;
+        if (opts.publish && !start_results(results, opts)) return -1;
+        int result = run_multi(opts, opts.publish ? &results : nullptr, stats_out);
+        std::cout << std::endl << "Cleaning up..." << std::endl;
+        if (stats_out != stderr) fclose(stats_out);
+        if (opts.publish) stop_results(results, opts);
+        std::cout << "Done!" << std::endl;
+        return result;
+    }
+    
+    FileSource file;
+    int sample_rate = mic_sample_rate;
+    if (opts.file_path) {
+        if (!file_source_open(file, opts.file_path, opts.have_raw ? &opts.raw : nullptr)) return -1;
+        if (file.channels != mic_channels) {
+            std::cout << "Expected " << mic_channels << " channels, file has " << file.channels << std::endl;
+            file_source_close(file);
+            return -1;
+        }
+        sample_rate = file.sample_rate;
+        std::cout << "Replaying " << opts.file_path << ": " << file.num_frames << " frames, "
+                  << sample_rate << " Hz, " << sample_format_name(file.format) << std::endl;
+    }
+    
+    // === Initialize SAF components ===
+    Pipeline pipeline;
+    pipeline.doa_method = opts.doa_method;
+    pipeline.doa_directions = opts.doa_directions;
+    pipeline.doa_sources = opts.doa_sources;
+    pipeline.histogram_decay_s = opts.histogram_s;
+    if (opts.gate) pipeline.gate_config = &opts.gate_config;
+    // The SH recording and the monitor must not have holes where the gate was closed
+    pipeline.encode_always = (opts.record && opts.record_config.record_sh) || (opts.monitor && !opts.file_path);
+    if (opts.monitor && opts.file_path) std::cout << "--monitor only applies to live capture" << std::endl;
+    if (opts.simulate && opts.file_path) std::cout << "--sim-source only applies to live capture" << std::endl;
+    if (!pipeline_init(pipeline, sample_rate)) {
+        std::cout << "Failed to initialize SAF pipeline." << std::endl;
+        pipeline_destroy(pipeline);
+        if (opts.file_path) file_source_close(file);
+        return -1;
+    }
+    
+    // Stage latency histograms; the summary goes to stderr unless --stats is given
+    static StageStats stats;
+    pipeline.stats = &stats;
+    FILE* stats_out = open_stats_out(opts);
+    
+    // Binary results for other processes
+    ResultsPublisher results;
+    if (opts.publish && !start_results(results, opts)) {
+        pipeline_destroy(pipeline);
+        if (opts.file_path) file_source_close(file);
+        return -1;
+    }
+    
+    // Archive of the SH (and mic) signals, written by a background thread
+    Recorder recorder;
+    if (opts.record) {
+        recorder.config = opts.record_config;
+        recorder.config.lossless = opts.file_path != nullptr; // replay waits for the disk, live drops
+        if (!recorder_start(recorder, sample_rate, pipeline.framesize)) {
+            if (opts.publish) results_publisher_stop(results);
+            pipeline_destroy(pipeline);
+            if (opts.file_path) file_source_close(file);
+            return -1;
+        }
+        std::cout << "Recording to " << recorder.sh.path << (recorder.mic.ring ? " and " + recorder.mic.path : "")
+                  << std::endl;
+    }
+    Recorder* rec = opts.record ? &recorder : nullptr;
+    
+    int result = opts.file_path
+                     ? run_file(pipeline, file, opts.quiet, opts.tracks, opts.publish ? &results : nullptr, rec,
+                                stats_out)
+                     : run_live(pipeline, opts, opts.publish ? &results : nullptr, rec, stats_out);
+    
     // === Cleanup ===
     std::cout << std::endl << "Cleaning up..." << std::endl;
     
-    snd_pcm_drop(pcm_handle);
-    snd_pcm_close(pcm_handle);
-    
-    sldoa_destroy(&sld_handle);
-    array2sh_destroy(&array2sh_handle);
+    if (opts.record) {
+        recorder_stop(recorder);
+        recorder_report(recorder, stats_out);
+    }
+    if (stats_out != stderr) fclose(stats_out);
     
-    for (int i = 0; i < mic_channels; ++i) delete[] mic_input[i];
-    delete[] mic_input;
-    for (int i = 0; i < NUM_SH_SIGNALS; ++i) delete[] sh_output[i];
-    delete[] sh_output;
-    delete[] alsa_buffer;
+    if (opts.publish) stop_results(results, opts);
+    pipeline_destroy(pipeline);
+    if (opts.file_path) file_source_close(file);
     
     std::cout << "Done!" << std::endl;
-    return 0;
-}
\ No newline at end of file
+    return result;
+}
@@ -0,0 +1,448 @@
+#include "array_sim.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// SAF framework includes
+#include "saf.h"
+
+typedef std::complex<double> cdouble;
+
+// ZM-1: 19 capsules on a rigid sphere, as in SAF's Zylia preset
+const double zm1_radius_m = 0.049;
+const double speed_of_sound = 343.0;
+
+// Reverb line lengths at 48 kHz (mutually prime, 21..58 ms) and the
+// directions the lines arrive from: the corners of a cube
+static const int reverb_delays_48k[ArraySimulator::reverb_lines] = {1031, 1327, 1523, 1783, 1999, 2239, 2503, 2797};
+static const float reverb_dirs_deg[ArraySimulator::reverb_lines][2] = {
+    {45.0f, 35.26f}, {135.0f, 35.26f}, {-135.0f, 35.26f}, {-45.0f, 35.26f},
+    {45.0f, -35.26f}, {135.0f, -35.26f}, {-135.0f, -35.26f}, {-45.0f, -35.26f}};
+static const float reverb_input_signs[ArraySimulator::reverb_lines] = {1, -1, 1, -1, 1, 1, -1, -1};
+
+const char* sim_signal_name(SimSignal signal)
+{
+    switch (signal) {
+        case SimSignal::Bursts: return "bursts";
+        case SimSignal::Tone: return "tone";
+        default: return "noise";
+    }
+}
+
+bool sim_signal_from_name(const char* name, SimSignal& signal)
+{
+    const SimSignal signals[] = {SimSignal::Noise, SimSignal::Bursts, SimSignal::Tone};
+    for (SimSignal s : signals) {
+        if (std::strcmp(name, sim_signal_name(s)) != 0) continue;
+        signal = s;
+        return true;
+    }
+    return false;
+}
+
+// Pressure on a rigid sphere at angle theta from the propagation direction
+// of a unit plane wave, x = k r (series solution, e^{-i w t} convention):
+// p = sum_n (2n+1) i^(n+1) / (x^2 h_n'(x)) P_n(cos theta)
+static cdouble rigid_sphere_pressure(double x, double cos_theta)
+{
+    const int max_n = (int)std::ceil(x) + 10;
+    const cdouble i(0.0, 1.0);
+    const cdouble e = std::exp(i * x);
+    // Spherical Hankel functions of the first kind, upward recurrence
+    cdouble h_prev = -i * e / x;                  // h_0
+    cdouble h = -(x + i) * e / (x * x);           // h_1
+    double p_prev = 1.0, p = cos_theta;           // Legendre P_0, P_1
+    cdouble i_pow = i;                            // i^(n+1)
+    cdouble sum = i_pow / (x * x * -h) * p_prev;  // n = 0: h_0' = -h_1
+    for (int n = 1; n <= max_n; ++n) {
+        i_pow *= i;
+        const cdouble dh = h_prev - (n + 1.0) / x * h;
+        sum += (2.0 * n + 1.0) * i_pow / (x * x * dh) * p;
+        const cdouble h_next = (2.0 * n + 1.0) / x * h - h_prev;
+        h_prev = h;
+        h = h_next;
+        const double p_next = ((2.0 * n + 1.0) * cos_theta * p - n * p_prev) / (n + 1.0);
+        p_prev = p;
+        p = p_next;
+    }
+    return sum;
+}
+
+static void spectrum_mac_scalar(const float* h_re, const float* h_im, const float* x_re, const float* x_im,
+                                float* y_re, float* y_im, int n)
+{
+    for (int k = 0; k < n; ++k) {
+        y_re[k] += h_re[k] * x_re[k] - h_im[k] * x_im[k];
+        y_im[k] += h_re[k] * x_im[k] + h_im[k] * x_re[k];
+    }
+}
+
+static void noise_scalar(uint32_t* lanes, float* out, int n, float gain, bool add)
+{
+    const float scale = gain / 2147483648.0f;
+    for (int i = 0; i < n; i += 8) {
+        for (int l = 0; l < 8; ++l) {
+            uint32_t x = lanes[l];
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            lanes[l] = x;
+            const float v = (float)(int32_t)x * scale;
+            out[i + l] = add ? out[i + l] + v : v;
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static void spectrum_mac_sse2(const float* h_re, const float* h_im, const float* x_re, const float* x_im,
+                              float* y_re, float* y_im, int n)
+{
+    for (int k = 0; k < n; k += 4) {
+        __m128 hr = _mm_load_ps(h_re + k), hi = _mm_load_ps(h_im + k);
+        __m128 xr = _mm_load_ps(x_re + k), xi = _mm_load_ps(x_im + k);
+        __m128 yr = _mm_add_ps(_mm_load_ps(y_re + k), _mm_sub_ps(_mm_mul_ps(hr, xr), _mm_mul_ps(hi, xi)));
+        __m128 yi = _mm_add_ps(_mm_load_ps(y_im + k), _mm_add_ps(_mm_mul_ps(hr, xi), _mm_mul_ps(hi, xr)));
+        _mm_store_ps(y_re + k, yr);
+        _mm_store_ps(y_im + k, yi);
+    }
+}
+
+__attribute__((target("sse2")))
+static void noise_sse2(uint32_t* lanes, float* out, int n, float gain, bool add)
+{
+    __m128i s0 = _mm_loadu_si128((const __m128i*)lanes);
+    __m128i s1 = _mm_loadu_si128((const __m128i*)(lanes + 4));
+    const __m128 scale = _mm_set1_ps(gain / 2147483648.0f);
+    for (int i = 0; i < n; i += 8) {
+        s0 = _mm_xor_si128(s0, _mm_slli_epi32(s0, 13));
+        s1 = _mm_xor_si128(s1, _mm_slli_epi32(s1, 13));
+        s0 = _mm_xor_si128(s0, _mm_srli_epi32(s0, 17));
+        s1 = _mm_xor_si128(s1, _mm_srli_epi32(s1, 17));
+        s0 = _mm_xor_si128(s0, _mm_slli_epi32(s0, 5));
+        s1 = _mm_xor_si128(s1, _mm_slli_epi32(s1, 5));
+        __m128 v0 = _mm_mul_ps(_mm_cvtepi32_ps(s0), scale);
+        __m128 v1 = _mm_mul_ps(_mm_cvtepi32_ps(s1), scale);
+        if (add) {
+            v0 = _mm_add_ps(v0, _mm_loadu_ps(out + i));
+            v1 = _mm_add_ps(v1, _mm_loadu_ps(out + i + 4));
+        }
+        _mm_storeu_ps(out + i, v0);
+        _mm_storeu_ps(out + i + 4, v1);
+    }
+    _mm_storeu_si128((__m128i*)lanes, s0);
+    _mm_storeu_si128((__m128i*)(lanes + 4), s1);
+}
+
+__attribute__((target("avx2,fma")))
+static void spectrum_mac_avx2(const float* h_re, const float* h_im, const float* x_re, const float* x_im,
+                              float* y_re, float* y_im, int n)
+{
+    for (int k = 0; k < n; k += 8) {
+        __m256 hr = _mm256_load_ps(h_re + k), hi = _mm256_load_ps(h_im + k);
+        __m256 xr = _mm256_load_ps(x_re + k), xi = _mm256_load_ps(x_im + k);
+        __m256 yr = _mm256_fmadd_ps(hr, xr, _mm256_load_ps(y_re + k));
+        __m256 yi = _mm256_fmadd_ps(hr, xi, _mm256_load_ps(y_im + k));
+        _mm256_store_ps(y_re + k, _mm256_fnmadd_ps(hi, xi, yr));
+        _mm256_store_ps(y_im + k, _mm256_fmadd_ps(hi, xr, yi));
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void noise_avx2(uint32_t* lanes, float* out, int n, float gain, bool add)
+{
+    __m256i s = _mm256_loadu_si256((const __m256i*)lanes);
+    const __m256 scale = _mm256_set1_ps(gain / 2147483648.0f);
+    for (int i = 0; i < n; i += 8) {
+        s = _mm256_xor_si256(s, _mm256_slli_epi32(s, 13));
+        s = _mm256_xor_si256(s, _mm256_srli_epi32(s, 17));
+        s = _mm256_xor_si256(s, _mm256_slli_epi32(s, 5));
+        __m256 v = _mm256_cvtepi32_ps(s);
+        v = add ? _mm256_fmadd_ps(v, scale, _mm256_loadu_ps(out + i)) : _mm256_mul_ps(v, scale);
+        _mm256_storeu_ps(out + i, v);
+    }
+    _mm256_storeu_si256((__m256i*)lanes, s);
+}
+#endif
+
+ArraySimulator::ArraySimulator(const ArraySimConfig& config)
+    : config_(config),
+      num_sources_(std::min((int)config.sources.size(), (int)max_sources)),
+      simd_level_(cpu_simd_level()),
+      mac_(spectrum_mac_scalar),
+      noise_(noise_scalar)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (simd_level_ >= SimdLevel::AVX2 && !__builtin_cpu_supports("fma")) simd_level_ = SimdLevel::SSE2;
+    switch (simd_level_) {
+        case SimdLevel::AVX512:
+        case SimdLevel::AVX2:
+            mac_ = spectrum_mac_avx2;
+            noise_ = noise_avx2;
+            break;
+        case SimdLevel::SSE2:
+            mac_ = spectrum_mac_sse2;
+            noise_ = noise_sse2;
+            break;
+        default:
+            break;
+    }
+#endif
+    // Independent, never-zero xorshift states per stream and lane
+    uint32_t state = config.seed * 2654435761u + 0x9e3779b9u;
+    for (auto& lanes : rng_) {
+        for (uint32_t& lane : lanes) {
+            state = state * 1664525u + 1013904223u;
+            lane = state | 1u;
+        }
+    }
+}
+
+ArraySimulator::~ArraySimulator()
+{
+    if (fft_) saf_rfft_destroy(&fft_);
+}
+
+bool ArraySimulator::prepare(int sample_rate, int block_frames)
+{
+    if (block_frames < 32 || (block_frames & (block_frames - 1)) != 0) {
+        std::cout << "Simulator: the block size must be a power of 2 of at least 32 frames, not " << block_frames
+                  << std::endl;
+        return false;
+    }
+    if (num_sources_ < (int)config_.sources.size()) {
+        std::cout << "Simulator: only the first " << (int)max_sources << " sources are used" << std::endl;
+    }
+    sample_rate_ = sample_rate;
+    block_ = block_frames;
+    num_bins_ = block_ + 1;
+    padded_bins_ = (num_bins_ + 15) & ~15;
+    const bool reverb = config_.rt60_s > 0.0f;
+    num_waves_ = num_sources_ + (reverb ? (int)reverb_lines : 0);
+
+    delay_size_ = 1;
+    if (reverb) {
+        int longest = 0;
+        for (int k = 0; k < reverb_lines; ++k) {
+            delay_len_[k] = std::max(block_, (int)lrintf(reverb_delays_48k[k] * sample_rate / 48000.0f));
+            delay_gain_[k] = powf(10.0f, -3.0f * delay_len_[k] / (config_.rt60_s * sample_rate));
+            longest = std::max(longest, delay_len_[k]);
+        }
+        while (delay_size_ < longest + block_) delay_size_ *= 2;
+    }
+
+    const int waves = std::max(num_waves_, 1);
+    int filter_re_handle = arena_.add_channels(waves * num_capsules, padded_bins_);
+    int filter_im_handle = arena_.add_channels(waves * num_capsules, padded_bins_);
+    int wave_re_handle = arena_.add_channels(waves, padded_bins_);
+    int wave_im_handle = arena_.add_channels(waves, padded_bins_);
+    int history_handle = arena_.add_channels(waves, 2 * block_);
+    int spec_handle = arena_.add_channels(2, padded_bins_);
+    int fft_buffer_handle = arena_.add_bytes(sizeof(float) * 2 * num_bins_);
+    int time_handle = arena_.add_bytes(sizeof(float) * 2 * block_);
+    int dry_handle = arena_.add_bytes(sizeof(float) * block_);
+    int delay_handle = arena_.add_channels(reverb_lines, delay_size_);
+    if (!arena_.allocate()) {
+        std::cout << "Simulator: cannot allocate the buffers" << std::endl;
+        return false;
+    }
+    filter_re_ = arena_.channels(filter_re_handle);
+    filter_im_ = arena_.channels(filter_im_handle);
+    wave_re_ = arena_.channels(wave_re_handle);
+    wave_im_ = arena_.channels(wave_im_handle);
+    history_ = arena_.channels(history_handle);
+    spec_re_ = arena_.channels(spec_handle)[0];
+    spec_im_ = arena_.channels(spec_handle)[1];
+    fft_buffer_ = (float*)arena_.bytes(fft_buffer_handle);
+    time_ = (float*)arena_.bytes(time_handle);
+    dry_ = (float*)arena_.bytes(dry_handle);
+    delay_ = arena_.channels(delay_handle);
+
+    saf_rfft_create(&fft_, 2 * block_);
+    for (int s = 0; s < num_sources_; ++s) {
+        const SimSource& src = config_.sources[s];
+        design_filters(s, src.azimuth_deg, src.elevation_deg);
+        gain_[s] = powf(10.0f, src.level_db / 20.0f);
+    }
+    if (reverb) {
+        for (int k = 0; k < reverb_lines; ++k) {
+            design_filters(num_sources_ + k, reverb_dirs_deg[k][0], reverb_dirs_deg[k][1]);
+        }
+        // Output gain from the energy of the network's impulse response
+        // (arriving from all lines), so the tail sits reverb_db under the
+        // direct sound
+        float* wet[reverb_lines];
+        for (int k = 0; k < reverb_lines; ++k) wet[k] = history_[num_sources_ + k] + block_;
+        reverb_out_gain_ = 1.0f;
+        double energy = 0.0;
+        const int blocks = (int)std::ceil(2.0 * config_.rt60_s * sample_rate / block_) + 1;
+        for (int b = 0; b < blocks; ++b) {
+            std::memset(dry_, 0, sizeof(float) * block_);
+            if (b == 0) dry_[0] = 1.0f;
+            reverb_block(dry_, wet);
+            for (int k = 0; k < reverb_lines; ++k) {
+                for (int t = 0; t < block_; ++t) energy += (double)wet[k][t] * wet[k][t];
+            }
+        }
+        reverb_out_gain_ = energy > 0.0 ? (float)std::sqrt(std::pow(10.0, config_.reverb_db / 10.0) / energy) : 0.0f;
+        for (int k = 0; k < reverb_lines; ++k) {
+            std::memset(delay_[k], 0, sizeof(float) * delay_size_);
+            std::memset(history_[num_sources_ + k], 0, sizeof(float) * 2 * block_);
+        }
+        delay_pos_ = 0;
+    }
+    // Uniform noise in [-1, 1) has an RMS of 1/sqrt(3)
+    noise_gain_ = sqrtf(3.0f) * powf(10.0f, config_.noise_db / 20.0f);
+    frame_ = 0;
+    return true;
+}
+
+// Capsule responses to a plane wave from (azimuth, elevation): the sphere
+// transfer function per bin of the block FFT, delayed by a quarter block so
+// the capsules facing the wave (which hear it before the centre would) stay
+// causal, cut to one block with a short fade, and transformed once
+void ArraySimulator::design_filters(int wave, float azimuth_deg, float elevation_deg)
+{
+    const int fft_size = 2 * block_;
+    const double azi = azimuth_deg * M_PI / 180.0, elev = elevation_deg * M_PI / 180.0;
+    const double ux = std::cos(azi) * std::cos(elev), uy = std::sin(azi) * std::cos(elev), uz = std::sin(elev);
+    const double bulk_delay = block_ / 4;
+    std::vector<std::complex<float>> spectrum(num_bins_);
+    std::vector<float> taps(fft_size);
+
+    for (int m = 0; m < num_capsules; ++m) {
+        const double ca = __Zylia_coords_rad[m][0], ce = __Zylia_coords_rad[m][1];
+        const double cos_theta = ux * std::cos(ca) * std::cos(ce) + uy * std::sin(ca) * std::cos(ce) + uz * std::sin(ce);
+        for (int k = 0; k < num_bins_; ++k) {
+            cdouble h = 1.0;
+            if (k > 0) {
+                const double x = 2.0 * M_PI * k * sample_rate_ / fft_size * zm1_radius_m / speed_of_sound;
+                // The wave travels away from its arrival direction, and the
+                // FFT's e^{+i w t} sign is the conjugate of the physics one
+                h = std::conj(rigid_sphere_pressure(x, -cos_theta));
+            }
+            h *= std::polar(1.0, -2.0 * M_PI * k * bulk_delay / fft_size);
+            if (k == num_bins_ - 1) h = cdouble(h.real(), 0.0);
+            spectrum[k] = std::complex<float>((float)h.real(), (float)h.imag());
+        }
+        saf_rfft_backward(fft_, (float_complex*)spectrum.data(), taps.data());
+        const int fade = block_ / 4;
+        for (int j = 0; j < fade; ++j) taps[block_ - fade + j] *= 0.5f * (1.0f + cosf((float)M_PI * (j + 1) / fade));
+        std::fill(taps.begin() + block_, taps.end(), 0.0f);
+        saf_rfft_forward(fft_, taps.data(), (float_complex*)spectrum.data());
+
+        float* re = filter_re_[wave * num_capsules + m];
+        float* im = filter_im_[wave * num_capsules + m];
+        for (int k = 0; k < num_bins_; ++k) {
+            re[k] = spectrum[k].real();
+            im[k] = spectrum[k].imag();
+        }
+    }
+}
+
+void ArraySimulator::source_block(int s, float* x)
+{
+    const SimSource& src = config_.sources[s];
+    if (src.signal == SimSignal::Tone) {
+        // Phase from the frame counter, so long runs do not drift
+        const double cycles = src.tone_hz / sample_rate_;
+        const double start = std::fmod(cycles * (double)frame_, 1.0);
+        const float amplitude = sqrtf(2.0f) * gain_[s];
+        for (int t = 0; t < block_; ++t) x[t] = amplitude * sinf((float)(2.0 * M_PI * (start + cycles * t)));
+        return;
+    }
+    noise_(rng_[s], x, block_, sqrtf(3.0f) * gain_[s], false);
+    if (src.signal == SimSignal::Bursts) {
+        const uint64_t period = std::max<uint64_t>(1, (uint64_t)(src.period_s * sample_rate_));
+        const uint64_t on = (uint64_t)(src.burst_s * sample_rate_);
+        for (int t = 0; t < block_; ++t) {
+            if ((frame_ + t) % period >= on) x[t] = 0.0f;
+        }
+    }
+}
+
+// One block of the feedback delay network. Every line is at least a block
+// long, so the block read from each line was written in earlier blocks and
+// the Hadamard feedback can be applied block-wise.
+void ArraySimulator::reverb_block(const float* dry, float* const* wet)
+{
+    const int mask = delay_size_ - 1;
+    for (int k = 0; k < reverb_lines; ++k) {
+        const int start = (delay_pos_ - delay_len_[k]) & mask;
+        const int first = std::min(block_, delay_size_ - start);
+        const float g = delay_gain_[k];
+        for (int t = 0; t < first; ++t) wet[k][t] = g * delay_[k][start + t];
+        for (int t = first; t < block_; ++t) wet[k][t] = g * delay_[k][t - first];
+    }
+
+    const float norm = 1.0f / sqrtf((float)reverb_lines);
+    for (int t = 0; t < block_; ++t) {
+        float a[reverb_lines];
+        for (int k = 0; k < reverb_lines; ++k) a[k] = wet[k][t];
+        for (int span = 1; span < reverb_lines; span *= 2) {
+            for (int k = 0; k < reverb_lines; k += 2 * span) {
+                for (int j = k; j < k + span; ++j) {
+                    const float u = a[j], v = a[j + span];
+                    a[j] = u + v;
+                    a[j + span] = u - v;
+                }
+            }
+        }
+        const int pos = (delay_pos_ + t) & mask;
+        for (int k = 0; k < reverb_lines; ++k) delay_[k][pos] = norm * (a[k] + reverb_input_signs[k] * dry[t]);
+    }
+    delay_pos_ = (delay_pos_ + block_) & mask;
+
+    for (int k = 0; k < reverb_lines; ++k) {
+        for (int t = 0; t < block_; ++t) wet[k][t] *= reverb_out_gain_;
+    }
+}
+
+void ArraySimulator::generate(float* const* out)
+{
+    // Slide each wave's overlap-save window and fill its new half
+    for (int w = 0; w < num_waves_; ++w) std::memcpy(history_[w], history_[w] + block_, sizeof(float) * block_);
+    std::memset(dry_, 0, sizeof(float) * block_);
+    for (int s = 0; s < num_sources_; ++s) {
+        float* x = history_[s] + block_;
+        source_block(s, x);
+        for (int t = 0; t < block_; ++t) dry_[t] += x[t];
+    }
+    if (num_waves_ > num_sources_) {
+        float* wet[reverb_lines];
+        for (int k = 0; k < reverb_lines; ++k) wet[k] = history_[num_sources_ + k] + block_;
+        reverb_block(dry_, wet);
+    }
+
+    for (int w = 0; w < num_waves_; ++w) {
+        saf_rfft_forward(fft_, history_[w], (float_complex*)fft_buffer_);
+        for (int k = 0; k < num_bins_; ++k) {
+            wave_re_[w][k] = fft_buffer_[2 * k];
+            wave_im_[w][k] = fft_buffer_[2 * k + 1];
+        }
+    }
+
+    for (int m = 0; m < num_capsules; ++m) {
+        std::memset(spec_re_, 0, sizeof(float) * padded_bins_);
+        std::memset(spec_im_, 0, sizeof(float) * padded_bins_);
+        for (int w = 0; w < num_waves_; ++w) {
+            mac_(filter_re_[w * num_capsules + m], filter_im_[w * num_capsules + m], wave_re_[w], wave_im_[w],
+                 spec_re_, spec_im_, padded_bins_);
+        }
+        for (int k = 0; k < num_bins_; ++k) {
+            fft_buffer_[2 * k] = spec_re_[k];
+            fft_buffer_[2 * k + 1] = spec_im_[k];
+        }
+        // The second half is the valid part of the circular convolution
+        saf_rfft_backward(fft_, (float_complex*)fft_buffer_, time_);
+        std::memcpy(out[m], time_ + block_, sizeof(float) * block_);
+        noise_(rng_[max_sources], out[m], block_, noise_gain_, true);
+    }
+    frame_ += block_;
+}
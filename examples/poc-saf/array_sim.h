@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "buffer_arena.h"
+#include "cpu_features.h"
+
+// Hardware-free input: synthesizes the 19 capsule signals of a ZM-1 for
+// point sources in the far field, so accuracy and throughput can be tested
+// without the array.
+//
+// Each source is a plane wave scattered by a rigid sphere of the ZM-1's
+// radius, with the capsules at the directions of SAF's Zylia preset (the
+// geometry MICROPHONE_ARRAY_PRESET_ZYLIA_1D describes to array2sh). The
+// sphere responses are precomputed once per source direction as FIRs of one
+// block, from the series solution of the scattering problem, and applied as
+// an overlap-save convolution: one FFT per source and one inverse FFT per
+// capsule per block, with the per-bin complex multiply-adds in between
+// vectorized (SSE2 / AVX2).
+//
+// A reverb tail comes from an 8-line feedback delay network fed by the
+// sources, its outputs arriving as plane waves from 8 fixed directions
+// around the array (a diffuse-ish field), with the decay set by rt60.
+// Uncorrelated sensor noise is added last.
+
+enum class SimSignal
+{
+    Noise,  // white noise
+    Bursts, // noise bursts (claps, knocks): burst_s on, then silent until the next period_s
+    Tone    // sine at tone_hz
+};
+
+const char* sim_signal_name(SimSignal signal);
+bool sim_signal_from_name(const char* name, SimSignal& signal);
+
+struct SimSource
+{
+    float azimuth_deg = 0.0f;    // SAF convention: 0 = front, +90 = left
+    float elevation_deg = 0.0f;  // +90 = up
+    float level_db = -20.0f;     // RMS at the array centre (free field), dBFS
+    SimSignal signal = SimSignal::Noise;
+    float tone_hz = 1000.0f;
+    float burst_s = 0.1f;
+    float period_s = 1.0f;
+};
+
+struct ArraySimConfig
+{
+    std::vector<SimSource> sources;
+    float noise_db = -80.0f;     // sensor noise per capsule, RMS dBFS
+    float rt60_s = 0.0f;         // reverb decay time; 0 = anechoic
+    float reverb_db = -6.0f;     // reverb energy relative to the direct sound
+    uint32_t seed = 1;
+};
+
+class ArraySimulator
+{
+public:
+    static const int num_capsules = 19;
+    static const int max_sources = 8;
+    static const int reverb_lines = 8;
+
+    explicit ArraySimulator(const ArraySimConfig& config);
+    ~ArraySimulator();
+
+    ArraySimulator(const ArraySimulator&) = delete;
+    ArraySimulator& operator=(const ArraySimulator&) = delete;
+
+    // Designs the sphere filters and allocates everything. block_frames is
+    // the size of every generate() call (a power of 2).
+    bool prepare(int sample_rate, int block_frames);
+
+    // The next block_frames of all capsules: out[capsule] (planar floats)
+    void generate(float* const* out);
+
+    int block_frames() const { return block_; }
+    int num_sources() const { return num_sources_; }
+    SimdLevel simd_level() const { return simd_level_; }
+
+    // Complex multiply-add over split spectra: y += h * x for n bins (a
+    // multiple of 16)
+    typedef void (*SpectrumMacKernel)(const float* h_re, const float* h_im, const float* x_re, const float* x_im,
+                                      float* y_re, float* y_im, int n);
+    // Uniform noise from 8 xorshift32 lanes: out = gain * u (add: out += ...)
+    // for n samples (a multiple of 8)
+    typedef void (*NoiseKernel)(uint32_t* lanes, float* out, int n, float gain, bool add);
+
+private:
+    void design_filters(int wave, float azimuth_deg, float elevation_deg);
+    void source_block(int s, float* x);
+    void reverb_block(const float* dry, float* const* wet);
+
+    ArraySimConfig config_;
+    int num_sources_ = 0;
+    int num_waves_ = 0;          // sources + reverb lines, each a plane wave with its own filters
+    int sample_rate_ = 0;
+    int block_ = 0;
+    int num_bins_ = 0;           // block + 1
+    int padded_bins_ = 0;        // num_bins rounded up to 16
+    SimdLevel simd_level_;
+    SpectrumMacKernel mac_;
+    NoiseKernel noise_;
+
+    void* fft_ = nullptr;        // saf_rfft of 2 * block
+    BufferArena arena_;
+    float** filter_re_ = nullptr;    // [wave * num_capsules + capsule], padded_bins
+    float** filter_im_ = nullptr;
+    float** wave_re_ = nullptr;      // [wave], this block's spectra
+    float** wave_im_ = nullptr;
+    float** history_ = nullptr;      // [wave]: previous block + this block (2 * block)
+    float* spec_re_ = nullptr;       // capsule spectrum scratch
+    float* spec_im_ = nullptr;
+    float* fft_buffer_ = nullptr;    // interleaved complex scratch, num_bins
+    float* time_ = nullptr;          // 2 * block
+    float* dry_ = nullptr;           // mono sum of the sources, feeds the reverb
+
+    // Reverb: delay lines, read block-wise (every line is longer than a block)
+    float** delay_ = nullptr;
+    int delay_len_[reverb_lines] = {};
+    int delay_pos_ = 0;
+    int delay_size_ = 0;
+    float delay_gain_[reverb_lines] = {};
+    float reverb_out_gain_ = 0.0f;
+
+    // Per source
+    float gain_[max_sources] = {};
+    uint64_t frame_ = 0;
+    uint32_t rng_[max_sources + 1][8] = {}; // + sensor noise
+    float noise_gain_ = 0.0f;
+};
@@ -0,0 +1,73 @@
+#include "buffer_arena.h"
+#include <cstdlib>
+#include <cstring>
+
+static size_t round_up(size_t n, size_t multiple)
+{
+    return (n + multiple - 1) / multiple * multiple;
+}
+
+BufferArena::~BufferArena()
+{
+    std::free(base_);
+}
+
+size_t BufferArena::padded_stride(int frames)
+{
+    return round_up((size_t)frames * sizeof(float), alignment) / sizeof(float);
+}
+
+size_t BufferArena::reserve(size_t num_bytes)
+{
+    size_t offset = size_;
+    size_ += round_up(num_bytes, alignment);
+    return offset;
+}
+
+int BufferArena::add_channels(int num_channels, int frames)
+{
+    Block b;
+    b.num_channels = num_channels;
+    b.stride = padded_stride(frames);
+    b.views_offset = reserve((size_t)num_channels * sizeof(float*));
+    b.offset = reserve((size_t)num_channels * b.stride * sizeof(float));
+    blocks_.push_back(b);
+    return (int)blocks_.size() - 1;
+}
+
+int BufferArena::add_bytes(size_t num_bytes)
+{
+    Block b;
+    b.offset = reserve(num_bytes);
+    blocks_.push_back(b);
+    return (int)blocks_.size() - 1;
+}
+
+bool BufferArena::allocate()
+{
+    if (base_ || size_ == 0) return false;
+
+    base_ = (uint8_t*)std::aligned_alloc(alignment, size_);
+    if (!base_) return false;
+    std::memset(base_, 0, size_); // also faults in every page
+
+    for (const Block& b : blocks_) {
+        if (!b.num_channels) continue;
+        float** views = (float**)(base_ + b.views_offset);
+        float* data = (float*)(base_ + b.offset);
+        for (int ch = 0; ch < b.num_channels; ++ch) {
+            views[ch] = data + (size_t)ch * b.stride;
+        }
+    }
+    return true;
+}
+
+float** BufferArena::channels(int handle) const
+{
+    return (float**)(base_ + blocks_[handle].views_offset);
+}
+
+void* BufferArena::bytes(int handle) const
+{
+    return base_ + blocks_[handle].offset;
+}
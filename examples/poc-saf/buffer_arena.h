@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One 64-byte-aligned allocation for all per-frame audio buffers.
+//
+// Usage is two-phase: reserve every buffer first (add_channels/add_bytes),
+// then allocate() once. Each channel starts on its own cache line and is
+// padded to a whole number of lines, so neighbouring channels never share a
+// line and vector loads/stores on them are aligned. The `float**` views SAF
+// expects live inside the same allocation. Nothing is allocated after
+// allocate(), and everything is freed with the arena, including on early
+// error returns.
+class BufferArena
+{
+public:
+    static const size_t alignment = 64;
+
+    BufferArena() = default;
+    ~BufferArena();
+
+    BufferArena(const BufferArena&) = delete;
+    BufferArena& operator=(const BufferArena&) = delete;
+
+    // Floats per channel after padding `frames` up to whole cache lines
+    static size_t padded_stride(int frames);
+
+    // Layout phase. Returns a handle for channels()/bytes().
+    int add_channels(int num_channels, int frames);
+    int add_bytes(size_t num_bytes);
+
+    // Performs the single allocation, zeroes it and touches every page so
+    // the audio thread never takes a first-touch page fault.
+    bool allocate();
+
+    // Access phase (after allocate())
+    float** channels(int handle) const;
+    void* bytes(int handle) const;
+    size_t stride(int handle) const { return blocks_[handle].stride; }
+
+    size_t size() const { return size_; }
+
+private:
+    struct Block
+    {
+        size_t offset = 0;       // data
+        size_t views_offset = 0; // float* table, channel buffers only
+        int num_channels = 0;
+        size_t stride = 0;       // floats per channel
+    };
+
+    size_t reserve(size_t num_bytes);
+
+    std::vector<Block> blocks_;
+    size_t size_ = 0;
+    uint8_t* base_ = nullptr;
+};
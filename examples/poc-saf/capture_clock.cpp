@@ -0,0 +1,115 @@
+#include "capture_clock.h"
+#include <cmath>
+
+// Anchors jitter by the interrupt / USB packet latency; errors below this
+// are averaged out, larger ones mean the clock was lost and re-anchor
+const int64_t max_jitter_ns = 2000000;
+const int anchor_smoothing = 64;
+// The rate is trusted once measured over this long, and never beyond +-0.1 %
+const double min_rate_baseline_s = 1.0;
+const double max_rate_error = 0.001;
+
+void CaptureClock::reset(int sample_rate)
+{
+    sample_rate_ = sample_rate;
+    nominal_ns_per_frame_ = 1e9 / sample_rate;
+    model_ = CaptureClockModel();
+    measured_rate_.store(0.0, std::memory_order_relaxed);
+}
+
+void CaptureClock::observe(uint64_t device_frame, int64_t t_ns, int64_t realtime_offset_ns)
+{
+    CaptureClockModel& m = model_;
+    if (!m.valid) {
+        m.valid = true;
+        m.ns_per_frame = nominal_ns_per_frame_;
+        m.anchor_frame = base_frame_ = device_frame;
+        m.anchor_ns = base_ns_ = t_ns;
+    } else {
+        int64_t predicted = capture_clock_ns(m, device_frame);
+        int64_t error = t_ns - predicted;
+        m.anchor_frame = device_frame;
+        if (error > max_jitter_ns || error < -max_jitter_ns) {
+            m.anchor_ns = t_ns;
+            base_frame_ = device_frame;
+            base_ns_ = t_ns;
+        } else {
+            m.anchor_ns = predicted + error / anchor_smoothing;
+        }
+
+        // Rate over the whole run so far, between smoothed anchors: the
+        // longer the baseline, the less the remaining jitter matters
+        uint64_t span = device_frame - base_frame_;
+        if (span >= (uint64_t)(min_rate_baseline_s * sample_rate_)) {
+            double measured = (double)(m.anchor_ns - base_ns_) / (double)span;
+            if (std::fabs(measured / nominal_ns_per_frame_ - 1.0) <= max_rate_error) {
+                m.ns_per_frame = measured;
+                measured_rate_.store(1e9 / measured, std::memory_order_relaxed);
+            }
+        }
+    }
+    m.realtime_offset_ns = realtime_offset_ns;
+
+    models.write_buffer() = m;
+    models.publish();
+}
+
+uint64_t CaptureClock::resync(uint64_t next_device_frame, uint64_t frames_since_start, int64_t t_ns,
+                              int64_t realtime_offset_ns)
+{
+    uint64_t lost = 0;
+    if (model_.valid) {
+        // When the first frame of the new run was captured, against when the
+        // old run would have captured it
+        double first_ns = (double)t_ns - (double)frames_since_start * model_.ns_per_frame;
+        double gap = (first_ns - (double)capture_clock_ns(model_, next_device_frame)) / model_.ns_per_frame;
+        if (gap > 0.0) lost = (uint64_t)std::llround(gap);
+    }
+    // Keep the measured rate, the anchor starts over
+    double ns_per_frame = model_.valid ? model_.ns_per_frame : nominal_ns_per_frame_;
+    model_.valid = true;
+    model_.ns_per_frame = ns_per_frame;
+    model_.anchor_frame = base_frame_ = next_device_frame + lost + frames_since_start;
+    model_.anchor_ns = base_ns_ = t_ns;
+    observe(model_.anchor_frame, t_ns, realtime_offset_ns);
+    return lost;
+}
+
+SampleTime StreamTimeline::at(uint64_t stream_frame)
+{
+    // Gaps at or before this frame shift the device frame numbering
+    while (next_gap_ < gaps_.count()) {
+        Discontinuity d;
+        if (gaps_.get(next_gap_, d)) {
+            if (d.stream_frame > stream_frame) break;
+            offset_ += d.lost_frames;
+        }
+        ++next_gap_; // overwritten before we saw it: its size is lost with it
+    }
+
+    SampleTime t;
+    t.stream_frame = stream_frame;
+    t.device_frame = stream_frame + offset_;
+    if (models_) {
+        models_->update();
+        const CaptureClockModel& m = models_->read_buffer();
+        if (m.valid) {
+            t.monotonic_ns = capture_clock_ns(m, t.device_frame);
+            t.realtime_ns = t.monotonic_ns + m.realtime_offset_ns;
+        }
+    }
+    return t;
+}
+
+SampleTime StreamTimeline::after(const SampleTime& start, int frames) const
+{
+    SampleTime t = start;
+    t.stream_frame += (uint64_t)frames;
+    t.device_frame += (uint64_t)frames;
+    if (models_ && start.monotonic_ns) {
+        const CaptureClockModel& m = models_->read_buffer();
+        t.monotonic_ns = capture_clock_ns(m, t.device_frame);
+        t.realtime_ns = t.monotonic_ns + m.realtime_offset_ns;
+    }
+    return t;
+}
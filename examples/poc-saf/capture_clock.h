@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "discontinuity_log.h"
+#include "triple_buffer.h"
+
+// Capture time of every sample, for aligning DoA estimates with other
+// sensors (cameras).
+//
+// Device frames count every frame the hardware captured, including the ones
+// lost in overruns or dropped before the ring, so device time runs linearly
+// through gaps. The capture thread fits a model device frame -> capture time
+// to the (hardware position, htstamp) pairs of snd_pcm_status and publishes
+// it; the DSP thread turns stream frames (what it actually got) into device
+// frames with the ring's discontinuity log, then into times.
+
+// device frame -> CLOCK_MONOTONIC capture time
+struct CaptureClockModel
+{
+    bool valid = false;
+    uint64_t anchor_frame = 0;       // device frame
+    int64_t anchor_ns = 0;           // when anchor_frame was captured
+    double ns_per_frame = 0.0;       // measured; 1e9 / sample rate nominally
+    int64_t realtime_offset_ns = 0;  // CLOCK_REALTIME - CLOCK_MONOTONIC at the last anchor
+};
+
+inline int64_t capture_clock_ns(const CaptureClockModel& m, uint64_t device_frame)
+{
+    return m.anchor_ns + (int64_t)((double)(int64_t)(device_frame - m.anchor_frame) * m.ns_per_frame);
+}
+
+// Where and when one frame of the stream was captured
+struct SampleTime
+{
+    uint64_t stream_frame = 0;  // frames the DSP received before this one
+    uint64_t device_frame = 0;  // frames the device captured before this one, gaps included
+    int64_t monotonic_ns = 0;   // CLOCK_MONOTONIC capture time; 0 = unknown (no timestamps, file replay)
+    int64_t realtime_ns = 0;    // CLOCK_REALTIME capture time; 0 = unknown
+};
+
+// Capture thread: fits and publishes the model
+class CaptureClock
+{
+public:
+    void reset(int sample_rate);
+
+    // The hardware had captured `device_frame` frames at monotonic time t_ns
+    void observe(uint64_t device_frame, int64_t t_ns, int64_t realtime_offset_ns);
+
+    // After the stream restarted (overrun recovery): the hardware had
+    // captured `frames_since_start` frames of the new run at t_ns, and the
+    // old run ended at device frame `next_device_frame`. Returns how many
+    // frames went by in between, and observes the new run.
+    uint64_t resync(uint64_t next_device_frame, uint64_t frames_since_start, int64_t t_ns,
+                    int64_t realtime_offset_ns);
+
+    bool valid() const { return model_.valid; }
+    // Device sample rate as measured against CLOCK_MONOTONIC; 0 until known. Any thread.
+    double measured_rate() const { return measured_rate_.load(std::memory_order_relaxed); }
+
+    TripleBuffer<CaptureClockModel> models; // read by the DSP thread (StreamTimeline)
+
+private:
+    CaptureClockModel model_;
+    double nominal_ns_per_frame_ = 0.0;
+    int sample_rate_ = 0;
+    uint64_t base_frame_ = 0;  // start of the rate measurement (first anchor of this run)
+    int64_t base_ns_ = 0;
+    std::atomic<double> measured_rate_{0.0};
+};
+
+// DSP thread: stream frame -> SampleTime. Frames must be asked for in
+// non-decreasing order (the gaps are consumed as they are passed).
+class StreamTimeline
+{
+public:
+    StreamTimeline(const DiscontinuityLog& gaps, TripleBuffer<CaptureClockModel>* models)
+        : gaps_(gaps), models_(models) {}
+
+    SampleTime at(uint64_t stream_frame);
+
+    // The frame right after a block that starts at `start`, without the gaps
+    // that follow the block (they belong to the next one)
+    SampleTime after(const SampleTime& start, int frames) const;
+
+    uint64_t frames_lost() const { return offset_; } // device frames missing from the stream so far
+
+private:
+    const DiscontinuityLog& gaps_;
+    TripleBuffer<CaptureClockModel>* models_;   // nullptr = no timestamps
+    uint64_t next_gap_ = 0;
+    uint64_t offset_ = 0;                       // device frame - stream frame
+};
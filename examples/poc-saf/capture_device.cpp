@@ -0,0 +1,30 @@
+#include "capture_device.h"
+#include <iostream>
+
+// Formats with a conversion kernel, least memory traffic first
+static const snd_pcm_format_t kernel_formats[] = {SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S32_LE,
+                                                  SND_PCM_FORMAT_S24_LE};
+
+bool capture_device_open(CaptureDevice& dev, const CaptureDeviceConfig& config)
+{
+    if (!pcm_device_open(dev, SND_PCM_STREAM_CAPTURE, config, kernel_formats, 3)) return false;
+    sample_format_from_alsa(dev.alsa_format, dev.format);
+
+    // Poll wakes the capture thread once per period
+    snd_pcm_sw_params_t* sw_params = nullptr;
+    snd_pcm_sw_params_malloc(&sw_params);
+    snd_pcm_sw_params_current(dev.pcm, sw_params);
+    snd_pcm_sw_params_set_avail_min(dev.pcm, sw_params, dev.period_frames);
+    // snd_pcm_status then reports when the driver last moved the hardware
+    // position, on the same clock as the DoA results
+    dev.htstamps = snd_pcm_sw_params_set_tstamp_mode(dev.pcm, sw_params, SND_PCM_TSTAMP_ENABLE) == 0 &&
+                   snd_pcm_sw_params_set_tstamp_type(dev.pcm, sw_params, SND_PCM_TSTAMP_TYPE_MONOTONIC) == 0;
+    int err = snd_pcm_sw_params(dev.pcm, sw_params);
+    snd_pcm_sw_params_free(sw_params);
+    if (err) {
+        std::cout << "Error setting SW params: " << snd_strerror(err) << std::endl;
+        pcm_device_close(dev);
+        return false;
+    }
+    return true;
+}
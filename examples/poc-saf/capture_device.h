@@ -0,0 +1,37 @@
+#pragma once
+
+#include "pcm_device.h"
+#include "sample_convert.h"
+
+// Maps the ALSA formats we have conversion kernels for
+inline bool sample_format_from_alsa(snd_pcm_format_t alsa_format, SampleFormat& format)
+{
+    switch (alsa_format) {
+        case SND_PCM_FORMAT_S24_LE: format = SampleFormat::S24_LE; return true;
+        case SND_PCM_FORMAT_S24_3LE: format = SampleFormat::S24_3LE; return true;
+        case SND_PCM_FORMAT_S32_LE: format = SampleFormat::S32_LE; return true;
+        default: return false;
+    }
+}
+
+// The capture PCM for every tool in this repo: the ZM-1 by default, in the
+// first format with a conversion kernel that the hardware supports natively,
+// least memory traffic first (S24_3LE, S32_LE, S24_LE). See pcm_device.h.
+struct CaptureDeviceConfig : PcmDeviceConfig
+{
+    CaptureDeviceConfig()
+    {
+        card_name = "ZM-1";
+        channels = 19;
+    }
+};
+
+struct CaptureDevice : PcmDevice
+{
+    SampleFormat format = SampleFormat::S24_3LE;  // kernel for convert_to_float_channels
+    bool htstamps = false;                  // status timestamps are SND_PCM_TSTAMP_ENABLE + MONOTONIC
+};
+
+// Opens and configures the PCM (hw and sw params, not yet started). Prints
+// why on failure.
+bool capture_device_open(CaptureDevice& dev, const CaptureDeviceConfig& config);
@@ -0,0 +1,137 @@
+#include "console_ui.h"
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+#include "stage_stats.h"
+
+// printf-style append to the frame buffer
+static void append(std::string& out, const char* fmt, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n > 0) out.append(line, n < (int)sizeof(line) ? n : (int)sizeof(line) - 1);
+}
+
+static const char* direction_name(float azi)
+{
+    if (azi >= -22.5f && azi < 22.5f) return "Front";
+    if (azi >= 22.5f && azi < 67.5f) return "Front-Right";
+    if (azi >= 67.5f && azi < 112.5f) return "Right";
+    if (azi >= 112.5f && azi < 157.5f) return "Back-Right";
+    if (azi >= 157.5f || azi < -157.5f) return "Back";
+    if (azi >= -157.5f && azi < -112.5f) return "Back-Left";
+    if (azi >= -112.5f && azi < -67.5f) return "Left";
+    return "Front-Left";
+}
+
+static void render(const DoaSnapshot& s, std::string& out)
+{
+    out.clear();
+    out += "\033[2J\033[H"; // Clear screen
+    out += "=== SAF Ambisonics Sound Source Localization ===\n";
+    append(out, "Input Level: %.1f dB\n\n", s.input_db);
+    append(out, "SH Output Level: %.1f dB\n", s.sh_db);
+    out += "Capsules (dB):";
+    for (int ch = 0; ch < mic_channels; ++ch) append(out, " %5.0f", s.capsule_db[ch]);
+    out += "\n";
+    if (s.gated) {
+        append(out, "Gate: %s, level %.1f dB", s.gate_open ? "open" : "closed", s.gate_level_db);
+        if (s.gate_vad) append(out, ", noise floor %.1f dB", s.gate_floor_db);
+        append(out, ", DoA duty cycle %.1f%%\n", 100.0f * s.duty_cycle);
+    }
+    append(out, "Ring: %d/%d frames, dropped blocks: %llu, xruns: %llu, discontinuities: %llu\n\n",
+           s.ring_fill, s.ring_capacity, (unsigned long long)s.dropped_blocks,
+           (unsigned long long)s.xruns, (unsigned long long)s.discontinuities);
+
+    out += "Detected Sound Direction:\n";
+    if (s.method == DoaMethod::Sldoa) {
+        append(out, "  Bands: %d to %d, max_num_sectors: %d\n", s.start_band, s.end_band, s.max_num_sectors);
+        append(out, "  Sectors in band %d: %d\n", s.start_band, s.sectors_in_start_band);
+    } else {
+        append(out, "  Method: %s map, %d directions\n", doa_method_name(s.method), s.grid_directions);
+    }
+    append(out, "  Azimuth:   %8.1f deg\n", s.azimuth_deg);
+    append(out, "  Elevation: %8.1f deg\n", s.elevation_deg);
+    if (s.histogram) {
+        append(out, "  Share:     %8.3f (histogram peak)\n", s.alpha);
+    } else if (s.method == DoaMethod::Sldoa) {
+        append(out, "  Alpha:     %8.3f\n", s.alpha);
+        append(out, "  Band/Sector: %d/%d\n", s.band, s.sector);
+    } else {
+        append(out, "  Peak:      %8.3f\n", s.alpha);
+    }
+
+    out += "\nTracks:\n";
+    if (s.num_tracks == 0) out += "  (none)\n";
+    for (int i = 0; i < s.num_tracks; ++i) {
+        const DoaTrack& t = s.tracks[i];
+        append(out, "  #%-4u %8.1f az %7.1f el  strength %.2f  %s\n", t.id, t.azimuth_deg, t.elevation_deg,
+               t.strength, direction_name(t.azimuth_deg));
+    }
+
+    // Simple ASCII compass visualization
+    out += "\n  Compass (top view):\n";
+    out += "         N (0°)\n";
+    out += "           |\n";
+    out += "  W (-90°) + E (90°)\n";
+    out += "           |\n";
+    out += "       S (±180°)\n";
+
+    append(out, "\n  Direction: %s\n", direction_name(s.azimuth_deg));
+    append(out, "\nFrame: %llu", (unsigned long long)s.frame);
+}
+
+// One write() per frame; retried only for partial writes and EINTR
+static void write_all(const std::string& out)
+{
+    size_t done = 0;
+    while (done < out.size()) {
+        ssize_t n = write(STDOUT_FILENO, out.data() + done, out.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        done += (size_t)n;
+    }
+}
+
+static void ui_loop(ConsoleUi* ui)
+{
+    const uint64_t period_ns = 1000000000ull / (uint64_t)(ui->refresh_hz > 0 ? ui->refresh_hz : 15);
+    std::string frame;
+    frame.reserve(4096);
+
+    uint64_t next = monotonic_ns();
+    while (ui->running.load(std::memory_order_relaxed)) {
+        next += period_ns;
+        uint64_t now = monotonic_ns();
+        if (next > now) usleep((useconds_t)((next - now) / 1000));
+        else next = now; // fell behind (slow terminal): don't try to catch up
+
+        // Nothing new, or no sound: keep the last screen, like the old display did
+        if (!ui->snapshots.update()) continue;
+        const DoaSnapshot& s = ui->snapshots.read_buffer();
+        if (!s.have_doa) continue;
+
+        StageTimer timer(ui->stats, Stage::Render);
+        render(s, frame);
+        write_all(frame);
+    }
+}
+
+bool console_ui_start(ConsoleUi& ui)
+{
+    fflush(stdout); // anything buffered so far goes out before the first frame
+    ui.running.store(true);
+    ui.thread = std::thread(ui_loop, &ui);
+    return true;
+}
+
+void console_ui_stop(ConsoleUi& ui)
+{
+    ui.running.store(false);
+    if (ui.thread.joinable()) ui.thread.join();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include "doa_tracker.h"
+#include "pipeline.h"
+#include "triple_buffer.h"
+
+struct StageStats;
+
+// Everything the console display shows, captured by the DSP thread. Plain
+// values only, so publishing is a small copy and never allocates.
+struct DoaSnapshot
+{
+    uint64_t frame = 0;         // DSP iteration
+    bool have_doa = false;      // display data present and input above the gate
+
+    float input_db = 0.0f;
+    float sh_db = 0.0f;
+    float capsule_db[mic_channels] = {};
+
+    int ring_fill = 0;
+    int ring_capacity = 0;
+    uint64_t dropped_blocks = 0;
+    uint64_t xruns = 0;
+    uint64_t discontinuities = 0;
+
+    bool gated = false;         // activity gate in use
+    bool gate_open = false;
+    float gate_level_db = 0.0f;
+    float gate_floor_db = 0.0f; // vad only
+    bool gate_vad = false;
+    float duty_cycle = 0.0f;    // fraction of blocks the chain ran
+
+    DoaMethod method = DoaMethod::Sldoa;
+    int grid_directions = 0;    // pwd / music
+    bool histogram = false;     // direction = histogram peak, alpha = its share
+
+    int start_band = 0;         // sldoa only, like max_num_sectors .. sector
+    int end_band = 0;
+    int max_num_sectors = 0;
+    int sectors_in_start_band = 0;
+    float azimuth_deg = 0.0f;
+    float elevation_deg = 0.0f;
+    float alpha = 0.0f;         // sldoa alpha or grid map peak
+    int band = 0;
+    int sector = 0;
+
+    int num_tracks = 0;         // confirmed tracks only
+    DoaTrack tracks[DoaTracker::max_tracks];
+};
+
+// UI thread: renders the newest snapshot at a fixed refresh rate into one
+// buffer and writes it to stdout with a single write() per frame. The DSP
+// thread only fills snapshots.write_buffer() and calls publish(), which is
+// wait-free, so a slow terminal can never stall the audio path.
+struct ConsoleUi
+{
+    int refresh_hz = 15;
+    StageStats* stats = nullptr;   // optional: records Render
+
+    TripleBuffer<DoaSnapshot> snapshots;
+    std::atomic<bool> running{false};
+    std::thread thread;
+};
+
+bool console_ui_start(ConsoleUi& ui);
+void console_ui_stop(ConsoleUi& ui);
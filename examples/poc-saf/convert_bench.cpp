@@ -0,0 +1,150 @@
+// Microbenchmark: 24-bit interleaved -> channel-major float conversion.
+// Compares the original scalar frame-major loop from array2sh.cpp against
+// the dispatched kernels in sample_convert.cpp, and the metered kernels
+// against converting first and measuring levels in a second pass.
+// No audio hardware needed.
+//
+//   ./convert_bench [frames_per_block] [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "sample_convert.h"
+
+const int mic_channels = 19;
+
+// The original conversion loop, kept as the baseline
+static void convert_interleaved_to_float_channels(int32_t* interleaved, float** channels,
+                                                  int num_frames, int num_channels)
+{
+    const float scale = 1.0f / 8388608.0f; // 2^23 for 24-bit normalization
+
+    for (int f = 0; f < num_frames; ++f) {
+        for (int ch = 0; ch < num_channels; ++ch) {
+            int32_t sample = interleaved[f * num_channels + ch];
+            // Sign extension for 24-bit in 32-bit container
+            sample = (sample << 8) >> 8;
+            channels[ch][f] = (float)sample * scale;
+        }
+    }
+}
+
+static void baseline_kernel(const void* src, float* const* dst, int num_frames, int num_channels,
+                            LevelAccum*)
+{
+    convert_interleaved_to_float_channels((int32_t*)src, (float**)dst, num_frames, num_channels);
+}
+
+// Returns nanoseconds per block
+static double time_kernel(ConvertKernel kernel, const void* src, float* const* dst,
+                          int frames, int iterations, LevelAccum* levels = nullptr)
+{
+    for (int i = 0; i < iterations / 10 + 1; ++i) kernel(src, dst, frames, mic_channels, levels); // warm-up
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) kernel(src, dst, frames, mic_channels, levels);
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+int main(int argc, char** argv)
+{
+    const int frames = argc > 1 ? std::atoi(argv[1]) : 128;
+    const int iterations = argc > 2 ? std::atoi(argv[2]) : 200000;
+
+    // Random 24-bit test signal in all container formats
+    std::vector<int32_t> s24_le((size_t)frames * mic_channels);
+    std::vector<uint8_t> s24_3le((size_t)frames * mic_channels * 3);
+    std::vector<int32_t> s32_le((size_t)frames * mic_channels);
+    srand(1);
+    for (size_t i = 0; i < s24_le.size(); ++i) {
+        int32_t v = (rand() & 0xFFFFFF) - 0x800000;
+        s24_le[i] = v & 0xFFFFFF; // ALSA leaves the top byte undefined; keep it clear like the hardware
+        std::memcpy(&s24_3le[i * 3], &v, 3);
+        s32_le[i] = (int32_t)((uint32_t)v << 8) | (rand() & 0xFF); // low byte below the converters' resolution
+    }
+
+    std::vector<float> ref_storage((size_t)frames * mic_channels);
+    std::vector<float> out_storage((size_t)frames * mic_channels);
+    std::vector<float*> ref(mic_channels), out(mic_channels);
+    for (int ch = 0; ch < mic_channels; ++ch) {
+        ref[ch] = &ref_storage[(size_t)ch * frames];
+        out[ch] = &out_storage[(size_t)ch * frames];
+    }
+    baseline_kernel(s24_le.data(), ref.data(), frames, mic_channels, nullptr);
+
+    // Reference levels in double precision
+    std::vector<double> ref_peak(mic_channels, 0.0), ref_sum_sq(mic_channels, 0.0);
+    for (int ch = 0; ch < mic_channels; ++ch) {
+        for (int f = 0; f < frames; ++f) {
+            ref_peak[ch] = std::max(ref_peak[ch], (double)std::fabs(ref[ch][f]));
+            ref_sum_sq[ch] += (double)ref[ch][f] * ref[ch][f];
+        }
+    }
+
+    std::cout << "Converting " << mic_channels << " channels x " << frames << " frames, "
+              << iterations << " iterations (cpu: " << simd_level_name(cpu_simd_level()) << ")" << std::endl;
+
+    double baseline_ns = time_kernel(baseline_kernel, s24_le.data(), ref.data(), frames, iterations);
+    std::cout << std::left << std::setw(24) << "baseline S24_LE" << std::right << std::fixed
+              << std::setprecision(1) << std::setw(10) << baseline_ns << " ns/block" << std::endl;
+
+    const SampleFormat formats[] = {SampleFormat::S24_LE, SampleFormat::S24_3LE, SampleFormat::S32_LE};
+    const SimdLevel levels_to_test[] = {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512};
+    int failures = 0;
+
+    LevelAccum levels[mic_channels];
+    for (SampleFormat format : formats) {
+        const void* src = format == SampleFormat::S24_3LE ? (const void*)s24_3le.data()
+                          : format == SampleFormat::S32_LE ? (const void*)s32_le.data()
+                          : (const void*)s24_le.data();
+        for (SimdLevel level : levels_to_test) {
+            ConvertKernel kernel = select_convert_kernel(format, level);
+            if (!kernel) continue;
+
+            std::fill(out_storage.begin(), out_storage.end(), NAN);
+            kernel(src, out.data(), frames, mic_channels, nullptr);
+            bool match = std::memcmp(out_storage.data(), ref_storage.data(), out_storage.size() * sizeof(float)) == 0;
+            if (!match) failures++;
+
+            double ns = time_kernel(kernel, src, out.data(), frames, iterations);
+            std::string name = std::string(sample_format_name(format)) + " " + simd_level_name(level);
+            std::cout << std::left << std::setw(24) << name << std::right << std::setw(10) << ns
+                      << " ns/block  x" << std::setprecision(2) << baseline_ns / ns << std::setprecision(1)
+                      << (match ? "" : "  MISMATCH") << std::endl;
+
+            // Fused metering vs. a separate measuring pass over the converted block
+            ConvertKernel metered = select_convert_kernel(format, level, true);
+            std::fill(out_storage.begin(), out_storage.end(), NAN);
+            std::fill(levels, levels + mic_channels, LevelAccum());
+            metered(src, out.data(), frames, mic_channels, levels);
+            match = std::memcmp(out_storage.data(), ref_storage.data(), out_storage.size() * sizeof(float)) == 0;
+            for (int ch = 0; ch < mic_channels; ++ch) {
+                if (levels[ch].peak != (float)ref_peak[ch] ||
+                    std::fabs(levels[ch].sum_sq - ref_sum_sq[ch]) > 1e-4 * ref_sum_sq[ch]) match = false;
+            }
+            if (!match) failures++;
+
+            double fused_ns = time_kernel(metered, src, out.data(), frames, iterations, levels);
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; ++i) {
+                kernel(src, out.data(), frames, mic_channels, nullptr);
+                measure_levels(out.data(), mic_channels, frames, levels);
+            }
+            auto end = std::chrono::steady_clock::now();
+            double two_pass_ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+            std::cout << std::left << std::setw(24) << (name + " +meter") << std::right << std::setw(10) << fused_ns
+                      << " ns/block  (two passes: " << two_pass_ns << ")"
+                      << (match ? "" : "  MISMATCH") << std::endl;
+        }
+    }
+
+    return failures ? 1 : 0;
+}
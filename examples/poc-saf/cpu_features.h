@@ -0,0 +1,33 @@
+#pragma once
+
+// Runtime CPU feature detection for the hand-vectorized kernels.
+// Kernels are compiled per instruction set with target attributes, and the
+// best one the running CPU supports is picked once at startup.
+
+enum class SimdLevel { Scalar = 0, SSE2, AVX2, AVX512 };
+
+inline SimdLevel cpu_simd_level()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const SimdLevel level = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return SimdLevel::AVX512;
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+        return SimdLevel::Scalar;
+    }();
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+inline const char* simd_level_name(SimdLevel level)
+{
+    switch (level) {
+        case SimdLevel::SSE2: return "sse2";
+        case SimdLevel::AVX2: return "avx2";
+        case SimdLevel::AVX512: return "avx512";
+        default: return "scalar";
+    }
+}
@@ -0,0 +1,147 @@
+#include "deadline_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+DeadlinePool::DeadlinePool(const DeadlinePoolConfig& config, int num_streams, JobFn job)
+    : config_(config), num_streams_(std::min(std::max(num_streams, 1), (int)max_streams)), job_(std::move(job))
+{
+    config_.num_workers = std::max(1, config_.num_workers);
+    start_ns_ = monotonic_ns();
+    for (int w = 0; w < config_.num_workers; ++w) workers_.emplace_back(new Worker());
+    for (int w = 0; w < config_.num_workers; ++w) workers_[w]->thread = std::thread(&DeadlinePool::worker_main, this, w);
+}
+
+DeadlinePool::~DeadlinePool()
+{
+    stop();
+}
+
+void DeadlinePool::post(int stream, int64_t deadline_ns)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Stream& s = streams_[stream];
+        switch (s.state) {
+            case State::Idle:
+                s.state = State::Queued;
+                s.deadline_ns = deadline_ns;
+                break;
+            case State::Queued:
+                // The oldest unprocessed block sets the deadline
+                break;
+            case State::Running:
+                if (!s.pending) s.pending_deadline_ns = deadline_ns;
+                s.pending = true;
+                return;
+        }
+    }
+    ready_.notify_one();
+}
+
+void DeadlinePool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    ready_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) worker->thread.join();
+    }
+}
+
+void DeadlinePool::worker_main(int w)
+{
+    Worker& self = *workers_[w];
+    if (config_.priority > 0 || config_.first_cpu >= 0) {
+        RtThreadConfig rt;
+        rt.priority = config_.priority;
+        rt.cpu = config_.first_cpu >= 0 ? config_.first_cpu + w : -1;
+        self.rt_applied.store(rt_apply_thread(("dsp" + std::to_string(w)).c_str(), rt));
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        // Earliest deadline among the queued streams; a handful, so a scan
+        int next = -1;
+        for (int i = 0; i < num_streams_; ++i) {
+            if (streams_[i].state != State::Queued) continue;
+            if (next < 0 || streams_[i].deadline_ns < streams_[next].deadline_ns) next = i;
+        }
+        if (next < 0) {
+            if (stopping_) break;
+            ready_.wait(lock);
+            continue;
+        }
+        Stream& s = streams_[next];
+        s.state = State::Running;
+        s.pending = false;
+        const int64_t deadline = s.deadline_ns;
+        lock.unlock();
+
+        const uint64_t start = monotonic_ns();
+        const int64_t next_deadline = job_(w, next);
+        const uint64_t end = monotonic_ns();
+        self.busy_ns.fetch_add(end - start, std::memory_order_relaxed);
+        s.busy_ns.fetch_add(end - start, std::memory_order_relaxed);
+        if (next_deadline >= 0) {
+            // The block was ready at deadline - budget
+            const int64_t ready_ns = deadline - config_.deadline_ns;
+            s.response.record((int64_t)end > ready_ns ? (uint64_t)((int64_t)end - ready_ns) : 0);
+            s.jobs.fetch_add(1, std::memory_order_relaxed);
+            if ((int64_t)end > deadline) s.misses.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        lock.lock();
+        if (next_deadline > 0 || s.pending) {
+            s.state = State::Queued;
+            s.deadline_ns = next_deadline > 0 ? next_deadline : s.pending_deadline_ns;
+            s.pending = false;
+        } else {
+            s.state = State::Idle;
+        }
+    }
+}
+
+double DeadlinePool::utilization() const
+{
+    const double capacity = (double)elapsed_ns() * config_.num_workers;
+    uint64_t busy = 0;
+    for (int w = 0; w < config_.num_workers; ++w) busy += workers_[w]->busy_ns.load();
+    return capacity > 0.0 ? busy / capacity : 0.0;
+}
+
+int DeadlinePool::stream_capacity(double reserve) const
+{
+    const double elapsed = (double)elapsed_ns();
+    double load = 0.0;
+    for (int i = 0; i < num_streams_; ++i) load += streams_[i].busy_ns.load() / elapsed;
+    const double per_stream = load / num_streams_;
+    if (!(per_stream > 0.0)) return 0;
+    return (int)std::floor(config_.num_workers * (1.0 - reserve) / per_stream);
+}
+
+void deadline_pool_report(const DeadlinePool& pool, const char* const* stream_names, FILE* out)
+{
+    const DeadlinePoolConfig& c = pool.config();
+    const double elapsed = (double)pool.elapsed_ns();
+    fprintf(out, "DSP pool: %d worker(s)", c.num_workers);
+    if (c.first_cpu >= 0) fprintf(out, " on CPUs %d-%d", c.first_cpu, c.first_cpu + c.num_workers - 1);
+    fprintf(out, ", earliest deadline first, %.1f ms after each block\n", c.deadline_ns / 1e6);
+    fprintf(out, "%-20s %8s %9s %9s %9s %9s %8s  (response, us)\n", "array", "load", "blocks", "p50", "p99", "max",
+            "misses");
+    for (int i = 0; i < pool.num_streams(); ++i) {
+        const LatencyHistogram& h = pool.response(i);
+        fprintf(out, "%-20s %7.1f%% %9llu %9.1f %9.1f %9.1f %8llu\n", stream_names[i],
+                100.0 * pool.stream_busy_ns(i) / elapsed, (unsigned long long)h.count(),
+                h.percentile(50.0) / 1000.0, h.percentile(99.0) / 1000.0, h.max() / 1000.0,
+                (unsigned long long)pool.misses(i));
+    }
+    fprintf(out, "workers:");
+    for (int w = 0; w < c.num_workers; ++w) fprintf(out, " %.1f%%", 100.0 * pool.worker_busy_ns(w) / elapsed);
+    const double u = pool.utilization();
+    fprintf(out, "\nheadroom: %.1f%% of the pool idle; at this per-array load its workers fit about %d arrays "
+            "(keeping 20%% of each free)\n", 100.0 * (1.0 - u), pool.stream_capacity(0.2));
+    fflush(out);
+}
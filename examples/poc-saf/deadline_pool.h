@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "rt_config.h"
+#include "stage_stats.h"
+
+// Shared DSP workers for several audio streams (one per array), earliest
+// deadline first.
+//
+// A capture thread posts its stream once a block is ready, with the time
+// by which that block must be processed. Each worker, pinned to its own
+// core, always takes the ready stream with the earliest deadline. A
+// stream's blocks depend on each other (filter and averaging state), so a
+// stream is never on two workers at once: posts that arrive while it runs
+// are remembered, and it is requeued when its job returns.
+//
+// Per stream, the pool records the response time (block ready -> done) and
+// the deadline misses; per stream and per worker the busy time. From those,
+// deadline_pool_report() derives the headroom: the share of the pool the
+// streams use, and how many more streams of the measured cost it can take.
+
+struct DeadlinePoolConfig
+{
+    int num_workers = 1;
+    int first_cpu = -1;           // pin worker i to CPU first_cpu + i; -1 = unpinned
+    int priority = 0;             // SCHED_FIFO priority of the workers; 0 = SCHED_OTHER
+    int64_t deadline_ns = 10000000; // after a block is ready
+};
+
+class DeadlinePool
+{
+public:
+    static const int max_streams = 8;
+
+    // Processes the oldest ready block of `stream` on worker `worker`.
+    // Returns when its next block is due (CLOCK_MONOTONIC ns) if that one is
+    // ready too, 0 if not, and -1 if there was no block to process (a post
+    // that raced with the previous job).
+    typedef std::function<int64_t(int worker, int stream)> JobFn;
+
+    DeadlinePool(const DeadlinePoolConfig& config, int num_streams, JobFn job);
+    ~DeadlinePool();
+
+    DeadlinePool(const DeadlinePool&) = delete;
+    DeadlinePool& operator=(const DeadlinePool&) = delete;
+
+    // Any thread (normally the stream's capture thread): a block of
+    // `stream` is ready and due at deadline_ns. Never blocks for long.
+    void post(int stream, int64_t deadline_ns);
+
+    // Lets running jobs finish and joins the workers
+    void stop();
+
+    const DeadlinePoolConfig& config() const { return config_; }
+    int num_streams() const { return num_streams_; }
+
+    // Statistics (any thread)
+    const LatencyHistogram& response(int stream) const { return streams_[stream].response; }
+    uint64_t jobs(int stream) const { return streams_[stream].jobs.load(); }
+    uint64_t misses(int stream) const { return streams_[stream].misses.load(); }
+    uint64_t stream_busy_ns(int stream) const { return streams_[stream].busy_ns.load(); }
+    uint64_t worker_busy_ns(int worker) const { return workers_[worker]->busy_ns.load(); }
+    bool worker_rt_applied(int worker) const { return workers_[worker]->rt_applied.load(); }
+    uint64_t elapsed_ns() const { return monotonic_ns() - start_ns_; }
+
+    // Share of the pool's capacity (workers x elapsed time) the jobs used
+    double utilization() const;
+    // Streams of the current mean cost the pool could run in total while
+    // keeping `reserve` (0..1) of every worker free
+    int stream_capacity(double reserve) const;
+
+private:
+    enum class State { Idle, Queued, Running };
+
+    struct alignas(64) Stream
+    {
+        State state = State::Idle;       // under mutex_
+        int64_t deadline_ns = 0;         // under mutex_: due time of the oldest unprocessed block
+        bool pending = false;            // under mutex_: posted while running
+        int64_t pending_deadline_ns = 0;
+        LatencyHistogram response;       // jobs of one stream never overlap: one writer at a time
+        std::atomic<uint64_t> jobs{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> busy_ns{0};
+    };
+
+    struct alignas(64) Worker
+    {
+        std::thread thread;
+        std::atomic<uint64_t> busy_ns{0};
+        std::atomic<bool> rt_applied{false};
+    };
+
+    void worker_main(int w);
+
+    DeadlinePoolConfig config_;
+    int num_streams_;
+    JobFn job_;
+    Stream streams_[max_streams];
+    std::vector<std::unique_ptr<Worker>> workers_;
+    uint64_t start_ns_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    bool stopping_ = false;
+};
+
+// Per-stream response times and misses, worker load and the headroom.
+// Not for the audio threads.
+void deadline_pool_report(const DeadlinePool& pool, const char* const* stream_names, FILE* out);
@@ -0,0 +1,112 @@
+#include "direction_histogram.h"
+#include "doa_engine.h"
+#include <algorithm>
+#include <cmath>
+
+// Rescale once new weights are scaled up this much (~40 decay_s)
+static const float max_gain = 1e18f;
+
+// Elevation bins for about this resolution; the bins tile the sphere exactly
+static int half_circle_bins(float resolution_deg)
+{
+    return std::max(6, (int)std::lround(180.0f / std::max(resolution_deg, 1.0f)));
+}
+
+DirectionHistogram::DirectionHistogram(float resolution_deg, float decay_s)
+    : resolution_deg_(180.0f / half_circle_bins(resolution_deg)),
+      decay_s_(std::max(decay_s, 1e-3f)),
+      azimuth_bins_(2 * half_circle_bins(resolution_deg)),
+      elevation_bins_(half_circle_bins(resolution_deg))
+{
+}
+
+bool DirectionHistogram::prepare()
+{
+    int handle = arena_.add_channels(1, azimuth_bins_ * elevation_bins_);
+    if (!arena_.allocate()) return false;
+    bins_ = arena_.channels(handle)[0];
+    clear();
+    return true;
+}
+
+void DirectionHistogram::clear()
+{
+    if (bins_) std::fill(bins_, bins_ + azimuth_bins_ * elevation_bins_, 0.0f);
+    gain_ = 1.0f;
+    total_ = 0.0f;
+}
+
+void DirectionHistogram::decay(float dt_s)
+{
+    gain_ *= expf(dt_s / decay_s_);
+    if (gain_ < max_gain) return;
+
+    // Bring everything back to gain 1. Bins that have faded to nothing are
+    // zeroed, so they never become denormals.
+    const int n = azimuth_bins_ * elevation_bins_;
+    const float scale = 1.0f / gain_;
+    const float negligible = total_ * scale * 1e-9f;
+    for (int i = 0; i < n; ++i) {
+        float v = bins_[i] * scale;
+        bins_[i] = v > negligible ? v : 0.0f;
+    }
+    total_ *= scale;
+    gain_ = 1.0f;
+}
+
+void DirectionHistogram::add(float azimuth_deg, float elevation_deg, float weight)
+{
+    if (!bins_ || !(weight > 0.0f)) return;
+    weight *= gain_;
+
+    // Position in bins, relative to the bin centres
+    float fa = (azimuth_deg + 180.0f) / resolution_deg_ - 0.5f;
+    float fe = (elevation_deg + 90.0f) / resolution_deg_ - 0.5f;
+    float a_floor = std::floor(fa), e_floor = std::floor(fe);
+    float ta = fa - a_floor, te = fe - e_floor;
+    int a0 = ((int)a_floor % azimuth_bins_ + azimuth_bins_) % azimuth_bins_; // azimuth wraps
+    int a1 = a0 + 1 == azimuth_bins_ ? 0 : a0 + 1;
+    int e0 = std::max(0, std::min((int)e_floor, elevation_bins_ - 1));     // elevation clamps
+    int e1 = std::max(0, std::min((int)e_floor + 1, elevation_bins_ - 1));
+
+    float* row0 = bins_ + e0 * azimuth_bins_;
+    float* row1 = bins_ + e1 * azimuth_bins_;
+    row0[a0] += weight * (1.0f - ta) * (1.0f - te);
+    row0[a1] += weight * ta * (1.0f - te);
+    row1[a0] += weight * (1.0f - ta) * te;
+    row1[a1] += weight * ta * te;
+    total_ += weight;
+}
+
+float DirectionHistogram::bin(int e, int a) const
+{
+    if (e < 0 || e >= elevation_bins_) return 0.0f;
+    a = (a + azimuth_bins_) % azimuth_bins_;
+    return bins_[e * azimuth_bins_ + a];
+}
+
+bool DirectionHistogram::peak(float& azimuth_deg, float& elevation_deg, float& strength) const
+{
+    if (!bins_ || !(total_ > 0.0f)) return false;
+    int index = find_peak(bins_, azimuth_bins_ * elevation_bins_);
+    int pe = index / azimuth_bins_, pa = index % azimuth_bins_;
+
+    // Sub-bin position from a parabola through the peak and its neighbours,
+    // per axis; azimuth wraps, elevation stops at the poles
+    auto vertex = [](float left, float centre, float right) {
+        float curvature = left - 2.0f * centre + right;
+        return curvature < 0.0f ? std::max(-0.5f, std::min(0.5f, 0.5f * (left - right) / curvature)) : 0.0f;
+    };
+    float da = vertex(bin(pe, pa - 1), bin(pe, pa), bin(pe, pa + 1));
+    float de = pe > 0 && pe + 1 < elevation_bins_ ? vertex(bin(pe - 1, pa), bin(pe, pa), bin(pe + 1, pa)) : 0.0f;
+    azimuth_deg = -180.0f + (pa + 0.5f + da) * resolution_deg_;
+    if (azimuth_deg >= 180.0f) azimuth_deg -= 360.0f;
+    elevation_deg = std::max(-90.0f, std::min(90.0f, -90.0f + (pe + 0.5f + de) * resolution_deg_));
+
+    float sum = 0.0f;
+    for (int e = pe - 1; e <= pe + 1; ++e) {
+        for (int a = pa - 1; a <= pa + 1; ++a) sum += bin(e, a);
+    }
+    strength = std::min(1.0f, sum / total_);
+    return true;
+}
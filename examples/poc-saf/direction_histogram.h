@@ -0,0 +1,61 @@
+#pragma once
+
+#include "buffer_arena.h"
+
+// Aggregates many weighted direction estimates over time: every sldoa
+// band/sector of every update, weighted by its alpha, instead of only the
+// single strongest one. Reverberation scatters the individual estimates; their
+// weighted density still peaks at the source.
+//
+// The histogram is one flat array of azimuth x elevation bins (azimuth
+// fastest), and each estimate is split bilinearly over its four neighbouring
+// bins. Older updates fade exponentially with time constant decay_s. The
+// decay is lazy: instead of scaling every bin per update, new weights are
+// scaled up by the inverse of the accumulated decay, and the array is only
+// rescaled when that gain gets large. So an update touches four bins per
+// estimate, plus one SIMD argmax scan to find the peak.
+
+class DirectionHistogram
+{
+public:
+    // resolution_deg: bin size in azimuth and elevation, rounded so that
+    // the bins divide 180 degrees
+    DirectionHistogram(float resolution_deg = 5.0f, float decay_s = 0.5f);
+
+    DirectionHistogram(const DirectionHistogram&) = delete;
+    DirectionHistogram& operator=(const DirectionHistogram&) = delete;
+
+    bool prepare();
+
+    // Starts an update dt_s after the previous one: everything so far fades
+    void decay(float dt_s);
+
+    // Adds one estimate (SAF convention: azimuth 0 = front, +90 = left)
+    void add(float azimuth_deg, float elevation_deg, float weight);
+
+    // Peak direction, interpolated between the bins around it. strength is
+    // the share of the histogram's weight within one bin of the peak (0..1).
+    // False while the histogram is empty.
+    bool peak(float& azimuth_deg, float& elevation_deg, float& strength) const;
+
+    void clear();
+
+    int azimuth_bins() const { return azimuth_bins_; }
+    int elevation_bins() const { return elevation_bins_; }
+    float resolution_deg() const { return resolution_deg_; }
+    // Raw bins, [elevation * azimuth_bins() + azimuth], in arbitrary units
+    const float* bins() const { return bins_; }
+
+private:
+    float bin(int e, int a) const;
+
+    const float resolution_deg_;
+    const float decay_s_;
+    const int azimuth_bins_;
+    const int elevation_bins_;
+
+    BufferArena arena_;
+    float* bins_ = nullptr;
+    float gain_ = 1.0f;  // applied to new weights: 1 / decay since the last rescale
+    float total_ = 0.0f; // sum of all bins, same scale
+};
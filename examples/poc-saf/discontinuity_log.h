@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Why the captured stream is not continuous at some point
+enum class DiscontinuityKind : uint32_t
+{
+    Overrun, // ALSA buffer overran (xrun); samples were lost in the driver
+    Dropped, // the DSP side fell behind and the capture thread discarded frames
+};
+
+struct Discontinuity
+{
+    uint64_t stream_frame = 0; // first frame delivered after the gap
+    uint32_t lost_frames = 0;  // 0 if unknown
+    DiscontinuityKind kind = DiscontinuityKind::Overrun;
+};
+
+// Fixed-size log of the most recent discontinuities. One writer (the capture
+// thread), any number of readers; readers detect overwritten entries and
+// skip them instead of blocking the writer.
+class DiscontinuityLog
+{
+public:
+    static const int capacity = 64;
+
+    void record(const Discontinuity& d)
+    {
+        uint64_t n = count_.load(std::memory_order_relaxed);
+        Entry& e = entries_[n % capacity];
+        e.seq.store(0, std::memory_order_relaxed); // mark as being written
+        std::atomic_thread_fence(std::memory_order_release);
+        e.stream_frame.store(d.stream_frame, std::memory_order_relaxed);
+        e.lost_frames.store(d.lost_frames, std::memory_order_relaxed);
+        e.kind.store((uint32_t)d.kind, std::memory_order_relaxed);
+        e.seq.store(n + 1, std::memory_order_release);
+        count_.store(n + 1, std::memory_order_release);
+    }
+
+    // Total number of discontinuities recorded so far
+    uint64_t count() const { return count_.load(std::memory_order_acquire); }
+
+    // Reads entry `index` (0-based, < count()). Fails if it was already overwritten.
+    bool get(uint64_t index, Discontinuity& out) const
+    {
+        const Entry& e = entries_[index % capacity];
+        if (e.seq.load(std::memory_order_acquire) != index + 1) return false;
+        out.stream_frame = e.stream_frame.load(std::memory_order_relaxed);
+        out.lost_frames = e.lost_frames.load(std::memory_order_relaxed);
+        out.kind = (DiscontinuityKind)e.kind.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return e.seq.load(std::memory_order_relaxed) == index + 1;
+    }
+
+private:
+    struct Entry
+    {
+        std::atomic<uint64_t> seq{0}; // index + 1 once complete
+        std::atomic<uint64_t> stream_frame{0};
+        std::atomic<uint32_t> lost_frames{0};
+        std::atomic<uint32_t> kind{0};
+    };
+    Entry entries_[capacity];
+    std::atomic<uint64_t> count_{0};
+};
+
+inline const char* discontinuity_kind_name(DiscontinuityKind kind)
+{
+    return kind == DiscontinuityKind::Dropped ? "dropped" : "overrun";
+}
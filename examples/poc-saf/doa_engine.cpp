@@ -0,0 +1,582 @@
+#include "doa_engine.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+void sn3d_sh(float x, float y, float z, int order, float* out)
+{
+    const float s3 = sqrtf(3.0f), s15 = sqrtf(15.0f), s58 = sqrtf(5.0f / 8.0f), s38 = sqrtf(3.0f / 8.0f);
+    out[0] = 1.0f;
+    if (order < 1) return;
+    out[1] = y;
+    out[2] = z;
+    out[3] = x;
+    if (order < 2) return;
+    out[4] = s3 * x * y;
+    out[5] = s3 * y * z;
+    out[6] = 0.5f * (3.0f * z * z - 1.0f);
+    out[7] = s3 * x * z;
+    out[8] = 0.5f * s3 * (x * x - y * y);
+    if (order < 3) return;
+    out[9] = s58 * y * (3.0f * x * x - y * y);
+    out[10] = s15 * x * y * z;
+    out[11] = s38 * y * (5.0f * z * z - 1.0f);
+    out[12] = 0.5f * z * (5.0f * z * z - 3.0f);
+    out[13] = s38 * x * (5.0f * z * z - 1.0f);
+    out[14] = 0.5f * s15 * z * (x * x - y * y);
+    out[15] = s58 * x * (x * x - 3.0f * y * y);
+}
+
+// Cholesky factor of the symmetric positive definite n x n matrix a
+// (row-major): a = L L', L lower triangular, written to l. False if a is not
+// positive definite.
+static bool cholesky(const double* a, int n, double* l)
+{
+    for (int i = 0; i < n * n; ++i) l[i] = 0.0;
+    for (int j = 0; j < n; ++j) {
+        double d = a[j * n + j];
+        for (int k = 0; k < j; ++k) d -= l[j * n + k] * l[j * n + k];
+        if (!(d > 0.0)) return false;
+        d = std::sqrt(d);
+        l[j * n + j] = d;
+        for (int i = j + 1; i < n; ++i) {
+            double s = a[i * n + j];
+            for (int k = 0; k < j; ++k) s -= l[i * n + k] * l[j * n + k];
+            l[i * n + j] = s / d;
+        }
+    }
+    return true;
+}
+
+// One step of subspace iteration: q <- orth(a q) for the n x m column basis q
+// (row-major n x max_sh, columns 0..m-1), by modified Gram-Schmidt. Repeated
+// from the previous estimate's basis, q tracks the m leading eigenvectors.
+static void subspace_step(const double* a, int n, double* q, int m)
+{
+    double z[DoaEngine::max_sh * DoaEngine::max_sh];
+    const int stride = DoaEngine::max_sh;
+    for (int i = 0; i < n; ++i) {
+        for (int k = 0; k < m; ++k) {
+            double s = 0.0;
+            for (int j = 0; j < n; ++j) s += a[i * n + j] * q[j * stride + k];
+            z[i * stride + k] = s;
+        }
+    }
+    for (int k = 0; k < m; ++k) {
+        for (int p = 0; p < k; ++p) {
+            double d = 0.0;
+            for (int i = 0; i < n; ++i) d += z[i * stride + p] * z[i * stride + k];
+            for (int i = 0; i < n; ++i) z[i * stride + k] -= d * z[i * stride + p];
+        }
+        double norm = 0.0;
+        for (int i = 0; i < n; ++i) norm += z[i * stride + k] * z[i * stride + k];
+        // Collapsed column (rank-deficient R): keep the previous basis vector
+        if (!(norm > 1e-300)) {
+            for (int i = 0; i < n; ++i) z[i * stride + k] = q[i * stride + k];
+            continue;
+        }
+        norm = 1.0 / std::sqrt(norm);
+        for (int i = 0; i < n; ++i) z[i * stride + k] *= norm;
+    }
+    for (int i = 0; i < n; ++i) {
+        for (int k = 0; k < m; ++k) q[i * stride + k] = z[i * stride + k];
+    }
+}
+
+// === Scan kernels ===
+// Rows are taken four at a time so four independent FMA chains hide the
+// latency; the caller pads the rows with zeros to a multiple of four.
+
+static void project_scalar(const float* const* y, int num_sh, const float* rows, int num_rows,
+                           float* map, int num_padded)
+{
+    for (int g = 0; g < num_padded; ++g) {
+        float sum = 0.0f;
+        for (int k = 0; k < num_rows; ++k) {
+            const float* a = rows + k * DoaEngine::max_sh;
+            float p = 0.0f;
+            for (int j = 0; j < num_sh; ++j) p += a[j] * y[j][g];
+            sum += p * p;
+        }
+        map[g] = sum;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Two vectors of directions x four rows: eight independent chains per step
+__attribute__((target("sse2")))
+static void project_sse2(const float* const* y, int num_sh, const float* rows, int num_rows,
+                         float* map, int num_padded)
+{
+    const int s = DoaEngine::max_sh;
+    for (int g = 0; g < num_padded; g += 8) {
+        __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+        for (int k = 0; k < num_rows; k += 4) {
+            const float* a = rows + k * s;
+            __m128 p0 = _mm_setzero_ps(), p1 = _mm_setzero_ps(), p2 = _mm_setzero_ps(), p3 = _mm_setzero_ps();
+            __m128 q0 = _mm_setzero_ps(), q1 = _mm_setzero_ps(), q2 = _mm_setzero_ps(), q3 = _mm_setzero_ps();
+            for (int j = 0; j < num_sh; ++j) {
+                __m128 y0 = _mm_load_ps(y[j] + g), y1 = _mm_load_ps(y[j] + g + 4);
+                __m128 w0 = _mm_set1_ps(a[j]), w1 = _mm_set1_ps(a[s + j]);
+                __m128 w2 = _mm_set1_ps(a[2 * s + j]), w3 = _mm_set1_ps(a[3 * s + j]);
+                p0 = _mm_add_ps(p0, _mm_mul_ps(w0, y0));
+                p1 = _mm_add_ps(p1, _mm_mul_ps(w1, y0));
+                p2 = _mm_add_ps(p2, _mm_mul_ps(w2, y0));
+                p3 = _mm_add_ps(p3, _mm_mul_ps(w3, y0));
+                q0 = _mm_add_ps(q0, _mm_mul_ps(w0, y1));
+                q1 = _mm_add_ps(q1, _mm_mul_ps(w1, y1));
+                q2 = _mm_add_ps(q2, _mm_mul_ps(w2, y1));
+                q3 = _mm_add_ps(q3, _mm_mul_ps(w3, y1));
+            }
+            sum0 = _mm_add_ps(sum0, _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, p0), _mm_mul_ps(p1, p1)),
+                               _mm_add_ps(_mm_mul_ps(p2, p2), _mm_mul_ps(p3, p3))));
+            sum1 = _mm_add_ps(sum1, _mm_add_ps(_mm_add_ps(_mm_mul_ps(q0, q0), _mm_mul_ps(q1, q1)),
+                               _mm_add_ps(_mm_mul_ps(q2, q2), _mm_mul_ps(q3, q3))));
+        }
+        _mm_store_ps(map + g, sum0);
+        _mm_store_ps(map + g + 4, sum1);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void project_avx2(const float* const* y, int num_sh, const float* rows, int num_rows,
+                         float* map, int num_padded)
+{
+    const int s = DoaEngine::max_sh;
+    for (int g = 0; g < num_padded; g += 16) {
+        __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+        for (int k = 0; k < num_rows; k += 4) {
+            const float* a = rows + k * s;
+            __m256 p0 = _mm256_setzero_ps(), p1 = _mm256_setzero_ps(), p2 = _mm256_setzero_ps(), p3 = _mm256_setzero_ps();
+            __m256 q0 = _mm256_setzero_ps(), q1 = _mm256_setzero_ps(), q2 = _mm256_setzero_ps(), q3 = _mm256_setzero_ps();
+            for (int j = 0; j < num_sh; ++j) {
+                __m256 y0 = _mm256_load_ps(y[j] + g), y1 = _mm256_load_ps(y[j] + g + 8);
+                __m256 w0 = _mm256_broadcast_ss(a + j), w1 = _mm256_broadcast_ss(a + s + j);
+                __m256 w2 = _mm256_broadcast_ss(a + 2 * s + j), w3 = _mm256_broadcast_ss(a + 3 * s + j);
+                p0 = _mm256_fmadd_ps(w0, y0, p0);
+                p1 = _mm256_fmadd_ps(w1, y0, p1);
+                p2 = _mm256_fmadd_ps(w2, y0, p2);
+                p3 = _mm256_fmadd_ps(w3, y0, p3);
+                q0 = _mm256_fmadd_ps(w0, y1, q0);
+                q1 = _mm256_fmadd_ps(w1, y1, q1);
+                q2 = _mm256_fmadd_ps(w2, y1, q2);
+                q3 = _mm256_fmadd_ps(w3, y1, q3);
+            }
+            sum0 = _mm256_fmadd_ps(p0, p0, sum0);
+            sum0 = _mm256_fmadd_ps(p1, p1, sum0);
+            sum0 = _mm256_fmadd_ps(p2, p2, sum0);
+            sum0 = _mm256_fmadd_ps(p3, p3, sum0);
+            sum1 = _mm256_fmadd_ps(q0, q0, sum1);
+            sum1 = _mm256_fmadd_ps(q1, q1, sum1);
+            sum1 = _mm256_fmadd_ps(q2, q2, sum1);
+            sum1 = _mm256_fmadd_ps(q3, q3, sum1);
+        }
+        _mm256_store_ps(map + g, sum0);
+        _mm256_store_ps(map + g + 8, sum1);
+    }
+}
+
+__attribute__((target("avx512f")))
+static void project_avx512(const float* const* y, int num_sh, const float* rows, int num_rows,
+                           float* map, int num_padded)
+{
+    const int s = DoaEngine::max_sh;
+    for (int g = 0; g < num_padded; g += 32) {
+        __m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps();
+        for (int k = 0; k < num_rows; k += 4) {
+            const float* a = rows + k * s;
+            __m512 p0 = _mm512_setzero_ps(), p1 = _mm512_setzero_ps(), p2 = _mm512_setzero_ps(), p3 = _mm512_setzero_ps();
+            __m512 q0 = _mm512_setzero_ps(), q1 = _mm512_setzero_ps(), q2 = _mm512_setzero_ps(), q3 = _mm512_setzero_ps();
+            for (int j = 0; j < num_sh; ++j) {
+                __m512 y0 = _mm512_load_ps(y[j] + g), y1 = _mm512_load_ps(y[j] + g + 16);
+                __m512 w0 = _mm512_set1_ps(a[j]), w1 = _mm512_set1_ps(a[s + j]);
+                __m512 w2 = _mm512_set1_ps(a[2 * s + j]), w3 = _mm512_set1_ps(a[3 * s + j]);
+                p0 = _mm512_fmadd_ps(w0, y0, p0);
+                p1 = _mm512_fmadd_ps(w1, y0, p1);
+                p2 = _mm512_fmadd_ps(w2, y0, p2);
+                p3 = _mm512_fmadd_ps(w3, y0, p3);
+                q0 = _mm512_fmadd_ps(w0, y1, q0);
+                q1 = _mm512_fmadd_ps(w1, y1, q1);
+                q2 = _mm512_fmadd_ps(w2, y1, q2);
+                q3 = _mm512_fmadd_ps(w3, y1, q3);
+            }
+            sum0 = _mm512_fmadd_ps(p0, p0, sum0);
+            sum0 = _mm512_fmadd_ps(p1, p1, sum0);
+            sum0 = _mm512_fmadd_ps(p2, p2, sum0);
+            sum0 = _mm512_fmadd_ps(p3, p3, sum0);
+            sum1 = _mm512_fmadd_ps(q0, q0, sum1);
+            sum1 = _mm512_fmadd_ps(q1, q1, sum1);
+            sum1 = _mm512_fmadd_ps(q2, q2, sum1);
+            sum1 = _mm512_fmadd_ps(q3, q3, sum1);
+        }
+        _mm512_store_ps(map + g, sum0);
+        _mm512_store_ps(map + g + 16, sum1);
+    }
+}
+#endif
+
+// === Covariance kernels ===
+// Channel i against four channels j at once. The last group is shifted left
+// to end on the last channel (as the convert kernels do with tiles), so some
+// entries are written twice with the same value and a few land below the
+// diagonal; only j >= i is read.
+
+static void covariance_scalar(const float* const* x, int num_sh, int num_frames, float* cov)
+{
+    for (int i = 0; i < num_sh; ++i) {
+        for (int j = i; j < num_sh; ++j) {
+            float sum = 0.0f;
+            for (int t = 0; t < num_frames; ++t) sum += x[i][t] * x[j][t];
+            cov[i * DoaEngine::max_sh + j] = sum;
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static inline float hsum_sse2(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+__attribute__((target("sse2")))
+static void covariance_sse2(const float* const* x, int num_sh, int num_frames, float* cov)
+{
+    const int vec_frames = num_frames & ~3;
+    for (int i = 0; i < num_sh; ++i) {
+        const float* xi = x[i];
+        for (int j0 = i; j0 < num_sh; j0 += 4) {
+            const int j = std::min(j0, num_sh - 4);
+            const float *x0 = x[j], *x1 = x[j + 1], *x2 = x[j + 2], *x3 = x[j + 3];
+            __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+            for (int t = 0; t < vec_frames; t += 4) {
+                __m128 v = _mm_loadu_ps(xi + t);
+                s0 = _mm_add_ps(s0, _mm_mul_ps(v, _mm_loadu_ps(x0 + t)));
+                s1 = _mm_add_ps(s1, _mm_mul_ps(v, _mm_loadu_ps(x1 + t)));
+                s2 = _mm_add_ps(s2, _mm_mul_ps(v, _mm_loadu_ps(x2 + t)));
+                s3 = _mm_add_ps(s3, _mm_mul_ps(v, _mm_loadu_ps(x3 + t)));
+            }
+            float* out = cov + i * DoaEngine::max_sh + j;
+            out[0] = hsum_sse2(s0);
+            out[1] = hsum_sse2(s1);
+            out[2] = hsum_sse2(s2);
+            out[3] = hsum_sse2(s3);
+            for (int t = vec_frames; t < num_frames; ++t) {
+                out[0] += xi[t] * x0[t];
+                out[1] += xi[t] * x1[t];
+                out[2] += xi[t] * x2[t];
+                out[3] += xi[t] * x3[t];
+            }
+        }
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static inline float hsum_avx2(__m256 v)
+{
+    return hsum_sse2(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+__attribute__((target("avx2,fma")))
+static void covariance_avx2(const float* const* x, int num_sh, int num_frames, float* cov)
+{
+    const int vec_frames = num_frames & ~7;
+    for (int i = 0; i < num_sh; ++i) {
+        const float* xi = x[i];
+        for (int j0 = i; j0 < num_sh; j0 += 4) {
+            const int j = std::min(j0, num_sh - 4);
+            const float *x0 = x[j], *x1 = x[j + 1], *x2 = x[j + 2], *x3 = x[j + 3];
+            __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+            for (int t = 0; t < vec_frames; t += 8) {
+                __m256 v = _mm256_loadu_ps(xi + t);
+                s0 = _mm256_fmadd_ps(v, _mm256_loadu_ps(x0 + t), s0);
+                s1 = _mm256_fmadd_ps(v, _mm256_loadu_ps(x1 + t), s1);
+                s2 = _mm256_fmadd_ps(v, _mm256_loadu_ps(x2 + t), s2);
+                s3 = _mm256_fmadd_ps(v, _mm256_loadu_ps(x3 + t), s3);
+            }
+            float* out = cov + i * DoaEngine::max_sh + j;
+            out[0] = hsum_avx2(s0);
+            out[1] = hsum_avx2(s1);
+            out[2] = hsum_avx2(s2);
+            out[3] = hsum_avx2(s3);
+            for (int t = vec_frames; t < num_frames; ++t) {
+                out[0] += xi[t] * x0[t];
+                out[1] += xi[t] * x1[t];
+                out[2] += xi[t] * x2[t];
+                out[3] += xi[t] * x3[t];
+            }
+        }
+    }
+}
+#endif
+
+int find_peak(const float* map, int n)
+{
+    int g = 0;
+    float best = -FLT_MAX;
+    int best_index = 0;
+#if defined(__SSE2__)
+    // Per-lane maximum and its index, combined once at the end
+    __m128 vbest = _mm_set1_ps(-FLT_MAX);
+    __m128i vbest_index = _mm_setzero_si128();
+    __m128i vindex = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i four = _mm_set1_epi32(4);
+    for (; g + 4 <= n; g += 4) {
+        __m128 v = _mm_loadu_ps(map + g);
+        __m128i greater = _mm_castps_si128(_mm_cmpgt_ps(v, vbest));
+        vbest = _mm_max_ps(v, vbest);
+        vbest_index = _mm_or_si128(_mm_and_si128(greater, vindex), _mm_andnot_si128(greater, vbest_index));
+        vindex = _mm_add_epi32(vindex, four);
+    }
+    alignas(16) float lane_best[4];
+    alignas(16) int lane_index[4];
+    _mm_store_ps(lane_best, vbest);
+    _mm_store_si128((__m128i*)lane_index, vbest_index);
+    for (int i = 0; i < 4 && g > 0; ++i) {
+        if (lane_best[i] > best || (lane_best[i] == best && lane_index[i] < best_index)) {
+            best = lane_best[i];
+            best_index = lane_index[i];
+        }
+    }
+#endif
+    for (; g < n; ++g) {
+        if (map[g] > best) {
+            best = map[g];
+            best_index = g;
+        }
+    }
+    return best_index;
+}
+
+DoaEngine::DoaEngine(int order, int num_directions, DoaMap map, int num_sources)
+    : order_(std::max(1, std::min(order, (int)max_order))),
+      num_sh_((order_ + 1) * (order_ + 1)),
+      num_directions_(std::max(num_directions, 1)),
+      map_type_(map),
+      num_sources_(std::max(1, std::min(num_sources, num_sh_ - 1))),
+      simd_level_(cpu_simd_level()),
+      project_(project_scalar),
+      covariance_(covariance_scalar)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (simd_level_ >= SimdLevel::AVX2 && !__builtin_cpu_supports("fma")) simd_level_ = SimdLevel::SSE2;
+    switch (simd_level_) {
+        case SimdLevel::AVX512:
+            project_ = project_avx512;
+            covariance_ = covariance_avx2;
+            break;
+        case SimdLevel::AVX2:
+            project_ = project_avx2;
+            covariance_ = covariance_avx2;
+            break;
+        case SimdLevel::SSE2:
+            project_ = project_sse2;
+            covariance_ = covariance_sse2;
+            break;
+        default:
+            break;
+    }
+#endif
+    std::memset(block_cov_, 0, sizeof(block_cov_));
+    std::memset(rows_, 0, sizeof(rows_));
+
+    // Initial signal subspace: the first SH channels (omni, dipoles)
+    for (int k = 0; k < num_sources_; ++k) basis_[k * max_sh + k] = 1.0;
+}
+
+bool DoaEngine::prepare(int sample_rate, float averaging_s)
+{
+    averaging_frames_ = std::max(1.0f, averaging_s * (float)sample_rate);
+
+    // The kernels take two vectors of directions per step, up to 32 floats
+    const int padded = (num_directions_ + 31) & ~31;
+    int steering = arena_.add_channels(num_sh_, padded);
+    int angles = arena_.add_channels(2, num_directions_);
+    int map = arena_.add_channels(1, padded);
+    int neighbours = arena_.add_bytes(sizeof(int) * grid_neighbours * num_directions_);
+    int candidates = arena_.add_bytes(sizeof(int) * num_directions_);
+    if (!arena_.allocate()) return false;
+    steering_ = arena_.channels(steering);
+    azimuth_ = arena_.channels(angles)[0];
+    elevation_ = arena_.channels(angles)[1];
+    map_ = arena_.channels(map)[0];
+    neighbours_ = (int*)arena_.bytes(neighbours);
+    candidates_ = (int*)arena_.bytes(candidates);
+    num_padded_ = padded; // directions beyond num_directions stay zero
+
+    // Fibonacci grid: equal-area bands in z, golden-angle steps in azimuth
+    const double golden_angle = M_PI * (3.0 - std::sqrt(5.0));
+    float y[max_sh];
+    for (int g = 0; g < num_directions_; ++g) {
+        double z = 1.0 - (2.0 * g + 1.0) / num_directions_;
+        double r = std::sqrt(std::max(0.0, 1.0 - z * z));
+        double phi = std::remainder(golden_angle * g, 2.0 * M_PI);
+        float ux = (float)(r * std::cos(phi)), uy = (float)(r * std::sin(phi)), uz = (float)z;
+        sn3d_sh(ux, uy, uz, order_, y);
+        for (int j = 0; j < num_sh_; ++j) steering_[j][g] = y[j];
+        azimuth_[g] = (float)(phi * 180.0 / M_PI);
+        elevation_[g] = (float)(std::asin(z) * 180.0 / M_PI);
+    }
+
+    // Nearest neighbours for the peak search. The grid index follows z, so
+    // they are within ~sqrt(pi N) indices: a window of twice that, not all
+    // N^2 pairs. The order-1 steering rows are the unit vectors (y, z, x).
+    const float* gy = steering_[1];
+    const float* gz = steering_[2];
+    const float* gx = steering_[3];
+    const int window = (int)std::ceil(2.0 * std::sqrt(M_PI * num_directions_)) + grid_neighbours;
+    for (int g = 0; g < num_directions_; ++g) {
+        int* nb = neighbours_ + g * grid_neighbours;
+        float nb_cos[grid_neighbours];
+        int found = 0;
+        const int lo = std::max(0, g - window), hi = std::min(num_directions_ - 1, g + window);
+        for (int h = lo; h <= hi; ++h) {
+            if (h == g) continue;
+            float c = gx[g] * gx[h] + gy[g] * gy[h] + gz[g] * gz[h];
+            if (found == grid_neighbours && c <= nb_cos[found - 1]) continue;
+            int i = found < grid_neighbours ? found++ : found - 1;
+            for (; i > 0 && nb_cos[i - 1] < c; --i) {
+                nb_cos[i] = nb_cos[i - 1];
+                nb[i] = nb[i - 1];
+            }
+            nb_cos[i] = c;
+            nb[i] = h;
+        }
+        for (int i = found; i < grid_neighbours; ++i) nb[i] = g; // tiny grids
+    }
+
+    // SN3D: every order contributes 1 to |y|^2, whatever the direction
+    steering_norm_ = (float)(order_ + 1);
+    return true;
+}
+
+void DoaEngine::accumulate(const float* const* sh, int num_frames)
+{
+    if (num_frames <= 0) return;
+    covariance_(sh, num_sh_, num_frames, block_cov_);
+    for (int i = 0; i < num_sh_; ++i) {
+        for (int j = i; j < num_sh_; ++j) window_[i * max_sh + j] += block_cov_[i * max_sh + j];
+    }
+    window_frames_ += num_frames;
+}
+
+bool DoaEngine::estimate(DoaPeak& peak)
+{
+    if (!map_ || window_frames_ == 0) return false;
+
+    // Fold the window into the smoothed covariance
+    const double keep = std::exp(-(double)window_frames_ / averaging_frames_);
+    const double scale = (1.0 - keep) / window_frames_;
+    double trace = 0.0;
+    for (int i = 0; i < num_sh_; ++i) {
+        for (int j = i; j < num_sh_; ++j) {
+            cov_[i * max_sh + j] = keep * cov_[i * max_sh + j] + scale * window_[i * max_sh + j];
+            window_[i * max_sh + j] = 0.0;
+        }
+        trace += cov_[i * max_sh + i];
+    }
+    window_frames_ = 0;
+    if (!(trace > 1e-20)) return false;
+
+    double a[max_sh * max_sh];
+    const int n = num_sh_;
+    for (int i = 0; i < n; ++i) {
+        for (int j = i; j < n; ++j) a[i * n + j] = a[j * n + i] = cov_[i * max_sh + j];
+    }
+
+    // Rows a_k of the scan; unused rows up to the next multiple of 4 stay zero
+    int num_rows = 0;
+    if (map_type_ == DoaMap::Pwd) {
+        // y'Ry = |L'y|^2 with R = LL'; a little diagonal loading keeps R
+        // positive definite when fewer sources than SH channels are active
+        for (int i = 0; i < n; ++i) a[i * n + i] += 1e-7 * trace;
+        double l[max_sh * max_sh];
+        if (!cholesky(a, n, l)) return false;
+        const double norm = 1.0 / std::sqrt(trace * steering_norm_);
+        for (int k = 0; k < n; ++k, ++num_rows) {
+            for (int j = 0; j < n; ++j) rows_[k * max_sh + j] = (float)(l[j * n + k] * norm);
+        }
+    } else {
+        // The signal subspace changes slowly between estimates, so a few
+        // warm-started iterations per estimate keep it converged
+        for (int it = 0; it < subspace_iterations; ++it) subspace_step(a, n, basis_, num_sources_);
+        const double norm = 1.0 / std::sqrt(steering_norm_);
+        for (int k = 0; k < num_sources_; ++k, ++num_rows) {
+            for (int j = 0; j < n; ++j) rows_[k * max_sh + j] = (float)(basis_[j * max_sh + k] * norm);
+        }
+    }
+    const int padded_rows = (num_rows + 3) & ~3;
+    for (int k = num_rows; k < padded_rows; ++k) std::memset(rows_ + k * max_sh, 0, sizeof(float) * max_sh);
+
+    project_((const float* const*)steering_, n, rows_, padded_rows, map_, num_padded_);
+
+    peak.index = find_peak(map_, num_directions_);
+    peak.azimuth_deg = azimuth_[peak.index];
+    peak.elevation_deg = elevation_[peak.index];
+    peak.strength = map_[peak.index];
+    return true;
+}
+
+int DoaEngine::peaks(DoaPeak* out, int max_peaks, float separation_deg, float min_relative)
+{
+    if (!map_ || max_peaks <= 0) return 0;
+
+    // Every local maximum above the floor, not just the strongest max_peaks:
+    // a broad source can have two, and they must not crowd out a weaker one
+    const float floor = min_relative * map_[find_peak(map_, num_directions_)];
+    int num = 0;
+    for (int g = 0; g < num_directions_; ++g) {
+        const float v = map_[g];
+        if (v < floor) continue;
+        const int* nb = neighbours_ + g * grid_neighbours;
+        bool local_max = true;
+        for (int i = 0; i < grid_neighbours && local_max; ++i) {
+            local_max = map_[nb[i]] < v || (map_[nb[i]] == v && nb[i] >= g);
+        }
+        if (local_max) candidates_[num++] = g;
+    }
+    // Strongest first; ties go to the lower index
+    const float* map = map_;
+    std::sort(candidates_, candidates_ + num,
+              [map](int a, int b) { return map[a] > map[b] || (map[a] == map[b] && a < b); });
+
+    // Ones too close to a stronger kept one (the same source) go
+    const float* gy = steering_[1];
+    const float* gz = steering_[2];
+    const float* gx = steering_[3];
+    const float max_cos = std::cos(separation_deg * (float)M_PI / 180.0f);
+    int kept = 0;
+    for (int k = 0; k < num && kept < max_peaks; ++k) {
+        const int g = candidates_[k];
+        bool close = false;
+        for (int j = 0; j < kept && !close; ++j) {
+            const int c = out[j].index;
+            close = gx[g] * gx[c] + gy[g] * gy[c] + gz[g] * gz[c] > max_cos;
+        }
+        if (close) continue;
+        out[kept].index = g;
+        out[kept].strength = map_[g];
+        out[kept].azimuth_deg = azimuth_[g];
+        out[kept].elevation_deg = elevation_[g];
+        ++kept;
+    }
+    return kept;
+}
+
+void DoaEngine::direction(int index, float& azimuth_deg, float& elevation_deg) const
+{
+    azimuth_deg = azimuth_[index];
+    elevation_deg = elevation_[index];
+}
+
+float DoaEngine::resolution_deg() const
+{
+    return (float)(std::sqrt(4.0 * M_PI / num_directions_) * 180.0 / M_PI);
+}
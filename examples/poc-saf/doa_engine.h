@@ -0,0 +1,125 @@
+#pragma once
+
+#include "buffer_arena.h"
+#include "cpu_features.h"
+
+// Native direction-of-arrival estimation on ACN/SN3D SH signals, as an
+// alternative to sldoa: a full-sphere power map on a fixed grid of
+// directions, and its peak.
+//
+// Every SAF frame adds its SH covariance to the current window. estimate()
+// folds the window into an exponentially smoothed covariance R and evaluates
+// the map on every grid direction with steering vector y:
+//
+//   Pwd:   steered response power of a plane-wave decomposition beam, y'Ry,
+//          divided by trace(R) |y|^2 (1 = all energy from that direction)
+//   Music: SH-MUSIC, |Es'y|^2 / |y|^2 with Es an orthonormal basis of the
+//          num_sources-dimensional signal subspace (1 = the direction lies in
+//          the signal subspace)
+//
+// Both are sums of squared projections, sum_k (a_k'y)^2: for Pwd the a_k are
+// the columns of the Cholesky factor of R, for Music the basis vectors, which
+// are tracked by subspace iteration warm-started from the previous estimate
+// (no full eigendecomposition per update). So one kernel scans both.
+//
+// The steering vectors are computed once in prepare() and stored SoA: one
+// row per SH channel over all directions, so the scan streams contiguous
+// vectors of directions through FMAs with the a_k broadcast.
+
+enum class DoaMap { Pwd, Music };
+
+struct DoaPeak
+{
+    float azimuth_deg = 0.0f;   // SAF convention: 0 = front, +90 = left
+    float elevation_deg = 0.0f; // +90 = up
+    float strength = 0.0f;      // map value at the peak, 0..1
+    int index = -1;             // grid direction
+};
+
+// Real SH up to order 3, ACN order, SN3D normalization (AmbiX), for the unit
+// vector (x, y, z): x front, y left, z up
+void sn3d_sh(float x, float y, float z, int order, float* out);
+
+// Index of the largest of n values, the first one on ties (SSE2 scan)
+int find_peak(const float* map, int n);
+
+class DoaEngine
+{
+public:
+    static const int max_order = 3;
+    static const int max_sh = (max_order + 1) * (max_order + 1);
+
+    // order 1..max_order. num_directions points of a Fibonacci grid, which are
+    // spread almost uniformly: mean spacing ~ sqrt(4 pi / num_directions).
+    DoaEngine(int order, int num_directions, DoaMap map, int num_sources = 1);
+
+    DoaEngine(const DoaEngine&) = delete;
+    DoaEngine& operator=(const DoaEngine&) = delete;
+
+    // Allocates the grid and the map and computes the steering vectors.
+    // averaging_s is the time constant of the covariance smoothing.
+    bool prepare(int sample_rate, float averaging_s = 0.1f);
+
+    // Adds one block of (order+1)^2 SH signals to the current window
+    void accumulate(const float* const* sh, int num_frames);
+
+    // Closes the window, updates the map and returns its peak.
+    // False while nothing but silence has been accumulated.
+    bool estimate(DoaPeak& peak);
+
+    // Up to max_peaks directions of the last estimate's map, strongest first,
+    // one per source for the tracker. All local maxima (above each of their
+    // grid neighbours) down to min_relative of the strongest are ranked
+    // first; one within separation_deg of a stronger kept peak is the same
+    // source and is skipped, so it cannot take a weaker source's place.
+    // Returns how many.
+    int peaks(DoaPeak* out, int max_peaks, float separation_deg, float min_relative);
+
+    // Map of the last estimate, one value per grid direction
+    const float* map() const { return map_; }
+    int num_directions() const { return num_directions_; }
+    void direction(int index, float& azimuth_deg, float& elevation_deg) const;
+    float resolution_deg() const;
+
+    DoaMap map_type() const { return map_type_; }
+    SimdLevel simd_level() const { return simd_level_; }
+
+    // Scan kernel: map[g] = sum_k (rows[k] . y_g)^2 for num_rows rows of
+    // max_sh floats (a multiple of 4 rows) over num_padded directions
+    // (a multiple of 32).
+    typedef void (*ProjectionKernel)(const float* const* steering, int num_sh, const float* rows, int num_rows,
+                                     float* map, int num_padded);
+    // Block covariance kernel: cov[i * max_sh + j] = sum_t x_i[t] x_j[t] for
+    // at least all j >= i
+    typedef void (*CovarianceKernel)(const float* const* x, int num_sh, int num_frames, float* cov);
+
+private:
+    int order_;
+    int num_sh_;
+    int num_directions_;
+    int num_padded_ = 0;
+    DoaMap map_type_;
+    int num_sources_;
+    SimdLevel simd_level_;
+    ProjectionKernel project_;
+    CovarianceKernel covariance_;
+
+    BufferArena arena_;
+    float** steering_ = nullptr; // num_sh x num_padded, zero beyond num_directions
+    static const int grid_neighbours = 6; // a Fibonacci grid cell is mostly a hexagon
+    int* neighbours_ = nullptr;  // per direction, its grid_neighbours nearest
+    int* candidates_ = nullptr;  // peaks() scratch, num_directions
+    float* azimuth_ = nullptr;   // degrees, per direction
+    float* elevation_ = nullptr;
+    float* map_ = nullptr;
+    float steering_norm_ = 1.0f; // |y|^2, the same for every direction
+
+    float averaging_frames_ = 1.0f; // smoothing time constant in samples
+    float block_cov_[max_sh * max_sh];
+    double window_[max_sh * max_sh] = {}; // upper triangle used
+    int window_frames_ = 0;
+    double cov_[max_sh * max_sh] = {};    // smoothed R, upper triangle used
+    static const int subspace_iterations = 3;
+    double basis_[max_sh * max_sh] = {};  // Music: signal subspace, columns 0..num_sources-1
+    alignas(64) float rows_[max_sh * max_sh];
+};
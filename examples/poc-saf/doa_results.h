@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Binary results channel of the localization pipeline: one fixed-size
+// DoaRecord per DoA update, published into a POSIX shared-memory ring
+// (and optionally streamed over a Unix-domain socket, see
+// results_publisher.h). Consumers use doa_results_reader.h; this header is
+// all they share with the pipeline, so it has no other dependencies.
+//
+// Shared memory layout: a DoaResultsHeader followed by `capacity` slots.
+// Each slot is a seqlock: the writer makes its sequence odd, writes the
+// record, then sets it to 2 * (record number + 1). A reader copies the record
+// and accepts it only if the sequence was that even value before and after
+// the copy. Readers map the ring read-only and never write it, so any number
+// of them can attach without the writer noticing; a reader that falls more
+// than `capacity` records behind loses the oldest ones. Blocked readers sleep
+// on the notify futex, which the writer bumps (off the DSP thread) whenever
+// new records have appeared.
+
+const uint32_t doa_results_magic = 0x414f4453; // "SDOA"
+const uint32_t doa_results_version = 3;
+
+const char* const doa_results_default_name = "/ssl-doa";
+
+const int doa_record_max_bands = 160;  // sldoa analyses at most 133 bands
+const int doa_record_max_tracks = 8;
+
+// Dominant sector of one sldoa band
+struct DoaBandRecord
+{
+    float azimuth_deg;
+    float elevation_deg;
+    float alpha;
+};
+
+struct DoaTrackRecord
+{
+    uint32_t id;
+    float azimuth_deg;
+    float elevation_deg;
+    float strength;
+};
+
+struct DoaRecord
+{
+    uint64_t sequence;      // update number, from 0
+    uint64_t timestamp_ns;  // CLOCK_MONOTONIC when published (comparable across processes)
+    uint64_t stream_frame;  // audio frames into the stream at the end of the update
+    uint64_t device_frame;  // the same position counting the frames lost in gaps (device timeline)
+    int64_t capture_monotonic_ns; // CLOCK_MONOTONIC when device_frame was captured; 0 = unknown
+    int64_t capture_realtime_ns;  // the same on CLOCK_REALTIME; 0 = unknown
+    uint32_t sample_rate;
+    int32_t method;         // 0 sldoa, 1 pwd, 2 music
+    uint32_t array_id;      // which array of a multi-array run; 0 with a single array
+
+    // Dominant direction (DoaEstimate); strength < 0 = none
+    float azimuth_deg;
+    float elevation_deg;
+    float strength;
+
+    float input_db;         // mean mic level, dBFS
+    float sh_db;            // mean SH level, dBFS
+    int32_t gate_open;      // 1 if the activity gate was open (or there is none)
+
+    int32_t num_tracks;     // confirmed tracks
+    DoaTrackRecord tracks[doa_record_max_tracks];
+
+    int32_t start_band;     // sldoa band of bands[0]
+    int32_t num_bands;      // 0 for the grid methods
+    DoaBandRecord bands[doa_record_max_bands];
+};
+
+static_assert(std::is_trivially_copyable<DoaRecord>::value, "DoaRecord is copied as bytes");
+
+struct DoaResultsHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;   // sizeof(DoaRecord)
+    uint32_t capacity;      // slots
+    int32_t writer_pid;
+    uint32_t reserved;
+    uint64_t session;       // differs for every writer start
+
+    alignas(64) std::atomic<uint64_t> head;   // records published so far (DSP thread)
+    alignas(64) std::atomic<uint32_t> notify; // futex word, bumped by the writer's notifier thread
+};
+
+struct alignas(64) DoaResultsSlot
+{
+    std::atomic<uint64_t> seq;
+    DoaRecord record;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "the ring is shared between processes");
+
+inline size_t doa_results_size(uint32_t capacity)
+{
+    return sizeof(DoaResultsHeader) + (size_t)capacity * sizeof(DoaResultsSlot);
+}
+
+inline DoaResultsSlot* doa_results_slots(DoaResultsHeader* header)
+{
+    return reinterpret_cast<DoaResultsSlot*>(header + 1);
+}
+
+// Socket stream: the server sends this once per connection, then one
+// SOCK_SEQPACKET message per DoaRecord
+struct DoaStreamHello
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t session;
+};
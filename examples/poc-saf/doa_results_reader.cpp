@@ -0,0 +1,196 @@
+#include "doa_results_reader.h"
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Shared (not FUTEX_PRIVATE) waits: the writer is another process
+static void futex_wait(std::atomic<uint32_t>* word, uint32_t expected, int timeout_ms)
+{
+    timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+static uint64_t now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+DoaResultsReader::~DoaResultsReader()
+{
+    detach();
+}
+
+bool DoaResultsReader::attach(const char* name)
+{
+    detach();
+    // Read-only: readers never write the ring (futex waits work on it too)
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(DoaResultsHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void* mem = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) return false;
+
+    DoaResultsHeader* header = static_cast<DoaResultsHeader*>(mem);
+    if (header->magic != doa_results_magic || header->version != doa_results_version ||
+        header->record_size != sizeof(DoaRecord) || header->capacity == 0 ||
+        doa_results_size(header->capacity) > (size_t)st.st_size) {
+        munmap(mem, (size_t)st.st_size);
+        return false;
+    }
+    header_ = header;
+    slots_ = doa_results_slots(header);
+    size_ = (size_t)st.st_size;
+    next_ = header_->head.load(std::memory_order_acquire);
+    lost_ = 0;
+    return true;
+}
+
+void DoaResultsReader::detach()
+{
+    if (header_) munmap(header_, size_);
+    header_ = nullptr;
+    slots_ = nullptr;
+    size_ = 0;
+}
+
+bool DoaResultsReader::next(DoaRecord& record)
+{
+    if (!header_) return false;
+    const uint64_t capacity = header_->capacity;
+    for (;;) {
+        uint64_t head = header_->head.load(std::memory_order_acquire);
+        if (next_ >= head) return false;
+        if (head - next_ > capacity) {
+            lost_ += head - capacity - next_;
+            next_ = head - capacity;
+        }
+
+        const DoaResultsSlot& slot = slots_[next_ % capacity];
+        const uint64_t expected = 2 * (next_ + 1);
+        uint64_t before = slot.seq.load(std::memory_order_acquire);
+        if (before == expected) {
+            std::memcpy(&record, &slot.record, sizeof(DoaRecord));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == expected) {
+                ++next_;
+                return true;
+            }
+        }
+        // Overwritten before or while copying: that record is lost
+        ++lost_;
+        ++next_;
+    }
+}
+
+bool DoaResultsReader::wait(DoaRecord& record, int timeout_ms)
+{
+    if (next(record)) return true;
+    if (!header_) return false;
+
+    const uint64_t deadline = now_ns() + (uint64_t)timeout_ms * 1000000ull;
+    for (;;) {
+        // Read notify before re-checking: a record the re-check misses is
+        // followed by a bump, which either changes the word before the wait
+        // (no sleep) or wakes it
+        uint32_t seen = header_->notify.load(std::memory_order_acquire);
+        if (next(record)) return true;
+        uint64_t now = now_ns();
+        if (now >= deadline) return false;
+        int left_ms = (int)((deadline - now + 999999) / 1000000);
+        futex_wait(&header_->notify, seen, left_ms);
+        if (next(record)) return true;
+        if (now_ns() >= deadline) return false;
+    }
+}
+
+bool DoaResultsReader::writer_alive() const
+{
+    if (!header_ || header_->writer_pid <= 0) return false;
+    return kill(header_->writer_pid, 0) == 0 || errno == EPERM;
+}
+
+uint64_t DoaResultsReader::session() const
+{
+    return header_ ? header_->session : 0;
+}
+
+uint32_t DoaResultsReader::capacity() const
+{
+    return header_ ? header_->capacity : 0;
+}
+
+DoaStreamClient::~DoaStreamClient()
+{
+    close();
+}
+
+bool DoaStreamClient::connect(const char* socket_path)
+{
+    close();
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (std::strlen(socket_path) >= sizeof(addr.sun_path)) return false;
+    std::strcpy(addr.sun_path, socket_path);
+
+    fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) return false;
+    if (::connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close();
+        return false;
+    }
+
+    // The server introduces the stream before the first record
+    DoaStreamHello hello;
+    pollfd pfd = {fd_, POLLIN, 0};
+    if (poll(&pfd, 1, 1000) != 1 || recv(fd_, &hello, sizeof(hello), 0) != (ssize_t)sizeof(hello) ||
+        hello.magic != doa_results_magic || hello.version != doa_results_version ||
+        hello.record_size != sizeof(DoaRecord)) {
+        close();
+        return false;
+    }
+    session_ = hello.session;
+    return true;
+}
+
+void DoaStreamClient::close()
+{
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+bool DoaStreamClient::receive(DoaRecord& record, int timeout_ms)
+{
+    if (fd_ < 0) return false;
+    pollfd pfd = {fd_, POLLIN, 0};
+    int ready;
+    do {
+        ready = poll(&pfd, 1, timeout_ms);
+    } while (ready < 0 && errno == EINTR);
+    if (ready <= 0) return false;
+
+    ssize_t n = recv(fd_, &record, sizeof(record), 0);
+    if (n == (ssize_t)sizeof(record)) return true;
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) return false;
+    close(); // orderly shutdown (0) or a broken stream
+    return false;
+}
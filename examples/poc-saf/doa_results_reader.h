@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include "doa_results.h"
+
+// Reader side of the DoA results channel (see doa_results.h). Link against
+// the doa_results library; it needs neither SAF nor ALSA.
+//
+//   DoaResultsReader reader;
+//   if (!reader.attach()) ...;
+//   DoaRecord r;
+//   while (reader.wait(r, 1000)) use(r);
+//
+// A reader starts at the newest record. Records are delivered in order;
+// when the reader falls more than a ring's worth behind, the overwritten
+// ones are skipped and counted in lost().
+class DoaResultsReader
+{
+public:
+    DoaResultsReader() = default;
+    ~DoaResultsReader();
+
+    DoaResultsReader(const DoaResultsReader&) = delete;
+    DoaResultsReader& operator=(const DoaResultsReader&) = delete;
+
+    // Maps the ring published under `name` (a POSIX shm name, "/...")
+    bool attach(const char* name = doa_results_default_name);
+    void detach();
+    bool attached() const { return header_ != nullptr; }
+
+    // Next record, if one was published since the last call
+    bool next(DoaRecord& record);
+
+    // Like next(), but blocks up to timeout_ms (futex, no polling) for a new
+    // record. False on timeout.
+    bool wait(DoaRecord& record, int timeout_ms);
+
+    // False once the writer process is gone (or was restarted: a restarted
+    // writer creates a new ring, so attach() again)
+    bool writer_alive() const;
+    uint64_t session() const;
+
+    uint64_t lost() const { return lost_; }
+    uint32_t capacity() const;
+
+private:
+    DoaResultsHeader* header_ = nullptr;
+    DoaResultsSlot* slots_ = nullptr;
+    size_t size_ = 0;
+    uint64_t next_ = 0;   // record number to read next
+    uint64_t lost_ = 0;
+};
+
+// Client of the socket stream (results_publisher_start with a socket path).
+// Each receive() returns exactly one record.
+class DoaStreamClient
+{
+public:
+    DoaStreamClient() = default;
+    ~DoaStreamClient();
+
+    DoaStreamClient(const DoaStreamClient&) = delete;
+    DoaStreamClient& operator=(const DoaStreamClient&) = delete;
+
+    bool connect(const char* socket_path);
+    void close();
+
+    // Blocks up to timeout_ms (-1 = forever). False on timeout or when the
+    // server went away (then connected() is false).
+    bool receive(DoaRecord& record, int timeout_ms);
+    bool connected() const { return fd_ >= 0; }
+    uint64_t session() const { return session_; }
+
+private:
+    int fd_ = -1;
+    uint64_t session_ = 0;
+};
@@ -0,0 +1,184 @@
+#include "doa_tracker.h"
+#include <algorithm>
+#include <cmath>
+
+static const float deg_to_rad = (float)M_PI / 180.0f;
+
+DoaObservation doa_observation(float azimuth_deg, float elevation_deg, float weight)
+{
+    float azi = azimuth_deg * deg_to_rad, elev = elevation_deg * deg_to_rad;
+    return {cosf(elev) * cosf(azi), cosf(elev) * sinf(azi), sinf(elev), weight};
+}
+
+static float dot(const DoaTrack& t, float x, float y, float z)
+{
+    return t.x * x + t.y * y + t.z * z;
+}
+
+// Normalizes (x, y, z) into the track's direction; false for a null vector
+static bool set_direction(DoaTrack& t, float x, float y, float z)
+{
+    float norm = sqrtf(x * x + y * y + z * z);
+    if (!(norm > 1e-9f)) return false;
+    t.x = x / norm;
+    t.y = y / norm;
+    t.z = z / norm;
+    t.azimuth_deg = atan2f(t.y, t.x) / deg_to_rad;
+    t.elevation_deg = asinf(std::max(-1.0f, std::min(1.0f, t.z))) / deg_to_rad;
+    return true;
+}
+
+DoaTracker::DoaTracker(const DoaTrackerConfig& config)
+    : config_(config),
+      cos_merge_(cosf(config.merge_deg * deg_to_rad)),
+      measurement_var_(config.measurement_deg * deg_to_rad * config.measurement_deg * deg_to_rad),
+      motion_var_per_s_(config.motion_deg_per_s * deg_to_rad * config.motion_deg_per_s * deg_to_rad)
+{
+}
+
+int DoaTracker::num_confirmed() const
+{
+    int n = 0;
+    for (int i = 0; i < num_tracks_; ++i) n += tracks_[i].confirmed;
+    return n;
+}
+
+void DoaTracker::finish(DoaTrack& t)
+{
+    if (t.confirmed) ++deaths_;
+}
+
+void DoaTracker::remove(int index)
+{
+    tracks_[index] = tracks_[--num_tracks_];
+}
+
+void DoaTracker::update(const DoaObservation* obs, int num_obs, float dt_s)
+{
+    num_obs = std::min(std::max(num_obs, 0), max_observations);
+
+    // Predict: uncertainty grows with the time since the last update
+    for (int i = 0; i < num_tracks_; ++i) {
+        tracks_[i].variance += motion_var_per_s_ * dt_s;
+        sum_[i][0] = sum_[i][1] = sum_[i][2] = sum_[i][3] = 0.0f;
+        count_[i] = 0;
+    }
+
+    float max_weight = 0.0f;
+    for (int o = 0; o < num_obs; ++o) max_weight = std::max(max_weight, obs[o].weight);
+    const float min_weight = max_weight * config_.relative_threshold;
+
+    // Associate: nearest track inside the gate. The gate stays fixed: widening
+    // it with the track's uncertainty mostly lets clutter keep dead tracks alive.
+    const float gate_rad = config_.gate_deg * deg_to_rad;
+    const float cos_gate = cosf(gate_rad);
+    for (int o = 0; o < num_obs; ++o) {
+        assigned_[o] = -2; // ignored (-3: used in a birth cluster)
+        if (!(obs[o].weight > 0.0f) || obs[o].weight < min_weight) continue;
+        assigned_[o] = -1; // unclaimed
+        float best = -2.0f;
+        for (int i = 0; i < num_tracks_; ++i) {
+            float d = dot(tracks_[i], obs[o].x, obs[o].y, obs[o].z);
+            if (d >= cos_gate && d > best) {
+                best = d;
+                assigned_[o] = i;
+            }
+        }
+        if (assigned_[o] < 0) continue;
+        float* s = sum_[assigned_[o]];
+        s[0] += obs[o].weight * obs[o].x;
+        s[1] += obs[o].weight * obs[o].y;
+        s[2] += obs[o].weight * obs[o].z;
+        s[3] += obs[o].weight;
+        ++count_[assigned_[o]];
+    }
+
+    const float presence_coeff = 1.0f - expf(-dt_s / std::max(config_.coast_s, 1e-3f));
+
+    // Correct, on the sphere: blend towards the mean observation and renormalize.
+    // More agreeing observations (bands) mean a more certain measurement.
+    for (int i = 0; i < num_tracks_; ++i) {
+        DoaTrack& t = tracks_[i];
+        const float* s = sum_[i];
+        DoaTrack measured;
+        if (count_[i] < config_.min_cluster || !set_direction(measured, s[0], s[1], s[2])) {
+            ++t.misses;
+            t.presence -= presence_coeff * t.presence;
+            continue;
+        }
+        t.presence += presence_coeff * (1.0f - t.presence);
+        float r = measurement_var_ / (float)std::min(count_[i], 8);
+        float gain = t.variance / (t.variance + r);
+        set_direction(t, t.x + gain * (measured.x - t.x), t.y + gain * (measured.y - t.y),
+                      t.z + gain * (measured.z - t.z));
+        t.variance *= 1.0f - gain;
+        t.strength += 0.3f * (s[3] / count_[i] - t.strength);
+        ++t.hits;
+        t.misses = 0;
+        if (!t.confirmed && t.hits >= config_.confirm_hits) {
+            t.confirmed = true;
+            ++births_;
+        }
+    }
+
+    // Deaths: tentative tracks after one miss, confirmed ones after coast_s
+    // or when they are mostly missed
+    const int max_misses = std::max(1, (int)(config_.coast_s / std::max(dt_s, 1e-6f)));
+    for (int i = num_tracks_ - 1; i >= 0; --i) {
+        const DoaTrack& t = tracks_[i];
+        if (t.misses > (t.confirmed ? max_misses : 0) || t.presence < config_.min_presence) {
+            finish(tracks_[i]);
+            remove(i);
+        }
+    }
+
+    // Merge converged tracks into the one confirmed first (lower id)
+    for (int i = 0; i < num_tracks_; ++i) {
+        for (int j = num_tracks_ - 1; j > i; --j) {
+            if (dot(tracks_[i], tracks_[j].x, tracks_[j].y, tracks_[j].z) < cos_merge_) continue;
+            int keep = tracks_[i].confirmed != tracks_[j].confirmed ? (tracks_[i].confirmed ? i : j)
+                       : (tracks_[i].id < tracks_[j].id ? i : j);
+            int drop = keep == i ? j : i;
+            tracks_[keep].hits = std::max(tracks_[keep].hits, tracks_[drop].hits);
+            finish(tracks_[drop]);
+            tracks_[drop] = tracks_[keep];
+            remove(j);
+        }
+    }
+
+    // Births: cluster unclaimed observations around the strongest one,
+    // while there is room
+    for (;;) {
+        int seed = -1;
+        for (int o = 0; o < num_obs; ++o) {
+            if (assigned_[o] == -1 && (seed < 0 || obs[o].weight > obs[seed].weight)) seed = o;
+        }
+        if (seed < 0 || num_tracks_ == max_tracks) break;
+
+        DoaTrack seed_dir;
+        set_direction(seed_dir, obs[seed].x, obs[seed].y, obs[seed].z);
+        float s[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        int count = 0;
+        for (int o = 0; o < num_obs; ++o) {
+            if (assigned_[o] != -1 || dot(seed_dir, obs[o].x, obs[o].y, obs[o].z) < cos_gate) continue;
+            s[0] += obs[o].weight * obs[o].x;
+            s[1] += obs[o].weight * obs[o].y;
+            s[2] += obs[o].weight * obs[o].z;
+            s[3] += obs[o].weight;
+            ++count;
+            assigned_[o] = -3; // used by this cluster
+        }
+        if (count < config_.min_cluster) continue; // a stray observation
+
+        DoaTrack& t = tracks_[num_tracks_];
+        t = DoaTrack();
+        if (!set_direction(t, s[0], s[1], s[2])) set_direction(t, seed_dir.x, seed_dir.y, seed_dir.z);
+        t.id = next_id_++;
+        t.variance = measurement_var_ / (float)std::min(count, 8);
+        t.strength = s[3] / count;
+        t.hits = 1;
+        t.confirmed = config_.confirm_hits <= 1;
+        if (t.confirmed) ++births_;
+        ++num_tracks_;
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+
+// Multi-source tracking over the per-update DoA estimates.
+//
+// Each update brings a set of weighted direction observations: every sldoa
+// sector of every band above a relative threshold, or the DoaEngine's map
+// peaks (one per source).
+// Each observation goes to the nearest track inside the gate. A track with at
+// least min_cluster observations (a real source shows up in several bands,
+// stray sectors don't) folds their weighted mean into a Kalman filter on the
+// unit sphere. The state is the direction plus an isotropic variance with a
+// random-walk motion model. Observations no track claims are clustered and
+// start tentative tracks, which are confirmed after confirm_hits updates
+// with observations. A track dies after coasting without observations for
+// coast_s (tentative ones after their first miss) or when it is only hit
+// sporadically (clutter), and tracks that converge are merged into the older
+// one.
+//
+// Capacity is fixed (max_tracks x max_observations), so an update costs
+// O(observations x tracks) at most and never allocates.
+
+struct DoaObservation
+{
+    float x, y, z;     // unit vector, x front, y left, z up
+    float weight;      // sldoa alpha or map peak
+};
+
+// Unit vector for a SAF azimuth / elevation pair in degrees
+DoaObservation doa_observation(float azimuth_deg, float elevation_deg, float weight);
+
+struct DoaTrack
+{
+    uint32_t id = 0;            // unique for the tracker's lifetime, from 1
+    float x = 1.0f, y = 0.0f, z = 0.0f;
+    float variance = 0.0f;      // rad^2
+    float strength = 0.0f;      // smoothed observation weight
+    float azimuth_deg = 0.0f;
+    float elevation_deg = 0.0f;
+    int hits = 0;               // updates with observations
+    int misses = 0;             // consecutive updates without
+    float presence = 1.0f;      // recent fraction of updates with observations
+    bool confirmed = false;
+};
+
+struct DoaTrackerConfig
+{
+    float gate_deg = 20.0f;          // association radius
+    float merge_deg = 8.0f;          // tracks closer than this are merged
+    float motion_deg_per_s = 60.0f;  // random-walk process noise
+    float measurement_deg = 12.0f;   // noise of one observation
+    float relative_threshold = 0.25f; // observations below this x the update's max weight are ignored
+    int min_cluster = 2;             // observations a hit / birth needs (sldoa: bands agreeing; 1 for a single peak)
+    int confirm_hits = 3;
+    float coast_s = 0.5f;            // confirmed tracks survive this long without observations
+    float min_presence = 0.15f;      // ... and die when hit less often than this (averaged over coast_s)
+};
+
+class DoaTracker
+{
+public:
+    static const int max_tracks = 8;
+    static const int max_observations = 256;
+
+    explicit DoaTracker(const DoaTrackerConfig& config = DoaTrackerConfig());
+
+    // One update, dt_s after the previous one. Observations beyond
+    // max_observations are ignored.
+    void update(const DoaObservation* observations, int num_observations, float dt_s);
+
+    // Live tracks, tentative ones included (check confirmed)
+    int num_tracks() const { return num_tracks_; }
+    const DoaTrack& track(int index) const { return tracks_[index]; }
+    int num_confirmed() const;
+
+    uint64_t births() const { return births_; }   // tracks confirmed so far
+    uint64_t deaths() const { return deaths_; }   // confirmed tracks ended so far
+
+    const DoaTrackerConfig& config() const { return config_; }
+
+private:
+    void remove(int index);
+    void finish(DoaTrack& t);
+
+    DoaTrackerConfig config_;
+    float cos_merge_;
+    float measurement_var_;
+    float motion_var_per_s_;
+
+    DoaTrack tracks_[max_tracks];
+    int num_tracks_ = 0;
+    uint32_t next_id_ = 1;
+    uint64_t births_ = 0;
+    uint64_t deaths_ = 0;
+
+    // Per-update scratch
+    int assigned_[max_observations];
+    float sum_[max_tracks][4]; // weighted x, y, z, weight
+    int count_[max_tracks];
+};
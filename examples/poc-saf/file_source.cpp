@@ -0,0 +1,163 @@
+#include "file_source.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint16_t read_u16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t read_u32(const uint8_t* p) { return (uint32_t)read_u16(p) | ((uint32_t)read_u16(p + 2) << 16); }
+static uint64_t read_u64(const uint8_t* p) { return (uint64_t)read_u32(p) | ((uint64_t)read_u32(p + 4) << 32); }
+
+static const uint16_t WAVE_FORMAT_PCM = 0x0001;
+static const uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+// Walks the RIFF/RF64 chunk list and fills in format and data location
+static bool parse_wav(FileSource& src, const uint8_t* file, size_t size)
+{
+    const bool rf64 = std::memcmp(file, "RF64", 4) == 0 || std::memcmp(file, "BW64", 4) == 0;
+    if (size < 12 || std::memcmp(file + 8, "WAVE", 4) != 0) {
+        std::cout << "Not a WAVE file." << std::endl;
+        return false;
+    }
+
+    uint64_t ds64_data_size = 0;
+    bool have_fmt = false;
+    int bits = 0, block_align = 0;
+    size_t pos = 12;
+
+    while (pos + 8 <= size) {
+        const uint8_t* chunk = file + pos;
+        uint64_t chunk_size = read_u32(chunk + 4);
+
+        if (std::memcmp(chunk, "ds64", 4) == 0 && chunk_size >= 16 && pos + 8 + 16 <= size) {
+            ds64_data_size = read_u64(chunk + 8 + 8);
+        } else if (std::memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16 && pos + 8 + 16 <= size) {
+            const uint8_t* fmt = chunk + 8;
+            uint16_t tag = read_u16(fmt);
+            src.channels = read_u16(fmt + 2);
+            src.sample_rate = (int)read_u32(fmt + 4);
+            block_align = read_u16(fmt + 12);
+            bits = read_u16(fmt + 14);
+            if (tag == WAVE_FORMAT_EXTENSIBLE && chunk_size >= 40 && pos + 8 + 40 <= size) {
+                tag = read_u16(fmt + 24); // first two bytes of the sub-format GUID
+            }
+            if (tag != WAVE_FORMAT_PCM) {
+                std::cout << "Unsupported WAV format tag " << tag << " (need integer PCM)." << std::endl;
+                return false;
+            }
+            have_fmt = true;
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            if (!have_fmt) {
+                std::cout << "WAV data chunk before fmt chunk." << std::endl;
+                return false;
+            }
+            if (rf64 && chunk_size == 0xFFFFFFFFu) chunk_size = ds64_data_size;
+            if (pos + 8 + chunk_size > size) chunk_size = size - pos - 8; // truncated recording
+
+            if (src.channels > 0 && bits == 24 && block_align == 3 * src.channels) {
+                src.format = SampleFormat::S24_3LE;
+            } else if (src.channels > 0 && bits == 32 && block_align == 4 * src.channels) {
+                src.format = SampleFormat::S32_LE;
+            } else {
+                std::cout << "Unsupported WAV sample layout: " << bits << " bits, block align "
+                          << block_align << " (need packed 24-bit or 32-bit)." << std::endl;
+                return false;
+            }
+            src.data = chunk + 8;
+            src.num_frames = chunk_size / block_align;
+            return true;
+        }
+        pos += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    std::cout << "WAV file has no data chunk." << std::endl;
+    return false;
+}
+
+bool file_source_open(FileSource& src, const char* path, const RawFormat* raw)
+{
+    src.fd = open(path, O_RDONLY);
+    if (src.fd < 0) {
+        std::cout << "Error opening " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(src.fd, &st) != 0 || st.st_size < 12) {
+        std::cout << "Error: " << path << " is empty or unreadable." << std::endl;
+        file_source_close(src);
+        return false;
+    }
+    src.map_size = (size_t)st.st_size;
+    src.map = mmap(nullptr, src.map_size, PROT_READ, MAP_PRIVATE, src.fd, 0);
+    if (src.map == MAP_FAILED) {
+        src.map = nullptr;
+        std::cout << "Error mapping " << path << ": " << strerror(errno) << std::endl;
+        file_source_close(src);
+        return false;
+    }
+    // We stream through the file once; let the kernel read ahead aggressively
+    madvise(src.map, src.map_size, MADV_SEQUENTIAL);
+
+    const uint8_t* file = (const uint8_t*)src.map;
+    bool ok;
+    if (std::memcmp(file, "RIFF", 4) == 0 || std::memcmp(file, "RF64", 4) == 0 || std::memcmp(file, "BW64", 4) == 0) {
+        ok = parse_wav(src, file, src.map_size);
+    } else if (raw) {
+        src.format = raw->format;
+        src.channels = raw->channels;
+        src.sample_rate = raw->sample_rate;
+        src.data = file;
+        src.num_frames = src.map_size / ((size_t)raw->channels * sample_format_bytes(raw->format));
+        ok = true;
+    } else {
+        std::cout << "Error: " << path << " has no WAV header and no raw format was given." << std::endl;
+        ok = false;
+    }
+
+    if (!ok) file_source_close(src);
+    return ok;
+}
+
+void file_source_close(FileSource& src)
+{
+    if (src.map) munmap(src.map, src.map_size);
+    if (src.fd >= 0) close(src.fd);
+    src = FileSource();
+}
+
+// Page-aligned part of the mapping covering the frames (inner: only pages
+// entirely inside them, so a neighbouring segment's pages stay mapped)
+static bool frame_pages(const FileSource& src, uint64_t frame, uint64_t num_frames, bool inner,
+                        uint8_t*& start, size_t& length)
+{
+    if (!src.map || num_frames == 0) return false;
+    const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t first = (uintptr_t)file_source_frame(src, frame);
+    uintptr_t last = (uintptr_t)file_source_frame(src, frame + num_frames);
+    first = inner ? (first + page - 1) & ~(page - 1) : first & ~(page - 1);
+    last = inner ? last & ~(page - 1) : (last + page - 1) & ~(page - 1);
+    last = std::min(last, ((uintptr_t)src.map + src.map_size + page - 1) & ~(page - 1));
+    if (last <= first) return false;
+    start = (uint8_t*)first;
+    length = last - first;
+    return true;
+}
+
+void file_source_prefetch(const FileSource& src, uint64_t frame, uint64_t num_frames)
+{
+    uint8_t* start;
+    size_t length;
+    if (frame_pages(src, frame, num_frames, false, start, length)) madvise(start, length, MADV_WILLNEED);
+}
+
+void file_source_release(const FileSource& src, uint64_t frame, uint64_t num_frames)
+{
+    uint8_t* start;
+    size_t length;
+    if (frame_pages(src, frame, num_frames, true, start, length)) madvise(start, length, MADV_DONTNEED);
+}
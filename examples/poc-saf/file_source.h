@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "sample_convert.h"
+
+// Memory-mapped multichannel recording (WAV, RF64 or headerless raw PCM).
+// The sample data is never copied: `data` points into the mapping and is fed
+// directly to the conversion kernels.
+struct FileSource
+{
+    int fd = -1;
+    void* map = nullptr;
+    size_t map_size = 0;
+
+    const uint8_t* data = nullptr; // first frame
+    uint64_t num_frames = 0;
+    int channels = 0;
+    int sample_rate = 0;
+    SampleFormat format = SampleFormat::S24_3LE;
+};
+
+// Settings for headerless files. WAV/RF64 files carry their own.
+struct RawFormat
+{
+    SampleFormat format = SampleFormat::S24_3LE;
+    int channels = 19;
+    int sample_rate = 48000;
+};
+
+// Opens and maps `path`. Files starting with a RIFF/RF64 header are parsed,
+// anything else is treated as raw PCM described by `raw` (nullptr rejects raw).
+bool file_source_open(FileSource& src, const char* path, const RawFormat* raw);
+void file_source_close(FileSource& src);
+
+// Batch access to parts of a file: read [frame, frame + num_frames) ahead,
+// and drop it from the mapping once done, so a process working through
+// large files keeps only the part it is on resident
+void file_source_prefetch(const FileSource& src, uint64_t frame, uint64_t num_frames);
+void file_source_release(const FileSource& src, uint64_t frame, uint64_t num_frames);
+
+// Interleaved bytes of frame `frame`
+inline const uint8_t* file_source_frame(const FileSource& src, uint64_t frame)
+{
+    return src.data + frame * (uint64_t)(src.channels * sample_format_bytes(src.format));
+}
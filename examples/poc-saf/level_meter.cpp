@@ -0,0 +1,77 @@
+#include "level_meter.h"
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static float power_to_db(float power)
+{
+    return power > 1e-12f ? 10.0f * log10f(power) : LevelMeter::floor_db;
+}
+
+void measure_levels(const float* const* x, int num_channels, int num_frames, LevelAccum* acc)
+{
+    for (int ch = 0; ch < num_channels; ++ch) {
+        const float* in = x[ch];
+        int f = 0;
+        float peak = 0.0f;
+        float sum_sq = 0.0f;
+#if defined(__SSE2__)
+        // 4 lanes; the lanes are only combined once per channel
+        const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        __m128 vpeak = _mm_setzero_ps();
+        __m128 vsq = _mm_setzero_ps();
+        for (; f + 4 <= num_frames; f += 4) {
+            __m128 v = _mm_loadu_ps(in + f);
+            vpeak = _mm_max_ps(vpeak, _mm_and_ps(v, abs_mask));
+            vsq = _mm_add_ps(vsq, _mm_mul_ps(v, v));
+        }
+        alignas(16) float lanes_peak[4], lanes_sq[4];
+        _mm_store_ps(lanes_peak, vpeak);
+        _mm_store_ps(lanes_sq, vsq);
+        for (int i = 0; i < 4; ++i) {
+            peak = std::max(peak, lanes_peak[i]);
+            sum_sq += lanes_sq[i];
+        }
+#endif
+        for (; f < num_frames; ++f) {
+            peak = std::max(peak, std::fabs(in[f]));
+            sum_sq += in[f] * in[f];
+        }
+        acc[ch].add(peak, sum_sq);
+    }
+}
+
+LevelMeter::LevelMeter(int num_channels, int sample_rate, float release_s)
+    : num_channels_(std::min(num_channels, max_channels)),
+      sample_rate_(sample_rate),
+      release_s_(release_s)
+{
+    for (int ch = 0; ch < max_channels; ++ch) {
+        peak_[ch].store(0.0f, std::memory_order_relaxed);
+        rms_[ch].store(0.0f, std::memory_order_relaxed);
+        smoothed_db_[ch].store(floor_db, std::memory_order_relaxed);
+    }
+}
+
+void LevelMeter::update(const LevelAccum* acc, int num_frames)
+{
+    if (num_frames <= 0) return;
+
+    // Release coefficient for this block length
+    const float release = expf(-(float)num_frames / (release_s_ * sample_rate_));
+    float total_power = 0.0f;
+
+    for (int ch = 0; ch < num_channels_; ++ch) {
+        float power = acc[ch].sum_sq / num_frames;
+        total_power += power;
+        smoothed_pow_[ch] = std::max(power, smoothed_pow_[ch] * release);
+
+        peak_[ch].store(acc[ch].peak, std::memory_order_relaxed);
+        rms_[ch].store(sqrtf(power), std::memory_order_relaxed);
+        smoothed_db_[ch].store(power_to_db(smoothed_pow_[ch]), std::memory_order_relaxed);
+    }
+    mean_db_.store(power_to_db(total_power / num_channels_), std::memory_order_relaxed);
+    updates_.fetch_add(1, std::memory_order_relaxed);
+}
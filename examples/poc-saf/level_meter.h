@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+// Per-channel peak and sum of squares collected while the samples are
+// produced (see convert_to_float_channels() and measure_levels()), so that
+// metering rarely needs its own pass over the audio.
+struct LevelAccum
+{
+    float peak = 0.0f;   // max |x|
+    float sum_sq = 0.0f; // sum of x^2
+
+    void add(float block_peak, float block_sum_sq)
+    {
+        peak = std::max(peak, block_peak);
+        sum_sq += block_sum_sq;
+    }
+};
+
+// Accumulates the levels of `num_frames` planar floats per channel into acc[ch].
+void measure_levels(const float* const* x, int num_channels, int num_frames, LevelAccum* acc);
+
+// Published channel levels. One thread calls update() once per block, any
+// thread may read. Each value is a relaxed atomic, so a reader may see
+// channels from two consecutive blocks, which is fine for metering.
+//
+// The smoothed level follows the RMS power with instant attack and an
+// exponential release, like a meter needle.
+class LevelMeter
+{
+public:
+    static const int max_channels = 32;
+    static constexpr float floor_db = -120.0f;
+
+    LevelMeter(int num_channels, int sample_rate, float release_s = 0.3f);
+
+    LevelMeter(const LevelMeter&) = delete;
+    LevelMeter& operator=(const LevelMeter&) = delete;
+
+    // Writer: publishes one block's accumulated levels
+    void update(const LevelAccum* acc, int num_frames);
+
+    // Readers (any thread)
+    int channels() const { return num_channels_; }
+    float peak(int ch) const { return peak_[ch].load(std::memory_order_relaxed); } // linear, last block
+    float rms(int ch) const { return rms_[ch].load(std::memory_order_relaxed); }   // linear, last block
+    float smoothed_db(int ch) const { return smoothed_db_[ch].load(std::memory_order_relaxed); }
+    float mean_db() const { return mean_db_.load(std::memory_order_relaxed); } // power averaged over channels
+    uint64_t updates() const { return updates_.load(std::memory_order_relaxed); }
+
+private:
+    const int num_channels_;
+    const int sample_rate_;
+    const float release_s_;
+
+    // Writer-only state
+    float smoothed_pow_[max_channels] = {};
+
+    std::atomic<float> peak_[max_channels];
+    std::atomic<float> rms_[max_channels];
+    std::atomic<float> smoothed_db_[max_channels];
+    std::atomic<float> mean_db_{floor_db};
+    std::atomic<uint64_t> updates_{0};
+};
+
+inline float level_to_db(float amplitude)
+{
+    return amplitude > 1e-6f ? 20.0f * log10f(amplitude) : LevelMeter::floor_db;
+}
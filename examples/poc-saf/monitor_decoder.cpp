@@ -0,0 +1,402 @@
+#include "monitor_decoder.h"
+#include "doa_engine.h"
+#include "stage_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// SAF framework includes
+#include "saf.h"
+
+typedef std::complex<double> cdouble;
+
+// Above c * order / (2 pi r_head) an SH representation of that order cannot
+// follow the HRTF phase across the head; MagLS takes over there
+const double head_radius_m = 0.0875;
+const double speed_of_sound = 343.0;
+
+const char* monitor_mode_name(MonitorMode mode)
+{
+    return mode == MonitorMode::Stereo ? "stereo" : "binaural";
+}
+
+bool monitor_mode_from_name(const char* name, MonitorMode& mode)
+{
+    const MonitorMode modes[] = {MonitorMode::Stereo, MonitorMode::Binaural};
+    for (MonitorMode m : modes) {
+        if (std::strcmp(name, monitor_mode_name(m)) != 0) continue;
+        mode = m;
+        return true;
+    }
+    return false;
+}
+
+// Least-squares decoder of the SH basis sampled at n directions:
+// d = (Y'Y)^-1 Y', with y (n x num_sh, row-major) -> d (num_sh x n).
+// Y'Y is small and positive definite for a full-sphere set; a little
+// diagonal loading keeps it so for sparse ones.
+static bool pseudo_inverse(const std::vector<double>& y, int n, int num_sh, std::vector<double>& d)
+{
+    std::vector<double> g((size_t)num_sh * num_sh, 0.0), l((size_t)num_sh * num_sh, 0.0);
+    for (int i = 0; i < n; ++i) {
+        for (int a = 0; a < num_sh; ++a) {
+            for (int b = 0; b < num_sh; ++b) g[a * num_sh + b] += y[(size_t)i * num_sh + a] * y[(size_t)i * num_sh + b];
+        }
+    }
+    double trace = 0.0;
+    for (int a = 0; a < num_sh; ++a) trace += g[a * num_sh + a];
+    for (int a = 0; a < num_sh; ++a) g[a * num_sh + a] += 1e-6 * trace / num_sh;
+
+    // Cholesky, then two triangular solves per direction
+    for (int j = 0; j < num_sh; ++j) {
+        double s = g[j * num_sh + j];
+        for (int k = 0; k < j; ++k) s -= l[j * num_sh + k] * l[j * num_sh + k];
+        if (!(s > 0.0)) return false;
+        l[j * num_sh + j] = std::sqrt(s);
+        for (int i = j + 1; i < num_sh; ++i) {
+            double t = g[i * num_sh + j];
+            for (int k = 0; k < j; ++k) t -= l[i * num_sh + k] * l[j * num_sh + k];
+            l[i * num_sh + j] = t / l[j * num_sh + j];
+        }
+    }
+    d.assign((size_t)num_sh * n, 0.0);
+    std::vector<double> x(num_sh);
+    for (int i = 0; i < n; ++i) {
+        for (int a = 0; a < num_sh; ++a) {
+            double t = y[(size_t)i * num_sh + a];
+            for (int k = 0; k < a; ++k) t -= l[a * num_sh + k] * x[k];
+            x[a] = t / l[a * num_sh + a];
+        }
+        for (int a = num_sh - 1; a >= 0; --a) {
+            double t = x[a];
+            for (int k = a + 1; k < num_sh; ++k) t -= l[k * num_sh + a] * x[k];
+            x[a] = t / l[a * num_sh + a];
+        }
+        for (int a = 0; a < num_sh; ++a) d[(size_t)a * n + i] = x[a];
+    }
+    return true;
+}
+
+// === Complex multiply-add kernels ===
+// The spectra are SAF's interleaved (re, im) pairs, so the vector kernels
+// duplicate a's real and imaginary parts across each pair and multiply by b
+// and by b with re / im swapped: re = ar br - ai bi, im = ar bi + ai br.
+
+static void complex_mac_scalar(float* acc, const float* a, const float* b, int num_bins)
+{
+    for (int k = 0; k < 2 * num_bins; k += 2) {
+        const float ar = a[k], ai = a[k + 1], br = b[k], bi = b[k + 1];
+        acc[k] += ar * br - ai * bi;
+        acc[k + 1] += ar * bi + ai * br;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Two bins per vector; no addsub in SSE2, so a sign flip on the real lanes
+__attribute__((target("sse2")))
+static void complex_mac_sse2(float* acc, const float* a, const float* b, int num_bins)
+{
+    const __m128 negate_re = _mm_castsi128_ps(_mm_setr_epi32((int)0x80000000, 0, (int)0x80000000, 0));
+    const int n = 2 * num_bins;
+    int k = 0;
+    for (; k + 4 <= n; k += 4) {
+        __m128 va = _mm_loadu_ps(a + k), vb = _mm_loadu_ps(b + k);
+        __m128 re = _mm_shuffle_ps(va, va, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128 im = _mm_shuffle_ps(va, va, _MM_SHUFFLE(3, 3, 1, 1));
+        __m128 swapped = _mm_shuffle_ps(vb, vb, _MM_SHUFFLE(2, 3, 0, 1));
+        __m128 sum = _mm_add_ps(_mm_mul_ps(re, vb), _mm_xor_ps(_mm_mul_ps(im, swapped), negate_re));
+        _mm_storeu_ps(acc + k, _mm_add_ps(_mm_loadu_ps(acc + k), sum));
+    }
+    for (; k < n; k += 2) {
+        const float ar = a[k], ai = a[k + 1], br = b[k], bi = b[k + 1];
+        acc[k] += ar * br - ai * bi;
+        acc[k + 1] += ar * bi + ai * br;
+    }
+}
+
+// Four bins per vector; fmaddsub subtracts on the real lanes, adds on the
+// imaginary ones
+__attribute__((target("avx2,fma")))
+static void complex_mac_avx2(float* acc, const float* a, const float* b, int num_bins)
+{
+    const int n = 2 * num_bins;
+    int k = 0;
+    for (; k + 8 <= n; k += 8) {
+        __m256 va = _mm256_loadu_ps(a + k), vb = _mm256_loadu_ps(b + k);
+        __m256 re = _mm256_moveldup_ps(va);
+        __m256 im = _mm256_movehdup_ps(va);
+        __m256 swapped = _mm256_permute_ps(vb, _MM_SHUFFLE(2, 3, 0, 1));
+        __m256 sum = _mm256_fmaddsub_ps(re, vb, _mm256_mul_ps(im, swapped));
+        _mm256_storeu_ps(acc + k, _mm256_add_ps(_mm256_loadu_ps(acc + k), sum));
+    }
+    for (; k < n; k += 2) {
+        const float ar = a[k], ai = a[k + 1], br = b[k], bi = b[k + 1];
+        acc[k] += ar * br - ai * bi;
+        acc[k + 1] += ar * bi + ai * br;
+    }
+}
+#endif
+
+MonitorDecoder::MonitorDecoder(int order, int block_frames, MonitorMode mode)
+    : order_(std::min(std::max(order, 1), max_order)),
+      num_sh_((order_ + 1) * (order_ + 1)),
+      block_(block_frames),
+      mode_(mode),
+      fft_size_(2 * block_frames),
+      num_bins_(block_frames + 1),
+      simd_level_(cpu_simd_level()),
+      mac_(complex_mac_scalar)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (simd_level_ >= SimdLevel::AVX2 && !__builtin_cpu_supports("fma")) simd_level_ = SimdLevel::SSE2;
+    switch (simd_level_) {
+        case SimdLevel::AVX512:
+        case SimdLevel::AVX2:
+            mac_ = complex_mac_avx2;
+            break;
+        case SimdLevel::SSE2:
+            mac_ = complex_mac_sse2;
+            break;
+        default:
+            break;
+    }
+#endif
+}
+
+MonitorDecoder::~MonitorDecoder()
+{
+    if (fft_) saf_rfft_destroy(&fft_);
+}
+
+bool MonitorDecoder::prepare(int sample_rate, float gain_db, int max_taps)
+{
+    gain_ = powf(10.0f, gain_db / 20.0f);
+    const float block_ns = 1e9f * block_ / sample_rate;
+    if (mode_ == MonitorMode::Stereo) {
+        // Cardioid towards azimuth a: 0.5 (W + cos(a) X + sin(a) Y), with
+        // SN3D first order = direction cosines; a = +90 (left), -90 (right)
+        mix_[0][0] = mix_[1][0] = 0.5f * gain_;
+        mix_[0][1] = 0.5f * gain_;
+        mix_[1][1] = -0.5f * gain_;
+        partitions_ = designed_partitions_ = 0;
+        load_ = time_blocks(64) / block_ns;
+        return true;
+    }
+
+    if (!design_binaural(sample_rate)) return false;
+
+    // Shorter filters drop the tail partitions; the FDL keeps its designed
+    // size. Timed once on noise for the report, then the state is cleared.
+    if (max_taps > 0) partitions_ = std::min(designed_partitions_, std::max(1, (max_taps + block_ - 1) / block_));
+    load_ = time_blocks(64) / block_ns;
+    std::memset(fdl_, 0, sizeof(float) * 2 * num_bins_ * num_sh_ * designed_partitions_);
+    for (int n = 0; n < num_sh_; ++n) std::memset(history_[n], 0, sizeof(float) * block_);
+    fdl_slot_ = 0;
+    return true;
+}
+
+// SH-domain HRTF filters from SAF's default HRIR set, at twice the HRIR
+// length (so the design has room for the MagLS phase), cut into block-sized
+// partitions and transformed once
+bool MonitorDecoder::design_binaural(int sample_rate)
+{
+    const int num_dirs = __default_N_hrir_dirs;
+    const int hrir_len = __default_hrir_len;
+    if (__default_hrir_fs != sample_rate) {
+        std::cout << "Binaural monitor: the HRIRs are sampled at " << __default_hrir_fs << " Hz, the stream runs at "
+                  << sample_rate << " Hz" << std::endl;
+        return false;
+    }
+    int design_size = fft_size_;
+    while (design_size < 2 * hrir_len) design_size *= 2;
+    const int design_bins = design_size / 2 + 1;
+
+    // SH basis at the HRIR directions and its least-squares inverse
+    std::vector<double> y((size_t)num_dirs * num_sh_), d;
+    for (int i = 0; i < num_dirs; ++i) {
+        const float azi = __default_hrir_dirs_deg[i][0] * (float)M_PI / 180.0f;
+        const float elev = __default_hrir_dirs_deg[i][1] * (float)M_PI / 180.0f;
+        float basis[max_sh];
+        sn3d_sh(cosf(azi) * cosf(elev), sinf(azi) * cosf(elev), sinf(elev), order_, basis);
+        for (int n = 0; n < num_sh_; ++n) y[(size_t)i * num_sh_ + n] = basis[n];
+    }
+    if (!pseudo_inverse(y, num_dirs, num_sh_, d)) {
+        std::cout << "Binaural monitor: the HRIR directions do not cover the sphere" << std::endl;
+        return false;
+    }
+
+    void* design_fft = nullptr;
+    saf_rfft_create(&design_fft, design_size);
+    std::vector<float> frame(design_size);
+    std::vector<std::complex<float>> spectrum(design_bins);
+
+    // HRTFs: [ear][direction][bin]
+    std::vector<cdouble> hrtf((size_t)2 * num_dirs * design_bins);
+    for (int ear = 0; ear < 2; ++ear) {
+        for (int i = 0; i < num_dirs; ++i) {
+            std::fill(frame.begin(), frame.end(), 0.0f);
+            std::memcpy(frame.data(), __default_hrirs[i][ear], sizeof(float) * hrir_len);
+            saf_rfft_forward(design_fft, frame.data(), (float_complex*)spectrum.data());
+            cdouble* h = &hrtf[((size_t)ear * num_dirs + i) * design_bins];
+            for (int k = 0; k < design_bins; ++k) h[k] = cdouble(spectrum[k].real(), spectrum[k].imag());
+        }
+    }
+
+    // Per ear and bin, num_sh filter coefficients. Least squares below the
+    // cutoff; above it only the magnitude is fitted, with the phase the
+    // previous bin's filters produce at each direction (MagLS).
+    const double cutoff_hz = speed_of_sound * order_ / (2.0 * M_PI * head_radius_m);
+    const int cutoff_bin = std::max(1, (int)(cutoff_hz * design_size / sample_rate));
+    std::vector<float> taps((size_t)2 * num_sh_ * design_size);
+    std::vector<cdouble> coeffs((size_t)design_bins * num_sh_), target(num_dirs);
+    for (int ear = 0; ear < 2; ++ear) {
+        const cdouble* h = &hrtf[(size_t)ear * num_dirs * design_bins];
+        for (int k = 0; k < design_bins; ++k) {
+            cdouble* c = &coeffs[(size_t)k * num_sh_];
+            for (int i = 0; i < num_dirs; ++i) {
+                target[i] = h[(size_t)i * design_bins + k];
+                if (k < cutoff_bin) continue;
+                const cdouble* prev = c - num_sh_;
+                cdouble est = 0.0;
+                for (int n = 0; n < num_sh_; ++n) est += prev[n] * y[(size_t)i * num_sh_ + n];
+                target[i] = std::polar(std::abs(target[i]), std::arg(est));
+            }
+            for (int n = 0; n < num_sh_; ++n) {
+                cdouble sum = 0.0;
+                for (int i = 0; i < num_dirs; ++i) sum += d[(size_t)n * num_dirs + i] * target[i];
+                c[n] = sum;
+            }
+            // DC and Nyquist of a real filter
+            if (k == 0 || k == design_bins - 1) {
+                for (int n = 0; n < num_sh_; ++n) c[n] = cdouble(c[n].real(), 0.0);
+            }
+        }
+
+        // Back to the time domain, with a short fade at the end of the design
+        // window against the circular wrap of the MagLS phase
+        for (int n = 0; n < num_sh_; ++n) {
+            for (int k = 0; k < design_bins; ++k) {
+                spectrum[k] = std::complex<float>((float)coeffs[(size_t)k * num_sh_ + n].real(),
+                                                  (float)coeffs[(size_t)k * num_sh_ + n].imag());
+            }
+            float* t = &taps[((size_t)ear * num_sh_ + n) * design_size];
+            saf_rfft_backward(design_fft, (float_complex*)spectrum.data(), t);
+            const int fade = design_size / 8;
+            for (int j = 0; j < fade; ++j) {
+                t[design_size - fade + j] *= 0.5f * (1.0f + cosf((float)M_PI * (j + 1) / fade));
+            }
+        }
+    }
+    saf_rfft_destroy(&design_fft);
+
+    // Partitioned spectra at the block FFT size, with the gain folded in
+    designed_partitions_ = partitions_ = design_size / block_;
+    const size_t spectrum_floats = 2 * (size_t)num_bins_;
+    int filters_handle = arena_.add_bytes(sizeof(float) * spectrum_floats * 2 * num_sh_ * partitions_);
+    int fdl_handle = arena_.add_bytes(sizeof(float) * spectrum_floats * num_sh_ * partitions_);
+    int accum_handle = arena_.add_bytes(sizeof(float) * spectrum_floats * 2);
+    int time_handle = arena_.add_bytes(sizeof(float) * fft_size_);
+    int history_handle = arena_.add_channels(num_sh_, block_);
+    if (!arena_.allocate()) {
+        std::cout << "Binaural monitor: cannot allocate the filters" << std::endl;
+        return false;
+    }
+    filters_ = (float*)arena_.bytes(filters_handle);
+    fdl_ = (float*)arena_.bytes(fdl_handle);
+    accum_ = (float*)arena_.bytes(accum_handle);
+    time_ = (float*)arena_.bytes(time_handle);
+    history_ = arena_.channels(history_handle);
+
+    saf_rfft_create(&fft_, fft_size_);
+    for (int p = 0; p < partitions_; ++p) {
+        for (int ear = 0; ear < 2; ++ear) {
+            for (int n = 0; n < num_sh_; ++n) {
+                // Overlap-save: the partition's taps, then zeros
+                const float* t = &taps[((size_t)ear * num_sh_ + n) * design_size + (size_t)p * block_];
+                for (int j = 0; j < block_; ++j) time_[j] = gain_ * t[j];
+                std::memset(time_ + block_, 0, sizeof(float) * block_);
+                float* dst = filters_ + ((size_t)(p * 2 + ear) * num_sh_ + n) * spectrum_floats;
+                saf_rfft_forward(fft_, time_, (float_complex*)dst);
+            }
+        }
+    }
+    return true;
+}
+
+// Median cost of one block in ns, on deterministic noise
+float MonitorDecoder::time_blocks(int num_blocks)
+{
+    std::vector<float> input((size_t)num_sh_ * block_), output((size_t)num_outputs * block_);
+    uint32_t state = 12345;
+    for (float& x : input) {
+        state = state * 1664525u + 1013904223u;
+        x = (float)(int32_t)state / 2147483648.0f * 0.1f;
+    }
+    const float* sh[max_sh];
+    float* out[num_outputs];
+    for (int n = 0; n < num_sh_; ++n) sh[n] = &input[(size_t)n * block_];
+    for (int e = 0; e < num_outputs; ++e) out[e] = &output[(size_t)e * block_];
+
+    std::vector<uint64_t> times(num_blocks);
+    for (int i = 0; i < num_blocks; ++i) {
+        uint64_t start = monotonic_ns();
+        process(sh, out);
+        times[i] = monotonic_ns() - start;
+    }
+    std::sort(times.begin(), times.end());
+    return (float)times[num_blocks / 2];
+}
+
+void MonitorDecoder::process(const float* const* sh, float* const* out)
+{
+    if (mode_ == MonitorMode::Binaural) {
+        process_binaural(sh, out);
+        return;
+    }
+    for (int e = 0; e < num_outputs; ++e) {
+        const float w = mix_[e][0], y = mix_[e][1];
+        const float* s0 = sh[0];
+        const float* s1 = sh[1];
+        float* o = out[e];
+        for (int t = 0; t < block_; ++t) o[t] = w * s0[t] + y * s1[t];
+    }
+}
+
+void MonitorDecoder::process_binaural(const float* const* sh, float* const* out)
+{
+    const size_t spectrum_floats = 2 * (size_t)num_bins_;
+    const int slots = designed_partitions_;
+
+    // Newest input spectra: previous block + this block per SH channel
+    fdl_slot_ = (fdl_slot_ + 1) % slots;
+    for (int n = 0; n < num_sh_; ++n) {
+        std::memcpy(time_, history_[n], sizeof(float) * block_);
+        std::memcpy(time_ + block_, sh[n], sizeof(float) * block_);
+        std::memcpy(history_[n], sh[n], sizeof(float) * block_);
+        saf_rfft_forward(fft_, time_, (float_complex*)(fdl_ + ((size_t)fdl_slot_ * num_sh_ + n) * spectrum_floats));
+    }
+
+    // Partition p meets the input from p blocks ago
+    for (int ear = 0; ear < num_outputs; ++ear) {
+        float* acc = accum_ + ear * spectrum_floats;
+        std::memset(acc, 0, sizeof(float) * spectrum_floats);
+        for (int p = 0; p < partitions_; ++p) {
+            const int slot = (fdl_slot_ - p + slots) % slots;
+            const float* filters = filters_ + (size_t)(p * 2 + ear) * num_sh_ * spectrum_floats;
+            const float* inputs = fdl_ + (size_t)slot * num_sh_ * spectrum_floats;
+            for (int n = 0; n < num_sh_; ++n) {
+                mac_(acc, filters + n * spectrum_floats, inputs + n * spectrum_floats, num_bins_);
+            }
+        }
+        // The second half is the valid part of the circular convolution
+        saf_rfft_backward(fft_, (float_complex*)acc, time_);
+        std::memcpy(out[ear], time_ + block_, sizeof(float) * block_);
+    }
+}
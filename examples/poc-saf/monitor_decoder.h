@@ -0,0 +1,95 @@
+#pragma once
+
+#include "buffer_arena.h"
+#include "cpu_features.h"
+
+// Headphone monitoring of the SH stream: decodes the ACN/SN3D signals of
+// array2sh to two channels, block by block, on the DSP thread.
+//
+//   Binaural: one FIR per (ear, SH channel), designed once in prepare() from
+//             SAF's default HRIR set: least squares onto the SH basis at low
+//             frequencies and magnitude least squares (MagLS) above ~2 kHz,
+//             where order 3 cannot match the HRTF phase anyway. The 16 x 2
+//             filters run as a uniformly partitioned overlap-save convolution
+//             with the block as partition: one 2-block FFT per SH channel,
+//             a complex multiply-add per partition, one inverse FFT per ear.
+//   Stereo:   two first-order cardioids at +-90 degrees, a plain mix.
+//
+// The work per block is the same for every block (no data-dependent paths,
+// nothing allocated). The filter length is fixed by the caller, not by a
+// timing at startup, so the same options always give the same decoder;
+// prepare() still times it once for the report.
+
+enum class MonitorMode
+{
+    Stereo,
+    Binaural
+};
+
+const char* monitor_mode_name(MonitorMode mode);
+bool monitor_mode_from_name(const char* name, MonitorMode& mode);
+
+class MonitorDecoder
+{
+public:
+    static const int max_order = 3;
+    static const int max_sh = (max_order + 1) * (max_order + 1);
+    static const int num_outputs = 2;
+
+    // order 1..max_order; block_frames is the SAF frame size (a power of 2)
+    MonitorDecoder(int order, int block_frames, MonitorMode mode);
+    ~MonitorDecoder();
+
+    MonitorDecoder(const MonitorDecoder&) = delete;
+    MonitorDecoder& operator=(const MonitorDecoder&) = delete;
+
+    // Designs the filters and allocates every buffer. Binaural: max_taps > 0
+    // cuts the filters to that many taps (whole blocks, rounded up), dropping
+    // the HRIR tail; 0 keeps the designed length. False (with a message) if
+    // the HRIRs do not match sample_rate or memory runs out.
+    bool prepare(int sample_rate, float gain_db = 0.0f, int max_taps = 0);
+
+    // One block: sh (num_sh x block_frames) -> out (2 x block_frames)
+    void process(const float* const* sh, float* const* out);
+
+    MonitorMode mode() const { return mode_; }
+    int partitions() const { return partitions_; }   // binaural: filter length in blocks
+    int designed_partitions() const { return designed_partitions_; }
+    float load() const { return load_; }             // measured per-block cost / block duration
+    SimdLevel simd_level() const { return simd_level_; }
+
+    // acc += a * b over num_bins interleaved complex values (re, im)
+    typedef void (*ComplexMacKernel)(float* acc, const float* a, const float* b, int num_bins);
+
+private:
+    bool design_binaural(int sample_rate);
+    void process_binaural(const float* const* sh, float* const* out);
+    float time_blocks(int num_blocks);
+
+    const int order_;
+    const int num_sh_;
+    const int block_;
+    const MonitorMode mode_;
+    const int fft_size_;                 // 2 * block
+    const int num_bins_;                 // block + 1
+    SimdLevel simd_level_;
+    ComplexMacKernel mac_;
+
+    float gain_ = 1.0f;
+    float load_ = 0.0f;
+    int partitions_ = 0;
+    int designed_partitions_ = 0;
+
+    // Stereo: out[e] = sum_n mix_[e][n] sh[n]
+    float mix_[num_outputs][max_sh] = {};
+
+    // Binaural. Spectra are interleaved re/im, num_bins complex values each.
+    void* fft_ = nullptr;                // saf_rfft of fft_size
+    BufferArena arena_;
+    float* filters_ = nullptr;           // [partition][ear][sh] spectra
+    float* fdl_ = nullptr;               // [slot][sh] input spectra, a ring of `partitions` slots
+    int fdl_slot_ = 0;                   // slot of the newest block
+    float** history_ = nullptr;          // per SH channel: previous block + current block
+    float* accum_ = nullptr;             // [ear] output spectra
+    float* time_ = nullptr;              // fft_size samples of scratch
+};
@@ -0,0 +1,193 @@
+#include "monitor_output.h"
+#include "spsc_ring.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+const int monitor_channels = 2;
+
+// Float sample -> left-justified 32-bit, clipped
+static inline int32_t to_s32(float x)
+{
+    x = std::min(std::max(x, -1.0f), 0.99999994f);
+    return (int32_t)lrintf(x * 2147483648.0f);
+}
+
+// frames of the two planar monitor channels -> interleaved device frames.
+// Extra device channels stay silent.
+static void interleave(const float* const* src, int offset, int frames, const PlaybackDevice& dev, uint8_t* dst)
+{
+    const int bytes = snd_pcm_format_physical_width(dev.alsa_format) / 8;
+    for (int f = 0; f < frames; ++f) {
+        for (int ch = 0; ch < dev.channels; ++ch) {
+            int32_t v = ch < monitor_channels ? to_s32(src[ch][offset + f]) : 0;
+            switch (dev.alsa_format) {
+                case SND_PCM_FORMAT_S16_LE: {
+                    int16_t s = (int16_t)(v >> 16);
+                    std::memcpy(dst, &s, 2);
+                    break;
+                }
+                case SND_PCM_FORMAT_S24_3LE:
+                    dst[0] = (uint8_t)(v >> 8);
+                    dst[1] = (uint8_t)(v >> 16);
+                    dst[2] = (uint8_t)(v >> 24);
+                    break;
+                case SND_PCM_FORMAT_S24_LE:
+                    v >>= 8;
+                    std::memcpy(dst, &v, 4);
+                    break;
+                default:
+                    std::memcpy(dst, &v, 4);
+                    break;
+            }
+            dst += bytes;
+        }
+    }
+}
+
+static void count(std::atomic<uint64_t>& counter, uint64_t n)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+static void playback_main(MonitorOutput* m)
+{
+    if (m->config.rt.priority > 0 || m->config.rt.cpu >= 0) {
+        m->rt_applied.store(rt_apply_thread("monitor", m->config.rt));
+    }
+    const PlaybackDevice& dev = m->device;
+    const int period = (int)dev.period_frames;
+    const int block = m->block_frames;
+    const size_t frame_bytes = (size_t)pcm_device_frame_bytes(dev);
+    SpscFrameRing& ring = *m->ring;
+
+    const float* src[monitor_channels] = {};
+    int block_pos = -1;    // read position in the current ring block, -1 = none
+    bool starved = true;   // refilling to the target; silence until then
+
+    while (m->running.load(std::memory_order_relaxed)) {
+        int fill = ring.fill();
+        if (fill > m->max_fill.load(std::memory_order_relaxed)) m->max_fill.store(fill, std::memory_order_relaxed);
+        if (starved && fill >= m->target_frames) starved = false;
+
+        // Capture clock faster than ours: give back a block to hold the latency
+        if (!starved && block_pos < 0 && fill > 2 * m->target_frames + block && ring.read_block(src, block)) {
+            ring.release(block);
+            count(m->skipped_blocks, 1);
+        }
+
+        // One period out of the ring, block by block
+        int done = 0;
+        while (!starved && done < period) {
+            if (block_pos < 0) {
+                if (!ring.read_block(src, block)) {
+                    starved = true;
+                    break;
+                }
+                block_pos = 0;
+            }
+            int n = std::min(block - block_pos, period - done);
+            interleave(src, block_pos, n, dev, m->period_buffer + done * frame_bytes);
+            done += n;
+            block_pos += n;
+            if (block_pos == block) {
+                ring.release(block);
+                block_pos = -1;
+            }
+        }
+        if (done < period) {
+            std::memset(m->period_buffer + done * frame_bytes, 0, (period - done) * frame_bytes);
+            count(m->silent_frames, (uint64_t)(period - done));
+        }
+
+        // Blocks until the device has room for the period
+        snd_pcm_sframes_t written = snd_pcm_writei(dev.pcm, m->period_buffer, period);
+        if (written == -EPIPE || written == -ESTRPIPE) {
+            count(m->underruns, 1);
+            int err = snd_pcm_recover(dev.pcm, (int)written, 1);
+            if (err < 0) {
+                std::cerr << "Monitor: ALSA recovery failed: " << snd_strerror(err) << std::endl;
+                break;
+            }
+        } else if (written < 0) {
+            std::cerr << "Monitor: ALSA Error: " << snd_strerror((int)written) << std::endl;
+            break;
+        } else {
+            count(m->periods, 1);
+        }
+    }
+}
+
+bool monitor_output_start(MonitorOutput& m, int sample_rate, int block_frames)
+{
+    PlaybackDeviceConfig device_config = m.config.device;
+    device_config.channels = monitor_channels;
+    device_config.sample_rate = (unsigned int)sample_rate;
+    device_config.mmap = false;
+    if (!playback_device_open(m.device, device_config)) return false;
+    if ((int)m.device.sample_rate != sample_rate) {
+        std::cout << "Monitor: " << m.device.name << " runs at " << m.device.sample_rate << " Hz, the stream at "
+                  << sample_rate << " Hz" << std::endl;
+        return false;
+    }
+
+    // Whole blocks, room for the target twice over plus the drift margin
+    m.block_frames = block_frames;
+    int target_blocks = std::max(1, (int)std::ceil(m.config.latency_ms * 1e-3f * sample_rate / block_frames));
+    m.target_frames = target_blocks * block_frames;
+    int capacity = std::max(8, 4 * target_blocks) * block_frames;
+    int ring_handle = m.arena.add_channels(monitor_channels, capacity);
+    int period_handle = m.arena.add_bytes(m.device.period_frames * pcm_device_frame_bytes(m.device));
+    if (!m.arena.allocate()) {
+        std::cout << "Cannot allocate the monitor buffers" << std::endl;
+        return false;
+    }
+    m.ring = new SpscFrameRing(m.arena.channels(ring_handle), monitor_channels, capacity);
+    m.period_buffer = (uint8_t*)m.arena.bytes(period_handle);
+
+    snd_pcm_prepare(m.device.pcm);
+    m.running.store(true);
+    m.thread = std::thread(playback_main, &m);
+    return true;
+}
+
+void monitor_output_stop(MonitorOutput& m)
+{
+    m.running.store(false);
+    if (m.thread.joinable()) m.thread.join();
+    if (m.device.pcm) snd_pcm_drop(m.device.pcm);
+}
+
+MonitorOutput::~MonitorOutput()
+{
+    monitor_output_stop(*this);
+    delete ring;
+}
+
+void monitor_output_push(MonitorOutput& m, const float* const* block)
+{
+    const int frames = m.block_frames;
+    if (m.ring->write_space() < frames) {
+        m.ring->note_dropped(frames);
+        return;
+    }
+    float* dst[monitor_channels];
+    m.ring->write_region(dst, frames); // contiguous: the capacity is a multiple of the block
+    for (int ch = 0; ch < monitor_channels; ++ch) std::memcpy(dst[ch], block[ch], sizeof(float) * frames);
+    m.ring->commit_write(frames);
+}
+
+void monitor_output_report(const MonitorOutput& m, FILE* out)
+{
+    if (!m.ring) return;
+    const double rate = m.device.sample_rate;
+    fprintf(out, "Monitor: %s, %.1f ms latency (%.1f queued + %.1f device buffer), %llu periods written\n",
+            m.device.name.c_str(), 1000.0 * (m.target_frames + m.device.buffer_frames) / rate,
+            1000.0 * m.target_frames / rate, 1000.0 * m.device.buffer_frames / rate,
+            (unsigned long long)m.periods.load());
+    fprintf(out, "  queued at most %.1f ms, %.1f ms of silence inserted, %llu blocks skipped, %llu dropped, %llu underruns\n",
+            1000.0 * m.max_fill.load() / rate, 1000.0 * m.silent_frames.load() / rate,
+            (unsigned long long)m.skipped_blocks.load(), (unsigned long long)m.ring->dropped_blocks(),
+            (unsigned long long)m.underruns.load());
+}
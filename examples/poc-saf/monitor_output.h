@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include "buffer_arena.h"
+#include "playback_device.h"
+#include "rt_config.h"
+
+class SpscFrameRing;
+
+// Streams the decoded monitor signal to a playback PCM.
+//
+// The DSP thread only copies each decoded block into an SPSC ring
+// (monitor_output_push never blocks or allocates). A playback thread, paced
+// by the device, interleaves whole periods out of the ring into the
+// device's format and writes them. The ring starts playing once it holds
+// latency_ms of audio. Capture and playback cards run on separate clocks,
+// so the fill drifts: above twice the target a block is skipped, and when
+// the ring runs dry the device gets silence instead of an underrun. Both
+// are counted.
+
+struct MonitorOutputConfig
+{
+    PlaybackDeviceConfig device;  // channels = 2; device/card_name select the PCM
+    float latency_ms = 20.0f;     // ring fill the playback thread aims for
+    RtThreadConfig rt;            // priority / CPU the playback thread gives itself
+};
+
+struct MonitorOutput
+{
+    ~MonitorOutput();
+
+    MonitorOutputConfig config;
+    PlaybackDevice device;
+
+    int block_frames = 0;
+    int target_frames = 0;        // latency_ms in whole blocks
+
+    SpscFrameRing* ring = nullptr;
+    BufferArena arena;            // ring storage and the period buffer
+    uint8_t* period_buffer = nullptr;
+
+    std::atomic<bool> running{false};
+    std::atomic<bool> rt_applied{false};
+    std::atomic<uint64_t> periods{0};       // periods written
+    std::atomic<uint64_t> underruns{0};     // device xruns, recovered
+    std::atomic<uint64_t> silent_frames{0}; // written as silence because the ring was empty
+    std::atomic<uint64_t> skipped_blocks{0};// dropped to hold the latency (capture clock faster)
+    std::atomic<int> max_fill{0};           // ring high-water mark, frames
+    std::thread thread;
+};
+
+// Opens the PCM, allocates the ring and starts the playback thread
+bool monitor_output_start(MonitorOutput& m, int sample_rate, int block_frames);
+void monitor_output_stop(MonitorOutput& m);
+
+// DSP thread: queues one decoded block (2 x block_frames). Drops it if the
+// ring is full.
+void monitor_output_push(MonitorOutput& m, const float* const* block);
+
+// Device, latency and the drift / xrun counters
+void monitor_output_report(const MonitorOutput& m, FILE* out);
@@ -0,0 +1,276 @@
+#include "pcm_device.h"
+#include <iostream>
+
+PcmDevice::~PcmDevice()
+{
+    pcm_device_close(*this);
+}
+
+void pcm_device_close(PcmDevice& dev)
+{
+    if (dev.pcm) snd_pcm_close(dev.pcm);
+    dev.pcm = nullptr;
+}
+
+// Calls fn(card, ctl, info) for every sound card until it returns true
+template <typename Fn>
+static void for_each_card(Fn fn)
+{
+    snd_ctl_card_info_t* info = nullptr;
+    snd_ctl_card_info_malloc(&info);
+    int card = -1;
+    bool done = false;
+    while (!done && snd_card_next(&card) == 0 && card >= 0) {
+        char ctl_name[32];
+        snprintf(ctl_name, sizeof(ctl_name), "hw:%d", card);
+        snd_ctl_t* ctl = nullptr;
+        if (snd_ctl_open(&ctl, ctl_name, 0) < 0) continue;
+        if (snd_ctl_card_info(ctl, info) == 0) done = fn(card, ctl, info);
+        snd_ctl_close(ctl);
+    }
+    snd_ctl_card_info_free(info);
+}
+
+// First PCM device of the card for `stream`, -1 if none
+static int first_device(snd_ctl_t* ctl, snd_pcm_stream_t stream)
+{
+    snd_pcm_info_t* info = nullptr;
+    snd_pcm_info_malloc(&info);
+    int device = -1, found = -1;
+    while (found < 0 && snd_ctl_pcm_next_device(ctl, &device) == 0 && device >= 0) {
+        snd_pcm_info_set_device(info, device);
+        snd_pcm_info_set_subdevice(info, 0);
+        snd_pcm_info_set_stream(info, stream);
+        if (snd_ctl_pcm_info(ctl, info) == 0) found = device;
+    }
+    snd_pcm_info_free(info);
+    return found;
+}
+
+static bool find_card(const char* card_name, snd_pcm_stream_t stream, std::string& pcm_name, std::string& label)
+{
+    bool found = false;
+    for_each_card([&](int card, snd_ctl_t* ctl, snd_ctl_card_info_t* info) {
+        const char* fields[] = {snd_ctl_card_info_get_id(info), snd_ctl_card_info_get_name(info),
+                                snd_ctl_card_info_get_longname(info)};
+        bool match = false;
+        for (const char* field : fields) match = match || (field && strcasestr(field, card_name));
+        if (!match) return false;
+        int device = first_device(ctl, stream);
+        if (device < 0) return false;
+        pcm_name = "hw:" + std::to_string(card) + "," + std::to_string(device);
+        label = snd_ctl_card_info_get_name(info);
+        found = true;
+        return true;
+    });
+    return found;
+}
+
+// What the PCM supports: "S24_3LE, 19 ch, 48000 Hz"
+static std::string describe_caps(snd_pcm_t* pcm, snd_pcm_hw_params_t* params)
+{
+    std::string formats;
+    for (int f = 0; f <= (int)SND_PCM_FORMAT_LAST; ++f) {
+        if (snd_pcm_hw_params_test_format(pcm, params, (snd_pcm_format_t)f) != 0) continue;
+        if (!formats.empty()) formats += "/";
+        formats += snd_pcm_format_name((snd_pcm_format_t)f);
+    }
+    unsigned int min_channels = 0, max_channels = 0, min_rate = 0, max_rate = 0;
+    snd_pcm_hw_params_get_channels_min(params, &min_channels);
+    snd_pcm_hw_params_get_channels_max(params, &max_channels);
+    snd_pcm_hw_params_get_rate_min(params, &min_rate, nullptr);
+    snd_pcm_hw_params_get_rate_max(params, &max_rate, nullptr);
+
+    std::string caps = formats.empty() ? "no formats" : formats;
+    caps += ", " + std::to_string(min_channels);
+    if (max_channels != min_channels) caps += "-" + std::to_string(max_channels);
+    caps += " ch, " + std::to_string(min_rate);
+    if (max_rate != min_rate) caps += "-" + std::to_string(max_rate);
+    return caps + " Hz";
+}
+
+// First of `formats` the PCM supports, SND_PCM_FORMAT_UNKNOWN if none
+static snd_pcm_format_t pick_format(snd_pcm_t* pcm, snd_pcm_hw_params_t* params, const snd_pcm_format_t* formats,
+                                    int num_formats)
+{
+    for (int i = 0; i < num_formats; ++i) {
+        if (snd_pcm_hw_params_test_format(pcm, params, formats[i]) == 0) return formats[i];
+    }
+    return SND_PCM_FORMAT_UNKNOWN;
+}
+
+// What the hardware cannot deliver as requested; empty if everything is native
+static std::string check_native(snd_pcm_t* pcm, snd_pcm_hw_params_t* params, const PcmDeviceConfig& config,
+                                snd_pcm_format_t format, const snd_pcm_format_t* formats, int num_formats)
+{
+    std::string why;
+    if (format == SND_PCM_FORMAT_UNKNOWN) {
+        why += "no ";
+        for (int i = 0; i < num_formats; ++i) why += std::string(i ? "/" : "") + snd_pcm_format_name(formats[i]);
+        why += " format";
+    }
+    if (snd_pcm_hw_params_test_channels(pcm, params, config.channels) != 0) {
+        why += std::string(why.empty() ? "" : ", ") + "no " + std::to_string(config.channels) + " channel mode";
+    }
+    if (snd_pcm_hw_params_test_rate(pcm, params, config.sample_rate, 0) != 0) {
+        why += std::string(why.empty() ? "" : ", ") + "no " + std::to_string(config.sample_rate) + " Hz";
+    }
+    if (!why.empty()) why += " (hardware: " + describe_caps(pcm, params) + ")";
+    return why;
+}
+
+static bool apply_params(PcmDevice& dev, const PcmDeviceConfig& config, snd_pcm_hw_params_t* params,
+                         snd_pcm_format_t format)
+{
+    snd_pcm_t* pcm = dev.pcm;
+    int dir = 0;
+
+    // Prefer mmap access (no copy out of the DMA buffer); fall back to RW
+    dev.mmap = config.mmap && snd_pcm_hw_params_set_access(pcm, params, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0;
+    if (!dev.mmap && snd_pcm_hw_params_set_access(pcm, params, SND_PCM_ACCESS_RW_INTERLEAVED) != 0) {
+        std::cout << "No interleaved access on " << dev.name << std::endl;
+        return false;
+    }
+    unsigned int rate = config.sample_rate;
+    snd_pcm_uframes_t period = config.period_frames;
+    snd_pcm_uframes_t buffer = config.period_frames * config.periods;
+    int err;
+    if ((err = snd_pcm_hw_params_set_format(pcm, params, format)) < 0 ||
+        (err = snd_pcm_hw_params_set_channels(pcm, params, config.channels)) < 0 ||
+        (err = snd_pcm_hw_params_set_rate_near(pcm, params, &rate, &dir)) < 0) {
+        std::cout << "Cannot set " << snd_pcm_format_name(format) << ", " << config.channels << " channels, "
+                  << config.sample_rate << " Hz on " << dev.name << ": " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    snd_pcm_hw_params_set_period_size_near(pcm, params, &period, &dir);
+    snd_pcm_hw_params_set_buffer_size_near(pcm, params, &buffer);
+
+    err = snd_pcm_hw_params(pcm, params);
+    if (err) {
+        std::cout << "Error setting HW params: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    snd_pcm_hw_params_get_period_size(params, &period, &dir);
+    snd_pcm_hw_params_get_buffer_size(params, &buffer);
+
+    dev.alsa_format = format;
+    dev.channels = config.channels;
+    dev.sample_rate = rate;
+    dev.period_frames = period;
+    dev.buffer_frames = buffer;
+    return true;
+}
+
+bool pcm_device_open(PcmDevice& dev, snd_pcm_stream_t stream, const PcmDeviceConfig& config,
+                     const snd_pcm_format_t* formats, int num_formats)
+{
+    pcm_device_close(dev);
+    dev.stream = stream;
+    dev.conversion.clear();
+    dev.card.clear();
+    const char* kind = stream == SND_PCM_STREAM_CAPTURE ? "capture" : "playback";
+
+    if (config.device) {
+        dev.name = config.device;
+    } else if (!config.card_name || !find_card(config.card_name, stream, dev.name, dev.card)) {
+        std::cout << "No " << kind << " card matching \"" << (config.card_name ? config.card_name : "")
+                  << "\" found" << std::endl;
+        return false;
+    }
+
+    int err = snd_pcm_open(&dev.pcm, dev.name.c_str(), stream, 0);
+    if (err < 0) {
+        std::cout << "Error opening PCM device " << dev.name << ": " << snd_strerror(err) << std::endl;
+        dev.pcm = nullptr;
+        return false;
+    }
+
+    snd_pcm_hw_params_t* params = nullptr;
+    snd_pcm_hw_params_malloc(&params);
+    snd_pcm_hw_params_any(dev.pcm, params);
+    snd_pcm_format_t format = pick_format(dev.pcm, params, formats, num_formats);
+
+    if (snd_pcm_type(dev.pcm) == SND_PCM_TYPE_HW) {
+        std::string why = check_native(dev.pcm, params, config, format, formats, num_formats);
+        if (!why.empty()) {
+            if (!config.allow_plug) {
+                std::cout << dev.name << " cannot " << (stream == SND_PCM_STREAM_CAPTURE ? "capture" : "play")
+                          << " the stream natively: " << why << std::endl;
+                snd_pcm_hw_params_free(params);
+                pcm_device_close(dev);
+                return false;
+            }
+            // Let alsa-lib convert, from the hardware's own format if it is one we can use
+            pcm_device_close(dev);
+            dev.name = "plug" + dev.name;
+            err = snd_pcm_open(&dev.pcm, dev.name.c_str(), stream, 0);
+            if (err < 0) {
+                std::cout << "Error opening PCM device " << dev.name << ": " << snd_strerror(err) << std::endl;
+                dev.pcm = nullptr;
+                snd_pcm_hw_params_free(params);
+                return false;
+            }
+            snd_pcm_hw_params_any(dev.pcm, params);
+            if (format == SND_PCM_FORMAT_UNKNOWN) format = formats[0];
+            dev.conversion = "by alsa-lib: " + why;
+        }
+    } else {
+        // A plugin PCM hides what the hardware delivers; it may convert anything
+        dev.conversion = std::string("possibly by alsa-lib (") + snd_pcm_type_name(snd_pcm_type(dev.pcm)) +
+                         " PCM; use hw: or the card name for native " + kind + ")";
+    }
+
+    bool ok = format != SND_PCM_FORMAT_UNKNOWN && apply_params(dev, config, params, format);
+    snd_pcm_hw_params_free(params);
+    if (!ok) {
+        if (format == SND_PCM_FORMAT_UNKNOWN) std::cout << "No usable sample format on " << dev.name << std::endl;
+        pcm_device_close(dev);
+        return false;
+    }
+    if (dev.sample_rate != config.sample_rate) {
+        dev.conversion += std::string(dev.conversion.empty() ? "" : "; ") + "runs at " +
+                          std::to_string(dev.sample_rate) + " Hz instead of " + std::to_string(config.sample_rate);
+    }
+    return true;
+}
+
+void pcm_device_report(const PcmDevice& dev, FILE* out)
+{
+    fprintf(out, "%s device: %s%s%s%s, %s, %d channels, %u Hz\n",
+            dev.stream == SND_PCM_STREAM_CAPTURE ? "Capture" : "Playback", dev.name.c_str(),
+            dev.card.empty() ? "" : " (", dev.card.c_str(), dev.card.empty() ? "" : ")",
+            snd_pcm_format_name(dev.alsa_format), dev.channels, dev.sample_rate);
+    if (dev.conversion.empty()) {
+        fprintf(out, "Conversion: none (native hw format)\n");
+    } else {
+        fprintf(out, "Conversion: %s\n", dev.conversion.c_str());
+    }
+    fflush(out);
+}
+
+void pcm_device_list(FILE* out, snd_pcm_stream_t stream)
+{
+    bool any = false;
+    for_each_card([&](int card, snd_ctl_t* ctl, snd_ctl_card_info_t* info) {
+        int device = first_device(ctl, stream);
+        if (device < 0) return false;
+        any = true;
+        std::string name = "hw:" + std::to_string(card) + "," + std::to_string(device);
+        fprintf(out, "%-8s %-12s %s\n", name.c_str(), snd_ctl_card_info_get_id(info),
+                snd_ctl_card_info_get_longname(info));
+
+        snd_pcm_t* pcm = nullptr;
+        if (snd_pcm_open(&pcm, name.c_str(), stream, SND_PCM_NONBLOCK) < 0) {
+            fprintf(out, "         (busy)\n");
+            return false;
+        }
+        snd_pcm_hw_params_t* params = nullptr;
+        snd_pcm_hw_params_malloc(&params);
+        snd_pcm_hw_params_any(pcm, params);
+        fprintf(out, "         %s\n", describe_caps(pcm, params).c_str());
+        snd_pcm_hw_params_free(params);
+        snd_pcm_close(pcm);
+        return false;
+    });
+    if (!any) fprintf(out, "No %s devices found\n", stream == SND_PCM_STREAM_CAPTURE ? "capture" : "playback");
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "alsa/asoundlib.h"
+
+// ALSA device setup shared by CaptureDevice and PlaybackDevice.
+//
+// The card is found by name instead of by index, which changes with USB
+// enumeration order, and opened as hw: so alsa-lib's plug layer cannot
+// quietly insert a format or rate conversion on every period. The first of
+// the caller's formats that the hardware supports natively is used; rate and
+// channel count must be exact. Only if hw: cannot deliver that is the device
+// reopened as plughw:, and `conversion` says what alsa-lib converts. An
+// explicit device name is used as given (and reported if it is not a hw: PCM).
+struct PcmDeviceConfig
+{
+    const char* device = nullptr;           // ALSA PCM name ("hw:2,0", "plughw:2,0", "default"); nullptr = find card_name
+    const char* card_name = nullptr;        // matched case-insensitively against card id, name and long name
+    int channels = 2;
+    unsigned int sample_rate = 48000;
+    snd_pcm_uframes_t period_frames = 1024;
+    int periods = 4;                        // buffer size in periods
+    bool mmap = false;                      // prefer SND_PCM_ACCESS_MMAP_INTERLEAVED, else RW
+    bool allow_plug = true;                 // fall back to plughw: if hw: cannot deliver the stream natively
+};
+
+struct PcmDevice
+{
+    ~PcmDevice();
+
+    snd_pcm_t* pcm = nullptr;
+    snd_pcm_stream_t stream = SND_PCM_STREAM_CAPTURE;
+    std::string name;                       // PCM that was opened, e.g. "hw:2,0"
+    std::string card;                       // card name, if found by name
+
+    // Negotiated configuration
+    snd_pcm_format_t alsa_format = SND_PCM_FORMAT_UNKNOWN;
+    int channels = 0;
+    unsigned int sample_rate = 0;
+    snd_pcm_uframes_t period_frames = 0;
+    snd_pcm_uframes_t buffer_frames = 0;
+    bool mmap = false;                      // SND_PCM_ACCESS_MMAP_INTERLEAVED
+
+    std::string conversion;                 // what alsa-lib converts and why; empty = samples as the hardware has them
+};
+
+// Finds the card, opens the PCM, negotiates the first of `formats` and sets
+// the hw params (not the sw params; not started). Prints why on failure.
+bool pcm_device_open(PcmDevice& dev, snd_pcm_stream_t stream, const PcmDeviceConfig& config,
+                     const snd_pcm_format_t* formats, int num_formats);
+void pcm_device_close(PcmDevice& dev);
+
+// Command line device argument: an ALSA PCM name ("hw:2,0", "default") or
+// else a card name to look up
+inline void pcm_device_select(PcmDeviceConfig& config, const char* arg)
+{
+    if (std::strchr(arg, ':') || std::strcmp(arg, "default") == 0) config.device = arg;
+    else config.card_name = arg;
+}
+
+// Bytes of one interleaved frame in the negotiated format
+inline int pcm_device_frame_bytes(const PcmDevice& dev)
+{
+    return dev.channels * snd_pcm_format_physical_width(dev.alsa_format) / 8;
+}
+
+// Device, format, period/buffer, access and any conversion
+void pcm_device_report(const PcmDevice& dev, FILE* out);
+
+// Every card with a PCM for `stream`, its hw: name and the formats, channel
+// counts and rates it supports natively
+void pcm_device_list(FILE* out, snd_pcm_stream_t stream);
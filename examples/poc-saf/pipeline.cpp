@@ -0,0 +1,364 @@
+#include "pipeline.h"
+#include "activity_gate.h"
+#include "buffer_arena.h"
+#include "direction_histogram.h"
+#include "doa_engine.h"
+#include "doa_tracker.h"
+#include "level_meter.h"
+#include "stage_stats.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// SAF framework includes
+#include "saf.h"
+#include "array2sh.h"
+#include "sldoa.h"
+
+const char* doa_method_name(DoaMethod method)
+{
+    switch (method) {
+        case DoaMethod::Pwd: return "pwd";
+        case DoaMethod::Music: return "music";
+        default: return "sldoa";
+    }
+}
+
+bool doa_method_from_name(const char* name, DoaMethod& method)
+{
+    const DoaMethod methods[] = {DoaMethod::Sldoa, DoaMethod::Pwd, DoaMethod::Music};
+    for (DoaMethod m : methods) {
+        if (std::strcmp(name, doa_method_name(m)) != 0) continue;
+        method = m;
+        return true;
+    }
+    return false;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+bool pipeline_init(Pipeline& p, int sample_rate)
+{
+    const auto start = std::chrono::steady_clock::now();
+    p.sample_rate = sample_rate;
+
+    // 1. Create array2sh instance (microphone array to spherical harmonics)
+    array2sh_create(&p.array2sh_handle);
+    array2sh_init(p.array2sh_handle, sample_rate);
+
+    // Configure for Zylia ZM-1 (19 microphones on a sphere)
+    array2sh_setPreset(p.array2sh_handle, MICROPHONE_ARRAY_PRESET_ZYLIA_1D);
+    array2sh_setEncodingOrder(p.array2sh_handle, (SH_ORDERS)SH_ORDER);
+    array2sh_setNormType(p.array2sh_handle, NORM_SN3D);
+    array2sh_setChOrder(p.array2sh_handle, CH_ACN);
+    //array2sh_setGain(p.array2sh_handle, 30.0f);
+
+    // 2. DoA stage: sldoa, or the native engine (set up below, with the buffers)
+    double codec_ms = 0.0;
+    if (p.doa_method == DoaMethod::Sldoa) {
+        // Create sldoa instance (spatial localization based on direction of arrival)
+        sldoa_create(&p.sld_handle);
+        sldoa_init(p.sld_handle, sample_rate);
+
+        // Configure sldoa
+        sldoa_setMasterOrder(p.sld_handle, (SH_ORDERS)SH_ORDER);
+        sldoa_setNormType(p.sld_handle, NORM_SN3D);
+        sldoa_setChOrder(p.sld_handle, CH_ACN);
+
+        // CRITICAL: Initialize the codec - without this, sldoa_analysis does nothing!
+        // On this thread: it plans FFTs like the array2sh setup below, and
+        // FFTW's planner is not thread-safe. Returns once initialised.
+        std::cout << "Initializing array2sh encoder and sldoa codec..." << std::endl;
+        auto t0 = std::chrono::steady_clock::now();
+        sldoa_initCodec(p.sld_handle);
+        codec_ms = elapsed_ms(t0);
+    } else {
+        std::cout << "Initializing array2sh encoder..." << std::endl;
+    }
+
+    // Get frame sizes
+    int a2sh_framesize = array2sh_getFrameSize();
+    int sldoa_framesize = sldoa_getFrameSize();
+
+    // Audio is fed in array2sh frames (smaller, more responsive)
+    // We'll accumulate frames for sldoa internally
+    p.framesize = a2sh_framesize;  // 128 samples
+
+    // sldoa processes every SLDOA_FRAME_SIZE (512) samples
+    // It has 4 time slots (512/128 = 4), so we should only read display data
+    // after 4 frames have been processed. The native engine updates at the
+    // same rate, so both methods produce estimates equally often.
+    p.frames_per_sldoa_update = sldoa_framesize / a2sh_framesize; // 512/128 = 4
+    p.frame_counter = 0;
+
+    // Output SH signals from array2sh, plus one silent input block for warm-up
+    p.arena = new BufferArena();
+    int sh_buffers = p.arena->add_channels(NUM_SH_SIGNALS, p.framesize);
+    int silence = p.arena->add_channels(mic_channels, p.framesize);
+    bool allocated = p.arena->allocate();
+
+    // array2sh computes its encoding filters lazily in the first process call.
+    // Do that now rather than in the first live frame.
+    auto t0 = std::chrono::steady_clock::now();
+    if (allocated) {
+        p.sh_output = p.arena->channels(sh_buffers);
+        array2sh_process(p.array2sh_handle, (const float* const*)p.arena->channels(silence), p.sh_output,
+                         mic_channels, NUM_SH_SIGNALS, p.framesize);
+    }
+    double filters_ms = elapsed_ms(t0);
+
+    if (!allocated) {
+        std::cout << "Cannot allocate pipeline buffers" << std::endl;
+        return false;
+    }
+    p.sh_levels = new LevelMeter(NUM_SH_SIGNALS, sample_rate);
+
+    if (p.gate_config) {
+        // Encoding every block anyway leaves nothing to replay: array2sh has
+        // already seen the skipped blocks, in order
+        ActivityGateConfig gate_config = *p.gate_config;
+        if (p.encode_always) gate_config.preroll_s = 0.0f;
+        p.gate = new ActivityGate(gate_config, mic_channels, p.framesize, sample_rate, p.frames_per_sldoa_update);
+        if (!p.gate->prepare()) {
+            std::cout << "Cannot allocate the activity gate pre-roll" << std::endl;
+            return false;
+        }
+    }
+
+    // Native engine: steering grid is computed once here
+    if (p.doa_method != DoaMethod::Sldoa) {
+        t0 = std::chrono::steady_clock::now();
+        p.doa_sources = std::max(1, std::min(p.doa_sources, (int)DoaTracker::max_tracks));
+        p.doa_engine = new DoaEngine(SH_ORDER, p.doa_directions,
+                                     p.doa_method == DoaMethod::Music ? DoaMap::Music : DoaMap::Pwd, p.doa_sources);
+        if (!p.doa_engine->prepare(sample_rate)) {
+            std::cout << "Cannot allocate the DoA grid" << std::endl;
+            return false;
+        }
+        codec_ms = elapsed_ms(t0);
+    }
+
+    // Tracks: several sldoa bands must agree for a hit. The engine reports
+    // one peak per source, each at least a gate apart, so one observation is
+    // a hit there; clutter peaks are only hit sporadically and die.
+    DoaTrackerConfig tracker_config;
+    if (p.doa_engine) tracker_config.min_cluster = 1;
+    p.tracker = new DoaTracker(tracker_config);
+    p.observations = new DoaObservation[DoaTracker::max_observations];
+
+    if (p.histogram_decay_s > 0.0f) {
+        p.histogram = new DirectionHistogram(p.histogram_resolution_deg, p.histogram_decay_s);
+        if (!p.histogram->prepare()) {
+            std::cout << "Cannot allocate the direction histogram" << std::endl;
+            return false;
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "array2sh filters: " << filters_ms << " ms, "
+              << (p.doa_engine ? "DoA grid: " : "sldoa codec: ") << codec_ms << " ms"
+              << ", ready after " << elapsed_ms(start) << " ms" << std::endl;
+    if (p.doa_engine) {
+        std::cout << "DoA: " << doa_method_name(p.doa_method) << " map on " << p.doa_engine->num_directions()
+                  << " directions (~" << p.doa_engine->resolution_deg() << " deg spacing, "
+                  << simd_level_name(p.doa_engine->simd_level()) << ")" << std::endl;
+    }
+    if (p.gate) {
+        const ActivityGateConfig& g = p.gate->config();
+        std::cout << "Activity gate: " << gate_detector_name(g.detector) << ", pre-roll "
+                  << p.gate->preroll_blocks() << " blocks, hold " << g.hold_s * 1000.0f << " ms";
+        if (p.encode_always) std::cout << ", array2sh on every block";
+        if (g.idle_decimation > 0) std::cout << ", 1 of " << g.idle_decimation << " updates while idle";
+        std::cout << std::endl;
+    }
+    if (p.histogram) {
+        std::cout << "Direction histogram: " << p.histogram->azimuth_bins() << " x " << p.histogram->elevation_bins()
+                  << " bins, " << p.histogram_decay_s * 1000.0f << " ms memory" << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+
+    std::cout << "array2sh frame size: " << a2sh_framesize << std::endl;
+    std::cout << (p.doa_engine ? "DoA update: " : "sldoa frame size: ") << sldoa_framesize << std::endl;
+    return true;
+}
+
+void pipeline_destroy(Pipeline& p)
+{
+    if (p.sld_handle) sldoa_destroy(&p.sld_handle);
+    if (p.array2sh_handle) array2sh_destroy(&p.array2sh_handle);
+
+    delete p.histogram;
+    delete p.gate;
+    delete p.tracker;
+    delete[] p.observations;
+    delete p.doa_engine;
+    delete p.sh_levels;
+    delete p.arena;
+    p = Pipeline();
+}
+
+// array2sh on one block of mic signals, into p.sh_output
+static void encode_block(Pipeline& p, const float* const* mic_input, bool meter = false)
+{
+    StageTimer timer(p.stats, Stage::Encode);
+    array2sh_process(p.array2sh_handle,
+                     mic_input,
+                     p.sh_output,
+                     mic_channels,
+                     NUM_SH_SIGNALS,
+                     p.framesize);
+
+    // Meter the SH signals while they are still in cache
+    if (!meter) return;
+    LevelAccum sh_accum[NUM_SH_SIGNALS];
+    measure_levels(p.sh_output, NUM_SH_SIGNALS, p.framesize, sh_accum);
+    p.sh_levels->update(sh_accum, p.framesize);
+}
+
+// Feeds p.sh_output to the DoA stage
+static void analyse_block(Pipeline& p)
+{
+    if (p.doa_engine) {
+        p.doa_engine->accumulate((const float* const*)p.sh_output, p.framesize);
+    } else {
+        sldoa_analysis(p.sld_handle,
+                       (const float* const*)p.sh_output,
+                       NUM_SH_SIGNALS,
+                       p.framesize,
+                       1); // isPlaying = 1
+    }
+}
+
+bool pipeline_process(Pipeline& p, const float* const* mic_input)
+{
+    // === Activity gate: run the chain at all? ===
+    // On opening, the skipped pre-roll blocks go through first, oldest first,
+    // a few per call (the gate bounds them)
+    int run = p.gate ? p.gate->process(mic_input) : 1;
+    for (int i = 0; i + 1 < run; ++i) {
+        encode_block(p, p.gate->run_block(i));
+        StageTimer timer(p.stats, Stage::Analysis);
+        analyse_block(p);
+    }
+
+    // === Process with array2sh (mic signals -> SH signals) ===
+    // The SH level is read once per update, so only its last block is metered
+    const bool meter = p.frame_counter + 1 >= p.frames_per_sldoa_update;
+    if (run > 0) encode_block(p, p.gate ? p.gate->run_block(run - 1) : mic_input, meter);
+    else if (p.encode_always) encode_block(p, mic_input, meter);
+
+    // === DoA estimation (SH signals -> directions) ===
+    // Not timed for gated blocks: they would record empty samples
+    StageTimer timer(run > 0 ? p.stats : nullptr, Stage::Analysis);
+    if (run > 0) {
+        analyse_block(p);
+        p.update_active = true;
+    }
+
+    // Increment frame counter
+    p.frame_counter++;
+
+    // Only get display data every N frames (when sldoa has processed a full block)
+    if (p.frame_counter < p.frames_per_sldoa_update) return false;
+
+    p.frame_counter = 0;
+    const float update_s = (float)(p.frames_per_sldoa_update * p.framesize) / p.sample_rate;
+    DoaEstimate& e = p.estimate;
+    if (p.histogram) p.histogram->decay(update_s);
+    if (!p.update_active) {
+        // Gated for the whole update: nothing new to report, tracks coast
+        e = DoaEstimate();
+        p.tracker->update(p.observations, 0, update_s);
+        return true;
+    }
+    p.update_active = false;
+    if (p.doa_engine) {
+        DoaPeak peak;
+        if (!p.doa_engine->estimate(peak)) {
+            e = DoaEstimate();
+            p.tracker->update(p.observations, 0, update_s);
+            return true;
+        }
+        e.azimuth_deg = peak.azimuth_deg;
+        e.elevation_deg = peak.elevation_deg;
+        e.strength = peak.strength;
+        e.direction = peak.index;
+
+        // Every source's peak is an observation for the tracker, and goes
+        // into the histogram. Music's map is subspace membership (sources
+        // near 1), Pwd's a beam power (a weaker source is a few dB down).
+        DoaPeak peaks[DoaTracker::max_tracks];
+        const float min_relative = p.doa_method == DoaMethod::Music ? 0.5f : 0.25f;
+        int n = p.doa_engine->peaks(peaks, p.doa_sources, p.tracker->config().gate_deg, min_relative);
+        for (int i = 0; i < n; ++i) {
+            p.observations[i] = doa_observation(peaks[i].azimuth_deg, peaks[i].elevation_deg, peaks[i].strength);
+            if (p.histogram) p.histogram->add(peaks[i].azimuth_deg, peaks[i].elevation_deg, peaks[i].strength);
+        }
+        p.tracker->update(p.observations, n, update_s);
+        if (p.histogram) {
+            e.direction = -1;
+            if (!p.histogram->peak(e.azimuth_deg, e.elevation_deg, e.strength)) e.strength = -1.0f;
+        }
+        return true;
+    }
+
+    DoaDisplayData& d = p.doa;
+    sldoa_getDisplayData(p.sld_handle, &d.azi_deg, &d.elev_deg, &d.colour_scale, &d.alpha_scale,
+                         &d.sectors_per_band, &d.max_num_sectors, &d.start_band, &d.end_band);
+    e.strength = find_dominant_sector(d, e.band, e.sector);
+    if (e.strength < 0.0f || !d.azi_deg || !d.elev_deg) {
+        p.tracker->update(p.observations, 0, update_s);
+        return true;
+    }
+    int idx = e.band * d.max_num_sectors + e.sector;
+    e.azimuth_deg = d.azi_deg[idx];
+    e.elevation_deg = d.elev_deg[idx];
+
+    // Every sector of every band is an observation for the tracker, and goes
+    // into the histogram
+    int n = 0;
+    for (int band = d.start_band; band <= d.end_band; ++band) {
+        for (int sector = 0; sector < d.sectors_per_band[band]; ++sector) {
+            int i = band * d.max_num_sectors + sector;
+            if (p.histogram) p.histogram->add(d.azi_deg[i], d.elev_deg[i], d.alpha_scale[i]);
+            if (n < DoaTracker::max_observations) {
+                p.observations[n++] = doa_observation(d.azi_deg[i], d.elev_deg[i], d.alpha_scale[i]);
+            }
+        }
+    }
+    p.tracker->update(p.observations, n, update_s);
+    if (p.histogram) {
+        e.band = e.sector = -1;
+        if (!p.histogram->peak(e.azimuth_deg, e.elevation_deg, e.strength)) e.strength = -1.0f;
+    }
+    return true;
+}
+
+float find_dominant_sector(const DoaDisplayData& d, int& best_band, int& best_sector)
+{
+    // Data layout: azi_deg[band * max_num_sectors + sector]
+    float max_alpha = -1.0f;
+    best_band = d.start_band;
+    best_sector = 0;
+    if (!d.alpha_scale || !d.sectors_per_band) return max_alpha;
+
+    for (int band = d.start_band; band <= d.end_band; ++band) {
+        int nSectors = d.sectors_per_band[band];
+        for (int sector = 0; sector < nSectors; ++sector) {
+            int idx = band * d.max_num_sectors + sector;
+            if (d.alpha_scale[idx] > max_alpha) {
+                max_alpha = d.alpha_scale[idx];
+                best_band = band;
+                best_sector = sector;
+            }
+        }
+    }
+    return max_alpha;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+class ActivityGate;
+struct ActivityGateConfig;
+class BufferArena;
+class DirectionHistogram;
+class DoaEngine;
+class DoaTracker;
+class LevelMeter;
+struct DoaObservation;
+struct StageStats;
+
+// The localization chain shared by live capture and file replay:
+// 19 mic signals -> [activity gate] -> array2sh (SH encoding) -> sldoa or DoaEngine (DoA estimates)
+
+// Array / SAF configuration
+const int mic_channels = 19;
+const int SH_ORDER = 3; // Zylia supports up to 3rd order
+const int NUM_SH_SIGNALS = (SH_ORDER + 1) * (SH_ORDER + 1); // 16 SH channels
+
+// How directions are estimated from the SH signals
+enum class DoaMethod
+{
+    Sldoa, // SAF sldoa: per-band sector DoAs, dominant sector by alpha
+    Pwd,   // DoaEngine plane-wave decomposition power map on a grid
+    Music  // DoaEngine SH-MUSIC map on a grid
+};
+
+const char* doa_method_name(DoaMethod method);
+bool doa_method_from_name(const char* name, DoaMethod& method);
+
+// Dominant direction after an update, whichever method produced it
+struct DoaEstimate
+{
+    float azimuth_deg = 0.0f;
+    float elevation_deg = 0.0f;
+    float strength = -1.0f; // sldoa: alpha of the dominant sector, grid: map peak (0..1),
+                            // histogram: share of the recent weight at the peak (0..1); < 0 = none
+    int band = -1;          // sldoa without histogram only
+    int sector = -1;        // sldoa without histogram only
+    int direction = -1;     // grid methods only
+};
+
+// Latest sldoa output. Pointers are owned by sldoa and stay valid until the
+// next update; layout is [band * max_num_sectors + sector].
+struct DoaDisplayData
+{
+    float* azi_deg = nullptr;
+    float* elev_deg = nullptr;
+    float* colour_scale = nullptr;
+    float* alpha_scale = nullptr;
+    int* sectors_per_band = nullptr;
+    int max_num_sectors = 0;
+    int start_band = 0;
+    int end_band = 0;
+};
+
+struct Pipeline
+{
+    // Set before pipeline_init
+    DoaMethod doa_method = DoaMethod::Sldoa;
+    int doa_directions = 1024;       // grid size for Pwd / Music (~6 degree spacing)
+    int doa_sources = 3;             // Pwd / Music: map peaks per update for the tracker (Music: its
+                                     // signal subspace too), up to DoaTracker::max_tracks
+    const ActivityGateConfig* gate_config = nullptr; // gate the chain on activity; nullptr = run every block
+    float histogram_decay_s = 0.0f;  // > 0: estimate = peak of a direction histogram with this memory
+    float histogram_resolution_deg = 5.0f;
+    bool encode_always = false;      // with a gate: array2sh still runs on every block (gapless
+                                     // sh_output for the recorder), only DoA is gated
+
+    void* array2sh_handle = nullptr;
+    void* sld_handle = nullptr;      // DoaMethod::Sldoa only
+    DoaEngine* doa_engine = nullptr; // DoaMethod::Pwd / Music only
+
+    int sample_rate = 0;
+    int framesize = 0;               // array2sh frame size (128 samples)
+    int frames_per_sldoa_update = 0; // sldoa frame size / framesize
+    int frame_counter = 0;
+    bool update_active = false;      // the chain ran for some block of the current update
+
+    BufferArena* arena = nullptr;    // backs sh_output
+    float** sh_output = nullptr;     // NUM_SH_SIGNALS x framesize
+    LevelMeter* sh_levels = nullptr; // per-SH-channel levels of the last block of each update, measured
+                                     // right after encoding
+    StageStats* stats = nullptr;     // optional, not owned: records Encode and Analysis
+    ActivityGate* gate = nullptr;    // with gate_config: skips array2sh + DoA while the scene is quiet
+    DoaDisplayData doa;              // sldoa only
+    DoaEstimate estimate;
+
+    // Source tracks over all of each update's directions (every sldoa sector
+    // of every band, or the engine's map peaks), fed by pipeline_process
+    DoaTracker* tracker = nullptr;
+    DoaObservation* observations = nullptr; // per-update scratch, DoaTracker::max_observations
+
+    // With histogram_decay_s: the same directions, weighted, aggregated over time
+    DirectionHistogram* histogram = nullptr;
+};
+
+// Creates and configures array2sh and the DoA stage (sldoa, or the native
+// engine for p.doa_method) for the Zylia ZM-1 and returns once both are ready
+// to process. Not thread-safe against other SAF setup (FFTW planning):
+// initialize several pipelines one after the other.
+bool pipeline_init(Pipeline& p, int sample_rate);
+void pipeline_destroy(Pipeline& p);
+
+// Runs one framesize block of mic signals through the chain.
+// Returns true after an update (every sldoa frame, for every method): then
+// p.estimate holds the dominant direction (or the histogram peak),
+// p.tracker the updated tracks and, for sldoa, p.doa the display data. With a gate, updates during which it
+// stayed closed have no estimate (strength < 0) and the tracks coast.
+// p.sh_output holds this block's SH signals if it was encoded: always
+// without a gate or with encode_always, else only while the gate is open
+// (and while it catches up on pre-roll, those of the latest block run).
+bool pipeline_process(Pipeline& p, const float* const* mic_input);
+
+// Sector with the maximum alpha (energy) across all frequency bands.
+// Returns that alpha, or -1 if there is no display data yet.
+float find_dominant_sector(const DoaDisplayData& d, int& best_band, int& best_sector);
@@ -0,0 +1,28 @@
+#include "playback_device.h"
+#include <iostream>
+
+// Widest first
+static const snd_pcm_format_t output_formats[] = {SND_PCM_FORMAT_S32_LE, SND_PCM_FORMAT_S24_3LE,
+                                                  SND_PCM_FORMAT_S24_LE, SND_PCM_FORMAT_S16_LE};
+
+bool playback_device_open(PlaybackDevice& dev, const PlaybackDeviceConfig& config)
+{
+    if (!pcm_device_open(dev, SND_PCM_STREAM_PLAYBACK, config, output_formats, 4)) return false;
+
+    // Poll wakes the writer once a period of space is free
+    snd_pcm_sw_params_t* sw_params = nullptr;
+    snd_pcm_sw_params_malloc(&sw_params);
+    snd_pcm_sw_params_current(dev.pcm, sw_params);
+    snd_pcm_sw_params_set_avail_min(dev.pcm, sw_params, dev.period_frames);
+    snd_pcm_uframes_t start_threshold = dev.buffer_frames;
+    if (config.explicit_start) snd_pcm_sw_params_get_boundary(sw_params, &start_threshold);
+    snd_pcm_sw_params_set_start_threshold(dev.pcm, sw_params, start_threshold);
+    int err = snd_pcm_sw_params(dev.pcm, sw_params);
+    snd_pcm_sw_params_free(sw_params);
+    if (err) {
+        std::cout << "Error setting SW params: " << snd_strerror(err) << std::endl;
+        pcm_device_close(dev);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "pcm_device.h"
+
+// A playback PCM for monitoring, in the first format the hardware takes
+// natively, widest first (S32_LE, S24_3LE, S24_LE, S16_LE) so nothing of the
+// 24-bit input is lost on the way. See pcm_device.h.
+struct PlaybackDeviceConfig : PcmDeviceConfig
+{
+    // Writes never start the stream; snd_pcm_start (or a capture PCM linked
+    // to it) does. Otherwise it starts once the buffer is full.
+    bool explicit_start = false;
+};
+
+struct PlaybackDevice : PcmDevice
+{
+};
+
+// Opens and configures the PCM (hw and sw params, not yet started). Prints
+// why on failure.
+bool playback_device_open(PlaybackDevice& dev, const PlaybackDeviceConfig& config);
@@ -0,0 +1,371 @@
+#include "recorder.h"
+#include "spsc_ring.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+
+// The WAV header takes one page, so the sample data starts page-aligned and
+// every O_DIRECT write stays aligned in the file as well as in memory
+const size_t io_align = 4096;
+const size_t header_bytes = 4096;
+const size_t data_chunk_offset = header_bytes - 8;
+
+static const uint8_t subformat_tail[12] = {0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+
+static void put_u16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put_u32(uint8_t* p, uint32_t v) { put_u16(p, (uint16_t)v); put_u16(p + 2, (uint16_t)(v >> 16)); }
+static void put_u64(uint8_t* p, uint64_t v) { put_u32(p, (uint32_t)v); put_u32(p + 4, (uint32_t)(v >> 32)); }
+
+// RIFF/WAVE, JUNK (ds64 once the file outgrows 4 GiB), fmt (extensible),
+// JUNK padding, data header in the last 8 bytes of the page
+static void write_header(uint8_t* h, const RecorderStream& s, int sample_rate, uint64_t data_bytes)
+{
+    const uint16_t block_align = (uint16_t)(s.channels * s.sample_bytes);
+    const uint64_t riff_size = header_bytes - 8 + data_bytes + (data_bytes & 1);
+    const bool rf64 = riff_size > 0xFFFFFFFFull;
+
+    std::memset(h, 0, header_bytes);
+    std::memcpy(h, rf64 ? "RF64" : "RIFF", 4);
+    put_u32(h + 4, rf64 ? 0xFFFFFFFFu : (uint32_t)riff_size);
+    std::memcpy(h + 8, "WAVE", 4);
+
+    uint8_t* c = h + 12;
+    std::memcpy(c, rf64 ? "ds64" : "JUNK", 4);
+    put_u32(c + 4, 28);
+    if (rf64) {
+        put_u64(c + 8, riff_size);
+        put_u64(c + 16, data_bytes);
+        put_u64(c + 24, data_bytes / block_align); // sample frames
+        put_u32(c + 32, 0);                        // no table
+    }
+
+    c = h + 48;
+    std::memcpy(c, "fmt ", 4);
+    put_u32(c + 4, 40);
+    put_u16(c + 8, 0xFFFE);                    // WAVE_FORMAT_EXTENSIBLE
+    put_u16(c + 10, (uint16_t)s.channels);
+    put_u32(c + 12, (uint32_t)sample_rate);
+    put_u32(c + 16, (uint32_t)sample_rate * block_align);
+    put_u16(c + 20, block_align);
+    put_u16(c + 22, (uint16_t)(8 * s.sample_bytes));
+    put_u16(c + 24, 22);
+    put_u16(c + 26, (uint16_t)(8 * s.sample_bytes)); // valid bits
+    put_u32(c + 28, 0);                              // no speaker mask: ambisonic / mic channels
+    put_u32(c + 32, s.pcm24 ? 1 : 3);                // KSDATAFORMAT_SUBTYPE_PCM / _IEEE_FLOAT
+    std::memcpy(c + 36, subformat_tail, sizeof(subformat_tail));
+
+    c = h + 96;
+    std::memcpy(c, "JUNK", 4);
+    put_u32(c + 4, (uint32_t)(data_chunk_offset - 96 - 8));
+
+    c = h + data_chunk_offset;
+    std::memcpy(c, "data", 4);
+    put_u32(c + 4, rf64 ? 0xFFFFFFFFu : (uint32_t)data_bytes);
+}
+
+// Writes all of buf at the current offset. Some filesystems accept O_DIRECT
+// on open but reject the writes; the stream then continues buffered.
+static bool write_all(RecorderStream& s, const uint8_t* buf, size_t bytes)
+{
+    while (bytes > 0) {
+        ssize_t n = write(s.fd, buf, bytes);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EINVAL && s.direct) {
+            fcntl(s.fd, F_SETFL, fcntl(s.fd, F_GETFL) & ~O_DIRECT);
+            s.direct = false;
+            continue;
+        }
+        if (n <= 0) return false;
+        buf += n;
+        bytes -= (size_t)n;
+        s.bytes_written.store(s.bytes_written.load(std::memory_order_relaxed) + (uint64_t)n,
+                              std::memory_order_relaxed);
+    }
+    return true;
+}
+
+static std::string stream_path(const Recorder& r, const RecorderStream& s)
+{
+    char index[16];
+    snprintf(index, sizeof(index), "%03d", s.file_index);
+    return r.config.directory + "/" + r.config.prefix + "_" + r.session + "_" + index + "_" + s.suffix + ".wav";
+}
+
+// Creates the next file of a stream and writes a placeholder header (the
+// sizes are filled in by close_file)
+static bool open_file(Recorder& r, RecorderStream& s)
+{
+    s.path = stream_path(r, s);
+    s.fd = open(s.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_DIRECT, 0644);
+    s.direct = s.fd >= 0;
+    if (s.fd < 0 && errno == EINVAL) s.fd = open(s.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (s.fd < 0) return false;
+
+    write_header(s.buffer, s, r.sample_rate, 0);
+    s.buffered = header_bytes;
+    s.file_bytes = 0;
+    s.file_frames = 0;
+    ++s.file_index;
+    r.files.store(r.files.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return true;
+}
+
+// Writes the whole pages of the staging buffer and keeps the remainder
+static bool flush_pages(RecorderStream& s)
+{
+    size_t whole = s.buffered / io_align * io_align;
+    if (whole == 0) return true;
+    if (!write_all(s, s.buffer, whole)) return false;
+    std::memmove(s.buffer, s.buffer + whole, s.buffered - whole);
+    s.buffered -= whole;
+    return true;
+}
+
+// Writes the unaligned tail without O_DIRECT, then the final header
+static bool close_file(Recorder& r, RecorderStream& s)
+{
+    if (s.fd < 0) return true;
+    bool ok = flush_pages(s);
+    if (ok && s.direct) {
+        fcntl(s.fd, F_SETFL, fcntl(s.fd, F_GETFL) & ~O_DIRECT);
+        s.direct = false;
+    }
+    if (ok && (s.file_bytes & 1)) s.buffer[s.buffered++] = 0; // RIFF pad byte
+    ok = ok && write_all(s, s.buffer, s.buffered);
+    s.buffered = 0;
+
+    uint8_t header[header_bytes];
+    write_header(header, s, r.sample_rate, s.file_bytes);
+    ok = ok && pwrite(s.fd, header, header_bytes, 0) == (ssize_t)header_bytes;
+    ok = close(s.fd) == 0 && ok;
+    s.fd = -1;
+    return ok;
+}
+
+static void stream_failed(Recorder& r, RecorderStream& s)
+{
+    std::cerr << "Recorder: cannot write " << s.path << ": " << strerror(errno)
+              << "; the rest of the " << s.suffix << " stream is discarded" << std::endl;
+    r.write_errors.store(r.write_errors.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (s.fd >= 0) close(s.fd);
+    s.fd = -1;
+    s.failed = true;
+}
+
+// Planar ring block -> interleaved file samples at the end of the staging buffer
+static void interleave(RecorderStream& s, const float* const* src, int frames)
+{
+    uint8_t* out = s.buffer + s.buffered;
+    if (s.pcm24) {
+        for (int f = 0; f < frames; ++f) {
+            for (int ch = 0; ch < s.channels; ++ch) {
+                float x = std::min(std::max(src[ch][f], -1.0f), 8388607.0f / 8388608.0f);
+                int32_t v = (int32_t)lrintf(x * 8388608.0f);
+                out[0] = (uint8_t)v;
+                out[1] = (uint8_t)(v >> 8);
+                out[2] = (uint8_t)(v >> 16);
+                out += 3;
+            }
+        }
+    } else {
+        float* o = reinterpret_cast<float*>(out);
+        for (int f = 0; f < frames; ++f) {
+            for (int ch = 0; ch < s.channels; ++ch) *o++ = src[ch][f];
+        }
+    }
+    size_t bytes = (size_t)frames * s.channels * s.sample_bytes;
+    s.buffered += bytes;
+    s.file_bytes += bytes;
+    s.file_frames += (uint64_t)frames;
+}
+
+// Moves everything queued in one stream's ring into its file
+static void drain(Recorder& r, RecorderStream& s)
+{
+    const int frames = r.block_frames;
+    int fill = s.ring->fill();
+    if (fill > s.max_fill.load(std::memory_order_relaxed)) s.max_fill.store(fill, std::memory_order_relaxed);
+
+    const float* src[32];
+    while (s.ring->read_block(src, frames)) {
+        if (s.failed) {
+            s.blocks_lost.store(s.blocks_lost.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            s.ring->release(frames);
+            continue;
+        }
+        interleave(s, src, frames);
+        s.ring->release(frames);
+
+        if (s.buffered >= (size_t)r.config.write_bytes && !flush_pages(s)) {
+            stream_failed(r, s);
+            continue;
+        }
+        if (r.rotate_frames && s.file_frames >= r.rotate_frames) {
+            if (!close_file(r, s) || !open_file(r, s)) stream_failed(r, s);
+        }
+    }
+}
+
+static void writer_loop(Recorder* r)
+{
+    RecorderStream* first = r->config.record_sh ? &r->sh : &r->mic;
+    for (;;) {
+        // Both streams are pushed together, so waiting on one is enough
+        bool stopping = !r->running.load(std::memory_order_acquire);
+        first->ring->wait_for(r->block_frames, 100);
+        if (r->config.record_sh) drain(*r, r->sh);
+        if (r->config.record_mic) drain(*r, r->mic);
+        if (stopping) break; // the final drain above saw everything pushed before stop
+    }
+}
+
+static bool init_stream(Recorder& r, RecorderStream& s, const char* suffix, int channels, bool pcm24)
+{
+    s.suffix = suffix;
+    s.channels = channels;
+    s.pcm24 = pcm24;
+    s.sample_bytes = pcm24 ? 3 : 4;
+
+    // Room for write_bytes plus one block and the pad byte beyond it
+    size_t block_bytes = (size_t)r.block_frames * channels * s.sample_bytes;
+    s.buffer_size = ((size_t)r.config.write_bytes + block_bytes + io_align) / io_align * io_align;
+    s.buffer = static_cast<uint8_t*>(aligned_alloc(io_align, s.buffer_size));
+    if (!s.buffer) return false;
+    std::memset(s.buffer, 0, s.buffer_size);
+
+    if (!open_file(r, s)) {
+        std::cout << "Cannot create " << s.path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool recorder_start(Recorder& r, int sample_rate, int block_frames)
+{
+    RecorderConfig& c = r.config;
+    if (!c.record_sh && !c.record_mic) return false;
+    r.sample_rate = sample_rate;
+    r.block_frames = block_frames;
+    c.write_bytes = (int)std::max(io_align, ((size_t)std::max(c.write_bytes, 0) + io_align - 1) / io_align * io_align);
+    r.rotate_frames = c.rotate_s > 0.0f
+        ? ((uint64_t)std::ceil(c.rotate_s * sample_rate / block_frames) * (uint64_t)block_frames) : 0;
+
+    char stamp[32];
+    time_t now = time(nullptr);
+    tm local;
+    localtime_r(&now, &local);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+    r.session = stamp;
+
+    // Queues: whole blocks, at least four of them
+    int capacity = std::max(4, (int)std::ceil(c.queue_s * sample_rate / block_frames)) * block_frames;
+    int sh_handle = -1, mic_handle = -1;
+    if (c.record_sh) sh_handle = r.arena.add_channels(16, capacity);
+    if (c.record_mic) mic_handle = r.arena.add_channels(19, capacity);
+    if (!r.arena.allocate()) {
+        std::cout << "Cannot allocate the recorder queues" << std::endl;
+        return false;
+    }
+    if (c.record_sh) {
+        r.sh.ring_storage = r.arena.channels(sh_handle);
+        r.sh.ring = new SpscFrameRing(r.sh.ring_storage, 16, capacity);
+        if (!init_stream(r, r.sh, "sh", 16, false)) {
+            recorder_stop(r);
+            return false;
+        }
+    }
+    if (c.record_mic) {
+        r.mic.ring_storage = r.arena.channels(mic_handle);
+        r.mic.ring = new SpscFrameRing(r.mic.ring_storage, 19, capacity);
+        if (!init_stream(r, r.mic, "mic", 19, true)) {
+            recorder_stop(r);
+            return false;
+        }
+    }
+
+    r.running.store(true);
+    r.thread = std::thread(writer_loop, &r);
+    return true;
+}
+
+static void stop_stream(Recorder& r, RecorderStream& s)
+{
+    if (s.fd >= 0 && !close_file(r, s)) {
+        std::cout << "Error finishing " << s.path << ": " << strerror(errno) << std::endl;
+    }
+    free(s.buffer);
+    s.buffer = nullptr;
+}
+
+Recorder::~Recorder()
+{
+    recorder_stop(*this);
+    delete sh.ring;
+    delete mic.ring;
+}
+
+void recorder_stop(Recorder& r)
+{
+    r.running.store(false, std::memory_order_release);
+    if (r.thread.joinable()) r.thread.join();
+    stop_stream(r, r.sh);
+    stop_stream(r, r.mic);
+}
+
+static void push_block(const Recorder& r, RecorderStream& s, const float* const* x)
+{
+    const int frames = r.block_frames;
+    // File replay produces faster than any disk; wait for the writer there.
+    // Live, a full queue costs this block, never the DSP deadline.
+    while (s.ring->write_space() < frames) {
+        if (!r.config.lossless) {
+            s.ring->note_dropped(frames);
+            return;
+        }
+        usleep(1000);
+    }
+    float* dst[32];
+    s.ring->write_region(dst, frames); // contiguous: the capacity is a multiple of the block
+    for (int ch = 0; ch < s.channels; ++ch) std::memcpy(dst[ch], x[ch], sizeof(float) * frames);
+    s.ring->commit_write(frames);
+}
+
+void recorder_push(Recorder& r, const float* const* sh, const float* const* mic)
+{
+    if (r.sh.buffer) push_block(r, r.sh, sh);
+    if (r.mic.buffer) push_block(r, r.mic, mic);
+}
+
+static void report_stream(const Recorder& r, const RecorderStream& s, FILE* out)
+{
+    if (!s.ring) return;
+    const SpscFrameRing& ring = *s.ring;
+    fprintf(out, "  %-3s %2d ch %s: %.1f s queued at most (%.0f%%), %llu blocks dropped", s.suffix, s.channels,
+            s.pcm24 ? "s24" : "f32", (double)s.max_fill.load() / r.sample_rate,
+            100.0 * s.max_fill.load() / ring.capacity(), (unsigned long long)ring.dropped_blocks());
+    if (s.blocks_lost.load()) fprintf(out, ", %llu lost to write errors", (unsigned long long)s.blocks_lost.load());
+    // Where the latest gap is, in stream time
+    const DiscontinuityLog& log = ring.discontinuities();
+    Discontinuity d;
+    if (log.count() && log.get(log.count() - 1, d)) {
+        fprintf(out, ", last at %.2f s", (double)d.stream_frame / r.sample_rate);
+    }
+    fprintf(out, "\n");
+}
+
+void recorder_report(const Recorder& r, FILE* out)
+{
+    uint64_t bytes = r.sh.bytes_written.load() + r.mic.bytes_written.load();
+    fprintf(out, "Recorder: %llu files, %.1f MB written to %s", (unsigned long long)r.files.load(), bytes / 1e6,
+            r.config.directory.c_str());
+    if (r.write_errors.load()) fprintf(out, ", %llu write errors", (unsigned long long)r.write_errors.load());
+    fprintf(out, "\n");
+    report_stream(r, r.sh, out);
+    report_stream(r, r.mic, out);
+}
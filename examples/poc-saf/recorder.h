@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include "buffer_arena.h"
+
+class SpscFrameRing;
+
+// Background recorder for the pipeline's signals: the 16 SH channels as an
+// AmbiX file (ACN channel order, SN3D normalisation, float32) and optionally
+// the 19 raw mic channels (packed 24-bit, so the file replays with --file).
+//
+// The DSP thread only copies each block into a lock-free SPSC ring per
+// stream (recorder_push never blocks, allocates or makes a syscall beyond a
+// semaphore post). A writer thread drains the rings, interleaves into a
+// page-aligned buffer and writes it in large chunks (write_bytes) with
+// O_DIRECT where the filesystem supports it, so the archive neither stalls
+// the DSP thread nor fills the page cache. If the writer falls more than
+// queue_s behind, whole blocks are dropped and logged as discontinuities of
+// the stream's ring instead.
+//
+// Files are WAVE_FORMAT_EXTENSIBLE with a 4 KiB header (so the data stays
+// block-aligned for O_DIRECT) that is rewritten on close: plain RIFF below
+// 4 GiB, RF64 (the reserved JUNK chunk becomes ds64) above. With rotate_s
+// a new pair of files starts every rotate_s seconds of audio:
+//   <directory>/<prefix>_<YYYYmmdd-HHMMSS>_<NNN>_sh.wav / _mic.wav
+
+struct RecorderConfig
+{
+    std::string directory = ".";
+    std::string prefix = "zylia";
+    bool record_sh = true;        // 16-channel AmbiX (ACN/SN3D) float32
+    bool record_mic = false;      // 19-channel raw mic signals, packed 24-bit
+    float rotate_s = 0.0f;        // > 0: start new files every rotate_s seconds of audio
+    float queue_s = 2.0f;         // audio buffered ahead of the writer before blocks are dropped
+    int write_bytes = 1 << 20;    // size of the writer's I/O requests (rounded to 4 KiB)
+    bool lossless = false;        // push waits for the writer instead of dropping (file replay)
+};
+
+// One recorded signal: its ring, its current file and its counters
+struct RecorderStream
+{
+    const char* suffix = "";
+    int channels = 0;
+    bool pcm24 = false;           // packed 24-bit, else float32
+    int sample_bytes = 4;
+
+    SpscFrameRing* ring = nullptr;
+    float** ring_storage = nullptr;
+
+    // Writer thread
+    int fd = -1;
+    bool direct = false;          // fd is O_DIRECT
+    uint8_t* buffer = nullptr;    // page-aligned staging buffer
+    size_t buffer_size = 0;
+    size_t buffered = 0;
+    uint64_t file_bytes = 0;      // data bytes in the current file, on disk or buffered
+    uint64_t file_frames = 0;
+    std::string path;
+    int file_index = 0;           // of the next file
+    bool failed = false;          // write error: the rest of the stream is discarded
+
+    // Statistics (written by the writer thread, read by anyone)
+    std::atomic<uint64_t> bytes_written{0};
+    std::atomic<uint64_t> blocks_lost{0};   // discarded by the writer after a write error
+    std::atomic<int> max_fill{0};           // ring high-water mark, frames
+};
+
+struct Recorder
+{
+    ~Recorder();
+
+    RecorderConfig config;
+
+    int sample_rate = 0;
+    int block_frames = 0;
+    uint64_t rotate_frames = 0;   // 0 = no rotation
+    std::string session;          // timestamp shared by all files of this run
+
+    RecorderStream sh;
+    RecorderStream mic;
+    BufferArena arena;            // backs both rings
+
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> files{0};         // files completed or open
+    std::atomic<uint64_t> write_errors{0};
+    std::thread thread;
+};
+
+// Allocates the rings, opens the first files and starts the writer thread
+bool recorder_start(Recorder& r, int sample_rate, int block_frames);
+// Drains everything queued, finalizes the headers and closes the files.
+// The statistics stay readable until the Recorder is destroyed.
+void recorder_stop(Recorder& r);
+
+// DSP thread: queues one block. sh (16 x block_frames) is needed with
+// record_sh, mic (19 x block_frames) with record_mic.
+void recorder_push(Recorder& r, const float* const* sh, const float* const* mic);
+
+// Files, volume written, dropped blocks and how full the queues got
+void recorder_report(const Recorder& r, FILE* out);
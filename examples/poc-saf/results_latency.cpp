@@ -0,0 +1,166 @@
+// Localhost latency test of the DoA results channel (no audio, no SAF).
+//
+//   ./results_latency [--records N] [--interval-us US] [--readers K] [--clients C]
+//
+// Forks K shared-memory readers (DoaResultsReader::wait) and C socket
+// clients (DoaStreamClient), then publishes N records from this process the
+// way the DSP thread does, one every US microseconds (default: one sldoa
+// update at 48 kHz). Every reader reports how long records took from
+// results_commit() to arriving in its process, and the writer reports what
+// publishing cost it, i.e. what the DSP thread pays.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "doa_results_reader.h"
+#include "results_publisher.h"
+#include "stage_stats.h"
+
+struct LatencyOptions
+{
+    int records = 2000;
+    int interval_us = 10667; // 512 frames at 48 kHz
+    int readers = 2;
+    int clients = 1;
+};
+
+static const char* const test_shm = "/ssl-doa-latency-test";
+
+static std::string test_socket()
+{
+    return "/tmp/ssl-doa-latency-test-" + std::to_string(getpid()) + ".sock";
+}
+
+static void print_histogram(const char* what, const LatencyHistogram& h, uint64_t lost)
+{
+    printf("%-22s %6llu records, %4llu lost, latency p50 %7.1f us, p99 %7.1f us, p99.9 %7.1f us, max %7.1f us\n",
+           what, (unsigned long long)h.count(), (unsigned long long)lost, h.percentile(50) / 1e3,
+           h.percentile(99) / 1e3, h.percentile(99.9) / 1e3, h.max() / 1e3);
+    fflush(stdout);
+}
+
+// Reader process: attach (retrying until the writer is up), signal ready,
+// then measure until the last record or a quiet second
+static int run_reader(int index, bool socket, const std::string& socket_path, int ready_fd, int records)
+{
+    DoaResultsReader reader;
+    DoaStreamClient client;
+    for (int attempt = 0; attempt < 200; ++attempt) {
+        if (socket ? client.connect(socket_path.c_str()) : reader.attach(test_shm)) break;
+        usleep(10000);
+    }
+    if (socket ? !client.connected() : !reader.attached()) {
+        fprintf(stderr, "reader %d: cannot attach\n", index);
+        return 1;
+    }
+    char ready = 1;
+    if (write(ready_fd, &ready, 1) != 1) return 1;
+    close(ready_fd);
+
+    static LatencyHistogram latency;
+    DoaRecord record;
+    uint64_t received = 0, last = 0;
+    for (;;) {
+        bool got = socket ? client.receive(record, 1000) : reader.wait(record, 1000);
+        if (!got) break;
+        latency.record(monotonic_ns() - record.timestamp_ns);
+        ++received;
+        last = record.sequence;
+        if (record.sequence + 1 >= (uint64_t)records) break;
+    }
+    std::string what = std::string(socket ? "socket client " : "shm reader ") + std::to_string(index) + ":";
+    uint64_t lost = socket ? (received ? last + 1 - received : records) : reader.lost();
+    print_histogram(what.c_str(), latency, lost);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    LatencyOptions opts;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--records" && has_value) opts.records = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--interval-us" && has_value) opts.interval_us = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--readers" && has_value) opts.readers = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--clients" && has_value) opts.clients = std::max(0, std::atoi(argv[++i]));
+        else {
+            fprintf(stderr, "Usage: %s [--records N] [--interval-us US] [--readers K] [--clients C]\n", argv[0]);
+            return -1;
+        }
+    }
+    const std::string socket_path = test_socket();
+
+    // Readers first, before this process has any threads
+    int ready_pipe[2];
+    if (pipe(ready_pipe) != 0) return -1;
+    const int num_children = opts.readers + opts.clients;
+    for (int i = 0; i < num_children; ++i) {
+        pid_t pid = fork();
+        if (pid < 0) return -1;
+        if (pid == 0) {
+            close(ready_pipe[0]);
+            bool socket = i >= opts.readers;
+            _exit(run_reader(socket ? i - opts.readers : i, socket, socket_path, ready_pipe[1], opts.records));
+        }
+    }
+    close(ready_pipe[1]);
+
+    ResultsPublisher publisher;
+    if (!results_publisher_start(publisher, test_shm, opts.clients ? socket_path.c_str() : nullptr)) return -1;
+    for (int i = 0; i < num_children; ++i) {
+        char ready;
+        if (read(ready_pipe[0], &ready, 1) != 1) break;
+    }
+    close(ready_pipe[0]);
+    // Let the socket thread accept everyone before the first record
+    while (publisher.stream_clients.load() < opts.clients) usleep(1000);
+
+    printf("Publishing %d records (%zu bytes each) every %d us to %d shm readers and %d socket clients\n",
+           opts.records, sizeof(DoaRecord), opts.interval_us, opts.readers, opts.clients);
+    fflush(stdout);
+
+    // Writer, as the DSP thread would: fill in place, commit, wait for the next update
+    static LatencyHistogram publish_cost;
+    uint64_t next = monotonic_ns();
+    for (int n = 0; n < opts.records; ++n) {
+        next += (uint64_t)opts.interval_us * 1000ull;
+        uint64_t start = monotonic_ns();
+        DoaRecord& r = results_begin(publisher);
+        r.stream_frame = (uint64_t)n * 512;
+        r.device_frame = r.stream_frame;
+        r.capture_monotonic_ns = 0;
+        r.capture_realtime_ns = 0;
+        r.sample_rate = 48000;
+        r.method = 0;
+        r.array_id = 0;
+        r.azimuth_deg = (float)(n % 360) - 180.0f;
+        r.elevation_deg = 0.0f;
+        r.strength = 0.5f;
+        r.input_db = -30.0f;
+        r.sh_db = -30.0f;
+        r.gate_open = 1;
+        r.num_tracks = 0;
+        r.start_band = 0;
+        r.num_bands = 64;
+        for (int b = 0; b < r.num_bands; ++b) r.bands[b] = {r.azimuth_deg, 0.0f, 0.5f};
+        results_commit(publisher);
+        publish_cost.record(monotonic_ns() - start);
+
+        uint64_t now = monotonic_ns();
+        if (next > now) usleep((useconds_t)((next - now) / 1000));
+    }
+
+    for (int i = 0; i < num_children; ++i) wait(nullptr);
+    printf("%-22s %6llu records, publish cost p50 %7.2f us, p99 %7.2f us, max %7.2f us\n", "writer (DSP thread):",
+           (unsigned long long)publish_cost.count(), publish_cost.percentile(50) / 1e3,
+           publish_cost.percentile(99) / 1e3, publish_cost.max() / 1e3);
+    if (opts.clients) {
+        printf("socket records dropped for slow clients: %llu\n", (unsigned long long)publisher.stream_dropped.load());
+    }
+    results_publisher_stop(publisher);
+    return 0;
+}
@@ -0,0 +1,246 @@
+#include "results_publisher.h"
+#include "doa_results_reader.h"
+#include "stage_stats.h"
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+const int max_stream_clients = 16;
+
+static void futex_wake_all(std::atomic<uint32_t>* word)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// Writer of an existing ring under `name`, or 0 if there is none, it is not
+// a results ring, or its writer is gone
+static int32_t live_writer(const char* name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return 0;
+    struct stat st;
+    void* mem = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(DoaResultsHeader)) {
+        mem = mmap(nullptr, sizeof(DoaResultsHeader), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mem == MAP_FAILED) return 0;
+    const DoaResultsHeader* h = static_cast<const DoaResultsHeader*>(mem);
+    int32_t pid = h->magic == doa_results_magic ? h->writer_pid : 0;
+    munmap(mem, sizeof(DoaResultsHeader));
+    if (pid > 0 && (kill(pid, 0) == 0 || errno == EPERM)) return pid;
+    return 0;
+}
+
+static bool create_ring(ResultsPublisher& p, const char* name)
+{
+    // A ring left behind by a crashed writer is replaced, not reused; a live
+    // writer's ring is left alone
+    int32_t owner = live_writer(name);
+    if (owner > 0) {
+        std::cout << "Shared memory " << name << " is in use by process " << owner
+                  << " (choose another name with --publish-name)" << std::endl;
+        return false;
+    }
+    shm_unlink(name);
+    // O_EXCL: of two writers starting at once, one fails here
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (fd < 0) {
+        std::cout << "Cannot create shared memory " << name << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    size_t size = doa_results_size((uint32_t)p.capacity);
+    void* mem = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0) mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        std::cout << "Cannot map shared memory " << name << ": " << strerror(errno) << std::endl;
+        shm_unlink(name);
+        return false;
+    }
+
+    // Touch every page now, not on the DSP thread
+    std::memset(mem, 0, size);
+    DoaResultsHeader* h = new (mem) DoaResultsHeader();
+    h->version = doa_results_version;
+    h->record_size = sizeof(DoaRecord);
+    h->capacity = (uint32_t)p.capacity;
+    h->writer_pid = (int32_t)getpid();
+    h->session = monotonic_ns() ^ ((uint64_t)getpid() << 40);
+    h->head.store(0, std::memory_order_relaxed);
+    h->notify.store(0, std::memory_order_relaxed);
+    DoaResultsSlot* slots = doa_results_slots(h);
+    for (int i = 0; i < p.capacity; ++i) slots[i].seq.store(0, std::memory_order_relaxed);
+    // Readers check the magic on attach, so it goes in last
+    std::atomic_thread_fence(std::memory_order_release);
+    h->magic = doa_results_magic;
+
+    p.header = h;
+    p.slots = slots;
+    p.size = size;
+    p.shm_name = name;
+    p.next_sequence = 0;
+    return true;
+}
+
+static int listen_on(const char* path)
+{
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (std::strlen(path) >= sizeof(addr.sun_path)) {
+        std::cout << "Socket path too long: " << path << std::endl;
+        return -1;
+    }
+    std::strcpy(addr.sun_path, path);
+    unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 8) != 0) {
+        std::cout << "Cannot listen on " << path << ": " << strerror(errno) << std::endl;
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Notifier thread: the DSP thread only publishes head; blocked readers are
+// woken from here, at most once per interval
+static void notify_loop(ResultsPublisher* p)
+{
+    DoaResultsHeader* h = p->header;
+    uint64_t seen = h->head.load(std::memory_order_acquire);
+    const long interval_ns = (long)p->notify_interval_us * 1000L;
+    while (p->notifying.load(std::memory_order_relaxed)) {
+        timespec ts = {interval_ns / 1000000000L, interval_ns % 1000000000L};
+        nanosleep(&ts, nullptr);
+        const uint64_t head = h->head.load(std::memory_order_acquire);
+        if (head == seen) continue;
+        seen = head;
+        // Pairs with DoaResultsReader::wait(): a reader that read notify
+        // before this bump is woken; one that read it after sees the records.
+        // Readers do not register, so the wake is unconditional, once per batch.
+        h->notify.fetch_add(1, std::memory_order_release);
+        futex_wake_all(&h->notify);
+    }
+}
+
+// Streaming thread: one more reader of the ring, fanning records out to the
+// socket clients without ever blocking on them
+static void stream_loop(ResultsPublisher* p)
+{
+    DoaResultsReader reader;
+    if (!reader.attach(p->shm_name.c_str())) {
+        std::cerr << "Results stream: cannot attach to " << p->shm_name << std::endl;
+        return;
+    }
+    int clients[max_stream_clients];
+    int num_clients = 0;
+    DoaStreamHello hello = {doa_results_magic, doa_results_version, (uint32_t)sizeof(DoaRecord), 0,
+                            reader.session()};
+    DoaRecord record;
+
+    while (p->running.load(std::memory_order_relaxed)) {
+        for (;;) {
+            int fd = accept4(p->listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) break;
+            if (num_clients == max_stream_clients ||
+                send(fd, &hello, sizeof(hello), MSG_DONTWAIT | MSG_NOSIGNAL) != (ssize_t)sizeof(hello)) {
+                close(fd);
+                continue;
+            }
+            clients[num_clients++] = fd;
+        }
+        p->stream_clients.store(num_clients, std::memory_order_relaxed);
+
+        // Short timeout, so new clients and stop() are noticed while silent
+        if (!reader.wait(record, 50)) continue;
+        for (int i = num_clients - 1; i >= 0; --i) {
+            if (send(clients[i], &record, sizeof(record), MSG_DONTWAIT | MSG_NOSIGNAL) == (ssize_t)sizeof(record)) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                p->stream_dropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            close(clients[i]); // gone
+            clients[i] = clients[--num_clients];
+        }
+    }
+    for (int i = 0; i < num_clients; ++i) close(clients[i]);
+    p->stream_clients.store(0, std::memory_order_relaxed);
+}
+
+bool results_publisher_start(ResultsPublisher& p, const char* shm_name, const char* socket_path)
+{
+    if (p.capacity < 2) p.capacity = 2;
+    if (p.notify_interval_us < 50) p.notify_interval_us = 50;
+    if (!create_ring(p, shm_name)) return false;
+    p.notifying.store(true);
+    p.notifier = std::thread(notify_loop, &p);
+    if (!socket_path) return true;
+
+    p.listen_fd = listen_on(socket_path);
+    if (p.listen_fd < 0) {
+        results_publisher_stop(p);
+        return false;
+    }
+    p.socket_path = socket_path;
+    p.running.store(true);
+    p.thread = std::thread(stream_loop, &p);
+    return true;
+}
+
+void results_publisher_stop(ResultsPublisher& p)
+{
+    p.running.store(false);
+    if (p.thread.joinable()) p.thread.join();
+    p.notifying.store(false);
+    if (p.notifier.joinable()) p.notifier.join();
+    if (p.listen_fd >= 0) {
+        close(p.listen_fd);
+        unlink(p.socket_path.c_str());
+        p.listen_fd = -1;
+    }
+    if (p.header) {
+        // Wake blocked readers so they can notice the writer is gone
+        p.header->writer_pid = 0;
+        p.header->notify.fetch_add(1, std::memory_order_release);
+        futex_wake_all(&p.header->notify);
+        munmap(p.header, p.size);
+        shm_unlink(p.shm_name.c_str());
+        p.header = nullptr;
+        p.slots = nullptr;
+    }
+}
+
+DoaRecord& results_begin(ResultsPublisher& p)
+{
+    DoaResultsSlot& slot = p.slots[p.next_sequence % (uint64_t)p.capacity];
+    // Seqlock write side: odd while the record is inconsistent
+    slot.seq.store(2 * p.next_sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return slot.record;
+}
+
+void results_commit(ResultsPublisher& p)
+{
+    const uint64_t n = p.next_sequence++;
+    DoaResultsSlot& slot = p.slots[n % (uint64_t)p.capacity];
+    slot.record.sequence = n;
+    slot.record.timestamp_ns = monotonic_ns();
+    slot.seq.store(2 * (n + 1), std::memory_order_release);
+    // Readers are woken by the notifier thread, not from here
+    p.header->head.store(n + 1, std::memory_order_release);
+}
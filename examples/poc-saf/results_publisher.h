@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include "doa_results.h"
+
+// Writer side of the DoA results channel (see doa_results.h).
+//
+// The DSP thread fills one record per update straight into the shared-memory
+// ring: results_begin() / results_commit() never block, never allocate and
+// make no syscalls. Readers blocked in DoaResultsReader::wait() are woken by
+// a notifier thread instead, which polls the ring's head every
+// notify_interval_us and wakes them once per batch of new records: that
+// bounds the extra delivery latency, and neither the wake syscall nor the
+// woken readers run on the DSP thread's time.
+//
+// With a socket path, a streaming thread serves the same records over a
+// SOCK_SEQPACKET Unix-domain socket. It reads the ring like any other reader,
+// so clients never touch the DSP thread; a client that does not keep up has
+// records dropped (counted in stream_dropped) rather than queued.
+struct ResultsPublisher
+{
+    int capacity = 256;                    // records in the ring (~2.7 s of sldoa updates)
+    int notify_interval_us = 500;          // how often the notifier looks for new records
+
+    // Writer state (DSP thread)
+    DoaResultsHeader* header = nullptr;
+    DoaResultsSlot* slots = nullptr;
+    size_t size = 0;
+    uint64_t next_sequence = 0;
+    std::string shm_name;
+
+    // Notifier: wakes blocked readers once per new batch of records
+    std::atomic<bool> notifying{false};
+    std::thread notifier;
+
+    // Socket stream
+    std::string socket_path;
+    int listen_fd = -1;
+    std::atomic<bool> running{false};
+    std::atomic<int> stream_clients{0};
+    std::atomic<uint64_t> stream_dropped{0}; // records not sent to slow clients
+    std::thread thread;
+};
+
+// Creates the ring under shm_name (replacing a stale one), starts the
+// notifier and, with a socket_path, the streaming thread
+bool results_publisher_start(ResultsPublisher& p, const char* shm_name = doa_results_default_name,
+                             const char* socket_path = nullptr);
+// Stops streaming and removes the ring and the socket; attached readers
+// keep their mapping but see writer_alive() == false
+void results_publisher_stop(ResultsPublisher& p);
+
+// DSP thread: the record to fill for the next update. Everything but
+// sequence and timestamp_ns, which results_commit() sets.
+DoaRecord& results_begin(ResultsPublisher& p);
+void results_commit(ResultsPublisher& p);
@@ -0,0 +1,75 @@
+#include "rt_alloc_guard.h"
+
+#ifdef SSL_RT_ALLOC_GUARD
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+// glibc's real allocator entry points
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+// initial-exec TLS: reading it must not itself allocate
+static __thread int no_alloc_depth __attribute__((tls_model("initial-exec"))) = 0;
+
+void rt_alloc_guard_enter() { ++no_alloc_depth; }
+void rt_alloc_guard_leave() { --no_alloc_depth; }
+
+static void check(const char* what)
+{
+    if (no_alloc_depth == 0) return;
+
+    no_alloc_depth = 0; // let abort() and anything it pulls in allocate
+    const char prefix[] = "rt_alloc_guard: ";
+    const char suffix[] = " called on the audio thread\n";
+    (void)!write(STDERR_FILENO, prefix, sizeof(prefix) - 1);
+    (void)!write(STDERR_FILENO, what, std::strlen(what));
+    (void)!write(STDERR_FILENO, suffix, sizeof(suffix) - 1);
+    std::abort();
+}
+
+extern "C" {
+
+void* malloc(size_t size)
+{
+    check("malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size)
+{
+    check("calloc");
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    check("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    check("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+    check("posix_memalign");
+    void* p = __libc_memalign(alignment, size);
+    if (!p) return ENOMEM;
+    *ptr = p;
+    return 0;
+}
+
+} // extern "C"
+
+#endif // SSL_RT_ALLOC_GUARD
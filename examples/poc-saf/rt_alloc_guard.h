@@ -0,0 +1,30 @@
+#pragma once
+
+// Debug check that the audio hot path never touches the heap.
+//
+// With SSL_RT_ALLOC_GUARD defined (Debug builds, see CMakeLists.txt) malloc,
+// calloc, realloc and the aligned variants are wrapped; any call made by a
+// thread inside a ScopedNoAlloc region prints the offending call and aborts.
+// Otherwise ScopedNoAlloc compiles to nothing.
+
+#ifdef SSL_RT_ALLOC_GUARD
+
+void rt_alloc_guard_enter();
+void rt_alloc_guard_leave();
+
+struct ScopedNoAlloc
+{
+    ScopedNoAlloc() { rt_alloc_guard_enter(); }
+    ~ScopedNoAlloc() { rt_alloc_guard_leave(); }
+    ScopedNoAlloc(const ScopedNoAlloc&) = delete;
+    ScopedNoAlloc& operator=(const ScopedNoAlloc&) = delete;
+};
+
+#else
+
+struct ScopedNoAlloc
+{
+    ScopedNoAlloc() {}
+};
+
+#endif
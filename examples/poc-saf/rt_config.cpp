@@ -0,0 +1,89 @@
+#include "rt_config.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// A frame this large is only ever touched once, here; the pages stay mapped
+// (and locked) for the thread's lifetime
+__attribute__((noinline)) static void prefault_stack()
+{
+    volatile uint8_t stack[rt_stack_prefault_bytes];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) stack[i] = 0;
+}
+
+int rt_priority_limit()
+{
+    rlimit limit;
+    if (getrlimit(RLIMIT_RTPRIO, &limit) != 0) return 0;
+    return limit.rlim_cur == RLIM_INFINITY ? 99 : (int)limit.rlim_cur;
+}
+
+bool rt_apply_thread(const char* name, const RtThreadConfig& config)
+{
+    bool ok = true;
+    if (config.cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(config.cpu, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err) {
+            std::cerr << "Warning: cannot pin the " << name << " thread to CPU " << config.cpu << ": "
+                      << strerror(err) << std::endl;
+            ok = false;
+        }
+    }
+
+    if (config.priority > 0) {
+        sched_param param = {};
+        param.sched_priority = config.priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err) {
+            std::cerr << "Warning: cannot run the " << name << " thread as SCHED_FIFO " << config.priority << ": "
+                      << strerror(err);
+            if (err == EPERM) {
+                std::cerr << " (rtprio limit " << rt_priority_limit() << "; needs CAP_SYS_NICE or a higher "
+                          << "rtprio in /etc/security/limits.conf)";
+            }
+            std::cerr << ", staying SCHED_OTHER" << std::endl;
+            ok = false;
+        }
+    }
+
+    prefault_stack();
+    return ok;
+}
+
+bool rt_lock_memory()
+{
+    // Freed memory is neither trimmed nor unmapped, so it stays locked and
+    // is not faulted in again when reused
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    // Under a finite memlock limit, MCL_FUTURE would make any later mapping
+    // beyond it fail (a new thread stack, a large malloc); lock what exists
+    // now and leave later allocations unlocked instead
+    rlimit limit = {};
+    getrlimit(RLIMIT_MEMLOCK, &limit);
+    const bool future = limit.rlim_cur == RLIM_INFINITY || geteuid() == 0;
+    if (mlockall(MCL_CURRENT | (future ? MCL_FUTURE : 0)) != 0) {
+        int err = errno;
+        std::cerr << "Warning: cannot lock memory: " << strerror(err);
+        if (err == ENOMEM || err == EPERM) {
+            std::cerr << " (memlock limit ";
+            if (limit.rlim_cur == RLIM_INFINITY) std::cerr << "unlimited";
+            else std::cerr << limit.rlim_cur / 1024 << " KiB";
+            std::cerr << "; raise it with ulimit -l / limits.conf or grant CAP_IPC_LOCK)";
+        }
+        std::cerr << ", page faults stay possible" << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+// Real-time setup for the audio threads (capture and DSP).
+//
+// Every step is best effort: without the privilege for it (CAP_SYS_NICE /
+// an rtprio limit for SCHED_FIFO, CAP_IPC_LOCK / a memlock limit for
+// mlockall) a warning explains what to configure and the thread or process
+// carries on as before. Typical limits.conf entries for the audio group:
+//   @audio - rtprio 95
+//   @audio - memlock unlimited
+
+struct RtThreadConfig
+{
+    int priority = 0;  // SCHED_FIFO priority 1..99; 0 = stay SCHED_OTHER
+    int cpu = -1;      // pin to this CPU; -1 = any
+};
+
+// Stack prefaulted by rt_apply_thread: well above what the audio path uses
+const size_t rt_stack_prefault_bytes = 256 * 1024;
+
+// Applies the config to the calling thread and touches the first
+// rt_stack_prefault_bytes of its stack so they are resident (and, after
+// rt_lock_memory, locked). Threads created afterwards by this thread inherit
+// its policy and affinity, so start helper threads before calling this.
+// Returns false if anything could not be applied.
+bool rt_apply_thread(const char* name, const RtThreadConfig& config);
+
+// mlockall, and keeps freed heap memory mapped so it stays locked. Call it
+// once the buffers are allocated (BufferArena touches all of its pages in
+// allocate()). With an unlimited memlock limit or as root, later mappings
+// are locked too (MCL_FUTURE); otherwise only the current ones, so that
+// allocations past the limit do not start failing. Returns false if the
+// memory could not be locked.
+bool rt_lock_memory();
+
+// Highest SCHED_FIFO priority this process may use without privileges
+// (RLIMIT_RTPRIO)
+int rt_priority_limit();
@@ -0,0 +1,386 @@
+#include "sample_convert.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SSL_HAVE_X86_KERNELS 1
+#endif
+
+static const float k_scale = 1.0f / 8388608.0f; // 2^23 for 24-bit normalization
+
+// Source bytes per sample, as a compile-time constant for the kernels
+template <SampleFormat FMT>
+constexpr int sample_bytes = FMT == SampleFormat::S24_3LE ? 3 : 4;
+
+// Reads one sample as a sign-extended 24-bit value. S32_LE keeps its top 24
+// bits, the resolution of the converters behind it, so all formats share
+// one scale and produce identical floats for the same audio.
+template <SampleFormat FMT>
+static inline int32_t load_sample(const uint8_t* p)
+{
+    uint32_t v;
+    if (FMT == SampleFormat::S24_3LE) {
+        v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+    } else {
+        std::memcpy(&v, p, 4);
+    }
+    if (FMT == SampleFormat::S32_LE) return (int32_t)v >> 8;
+    return (int32_t)(v << 8) >> 8;
+}
+
+// Channel-outer loop: strided loads, but contiguous stores into each channel
+template <SampleFormat FMT>
+static void convert_scalar(const void* src, float* const* dst, int num_frames, int num_channels, LevelAccum*)
+{
+    const uint8_t* base = (const uint8_t*)src;
+    const size_t frame_bytes = (size_t)sample_bytes<FMT> * num_channels;
+
+    for (int ch = 0; ch < num_channels; ++ch) {
+        const uint8_t* p = base + ch * sample_bytes<FMT>;
+        float* out = dst[ch];
+        for (int f = 0; f < num_frames; ++f) out[f] = (float)load_sample<FMT>(p + f * frame_bytes) * k_scale;
+    }
+}
+
+// Scalar metering stays a second pass over the converted block: fused, the
+// serial peak / sum chain holds up the strided loads and the pair is slower
+// than the two loops (convert_bench), and the pass picks up measure_levels'
+// vector path where the target has one
+template <SampleFormat FMT>
+static void convert_scalar_metered(const void* src, float* const* dst, int num_frames, int num_channels,
+                                   LevelAccum* levels)
+{
+    convert_scalar<FMT>(src, dst, num_frames, num_channels, nullptr);
+    measure_levels(dst, num_channels, num_frames, levels);
+}
+
+#ifdef SSL_HAVE_X86_KERNELS
+
+// The vector kernels always load 32 bits per sample; for packed S24_3LE that
+// reads one byte past the sample (discarded by the shift-left). The final
+// frame is therefore left to the scalar tail so we never read past the buffer.
+template <SampleFormat FMT>
+static inline int vector_frame_limit(int num_frames)
+{
+    return FMT == SampleFormat::S24_3LE ? num_frames - 1 : num_frames;
+}
+
+static inline int32_t load_u32(const uint8_t* p)
+{
+    int32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+__attribute__((target("sse2")))
+static inline float hmax_ps(__m128 v)
+{
+    v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(_mm_max_ss(v, _mm_shuffle_ps(v, v, 1)));
+}
+
+__attribute__((target("sse2")))
+static inline float hsum_ps(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(_mm_add_ss(v, _mm_shuffle_ps(v, v, 1)));
+}
+
+template <SampleFormat FMT, bool METER>
+__attribute__((target("sse2")))
+static void convert_sse2(const void* src, float* const* dst, int num_frames, int num_channels,
+                         LevelAccum* levels)
+{
+    const uint8_t* base = (const uint8_t*)src;
+    const size_t frame_bytes = (size_t)sample_bytes<FMT> * num_channels;
+    const __m128 scale = _mm_set1_ps(k_scale);
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const int limit = vector_frame_limit<FMT>(num_frames);
+
+    for (int ch = 0; ch < num_channels; ++ch) {
+        const uint8_t* p = base + ch * sample_bytes<FMT>;
+        float* out = dst[ch];
+        __m128 vpeak = _mm_setzero_ps();
+        __m128 vsq = _mm_setzero_ps();
+        int f = 0;
+        for (; f + 4 <= limit; f += 4) {
+            const uint8_t* q = p + f * frame_bytes;
+            __m128i v = _mm_setr_epi32(load_u32(q), load_u32(q + frame_bytes),
+                                       load_u32(q + 2 * frame_bytes), load_u32(q + 3 * frame_bytes));
+            v = FMT == SampleFormat::S32_LE ? _mm_srai_epi32(v, 8) : _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+            __m128 x = _mm_mul_ps(_mm_cvtepi32_ps(v), scale);
+            _mm_storeu_ps(out + f, x);
+            if (METER) {
+                vpeak = _mm_max_ps(vpeak, _mm_and_ps(x, abs_mask));
+                vsq = _mm_add_ps(vsq, _mm_mul_ps(x, x));
+            }
+        }
+        float peak = 0.0f, sum_sq = 0.0f;
+        if (METER) {
+            peak = hmax_ps(vpeak);
+            sum_sq = hsum_ps(vsq);
+        }
+        for (; f < num_frames; ++f) {
+            float x = (float)load_sample<FMT>(p + f * frame_bytes) * k_scale;
+            out[f] = x;
+            if (METER) {
+                peak = std::max(peak, std::fabs(x));
+                sum_sq += x * x;
+            }
+        }
+        if (METER) levels[ch].add(peak, sum_sq);
+    }
+}
+
+// Loads 8 consecutive channels of one frame as sign-extended 32-bit ints.
+// S24_3LE rows are 24 bytes, but 32 are read (see vector_frame_limit()).
+template <SampleFormat FMT>
+__attribute__((target("avx2")))
+static inline __m256i load_row8_avx2(const uint8_t* p)
+{
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    if (FMT == SampleFormat::S24_3LE) {
+        // Bytes 0..11 to the low lane, 12..23 to the high lane, then move each
+        // sample into the top three bytes of its dword so srai does the sign extension
+        v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6));
+        const __m256i spread = _mm256_setr_epi8(
+            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+        return _mm256_srai_epi32(_mm256_shuffle_epi8(v, spread), 8);
+    }
+    if (FMT == SampleFormat::S32_LE) return _mm256_srai_epi32(v, 8);
+    return _mm256_srai_epi32(_mm256_slli_epi32(v, 8), 8);
+}
+
+__attribute__((target("avx2")))
+static inline float hmax256_ps(__m256 v)
+{
+    return hmax_ps(_mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+__attribute__((target("avx2")))
+static inline float hsum256_ps(__m256 v)
+{
+    return hsum_ps(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+// 8 frames x 8 channels per tile: contiguous row loads, an in-register 8x8
+// transpose, and contiguous stores into each channel. The last tile is shifted
+// left to end on the last channel (19 channels -> tiles at 0, 8 and 11), so
+// rows never cross into the next frame; overlapping channels are just
+// written twice with the same values (and metered only once).
+// Tiles are the outer loop so each tile's level accumulators stay in registers.
+template <SampleFormat FMT, bool METER>
+__attribute__((target("avx2")))
+static void convert_avx2(const void* src, float* const* dst, int num_frames, int num_channels,
+                         LevelAccum* levels)
+{
+    if (num_channels < 8) {
+        convert_sse2<FMT, METER>(src, dst, num_frames, num_channels, levels);
+        return;
+    }
+
+    const uint8_t* base = (const uint8_t*)src;
+    const size_t frame_bytes = (size_t)sample_bytes<FMT> * num_channels;
+    const __m256 scale = _mm256_set1_ps(k_scale);
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    const int limit = vector_frame_limit<FMT>(num_frames);
+    const int vector_frames = limit > 0 ? limit / 8 * 8 : 0;
+
+    int metered_end = 0; // channels below this were metered by an earlier tile
+    for (int c0 = 0; c0 < num_channels; c0 += 8) {
+        if (c0 + 8 > num_channels) c0 = num_channels - 8;
+
+        __m256 vpeak[8], vsq[8];
+        for (int i = 0; i < 8; ++i) {
+            vpeak[i] = _mm256_setzero_ps();
+            vsq[i] = _mm256_setzero_ps();
+        }
+
+        for (int f = 0; f < vector_frames; f += 8) {
+            const uint8_t* p = base + f * frame_bytes + c0 * sample_bytes<FMT>;
+
+            __m256 r[8];
+            for (int i = 0; i < 8; ++i) {
+                r[i] = _mm256_mul_ps(_mm256_cvtepi32_ps(load_row8_avx2<FMT>(p + i * frame_bytes)), scale);
+            }
+
+            __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+            __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+            __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+            __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+            __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+            __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+            __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+            __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+            __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+            __m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+            __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+            __m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+            __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+            __m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+            __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+            __m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+            __m256 o[8];
+            o[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+            o[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+            o[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+            o[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+            o[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+            o[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+            o[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+            o[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+            for (int i = 0; i < 8; ++i) {
+                _mm256_storeu_ps(dst[c0 + i] + f, o[i]);
+                if (METER) {
+                    vpeak[i] = _mm256_max_ps(vpeak[i], _mm256_and_ps(o[i], abs_mask));
+                    vsq[i] = _mm256_add_ps(vsq[i], _mm256_mul_ps(o[i], o[i]));
+                }
+            }
+        }
+
+        if (METER) {
+            for (int i = std::max(metered_end - c0, 0); i < 8; ++i) {
+                levels[c0 + i].add(hmax256_ps(vpeak[i]), hsum256_ps(vsq[i]));
+            }
+            metered_end = c0 + 8;
+        }
+    }
+
+    for (int ch = 0; ch < num_channels; ++ch) {
+        const uint8_t* p = base + ch * sample_bytes<FMT>;
+        float peak = 0.0f, sum_sq = 0.0f;
+        for (int t = vector_frames; t < num_frames; ++t) {
+            float x = (float)load_sample<FMT>(p + t * frame_bytes) * k_scale;
+            dst[ch][t] = x;
+            if (METER) {
+                peak = std::max(peak, std::fabs(x));
+                sum_sq += x * x;
+            }
+        }
+        if (METER) levels[ch].add(peak, sum_sq);
+    }
+}
+
+// GCC 12's AVX-512 intrinsics start from _mm512_undefined_*() and trip
+// -Wmaybe-uninitialized at -O2 once inlined; the kernel below sticks to the
+// masked forms with a full mask and a zero source, which compile to the
+// same instructions.
+static const __mmask16 k_all16 = 0xFFFF;
+
+__attribute__((target("avx512f")))
+static inline float hmax512_ps(__m512 v)
+{
+    __m256 lo = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xFF, _mm512_castps_pd(v), 0));
+    __m256 hi = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xFF, _mm512_castps_pd(v), 1));
+    return hmax256_ps(_mm256_max_ps(lo, hi));
+}
+
+__attribute__((target("avx512f")))
+static inline float hsum512_ps(__m512 v)
+{
+    __m256 lo = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xFF, _mm512_castps_pd(v), 0));
+    __m256 hi = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xFF, _mm512_castps_pd(v), 1));
+    return hsum256_ps(_mm256_add_ps(lo, hi));
+}
+
+template <SampleFormat FMT, bool METER>
+__attribute__((target("avx512f")))
+static void convert_avx512(const void* src, float* const* dst, int num_frames, int num_channels,
+                           LevelAccum* levels)
+{
+    const uint8_t* base = (const uint8_t*)src;
+    const int frame_bytes = sample_bytes<FMT> * num_channels;
+    const __m512i offsets = _mm512_mullo_epi32(
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+        _mm512_set1_epi32(frame_bytes));
+    const __m512 scale = _mm512_set1_ps(k_scale);
+    const int limit = vector_frame_limit<FMT>(num_frames);
+
+    for (int ch = 0; ch < num_channels; ++ch) {
+        const uint8_t* p = base + ch * sample_bytes<FMT>;
+        float* out = dst[ch];
+        __m512 vpeak = _mm512_setzero_ps();
+        __m512 vsq = _mm512_setzero_ps();
+        int f = 0;
+        for (; f + 16 <= limit; f += 16) {
+            __m512i v = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), k_all16, offsets,
+                                                    (const void*)(p + (size_t)f * frame_bytes), 1);
+            v = FMT == SampleFormat::S32_LE
+                    ? _mm512_maskz_srai_epi32(k_all16, v, 8)
+                    : _mm512_maskz_srai_epi32(k_all16, _mm512_maskz_slli_epi32(k_all16, v, 8), 8);
+            __m512 x = _mm512_mul_ps(_mm512_maskz_cvtepi32_ps(k_all16, v), scale);
+            _mm512_storeu_ps(out + f, x);
+            if (METER) {
+                vpeak = _mm512_maskz_max_ps(k_all16, vpeak, _mm512_abs_ps(x));
+                vsq = _mm512_add_ps(vsq, _mm512_mul_ps(x, x));
+            }
+        }
+        float peak = 0.0f, sum_sq = 0.0f;
+        if (METER) {
+            peak = hmax512_ps(vpeak);
+            sum_sq = hsum512_ps(vsq);
+        }
+        for (; f < num_frames; ++f) {
+            float x = (float)load_sample<FMT>(p + (size_t)f * frame_bytes) * k_scale;
+            out[f] = x;
+            if (METER) {
+                peak = std::max(peak, std::fabs(x));
+                sum_sq += x * x;
+            }
+        }
+        if (METER) levels[ch].add(peak, sum_sq);
+    }
+}
+
+#endif // SSL_HAVE_X86_KERNELS
+
+template <SampleFormat FMT, bool METER>
+static ConvertKernel select_kernel_for(SimdLevel level)
+{
+    switch (level) {
+#ifdef SSL_HAVE_X86_KERNELS
+        case SimdLevel::AVX512: return convert_avx512<FMT, METER>;
+        case SimdLevel::AVX2: return convert_avx2<FMT, METER>;
+        case SimdLevel::SSE2: return convert_sse2<FMT, METER>;
+#endif
+        default: return METER ? convert_scalar_metered<FMT> : convert_scalar<FMT>;
+    }
+}
+
+ConvertKernel select_convert_kernel(SampleFormat format, SimdLevel level, bool metered)
+{
+    if ((int)level > (int)cpu_simd_level()) return nullptr;
+
+    switch (format) {
+        case SampleFormat::S24_3LE:
+            return metered ? select_kernel_for<SampleFormat::S24_3LE, true>(level)
+                           : select_kernel_for<SampleFormat::S24_3LE, false>(level);
+        case SampleFormat::S32_LE:
+            return metered ? select_kernel_for<SampleFormat::S32_LE, true>(level)
+                           : select_kernel_for<SampleFormat::S32_LE, false>(level);
+        default:
+            return metered ? select_kernel_for<SampleFormat::S24_LE, true>(level)
+                           : select_kernel_for<SampleFormat::S24_LE, false>(level);
+    }
+}
+
+void convert_to_float_channels(const void* src, SampleFormat format, float* const* dst,
+                               int num_frames, int num_channels, LevelAccum* levels)
+{
+    // Indexed by SampleFormat
+    static const ConvertKernel kernels[3][2] = {
+        {select_convert_kernel(SampleFormat::S24_LE, cpu_simd_level(), false),
+         select_convert_kernel(SampleFormat::S24_LE, cpu_simd_level(), true)},
+        {select_convert_kernel(SampleFormat::S24_3LE, cpu_simd_level(), false),
+         select_convert_kernel(SampleFormat::S24_3LE, cpu_simd_level(), true)},
+        {select_convert_kernel(SampleFormat::S32_LE, cpu_simd_level(), false),
+         select_convert_kernel(SampleFormat::S32_LE, cpu_simd_level(), true)},
+    };
+
+    kernels[(int)format][levels != nullptr](src, dst, num_frames, num_channels, levels);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "cpu_features.h"
+#include "level_meter.h"
+
+// Deinterleave + sign-extend + normalize of 24-bit PCM into channel-major
+// floats in [-1, 1), i.e. the `float**` layout SAF expects.
+
+enum class SampleFormat
+{
+    S24_LE,  // 24-bit sample in the low bytes of a 32-bit little-endian container (ALSA S24_LE)
+    S24_3LE, // packed 3-byte little-endian samples (ALSA S24_3LE, what hw: devices deliver)
+    S32_LE,  // 32-bit little-endian, converted from its top 24 bits (ALSA S32_LE)
+};
+
+// Bytes per sample in the interleaved source buffer
+inline int sample_format_bytes(SampleFormat format)
+{
+    return format == SampleFormat::S24_3LE ? 3 : 4;
+}
+
+inline const char* sample_format_name(SampleFormat format)
+{
+    switch (format) {
+        case SampleFormat::S24_3LE: return "S24_3LE";
+        case SampleFormat::S32_LE: return "S32_LE";
+        default: return "S24_LE";
+    }
+}
+
+// src: interleaved frames, dst[ch]: num_frames floats per channel.
+// If `levels` is non-null, the peak and sum of squares of every converted
+// channel are accumulated into levels[ch] in the same pass (the scalar
+// kernel: in a second pass over dst, which is faster there; the caller
+// resets them per metering block).
+typedef void (*ConvertKernel)(const void* src, float* const* dst, int num_frames, int num_channels,
+                              LevelAccum* levels);
+
+// Kernel for an explicit instruction set. Returns nullptr if the CPU does not
+// support `level` (used by the benchmark to compare implementations).
+// Metered kernels require a non-null `levels`; plain kernels ignore it.
+ConvertKernel select_convert_kernel(SampleFormat format, SimdLevel level, bool metered = false);
+
+// Converts with the fastest kernel the running CPU supports.
+void convert_to_float_channels(const void* src, SampleFormat format, float* const* dst,
+                               int num_frames, int num_channels, LevelAccum* levels = nullptr);
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <cerrno>
+#include <semaphore.h>
+#include "discontinuity_log.h"
+
+// Lock-free single-producer/single-consumer ring of multichannel audio frames.
+//
+// Samples are stored planar (channel-major), so the consumer can hand the
+// ring memory straight to SAF as `const float* const*` without copying. The
+// capacity must be a multiple of the consumer block size; blocks then never
+// straddle the wrap point. The producer may write any number of frames and
+// splits its writes at the wrap point itself (see write_region()), so the
+// ring also re-blocks arbitrary ALSA reads into exact SAF frames. Gaps in the
+// stream are recorded with their position (see discontinuities()).
+//
+// The ring does not own its sample memory: `channel_storage[ch]` must point at
+// `capacity_frames` floats per channel that outlive the ring (normally carved
+// from a BufferArena, so the ring shares one aligned allocation with the
+// other audio buffers).
+class SpscFrameRing
+{
+public:
+    SpscFrameRing(float* const* channel_storage, int num_channels, int capacity_frames)
+        : channels_(num_channels),
+          capacity_(capacity_frames),
+          data_(channel_storage)
+    {
+        sem_init(&data_ready_, 0, 0);
+    }
+
+    ~SpscFrameRing() { sem_destroy(&data_ready_); }
+
+    SpscFrameRing(const SpscFrameRing&) = delete;
+    SpscFrameRing& operator=(const SpscFrameRing&) = delete;
+
+    int channels() const { return channels_; }
+    int capacity() const { return capacity_; }
+
+    // Frames currently queued. Safe to call from any thread.
+    int fill() const
+    {
+        return (int)(write_pos_.load(std::memory_order_acquire) - read_pos_.load(std::memory_order_acquire));
+    }
+
+    // === Producer side ===
+
+    int write_space() const { return capacity_ - fill(); }
+
+    // Points dst[ch] at the next free frames and returns how many of them are
+    // contiguous (at most max_frames). Call commit_write() once they are filled.
+    int write_region(float** dst, int max_frames)
+    {
+        uint64_t w = write_pos_.load(std::memory_order_relaxed);
+        int space = capacity_ - (int)(w - read_pos_.load(std::memory_order_acquire));
+        int offset = (int)(w % (uint64_t)capacity_);
+        int n = std::min(std::min(space, max_frames), capacity_ - offset);
+        for (int ch = 0; ch < channels_; ++ch) {
+            dst[ch] = data_[ch] + offset;
+        }
+        return n;
+    }
+
+    void commit_write(int frames)
+    {
+        write_pos_.store(write_pos_.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+        sem_post(&data_ready_);
+    }
+
+    // Records that the producer had to throw away a block because the ring was full.
+    void note_dropped(int frames)
+    {
+        dropped_blocks_.fetch_add(1, std::memory_order_relaxed);
+        dropped_frames_.fetch_add(frames, std::memory_order_relaxed);
+        mark_discontinuity(DiscontinuityKind::Dropped, frames);
+    }
+
+    // Records a gap right before the next frame to be written
+    void mark_discontinuity(DiscontinuityKind kind, uint32_t lost_frames)
+    {
+        Discontinuity d;
+        d.stream_frame = write_pos_.load(std::memory_order_relaxed);
+        d.lost_frames = lost_frames;
+        d.kind = kind;
+        discontinuities_.record(d);
+    }
+
+    // === Consumer side ===
+
+    // Blocks until at least `frames` are queued or timeout_ms elapses.
+    bool wait_for(int frames, int timeout_ms)
+    {
+        while (fill() < frames) {
+            timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += timeout_ms / 1000;
+            deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec += 1;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            if (sem_timedwait(&data_ready_, &deadline) != 0 && errno == ETIMEDOUT) {
+                return fill() >= frames;
+            }
+        }
+        return true;
+    }
+
+    // Points src[ch] at the oldest `frames` frames if that many are queued.
+    // `frames` must divide the capacity so the block is always contiguous.
+    bool read_block(const float** src, int frames) const
+    {
+        uint64_t r = read_pos_.load(std::memory_order_relaxed);
+        if ((int)(write_pos_.load(std::memory_order_acquire) - r) < frames) return false;
+        int offset = (int)(r % (uint64_t)capacity_);
+        for (int ch = 0; ch < channels_; ++ch) {
+            src[ch] = data_[ch] + offset;
+        }
+        return true;
+    }
+
+    void release(int frames)
+    {
+        read_pos_.store(read_pos_.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+    }
+
+    // === Statistics (any thread) ===
+
+    uint64_t frames_written() const { return write_pos_.load(std::memory_order_relaxed); }
+    uint64_t frames_read() const { return read_pos_.load(std::memory_order_relaxed); }
+    uint64_t dropped_blocks() const { return dropped_blocks_.load(std::memory_order_relaxed); }
+    uint64_t dropped_frames() const { return dropped_frames_.load(std::memory_order_relaxed); }
+    const DiscontinuityLog& discontinuities() const { return discontinuities_; }
+
+private:
+    const int channels_;
+    const int capacity_;
+    float* const* data_;
+
+    // Producer and consumer indices live on separate cache lines
+    alignas(64) std::atomic<uint64_t> write_pos_{0};
+    alignas(64) std::atomic<uint64_t> read_pos_{0};
+    alignas(64) std::atomic<uint64_t> dropped_blocks_{0};
+    std::atomic<uint64_t> dropped_frames_{0};
+    DiscontinuityLog discontinuities_;
+    sem_t data_ready_;
+};
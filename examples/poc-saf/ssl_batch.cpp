@@ -0,0 +1,362 @@
+// Offline localization of recording archives on all cores.
+//
+// Every file is cut into segments (--segment seconds, whole sldoa frames)
+// and the segments are scheduled over a work-stealing pool. Each worker has
+// its own pipeline (array2sh + DoA stage, its own SAF instances), which it
+// keeps from segment to segment; it starts every segment --warmup seconds
+// early and discards the updates of that overlap, by which time the
+// averaging in the DoA stage has forgotten whatever it processed before.
+// Segments start on the update grid of the whole file, so the updates fall
+// on the same frames as with array2sh_poc --file.
+//
+// Results come back in segment order through a window of segments in
+// flight (--window), and are written as one CSV ordered by file and time.
+// What a worker holds does not grow with the input: its pipeline, one block
+// of floats, the results of its current segment, and about a second of the
+// file mapping (read ahead, and released behind it).
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include "buffer_arena.h"
+#include "file_source.h"
+#include "pipeline.h"
+#include "rt_config.h"
+#include "stage_stats.h"
+#include "work_pool.h"
+
+// SAF framework includes
+#include "saf.h"
+#include "sldoa.h"
+
+struct BatchOptions
+{
+    std::vector<std::string> files;
+    bool have_raw = false;
+    RawFormat raw;
+    int jobs = 0;                   // 0 = one per CPU
+    float segment_s = 60.0f;
+    float warmup_s = 2.0f;
+    int window = 0;                 // segments in flight, 0 = 4 per worker
+    bool pin = false;               // worker i on CPU i
+    DoaMethod doa_method = DoaMethod::Sldoa;
+    int doa_directions = 1024;
+    const char* out_path = nullptr; // CSV destination, default stdout
+};
+
+struct BatchFile
+{
+    int sample_rate = 0;
+    uint64_t num_frames = 0;
+};
+
+struct Segment
+{
+    int file = 0;
+    uint64_t start = 0;  // first frame reported
+    uint64_t end = 0;    // one past the last frame
+};
+
+struct BatchResult
+{
+    double time_s;
+    DoaEstimate estimate;
+};
+
+// Per worker, touched only by its thread
+struct BatchWorker
+{
+    Pipeline pipeline;
+    bool have_pipeline = false;
+    BufferArena arena;
+    float** mic = nullptr;
+    FileSource file;
+    int file_index = -1;
+    double warmup_s = 0.0;       // processed and discarded
+};
+
+// Finished segments, handed to the writer in order
+struct ResultWindow
+{
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::vector<std::vector<BatchResult>> slots;  // [segment % window]
+    std::vector<int64_t> done;                    // segment in each slot, -1 = none
+};
+
+static void print_usage(const char* prog)
+{
+    std::cerr << "Usage: " << prog << " [options] FILE...\n"
+              << "  --list PATH        also process the files listed in PATH, one per line\n"
+              << "  --raw FORMAT       headerless input format: s24_3le, s24_le or s32_le\n"
+              << "  --rate HZ          sample rate of headerless input (default 48000)\n"
+              << "  --jobs N           worker threads (default: one per CPU)\n"
+              << "  --segment S        segment length in seconds (default 60)\n"
+              << "  --warmup S         audio processed before each segment and discarded (default 2)\n"
+              << "  --window N         segments in flight ahead of the writer (default 4 per worker)\n"
+              << "  --pin              pin worker N to CPU N\n"
+              << "  --doa METHOD       DoA estimation: sldoa (default), pwd or music\n"
+              << "  --doa-grid N       directions on the pwd/music grid (default 1024)\n"
+              << "  --out PATH         write the CSV to PATH instead of stdout\n"
+              << "Output: file,time_s,azimuth_deg,elevation_deg,alpha,band,sector per DoA update, ordered by\n"
+              << "file and time. Run with OPENBLAS_NUM_THREADS=1: the workers already use every core." << std::endl;
+}
+
+static bool parse_options(int argc, char** argv, BatchOptions& opts)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--list" && has_value) {
+            std::ifstream list(argv[++i]);
+            if (!list) {
+                std::cerr << "Cannot open " << argv[i] << std::endl;
+                return false;
+            }
+            std::string line;
+            while (std::getline(list, line)) {
+                if (!line.empty() && line[0] != '#') opts.files.push_back(line);
+            }
+        } else if (arg == "--raw" && has_value) {
+            std::string fmt = argv[++i];
+            opts.have_raw = true;
+            if (fmt == "s24_3le") opts.raw.format = SampleFormat::S24_3LE;
+            else if (fmt == "s24_le") opts.raw.format = SampleFormat::S24_LE;
+            else if (fmt == "s32_le") opts.raw.format = SampleFormat::S32_LE;
+            else {
+                std::cerr << "Unknown raw format: " << fmt << std::endl;
+                return false;
+            }
+        } else if (arg == "--rate" && has_value) {
+            opts.raw.sample_rate = std::atoi(argv[++i]);
+        } else if (arg == "--jobs" && has_value) {
+            opts.jobs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--segment" && has_value) {
+            opts.segment_s = std::max(1.0f, (float)std::atof(argv[++i]));
+        } else if (arg == "--warmup" && has_value) {
+            opts.warmup_s = std::max(0.0f, (float)std::atof(argv[++i]));
+        } else if (arg == "--window" && has_value) {
+            opts.window = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--pin") {
+            opts.pin = true;
+        } else if (arg == "--doa" && has_value) {
+            if (!doa_method_from_name(argv[++i], opts.doa_method)) {
+                std::cerr << "Unknown DoA method: " << argv[i] << std::endl;
+                return false;
+            }
+        } else if (arg == "--doa-grid" && has_value) {
+            opts.doa_directions = std::max(16, std::atoi(argv[++i]));
+        } else if (arg == "--out" && has_value) {
+            opts.out_path = argv[++i];
+        } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            print_usage(argv[0]);
+            return false;
+        } else {
+            opts.files.push_back(arg);
+        }
+    }
+    if (opts.files.empty()) {
+        print_usage(argv[0]);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    BatchOptions opts;
+    if (!parse_options(argc, argv, opts)) return -1;
+    if (!getenv("OPENBLAS_NUM_THREADS") && !getenv("OMP_NUM_THREADS")) {
+        std::cerr << "Note: OPENBLAS_NUM_THREADS is not set; BLAS threads on top of the workers oversubscribe the CPUs"
+                  << std::endl;
+    }
+    // The pipeline reports on stdout; keep that free for the results
+    std::cout.rdbuf(std::cerr.rdbuf());
+
+    // === Plan: headers only, the files are mapped again by the workers ===
+    const uint64_t update_frames = (uint64_t)sldoa_getFrameSize();
+    std::vector<BatchFile> files(opts.files.size());
+    std::vector<Segment> segments;
+    double audio_s = 0.0;
+    for (size_t f = 0; f < opts.files.size(); ++f) {
+        FileSource src;
+        if (!file_source_open(src, opts.files[f].c_str(), opts.have_raw ? &opts.raw : nullptr)) return -1;
+        files[f].sample_rate = src.sample_rate;
+        files[f].num_frames = src.num_frames;
+        const int channels = src.channels;
+        file_source_close(src);
+        if (channels != mic_channels) {
+            std::cerr << opts.files[f] << ": expected " << mic_channels << " channels, found " << channels << std::endl;
+            return -1;
+        }
+        const uint64_t length = std::max<uint64_t>(
+            update_frames, (uint64_t)(opts.segment_s * files[f].sample_rate) / update_frames * update_frames);
+        for (uint64_t start = 0; start < files[f].num_frames; start += length) {
+            segments.push_back({(int)f, start, std::min(start + length, files[f].num_frames)});
+        }
+        audio_s += (double)files[f].num_frames / files[f].sample_rate;
+    }
+    const int64_t num_segments = (int64_t)segments.size();
+
+    const int jobs = opts.jobs > 0 ? opts.jobs : std::max(1, (int)std::thread::hardware_concurrency());
+    const int window = opts.window > 0 ? opts.window : 4 * jobs;
+    std::cerr << "Batch: " << files.size() << " file(s), " << std::fixed << std::setprecision(1) << audio_s / 3600.0
+              << " h of audio, " << num_segments << " segments of " << opts.segment_s << " s (+" << opts.warmup_s
+              << " s warm-up), " << jobs << " workers, " << window << " segments in flight" << std::endl;
+
+    FILE* out = opts.out_path ? fopen(opts.out_path, "w") : stdout;
+    if (!out) {
+        std::cerr << "Cannot open " << opts.out_path << std::endl;
+        return -1;
+    }
+    fprintf(out, "file,time_s,azimuth_deg,elevation_deg,alpha,band,sector\n");
+
+    std::vector<BatchWorker> workers(jobs);
+    ResultWindow results;
+    results.slots.resize(window);
+    results.done.assign(window, -1);
+    // Pipeline setup plans FFTs (FFTW's planner is not thread-safe), so
+    // workers set up one at a time
+    std::mutex setup_mutex;
+    std::atomic<bool> failed{false};
+
+    auto on_start = [&](int w) {
+        if (opts.pin) rt_apply_thread("batch", RtThreadConfig{0, w});
+    };
+    auto on_exit = [&](int w) {
+        BatchWorker& worker = workers[w];
+        if (worker.have_pipeline) pipeline_destroy(worker.pipeline);
+        if (worker.file_index >= 0) file_source_close(worker.file);
+    };
+    auto run_segment = [&](int w, int64_t task) {
+        BatchWorker& worker = workers[w];
+        const Segment& seg = segments[task];
+        const BatchFile& file = files[seg.file];
+        std::vector<BatchResult> found;
+
+        if (worker.have_pipeline && worker.pipeline.sample_rate != file.sample_rate) {
+            pipeline_destroy(worker.pipeline);
+            worker.pipeline = Pipeline();
+            worker.have_pipeline = false;
+        }
+        if (!worker.have_pipeline) {
+            std::lock_guard<std::mutex> lock(setup_mutex);
+            worker.pipeline.doa_method = opts.doa_method;
+            worker.pipeline.doa_directions = opts.doa_directions;
+            worker.have_pipeline = pipeline_init(worker.pipeline, file.sample_rate);
+            if (!worker.have_pipeline) {
+                pipeline_destroy(worker.pipeline);
+                worker.pipeline = Pipeline();
+            }
+            if (!worker.mic && worker.have_pipeline) {
+                int handle = worker.arena.add_channels(mic_channels, worker.pipeline.framesize);
+                if (worker.arena.allocate()) worker.mic = worker.arena.channels(handle);
+            }
+        }
+        if (worker.file_index != seg.file) {
+            if (worker.file_index >= 0) file_source_close(worker.file);
+            worker.file_index = file_source_open(worker.file, opts.files[seg.file].c_str(),
+                                                 opts.have_raw ? &opts.raw : nullptr) ? seg.file : -1;
+        }
+
+        if (worker.have_pipeline && worker.mic && worker.file_index == seg.file) {
+            Pipeline& p = worker.pipeline;
+            const uint64_t block = (uint64_t)p.framesize;
+            const uint64_t update = block * p.frames_per_sldoa_update;
+            const uint64_t warmup = (uint64_t)std::ceil(opts.warmup_s * file.sample_rate / update) * update;
+            const uint64_t from = seg.start > warmup ? seg.start - warmup : 0;
+            // Whole updates only, so the next segment starts on the grid too
+            const uint64_t to = from + (seg.end - from) / update * update;
+            // The mapping is read ahead and released in chunks of about a
+            // second, so the resident part does not depend on --segment
+            const uint64_t chunk = std::max<uint64_t>(1, file.sample_rate / update) * update;
+            uint64_t chunk_start = from;
+            file_source_prefetch(worker.file, from, std::min(chunk, to - from));
+            for (uint64_t frame = from; frame < to; frame += block) {
+                if (frame == chunk_start + chunk) {
+                    file_source_release(worker.file, chunk_start, chunk);
+                    chunk_start = frame;
+                    file_source_prefetch(worker.file, frame, std::min(chunk, to - frame));
+                }
+                convert_to_float_channels(file_source_frame(worker.file, frame), worker.file.format, worker.mic,
+                                          (int)block, mic_channels);
+                if (!pipeline_process(p, (const float* const*)worker.mic)) continue;
+                if (frame + block <= seg.start || p.estimate.strength < 0.0f) continue;
+                found.push_back({(double)(frame + block) / file.sample_rate, p.estimate});
+            }
+            file_source_release(worker.file, chunk_start, seg.end - chunk_start);
+            worker.warmup_s += (double)(seg.start - from) / file.sample_rate;
+        } else {
+            failed.store(true);
+        }
+
+        std::lock_guard<std::mutex> lock(results.mutex);
+        results.slots[task % window] = std::move(found);
+        results.done[task % window] = task;
+        results.ready.notify_all();
+    };
+
+    const uint64_t start_ns = monotonic_ns();
+    WorkStealingPool pool(jobs, run_segment, on_start, on_exit);
+    int64_t submitted = 0;
+    for (; submitted < std::min<int64_t>(window, num_segments); ++submitted) pool.submit(submitted);
+
+    // Writer: segments in order; each one written frees a slot for the next
+    size_t lines = 0;
+    std::vector<BatchResult> segment_results;
+    for (int64_t next = 0; next < num_segments; ++next) {
+        {
+            std::unique_lock<std::mutex> lock(results.mutex);
+            results.ready.wait(lock, [&] { return results.done[next % window] == next; });
+            segment_results.swap(results.slots[next % window]);
+            results.slots[next % window].clear();
+        }
+        if (submitted < num_segments) pool.submit(submitted++);
+
+        const char* path = opts.files[segments[next].file].c_str();
+        for (const BatchResult& r : segment_results) {
+            const DoaEstimate& est = r.estimate;
+            fprintf(out, "%s,%.4f,%.1f,%.1f,%.3f,%d,%d\n", path, r.time_s, est.azimuth_deg, est.elevation_deg,
+                    est.strength, est.band, est.sector);
+        }
+        lines += segment_results.size();
+        segment_results.clear();
+    }
+    pool.finish();
+    const double wall_s = (monotonic_ns() - start_ns) * 1e-9;
+    if (out != stdout) fclose(out);
+
+    // === Summary ===
+    double warmup_s = 0.0;
+    for (const BatchWorker& worker : workers) warmup_s += worker.warmup_s;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::cerr << std::fixed << std::setprecision(2) << "Processed " << audio_s << " s of audio in " << wall_s
+              << " s: real-time factor " << (wall_s > 0.0 ? audio_s / wall_s : 0.0) << "x, "
+              << (wall_s > 0.0 ? audio_s / wall_s / jobs : 0.0) << "x per worker; " << lines << " updates" << std::endl;
+    std::cerr << "Warm-up: " << std::setprecision(1) << warmup_s << " s processed twice ("
+              << (audio_s > 0.0 ? 100.0 * warmup_s / audio_s : 0.0) << "%), max RSS " << usage.ru_maxrss / 1024
+              << " MiB" << std::endl;
+    for (int w = 0; w < jobs; ++w) {
+        std::cerr << "  worker " << w << ": " << pool.tasks_run(w) << " segments (" << pool.steals(w) << " stolen), busy "
+                  << std::setprecision(0) << (wall_s > 0.0 ? 100.0 * pool.busy_ns(w) * 1e-9 / wall_s : 0.0) << "%"
+                  << std::endl;
+    }
+    if (failed.load()) {
+        std::cerr << "Some segments could not be processed (see above)" << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,640 @@
+// Benchmark suite for the localization chain. Runs on synthetic input, needs
+// no audio hardware, and writes the results as JSON so they can be tracked
+// across releases:
+//
+//   ./ssl_bench [--json PATH] [--min-time SECONDS] [--filter SUBSTRING]
+//
+// Micro benchmarks, one group each: 24-bit conversion (every format and
+// kernel, plain and metered), array2sh_process at orders 1-3, sldoa_analysis
+// and the dominant-sector search, the native DoA engine (PWD and SH-MUSIC
+// maps at 256-4096 directions, per block like sldoa_analysis), sldoa against
+// both maps at its own direction count, the source tracker at full capacity,
+// the direction histogram, the activity gate's detector, the headphone
+// monitor decode (binaural with the designed and the shortest filters, and
+// stereo) and the array simulator (1 and 4 sources, dry and reverberant).
+// Macro benchmarks: the whole chain (convert -> array2sh -> sldoa / pwd /
+// music) over 10 s of synthetic 19-channel S24_3LE audio, and sldoa behind
+// the activity gate (VAD and level detector) on a mostly quiet version of it
+// (1 s of sound every 5 s).
+//
+// Human-readable progress goes to stderr, JSON to stdout unless --json is given.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "activity_gate.h"
+#include "array_sim.h"
+#include "buffer_arena.h"
+#include "direction_histogram.h"
+#include "doa_engine.h"
+#include "doa_tracker.h"
+#include "monitor_decoder.h"
+#include "pipeline.h"
+#include "sample_convert.h"
+
+// SAF framework includes
+#include "saf.h"
+#include "array2sh.h"
+#include "sldoa.h"
+
+const int bench_sample_rate = 48000;
+
+struct BenchOptions
+{
+    const char* json_path = nullptr; // nullptr = stdout
+    double min_time_s = 0.5;         // measuring time per benchmark
+    const char* filter = nullptr;    // only run benchmarks whose name contains this
+};
+
+struct BenchResult
+{
+    std::string name;
+    std::string unit;           // what one operation is
+    int64_t frames_per_op = 0;  // audio frames per operation, 0 if not audio
+    uint64_t iterations = 0;
+    double median_ns = 0.0;
+    double mean_ns = 0.0;
+    double min_ns = 0.0;
+    double max_ns = 0.0;
+    double stddev_ns = 0.0;
+};
+
+static std::vector<BenchResult> results;
+static BenchOptions options;
+
+static double now_ns()
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Runs `op` in batches of at least ~1 ms for options.min_time_s and records
+// the per-operation time of each batch
+static void run_bench(const std::string& name, const std::string& unit, int64_t frames_per_op,
+                      const std::function<void()>& op)
+{
+    if (options.filter && name.find(options.filter) == std::string::npos) return;
+
+    // Warm-up and batch size calibration
+    uint64_t batch = 1;
+    for (;;) {
+        double start = now_ns();
+        for (uint64_t i = 0; i < batch; ++i) op();
+        if (now_ns() - start >= 1e6 || batch >= (1u << 24)) break;
+        batch *= 2;
+    }
+
+    std::vector<double> per_op;
+    uint64_t iterations = 0;
+    double deadline = now_ns() + options.min_time_s * 1e9;
+    do {
+        double start = now_ns();
+        for (uint64_t i = 0; i < batch; ++i) op();
+        per_op.push_back((now_ns() - start) / batch);
+        iterations += batch;
+    } while (now_ns() < deadline || per_op.size() < 5);
+
+    BenchResult r;
+    r.name = name;
+    r.unit = unit;
+    r.frames_per_op = frames_per_op;
+    r.iterations = iterations;
+    std::sort(per_op.begin(), per_op.end());
+    r.median_ns = per_op[per_op.size() / 2];
+    r.min_ns = per_op.front();
+    r.max_ns = per_op.back();
+    double sum = 0.0, sum_sq = 0.0;
+    for (double t : per_op) {
+        sum += t;
+        sum_sq += t * t;
+    }
+    r.mean_ns = sum / per_op.size();
+    r.stddev_ns = std::sqrt(std::max(0.0, sum_sq / per_op.size() - r.mean_ns * r.mean_ns));
+    results.push_back(r);
+
+    fprintf(stderr, "%-36s %12.1f ns/%s", name.c_str(), r.median_ns, unit.c_str());
+    if (frames_per_op) {
+        fprintf(stderr, "  (%.1fx real time)", frames_per_op * 1e9 / bench_sample_rate / r.median_ns);
+    }
+    fprintf(stderr, "\n");
+}
+
+// Deterministic 24-bit test signal: noise plus a few tones, per channel
+static int32_t synth_sample(int64_t frame, int ch)
+{
+    static uint32_t state = 12345;
+    state = state * 1664525u + 1013904223u;
+    float noise = (float)(int32_t)(state >> 8) / 8388608.0f - 1.0f;
+    float tone = sinf(2.0f * (float)M_PI * (440.0f + 37.0f * ch) * (float)frame / bench_sample_rate);
+    return (int32_t)((0.05f * noise + 0.3f * tone) * 8388607.0f);
+}
+
+static void fill_interleaved(std::vector<uint8_t>& s24_3le, std::vector<int32_t>& s24_le, int64_t frames)
+{
+    s24_3le.resize((size_t)frames * mic_channels * 3);
+    s24_le.resize((size_t)frames * mic_channels);
+    for (int64_t f = 0; f < frames; ++f) {
+        for (int ch = 0; ch < mic_channels; ++ch) {
+            int32_t v = synth_sample(f, ch);
+            size_t i = (size_t)f * mic_channels + ch;
+            s24_le[i] = v & 0xFFFFFF;
+            std::memcpy(&s24_3le[i * 3], &v, 3);
+        }
+    }
+}
+
+// The same signal, but 60 dB down except for the first second of every five:
+// a quiet room with the odd event, for the gated chain
+static std::vector<uint8_t> quiet_room(const std::vector<int32_t>& s24_le, int64_t frames)
+{
+    std::vector<uint8_t> out((size_t)frames * mic_channels * 3);
+    for (int64_t f = 0; f < frames; ++f) {
+        bool active = f % (5 * bench_sample_rate) < bench_sample_rate;
+        for (int ch = 0; ch < mic_channels; ++ch) {
+            size_t i = (size_t)f * mic_channels + ch;
+            int32_t v = (int32_t)((uint32_t)s24_le[i] << 8) >> 8; // sign-extend
+            if (!active) v /= 1000;
+            std::memcpy(&out[i * 3], &v, 3);
+        }
+    }
+    return out;
+}
+
+static void* create_array2sh(int order)
+{
+    void* h = nullptr;
+    array2sh_create(&h);
+    array2sh_init(h, bench_sample_rate);
+    array2sh_setPreset(h, MICROPHONE_ARRAY_PRESET_ZYLIA_1D);
+    array2sh_setEncodingOrder(h, order);
+    array2sh_setNormType(h, NORM_SN3D);
+    array2sh_setChOrder(h, CH_ACN);
+    array2sh_evalEncoder(h); // returns once evaluated
+    return h;
+}
+
+static void* create_sldoa(int order)
+{
+    void* h = nullptr;
+    sldoa_create(&h);
+    sldoa_init(h, bench_sample_rate);
+    sldoa_setMasterOrder(h, order);
+    sldoa_setNormType(h, NORM_SN3D);
+    sldoa_setChOrder(h, CH_ACN);
+    sldoa_initCodec(h); // returns once initialised
+    return h;
+}
+
+static void bench_convert(const std::vector<uint8_t>& s24_3le, const std::vector<int32_t>& s24_le, int frames)
+{
+    BufferArena arena;
+    int out_handle = arena.add_channels(mic_channels, frames);
+    if (!arena.allocate()) return;
+    float** out = arena.channels(out_handle);
+    LevelAccum levels[mic_channels];
+
+    const SampleFormat formats[] = {SampleFormat::S24_LE, SampleFormat::S24_3LE};
+    const SimdLevel simd_levels[] = {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512};
+    for (SampleFormat format : formats) {
+        const void* src = format == SampleFormat::S24_3LE ? (const void*)s24_3le.data() : (const void*)s24_le.data();
+        for (SimdLevel level : simd_levels) {
+            for (int metered = 0; metered < 2; ++metered) {
+                ConvertKernel kernel = select_convert_kernel(format, level, metered);
+                if (!kernel) continue;
+                std::string name = std::string("convert/") + sample_format_name(format) + "/" +
+                                   simd_level_name(level) + (metered ? "+meter" : "");
+                run_bench(name, "block", frames, [&] { kernel(src, out, frames, mic_channels, levels); });
+            }
+        }
+    }
+}
+
+static void bench_array2sh(const float* const* mic, int frames)
+{
+    for (int order = 1; order <= 3; ++order) {
+        const int num_sh = (order + 1) * (order + 1);
+        BufferArena arena;
+        int sh_handle = arena.add_channels(num_sh, frames);
+        if (!arena.allocate()) return;
+        float** sh = arena.channels(sh_handle);
+
+        void* h = create_array2sh(order);
+        run_bench("array2sh_process/order" + std::to_string(order), "block", frames,
+                  [&] { array2sh_process(h, mic, sh, mic_channels, num_sh, frames); });
+        array2sh_destroy(&h);
+    }
+}
+
+static void bench_sldoa(const float* const* mic, int frames)
+{
+    BufferArena arena;
+    int sh_handle = arena.add_channels(NUM_SH_SIGNALS, frames);
+    if (!arena.allocate()) return;
+    float** sh = arena.channels(sh_handle);
+
+    // Realistic SH input: the encoded synthetic array signal
+    void* a2sh = create_array2sh(SH_ORDER);
+    array2sh_process(a2sh, mic, sh, mic_channels, NUM_SH_SIGNALS, frames);
+    array2sh_destroy(&a2sh);
+
+    void* h = create_sldoa(SH_ORDER);
+    run_bench("sldoa_analysis/order" + std::to_string(SH_ORDER), "block", frames,
+              [&] { sldoa_analysis(h, (const float* const*)sh, NUM_SH_SIGNALS, frames, 1); });
+
+    // Search over the display data sldoa just produced
+    DoaDisplayData d;
+    sldoa_getDisplayData(h, &d.azi_deg, &d.elev_deg, &d.colour_scale, &d.alpha_scale,
+                         &d.sectors_per_band, &d.max_num_sectors, &d.start_band, &d.end_band);
+    if (d.alpha_scale && d.sectors_per_band) {
+        int best_band = 0, best_sector = 0;
+        volatile float sink = 0.0f;
+        run_bench("find_dominant_sector", "search", 0,
+                  [&] { sink = find_dominant_sector(d, best_band, best_sector); });
+        (void)sink;
+    }
+    sldoa_destroy(&h);
+}
+
+// The headphone decode of the encoded signal, binaural with the designed
+// filters and cut to one partition (--monitor-taps), and stereo
+static void bench_monitor(const float* const* mic, int frames)
+{
+    BufferArena arena;
+    int sh_handle = arena.add_channels(NUM_SH_SIGNALS, frames);
+    int out_handle = arena.add_channels(MonitorDecoder::num_outputs, frames);
+    if (!arena.allocate()) return;
+    float** sh = arena.channels(sh_handle);
+    float** out = arena.channels(out_handle);
+
+    void* a2sh = create_array2sh(SH_ORDER);
+    array2sh_process(a2sh, mic, sh, mic_channels, NUM_SH_SIGNALS, frames);
+    array2sh_destroy(&a2sh);
+
+    // The designed filters and the shortest cut, a single partition
+    const int max_taps[] = {0, frames};
+    for (int taps : max_taps) {
+        MonitorDecoder decoder(SH_ORDER, frames, MonitorMode::Binaural);
+        if (!decoder.prepare(bench_sample_rate, 0.0f, taps)) return;
+        run_bench("monitor/binaural/" + std::to_string(decoder.partitions() * frames) + "taps", "block", frames,
+                  [&] { decoder.process((const float* const*)sh, out); });
+    }
+    MonitorDecoder stereo(SH_ORDER, frames, MonitorMode::Stereo);
+    stereo.prepare(bench_sample_rate);
+    run_bench("monitor/stereo", "block", frames, [&] { stereo.process((const float* const*)sh, out); });
+}
+
+// The array simulator that stands in for the ZM-1 in stress runs: it must
+// stay a small fraction of the chain it feeds
+static void bench_sim(int frames)
+{
+    BufferArena arena;
+    int out_handle = arena.add_channels(ArraySimulator::num_capsules, frames);
+    if (!arena.allocate()) return;
+    float** out = arena.channels(out_handle);
+
+    const int source_counts[] = {1, 4};
+    const float rt60s[] = {0.0f, 0.5f};
+    for (int num_sources : source_counts) {
+        for (float rt60 : rt60s) {
+            ArraySimConfig config;
+            config.rt60_s = rt60;
+            for (int s = 0; s < num_sources; ++s) {
+                SimSource source;
+                source.azimuth_deg = -180.0f + 360.0f * s / num_sources;
+                config.sources.push_back(source);
+            }
+            ArraySimulator sim(config);
+            if (!sim.prepare(bench_sample_rate, frames)) return;
+            run_bench("sim/" + std::to_string(num_sources) + "src" + (rt60 > 0.0f ? "/reverb" : ""), "block", frames,
+                      [&] { sim.generate(out); });
+        }
+    }
+}
+
+// The native engine on the same input, timed per SAF frame like
+// sldoa_analysis: every block is accumulated, every 4th one (one sldoa frame)
+// also updates the map
+static void bench_doa_engine(const float* const* mic, int frames)
+{
+    BufferArena arena;
+    int sh_handle = arena.add_channels(NUM_SH_SIGNALS, frames);
+    if (!arena.allocate()) return;
+    float** sh = arena.channels(sh_handle);
+
+    void* a2sh = create_array2sh(SH_ORDER);
+    array2sh_process(a2sh, mic, sh, mic_channels, NUM_SH_SIGNALS, frames);
+    array2sh_destroy(&a2sh);
+
+    const int blocks_per_update = sldoa_getFrameSize() / frames;
+    const DoaMap maps[] = {DoaMap::Pwd, DoaMap::Music};
+    const int grid_sizes[] = {256, 1024, 4096};
+    for (DoaMap map : maps) {
+        for (int directions : grid_sizes) {
+            DoaEngine engine(SH_ORDER, directions, map);
+            if (!engine.prepare(bench_sample_rate)) return;
+            DoaPeak peak;
+            int block = 0;
+            std::string name = std::string("doa_engine/") + (map == DoaMap::Pwd ? "pwd" : "music") + "/" +
+                               std::to_string(directions);
+            run_bench(name, "block", frames, [&] {
+                engine.accumulate((const float* const*)sh, frames);
+                if (++block % blocks_per_update == 0) engine.estimate(peak);
+            });
+        }
+    }
+}
+
+// sldoa against the grid maps at the same number of directions per update:
+// sldoa reports one direction per sector and band, so the engines get a grid
+// of that many points. Same cadence as above (the display data fetch is part
+// of sldoa's update, like estimate() is of the engines'). The fixed grid
+// sizes above only compare the engines with each other.
+static void bench_doa_matched(const float* const* mic, int frames)
+{
+    BufferArena arena;
+    int sh_handle = arena.add_channels(NUM_SH_SIGNALS, frames);
+    if (!arena.allocate()) return;
+    float** sh = arena.channels(sh_handle);
+
+    void* a2sh = create_array2sh(SH_ORDER);
+    array2sh_process(a2sh, mic, sh, mic_channels, NUM_SH_SIGNALS, frames);
+    array2sh_destroy(&a2sh);
+
+    // Directions per sldoa update, from the display data after one update
+    const int blocks_per_update = sldoa_getFrameSize() / frames;
+    void* h = create_sldoa(SH_ORDER);
+    for (int b = 0; b < blocks_per_update; ++b) sldoa_analysis(h, (const float* const*)sh, NUM_SH_SIGNALS, frames, 1);
+    DoaDisplayData d;
+    sldoa_getDisplayData(h, &d.azi_deg, &d.elev_deg, &d.colour_scale, &d.alpha_scale,
+                         &d.sectors_per_band, &d.max_num_sectors, &d.start_band, &d.end_band);
+    int directions = 0;
+    if (d.sectors_per_band) {
+        for (int band = d.start_band; band <= d.end_band; ++band) directions += d.sectors_per_band[band];
+    }
+    if (directions <= 0) {
+        sldoa_destroy(&h);
+        return;
+    }
+
+    const std::string suffix = "/" + std::to_string(directions) + "dirs";
+    int block = 0;
+    run_bench("doa_matched/sldoa" + suffix, "block", frames, [&] {
+        sldoa_analysis(h, (const float* const*)sh, NUM_SH_SIGNALS, frames, 1);
+        if (++block % blocks_per_update == 0) {
+            sldoa_getDisplayData(h, &d.azi_deg, &d.elev_deg, &d.colour_scale, &d.alpha_scale,
+                                 &d.sectors_per_band, &d.max_num_sectors, &d.start_band, &d.end_band);
+        }
+    });
+    sldoa_destroy(&h);
+
+    const DoaMap maps[] = {DoaMap::Pwd, DoaMap::Music};
+    for (DoaMap map : maps) {
+        DoaEngine engine(SH_ORDER, directions, map);
+        if (!engine.prepare(bench_sample_rate)) return;
+        DoaPeak peak;
+        block = 0;
+        run_bench(std::string("doa_matched/") + (map == DoaMap::Pwd ? "pwd" : "music") + suffix, "block", frames,
+                  [&] {
+                      engine.accumulate((const float* const*)sh, frames);
+                      if (++block % blocks_per_update == 0) engine.estimate(peak);
+                  });
+    }
+}
+
+// One tracker update with the largest input the pipeline produces: a full set
+// of observations (four sources over many bands, plus clutter) and all
+// tracks alive
+static void bench_tracker()
+{
+    std::vector<DoaObservation> obs;
+    uint32_t state = 777;
+    auto noise = [&] {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) / 16777216.0f - 0.5f;
+    };
+    DoaTracker tracker;
+    const float dt = (float)sldoa_getFrameSize() / bench_sample_rate;
+    std::vector<std::vector<DoaObservation>> updates(64);
+    for (std::vector<DoaObservation>& u : updates) {
+        while ((int)u.size() < DoaTracker::max_observations) {
+            int source = (int)u.size() % 5;
+            if (source < 4) u.push_back(doa_observation(-135.0f + 90.0f * source + 10.0f * noise(), 10.0f * noise(), 0.8f));
+            else u.push_back(doa_observation(360.0f * noise(), 180.0f * noise(), 0.3f));
+        }
+    }
+    for (const std::vector<DoaObservation>& u : updates) tracker.update(u.data(), (int)u.size(), dt);
+
+    size_t next = 0;
+    run_bench("doa_tracker/update/" + std::to_string(DoaTracker::max_observations), "update", 0, [&] {
+        const std::vector<DoaObservation>& u = updates[next++ % updates.size()];
+        tracker.update(u.data(), (int)u.size(), dt);
+    });
+}
+
+// One histogram update as in the pipeline: decay, a full set of sldoa
+// band/sector estimates, peak scan (5 degree bins)
+static void bench_histogram()
+{
+    DirectionHistogram histogram;
+    if (!histogram.prepare()) return;
+    const int n = DoaTracker::max_observations;
+    std::vector<float> azi(n), elev(n), alpha(n);
+    uint32_t state = 4242;
+    for (int i = 0; i < n; ++i) {
+        state = state * 1664525u + 1013904223u;
+        azi[i] = (float)(state >> 8) / 16777216.0f * 360.0f - 180.0f;
+        elev[i] = (float)((state >> 4) & 0xFFF) / 4096.0f * 180.0f - 90.0f;
+        alpha[i] = (float)(state & 0xFF) / 256.0f;
+    }
+    const float dt = (float)sldoa_getFrameSize() / bench_sample_rate;
+    float a, e, strength;
+    run_bench("direction_histogram/update/" + std::to_string(n), "update", 0, [&] {
+        histogram.decay(dt);
+        for (int i = 0; i < n; ++i) histogram.add(azi[i], elev[i], alpha[i]);
+        histogram.peak(a, e, strength);
+    });
+}
+
+// Gate decision for one block: level measurement and detector, no pre-roll copy
+static void bench_gate(const float* const* mic, int frames)
+{
+    ActivityGateConfig config;
+    config.preroll_s = 0.0f;
+    ActivityGate gate(config, mic_channels, frames, bench_sample_rate, 4);
+    if (!gate.prepare()) return;
+    run_bench("activity_gate/process", "block", frames, [&] { gate.process(mic); });
+}
+
+// Whole chain over a synthetic recording, as in array2sh_poc --file
+static void bench_chain(const std::vector<uint8_t>& s24_3le, int64_t total_frames, DoaMethod method,
+                        const ActivityGateConfig* gate = nullptr)
+{
+    Pipeline pipeline;
+    pipeline.doa_method = method;
+    pipeline.gate_config = gate;
+    if (!pipeline_init(pipeline, bench_sample_rate)) {
+        pipeline_destroy(pipeline);
+        return;
+    }
+    const int frames = pipeline.framesize;
+    const int64_t num_blocks = total_frames / frames;
+    const size_t frame_bytes = (size_t)mic_channels * 3;
+
+    BufferArena arena;
+    int in_handle = arena.add_channels(mic_channels, frames);
+    if (arena.allocate()) {
+        float** mic = arena.channels(in_handle);
+        // sldoa keeps the original name so results stay comparable across releases
+        std::string name = method == DoaMethod::Sldoa ? "chain/order3/10s"
+                                                      : std::string("chain/order3/") + doa_method_name(method) + "/10s";
+        if (gate) name = std::string("chain/order3/") + doa_method_name(method) + "/gated_" +
+                         gate_detector_name(gate->detector) + "/quiet_room_10s";
+        run_bench(name, "run", num_blocks * frames, [&] {
+            for (int64_t b = 0; b < num_blocks; ++b) {
+                convert_to_float_channels(s24_3le.data() + (size_t)(b * frames) * frame_bytes,
+                                          SampleFormat::S24_3LE, mic, frames, mic_channels);
+                pipeline_process(pipeline, (const float* const*)mic);
+            }
+        });
+        if (pipeline.gate) {
+            fprintf(stderr, "  ");
+            activity_gate_report(*pipeline.gate, stderr);
+        }
+    }
+    pipeline_destroy(pipeline);
+}
+
+static std::string json_escape(const std::string& s)
+{
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if ((unsigned char)c >= 0x20) out += c;
+    }
+    return out;
+}
+
+static std::string cpu_model()
+{
+    FILE* f = fopen("/proc/cpuinfo", "r");
+    if (!f) return "unknown";
+    char line[512];
+    std::string model = "unknown";
+    while (fgets(line, sizeof(line), f)) {
+        if (std::strncmp(line, "model name", 10) != 0) continue;
+        const char* colon = std::strchr(line, ':');
+        if (colon) {
+            model = colon + 2;
+            while (!model.empty() && (model.back() == '\n' || model.back() == ' ')) model.pop_back();
+        }
+        break;
+    }
+    fclose(f);
+    return model;
+}
+
+static void write_json(FILE* out, int frames)
+{
+    char timestamp[32];
+    time_t t = time(nullptr);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&t));
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"suite\": \"ssl_bench\",\n  \"schema_version\": 1,\n");
+    fprintf(out, "  \"timestamp\": \"%s\",\n", timestamp);
+    fprintf(out, "  \"host\": {\"cpu\": \"%s\", \"simd\": \"%s\", \"cores\": %ld, \"compiler\": \"%s\"},\n",
+            json_escape(cpu_model()).c_str(), simd_level_name(cpu_simd_level()),
+            sysconf(_SC_NPROCESSORS_ONLN), json_escape(__VERSION__).c_str());
+    fprintf(out, "  \"config\": {\"sample_rate\": %d, \"frames_per_block\": %d, \"channels\": %d, \"min_time_s\": %g},\n",
+            bench_sample_rate, frames, mic_channels, options.min_time_s);
+    fprintf(out, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"unit\": \"%s\", \"iterations\": %llu, "
+                     "\"median_ns\": %.1f, \"mean_ns\": %.1f, \"min_ns\": %.1f, \"max_ns\": %.1f, \"stddev_ns\": %.1f",
+                json_escape(r.name).c_str(), r.unit.c_str(), (unsigned long long)r.iterations,
+                r.median_ns, r.mean_ns, r.min_ns, r.max_ns, r.stddev_ns);
+        if (r.frames_per_op) {
+            fprintf(out, ", \"frames\": %lld, \"realtime_factor\": %.2f", (long long)r.frames_per_op,
+                    r.frames_per_op * 1e9 / bench_sample_rate / r.median_ns);
+        }
+        fprintf(out, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--json" && has_value) {
+            options.json_path = argv[++i];
+        } else if (arg == "--min-time" && has_value) {
+            options.min_time_s = std::atof(argv[++i]);
+        } else if (arg == "--filter" && has_value) {
+            options.filter = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--json PATH] [--min-time SECONDS] [--filter SUBSTRING]" << std::endl;
+            return -1;
+        }
+    }
+
+    // SAF setup chatter (pipeline_init) must not end up in the JSON on stdout
+    std::streambuf* stdout_buf = std::cout.rdbuf(std::cerr.rdbuf());
+
+    const int frames = array2sh_getFrameSize();
+    const int64_t total_frames = (int64_t)bench_sample_rate * 10;
+    std::vector<uint8_t> s24_3le;
+    std::vector<int32_t> s24_le;
+    fill_interleaved(s24_3le, s24_le, total_frames);
+
+    // One converted block as input for the SAF micro benchmarks
+    BufferArena arena;
+    int mic_handle = arena.add_channels(mic_channels, frames);
+    if (!arena.allocate()) return -1;
+    float** mic = arena.channels(mic_handle);
+    convert_to_float_channels(s24_3le.data(), SampleFormat::S24_3LE, mic, frames, mic_channels);
+
+    fprintf(stderr, "ssl_bench: %d frames per block, %s, min %.2f s per benchmark\n",
+            frames, simd_level_name(cpu_simd_level()), options.min_time_s);
+    bench_convert(s24_3le, s24_le, frames);
+    bench_array2sh((const float* const*)mic, frames);
+    bench_sldoa((const float* const*)mic, frames);
+    bench_doa_engine((const float* const*)mic, frames);
+    bench_doa_matched((const float* const*)mic, frames);
+    bench_tracker();
+    bench_histogram();
+    bench_gate((const float* const*)mic, frames);
+    bench_monitor((const float* const*)mic, frames);
+    bench_sim(frames);
+    bench_chain(s24_3le, total_frames, DoaMethod::Sldoa);
+    bench_chain(s24_3le, total_frames, DoaMethod::Pwd);
+    bench_chain(s24_3le, total_frames, DoaMethod::Music);
+
+    const std::vector<uint8_t> quiet = quiet_room(s24_le, total_frames);
+    ActivityGateConfig gate_config;
+    bench_chain(quiet, total_frames, DoaMethod::Sldoa, &gate_config);
+    gate_config.detector = GateDetector::Level;
+    bench_chain(quiet, total_frames, DoaMethod::Sldoa, &gate_config);
+
+    std::cout.rdbuf(stdout_buf);
+
+    FILE* out = options.json_path ? fopen(options.json_path, "w") : stdout;
+    if (!out) {
+        std::cerr << "Cannot open " << options.json_path << std::endl;
+        return -1;
+    }
+    write_json(out, frames);
+    if (out != stdout) fclose(out);
+    return 0;
+}
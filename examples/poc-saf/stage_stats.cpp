@@ -0,0 +1,68 @@
+#include "stage_stats.h"
+
+uint64_t LatencyHistogram::bucket_upper(int index)
+{
+    if (index < (1 << sub_bits)) return (uint64_t)index;
+    int shift = (index >> sub_bits) - 1;
+    uint64_t mantissa = (uint64_t)((index & ((1 << sub_bits) - 1)) | (1 << sub_bits));
+    return (mantissa << shift) + ((1ull << shift) - 1);
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+    uint64_t total = count();
+    if (total == 0) return 0;
+
+    uint64_t target = (uint64_t)(p / 100.0 * (double)total + 0.5);
+    if (target < 1) target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < num_buckets; ++i) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            // The bucket bound can exceed the largest sample actually seen
+            uint64_t upper = bucket_upper(i);
+            uint64_t m = max();
+            return upper < m ? upper : m;
+        }
+    }
+    return max();
+}
+
+const char* stage_name(Stage stage)
+{
+    switch (stage) {
+        case Stage::CaptureWait: return "capture_wait";
+        case Stage::Convert: return "convert";
+        case Stage::DspWait: return "dsp_wait";
+        case Stage::Encode: return "array2sh";
+        case Stage::Analysis: return "doa";
+        case Stage::Monitor: return "monitor";
+        case Stage::Block: return "block";
+        case Stage::Render: return "render";
+        default: return "?";
+    }
+}
+
+void stage_stats_report(const StageStats& stats, FILE* out)
+{
+    fprintf(out, "%-13s %10s %9s %9s %9s %9s %9s  (us)\n",
+            "stage", "count", "mean", "p50", "p99", "p99.9", "max");
+    for (int s = 0; s < (int)Stage::Count; ++s) {
+        const LatencyHistogram& h = stats.hist[s];
+        uint64_t n = h.count();
+        if (n == 0) continue;
+        fprintf(out, "%-13s %10llu %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+                stage_name((Stage)s), (unsigned long long)n,
+                (double)h.sum() / n / 1000.0,
+                h.percentile(50.0) / 1000.0,
+                h.percentile(99.0) / 1000.0,
+                h.percentile(99.9) / 1000.0,
+                h.max() / 1000.0);
+    }
+    if (stats.block_budget_ns) {
+        fprintf(out, "deadline misses: %llu (budget %.1f us)\n",
+                (unsigned long long)stats.deadline_misses.load(std::memory_order_relaxed),
+                stats.block_budget_ns / 1000.0);
+    }
+    fflush(out);
+}
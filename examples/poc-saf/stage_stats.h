@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+
+// Hot-path latency instrumentation: per-stage histograms of how long each
+// step of the chain took, cheap enough to leave enabled in production.
+
+// Monotonic timestamp in nanoseconds (vDSO, no syscall)
+inline uint64_t monotonic_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Log-linear (HDR-style) histogram of nanosecond durations: 16 linear
+// sub-buckets per power of two, i.e. at most ~6% relative error, over the
+// full 64-bit range in a fixed array. Exactly one thread may record();
+// any thread may read, and sees each counter individually up to date.
+class LatencyHistogram
+{
+public:
+    static const int sub_bits = 4;
+    static const int num_buckets = (64 - sub_bits + 1) << sub_bits;
+
+    void record(uint64_t ns)
+    {
+        // Single writer: plain load + store instead of locked read-modify-write
+        std::atomic<uint64_t>& b = buckets_[bucket_index(ns)];
+        b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum_.store(sum_.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+        if (ns > max_.load(std::memory_order_relaxed)) max_.store(ns, std::memory_order_relaxed);
+        count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_acquire); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket holding the p-th percentile (0 < p <= 100)
+    uint64_t percentile(double p) const;
+
+private:
+    static int bucket_index(uint64_t ns)
+    {
+        if (ns < (1u << sub_bits)) return (int)ns;
+        int shift = 63 - __builtin_clzll(ns) - sub_bits;
+        return ((shift + 1) << sub_bits) + (int)((ns >> shift) & ((1u << sub_bits) - 1));
+    }
+    static uint64_t bucket_upper(int index);
+
+    std::atomic<uint64_t> buckets_[num_buckets] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// Stages of the live chain. The capture thread records CaptureWait and
+// Convert, the UI thread Render, the DSP thread everything else, so every
+// histogram has one writer.
+enum class Stage
+{
+    CaptureWait, // blocked in snd_pcm_readi / poll() waiting for the device
+    Convert,     // deinterleave + convert + meter into the ring
+    DspWait,     // DSP thread waiting for a full SAF frame in the ring
+    Encode,      // array2sh_process
+    Analysis,    // sldoa_analysis (+ display data fetch) or the DoA engine
+    Monitor,     // headphone decode of the SH signals (--monitor)
+    Block,       // whole per-frame DSP work, checked against the frame deadline
+    Render,      // console output (UI thread, off the audio path)
+    Count
+};
+
+const char* stage_name(Stage stage);
+
+struct StageStats
+{
+    LatencyHistogram hist[(int)Stage::Count];
+
+    // Per-frame DSP deadline (one SAF frame of audio); 0 = not checked
+    uint64_t block_budget_ns = 0;
+    std::atomic<uint64_t> deadline_misses{0};
+
+    void record(Stage stage, uint64_t ns)
+    {
+        hist[(int)stage].record(ns);
+        if (stage == Stage::Block && block_budget_ns && ns > block_budget_ns) {
+            deadline_misses.store(deadline_misses.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+};
+
+// Times a scope into one stage. A null StageStats makes it a no-op.
+class StageTimer
+{
+public:
+    StageTimer(StageStats* stats, Stage stage)
+        : stats_(stats), stage_(stage), start_(stats ? monotonic_ns() : 0)
+    {
+    }
+    ~StageTimer()
+    {
+        if (stats_) stats_->record(stage_, monotonic_ns() - start_);
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    StageStats* stats_;
+    Stage stage_;
+    uint64_t start_;
+};
+
+// Writes a table of count / mean / p50 / p99 / p99.9 / max per stage (in
+// microseconds) plus the deadline misses. Not for the audio threads.
+void stage_stats_report(const StageStats& stats, FILE* out);
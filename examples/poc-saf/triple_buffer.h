@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+
+// Wait-free single-producer/single-consumer handoff of the latest value.
+//
+// Three slots: the writer fills its back slot and publish() swaps it with the
+// shared middle slot; the reader's update() swaps its front slot with the
+// middle one if something new was published. Neither side ever waits for the
+// other, and the reader always sees a complete value (the newest one; older
+// unread values are simply overwritten).
+template <typename T>
+class TripleBuffer
+{
+public:
+    // === Writer ===
+    T& write_buffer() { return slots_[back_].value; }
+
+    void publish()
+    {
+        int prev = middle_.exchange(back_ | dirty_bit, std::memory_order_acq_rel);
+        back_ = prev & index_mask;
+    }
+
+    // === Reader ===
+
+    // Takes the newest published value, if any. Returns false if nothing new.
+    bool update()
+    {
+        if (!(middle_.load(std::memory_order_relaxed) & dirty_bit)) return false;
+        int prev = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = prev & index_mask;
+        return true;
+    }
+
+    const T& read_buffer() const { return slots_[front_].value; }
+
+private:
+    static const int index_mask = 3;
+    static const int dirty_bit = 4;
+
+    struct alignas(64) Slot
+    {
+        T value{};
+    };
+    Slot slots_[3];
+
+    alignas(64) int back_ = 0;             // writer only
+    alignas(64) std::atomic<int> middle_{1};
+    alignas(64) int front_ = 2;            // reader only
+};
@@ -0,0 +1,99 @@
+#include "work_pool.h"
+#include "stage_stats.h"
+
+WorkStealingPool::WorkStealingPool(int num_workers, TaskFn run, WorkerFn on_start, WorkerFn on_exit)
+    : run_(std::move(run)), on_start_(std::move(on_start)), on_exit_(std::move(on_exit))
+{
+    if (num_workers < 1) num_workers = 1;
+    for (int w = 0; w < num_workers; ++w) workers_.emplace_back(new Worker());
+    for (int w = 0; w < num_workers; ++w) workers_[w]->thread = std::thread(&WorkStealingPool::worker_main, this, w);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    finish();
+}
+
+void WorkStealingPool::submit(int64_t task)
+{
+    Worker& worker = *workers_[next_worker_];
+    next_worker_ = (next_worker_ + 1) % (int)workers_.size();
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(task);
+    }
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        queued_.fetch_add(1);
+    }
+    idle_.notify_one();
+}
+
+void WorkStealingPool::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        finishing_ = true;
+    }
+    idle_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) worker->thread.join();
+    }
+}
+
+// Own deque first, then the oldest queued task anywhere
+bool WorkStealingPool::take(int w, int64_t& task)
+{
+    Worker& own = *workers_[w];
+    {
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    const int n = (int)workers_.size();
+    for (;;) {
+        int victim = -1;
+        int64_t oldest = 0;
+        for (int i = 1; i < n; ++i) {
+            const int v = (w + i) % n;
+            std::lock_guard<std::mutex> lock(workers_[v]->mutex);
+            if (workers_[v]->tasks.empty()) continue;
+            if (victim < 0 || workers_[v]->tasks.front() < oldest) {
+                victim = v;
+                oldest = workers_[v]->tasks.front();
+            }
+        }
+        if (victim < 0) return false;
+        // Someone may have been quicker; look again if so
+        std::lock_guard<std::mutex> lock(workers_[victim]->mutex);
+        if (workers_[victim]->tasks.empty()) continue;
+        task = workers_[victim]->tasks.front();
+        workers_[victim]->tasks.pop_front();
+        own.steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+}
+
+void WorkStealingPool::worker_main(int w)
+{
+    Worker& self = *workers_[w];
+    if (on_start_) on_start_(w);
+    for (;;) {
+        int64_t task;
+        if (!take(w, task)) {
+            std::unique_lock<std::mutex> lock(idle_mutex_);
+            idle_.wait(lock, [&] { return queued_.load() > 0 || finishing_; });
+            if (queued_.load() == 0 && finishing_) break;
+            continue;
+        }
+        queued_.fetch_sub(1);
+        const uint64_t start = monotonic_ns();
+        run_(w, task);
+        self.busy_ns.fetch_add(monotonic_ns() - start, std::memory_order_relaxed);
+        self.tasks_run.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (on_exit_) on_exit_(w);
+}
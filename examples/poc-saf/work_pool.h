@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool for coarse batch tasks (seconds of work each).
+//
+// Every worker owns a deque of task ids. submit() deals them out
+// round-robin, so each deque is in submission order. A worker runs the front
+// of its own deque; once that is empty it steals the front of the deque
+// whose front is oldest, i.e. the task an in-order consumer of the results
+// needs soonest. A mutex per deque is plenty at this granularity; what
+// matters is that no worker idles while any task is queued.
+class WorkStealingPool
+{
+public:
+    typedef std::function<void(int worker, int64_t task)> TaskFn;
+    typedef std::function<void(int worker)> WorkerFn;
+
+    // Starts num_workers threads. on_start runs first on each (per-worker
+    // setup: pinning, buffers), on_exit last, both on the worker's thread.
+    WorkStealingPool(int num_workers, TaskFn run, WorkerFn on_start = nullptr, WorkerFn on_exit = nullptr);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void submit(int64_t task);
+
+    // No more tasks: returns once every queued task has run and the workers
+    // have exited
+    void finish();
+
+    int num_workers() const { return (int)workers_.size(); }
+    uint64_t tasks_run(int worker) const { return workers_[worker]->tasks_run.load(); }
+    uint64_t steals(int worker) const { return workers_[worker]->steals.load(); }
+    uint64_t busy_ns(int worker) const { return workers_[worker]->busy_ns.load(); }
+
+private:
+    struct alignas(64) Worker
+    {
+        std::mutex mutex;
+        std::deque<int64_t> tasks;
+        std::thread thread;
+        std::atomic<uint64_t> tasks_run{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> busy_ns{0};
+    };
+
+    void worker_main(int w);
+    bool take(int w, int64_t& task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    TaskFn run_;
+    WorkerFn on_start_;
+    WorkerFn on_exit_;
+    int next_worker_ = 0;
+
+    std::mutex idle_mutex_;
+    std::condition_variable idle_;
+    std::atomic<int64_t> queued_{0};  // incremented under idle_mutex_
+    bool finishing_ = false;
+};